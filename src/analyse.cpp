@@ -0,0 +1,349 @@
+/*
+ * Stoat, a USI shogi engine
+ * Copyright (C) 2025 Ciekce
+ *
+ * Stoat is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Stoat is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Stoat. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "analyse.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <sstream>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "limit.h"
+#include "position.h"
+#include "search.h"
+#include "selfplay.h"
+#include "util/args.h"
+#include "util/split.h"
+#include "util/timer.h"
+
+namespace stoat::analyse {
+    namespace {
+        struct ParsedInput {
+            Position pos{};
+            std::vector<u64> keyHistory{};
+        };
+
+        // returns an error message on failure
+        [[nodiscard]] std::optional<std::string> parseInput(ParsedInput& dst, std::string_view line) {
+            std::vector<std::string_view> args{};
+            util::split(args, line);
+
+            auto parsed = Position::fromPositionCommand(args, dst.keyHistory);
+
+            if (!parsed) {
+                return parsed.takeErr();
+            }
+
+            dst.pos = parsed.take();
+            return {};
+        }
+
+        void writeJsonString(std::ostream& stream, std::string_view str) {
+            stream << '"';
+
+            for (const auto c : str) {
+                if (c == '"' || c == '\\') {
+                    stream << '\\' << c;
+                } else if (static_cast<u8>(c) < 0x20) {
+                    stream << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<u32>(c)
+                           << std::dec << std::setfill(' ');
+                } else {
+                    stream << c;
+                }
+            }
+
+            stream << '"';
+        }
+
+        // same conventions as search info, mate scores in plies
+        void writeScore(std::ostream& stream, Score score) {
+            if (std::abs(score) >= kScoreMaxMate) {
+                stream << "{\"mate\": " << (score > 0 ? kScoreMate - score : -(kScoreMate + score)) << "}";
+                return;
+            }
+
+            // clamp draw scores to 0
+            if (std::abs(score) <= 2) {
+                score = 0;
+            }
+
+            stream << "{\"cp\": " << score << "}";
+        }
+
+        void writeResult(std::ostream& stream, usize index, std::string_view input, const AnalysisResult& result) {
+            stream << "{\"index\": " << index << ", \"input\": ";
+            writeJsonString(stream, input);
+
+            // no legal moves
+            if (result.pv.length == 0) {
+                stream << ", \"bestmove\": \"resign\"";
+            } else {
+                stream << ", \"bestmove\": \"" << result.pv.moves[0] << "\"";
+            }
+
+            stream << ", \"score\": ";
+            writeScore(stream, result.score);
+
+            stream << ", \"depth\": " << result.depth;
+            stream << ", \"nodes\": " << result.nodes;
+            stream << ", \"time\": " << std::fixed << std::setprecision(3) << result.time << std::defaultfloat;
+
+            stream << ", \"pv\": \"";
+
+            for (u32 idx = 0; idx < result.pv.length; ++idx) {
+                if (idx > 0) {
+                    stream << ' ';
+                }
+
+                stream << result.pv.moves[idx];
+            }
+
+            stream << "\"}";
+        }
+
+        void writeError(std::ostream& stream, usize index, std::string_view input, std::string_view error) {
+            stream << "{\"index\": " << index << ", \"input\": ";
+            writeJsonString(stream, input);
+            stream << ", \"error\": ";
+            writeJsonString(stream, error);
+            stream << "}";
+        }
+
+        // lines finish out of order, and are held back until every earlier line is written
+        class OrderedWriter {
+        public:
+            explicit OrderedWriter(std::ostream& stream) :
+                    m_stream{stream} {}
+
+            void write(usize index, std::string line) {
+                const std::unique_lock lock{m_mutex};
+
+                m_pending.emplace(index, std::move(line));
+
+                // the first pending line is always the lowest index
+                while (!m_pending.empty() && m_pending.begin()->first == m_next) {
+                    m_stream << m_pending.begin()->second << '\n';
+                    m_pending.erase(m_pending.begin());
+                    ++m_next;
+                }
+
+                m_stream.flush();
+            }
+
+        private:
+            std::mutex m_mutex{};
+            std::ostream& m_stream;
+
+            std::map<usize, std::string> m_pending{};
+            usize m_next{};
+        };
+
+        [[nodiscard]] std::unique_ptr<limit::ISearchLimiter> createLimiter(const AnalyseConfig& config) {
+            auto limiter = std::make_unique<limit::CompoundLimiter>();
+
+            if (config.nodes) {
+                limiter->addLimiter<limit::NodeLimiter>(*config.nodes);
+            }
+
+            if (config.moveTime) {
+                limiter->addLimiter<limit::MoveTimeLimiter>(util::Instant::now(), *config.moveTime);
+            }
+
+            return limiter;
+        }
+    } // namespace
+
+    bool run(const AnalyseConfig& config) {
+        std::ifstream input{config.inputFile};
+
+        if (!input) {
+            std::cerr << "Failed to open input file '" << config.inputFile << "'" << std::endl;
+            return false;
+        }
+
+        std::vector<std::string> lines{};
+
+        std::string line{};
+        while (std::getline(input, line)) {
+            if (!line.empty() && line.back() == '\r') {
+                line.pop_back();
+            }
+
+            if (line.empty() || line[0] == '#') {
+                continue;
+            }
+
+            lines.push_back(std::move(line));
+        }
+
+        std::ofstream outputFile{};
+
+        if (!config.outputFile.empty()) {
+            outputFile.open(config.outputFile, std::ios::trunc);
+
+            if (!outputFile) {
+                std::cerr << "Failed to open output file '" << config.outputFile << "'" << std::endl;
+                return false;
+            }
+        }
+
+        auto workerCount = config.workers;
+
+        if (workerCount == 0) {
+            workerCount = std::max<u32>(1, std::thread::hardware_concurrency());
+        }
+
+        workerCount = std::min<u32>(workerCount, std::max<usize>(1, lines.size()));
+
+        const auto depth = config.depth.value_or(config.nodes || config.moveTime ? kMaxDepth : kDefaultAnalyseDepth);
+
+        const auto searchers = selfplay::createSearchers(workerCount, config.hashMib);
+
+        OrderedWriter writer{config.outputFile.empty() ? std::cout : outputFile};
+
+        std::atomic<usize> nextLine{};
+
+        const auto runWorker = [&](Searcher& searcher) {
+            ParsedInput parsed{};
+            AnalysisResult result{};
+
+            std::ostringstream stream{};
+
+            while (true) {
+                const auto index = nextLine.fetch_add(1, std::memory_order::relaxed);
+
+                if (index >= lines.size()) {
+                    break;
+                }
+
+                stream.str("");
+
+                if (const auto err = parseInput(parsed, lines[index])) {
+                    writeError(stream, index, lines[index], *err);
+                } else {
+                    searcher.newGame();
+                    searcher.runAnalysisSearch(result, parsed.pos, parsed.keyHistory, depth, createLimiter(config));
+
+                    writeResult(stream, index, lines[index], result);
+                }
+
+                writer.write(index, stream.str());
+            }
+        };
+
+        const auto start = util::Instant::now();
+
+        std::vector<std::thread> threads{};
+        threads.reserve(workerCount);
+
+        for (u32 idx = 0; idx < workerCount; ++idx) {
+            threads.emplace_back(runWorker, std::ref(*searchers[idx]));
+        }
+
+        for (auto& thread : threads) {
+            thread.join();
+        }
+
+        const auto time = start.elapsed();
+
+        std::cerr << "Analysed " << lines.size() << " positions with " << workerCount << " workers in "
+                  << std::fixed << std::setprecision(3) << time << " s" << std::defaultfloat << std::endl;
+
+        return true;
+    }
+
+    std::optional<AnalyseConfig> parseArgs(std::span<const std::string_view> args) {
+        AnalyseConfig config{};
+
+        const auto onOption = [&](std::string_view name, std::string_view value) {
+            if (name == "--workers") {
+                if (!util::parseArg(config.workers, value, "worker count")) {
+                    return false;
+                }
+
+                config.workers = std::min(config.workers, kThreadCountRange.max());
+            } else if (name == "--hash") {
+                if (!util::parseArg(config.hashMib, value, "hash size")) {
+                    return false;
+                }
+
+                config.hashMib = tt::kTtSizeRange.clamp(config.hashMib);
+            } else if (name == "--depth") {
+                i32 depth{};
+
+                if (!util::parseArg(depth, value, "depth")) {
+                    return false;
+                }
+
+                config.depth = std::clamp(depth, 1, kMaxDepth);
+            } else if (name == "--nodes") {
+                usize nodes{};
+
+                if (!util::parseArg(nodes, value, "node count")) {
+                    return false;
+                }
+
+                config.nodes = nodes;
+            } else if (name == "--movetime") {
+                i64 moveTime{};
+
+                if (!util::parseArg(moveTime, value, "move time")) {
+                    return false;
+                }
+
+                config.moveTime = static_cast<f64>(std::max<i64>(moveTime, 1)) / 1000.0;
+            } else if (name == "--out") {
+                config.outputFile = value;
+            } else {
+                return util::unknownOption("analyse", name);
+            }
+
+            return true;
+        };
+
+        const auto onPositional = [&](std::string_view arg) {
+            if (!config.inputFile.empty()) {
+                return util::unexpectedArg(arg);
+            }
+
+            config.inputFile = arg;
+            return true;
+        };
+
+        if (!util::parseArgs(args, onOption, onPositional)) {
+            return {};
+        }
+
+        if (config.inputFile.empty()) {
+            std::cerr << "Missing input file" << std::endl;
+            return {};
+        }
+
+        return config;
+    }
+} // namespace stoat::analyse
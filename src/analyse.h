@@ -0,0 +1,62 @@
+/*
+ * Stoat, a USI shogi engine
+ * Copyright (C) 2025 Ciekce
+ *
+ * Stoat is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Stoat is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Stoat. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "types.h"
+
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+
+namespace stoat::analyse {
+    // used if no other limit is given
+    constexpr i32 kDefaultAnalyseDepth = 10;
+    constexpr usize kDefaultAnalyseHashMib = 16;
+
+    struct AnalyseConfig {
+        // one position per line, as a bare sfen or as the arguments of a position command,
+        // e.g. "startpos moves 7g7f 3c3d" or "sfen <sfen> moves 7g7f"
+        std::string inputFile{};
+        // stdout if empty
+        std::string outputFile{};
+
+        // hardware concurrency if 0
+        u32 workers{};
+        // per worker, every worker searches with a single thread and its own tt
+        usize hashMib{kDefaultAnalyseHashMib};
+
+        std::optional<i32> depth{};
+        std::optional<usize> nodes{};
+        // in seconds
+        std::optional<f64> moveTime{};
+    };
+
+    // Searches every position independently, and writes one json object per line
+    // in input order as soon as all earlier positions are done. Every position is
+    // searched from a cleared tt and history, so results only depend on the position
+    // and limits, unless the search is time limited.
+    // returns false if the input or output file could not be opened
+    bool run(const AnalyseConfig& config);
+
+    // <file> [--workers <count>] [--hash <mib>] [--depth <depth>] [--nodes <nodes>]
+    //     [--movetime <ms>] [--out <path>]
+    // prints an error and returns nothing if the arguments are invalid
+    [[nodiscard]] std::optional<AnalyseConfig> parseArgs(std::span<const std::string_view> args);
+} // namespace stoat::analyse
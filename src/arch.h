@@ -23,11 +23,37 @@
 #include <new>
 
 #if defined(ST_NATIVE)
-    // cannot expand a macro to defined()
-    #if __BMI2__ && defined(ST_FAST_PEXT)
-        #define ST_HAS_FAST_PEXT 1
+    // whether pext is available at all, the slider backend that
+    // uses it is only selected at runtime on cpus where it is fast
+    #if __BMI2__
+        #define ST_HAS_BMI2 1
     #else
-        #define ST_HAS_FAST_PEXT 0
+        #define ST_HAS_BMI2 0
+    #endif
+
+    #if __AVX512F__ && __AVX512BW__
+        #define ST_HAS_AVX512 1
+    #else
+        #define ST_HAS_AVX512 0
+    #endif
+
+    #if __AVX2__
+        #define ST_HAS_AVX2 1
+    #else
+        #define ST_HAS_AVX2 0
+    #endif
+
+    #if __ARM_NEON
+        #define ST_HAS_NEON 1
+    #else
+        #define ST_HAS_NEON 0
+    #endif
+
+    // opt-in, keeps bitboards in a vector register instead of a pair of gprs
+    #if defined(ST_VECTOR_BITBOARD) && (__SSE2__ || __ARM_NEON)
+        #define ST_HAS_VECTOR_BITBOARD 1
+    #else
+        #define ST_HAS_VECTOR_BITBOARD 0
     #endif
 #else //TODO others
     #error no arch specified
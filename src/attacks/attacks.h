@@ -26,11 +26,7 @@
 #include "../core.h"
 #include "../util/multi_array.h"
 
-#if ST_HAS_FAST_PEXT
-    #include "sliders/bmi2.h"
-#else
-    #include "sliders/black_magic.h"
-#endif
+#include "sliders/backend.h"
 
 namespace stoat::attacks {
     namespace tables {
@@ -0,0 +1,137 @@
+/*
+ * Stoat, a USI shogi engine
+ * Copyright (C) 2025 Ciekce
+ *
+ * Stoat is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Stoat is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Stoat. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "backend.h"
+
+#if ST_HAS_BMI2
+    #include <cpuid.h>
+#endif
+
+namespace stoat::attacks::sliders {
+    namespace {
+#if ST_HAS_BMI2
+        [[nodiscard]] bool hasFastPext() {
+            // may run before the cpu model has been initialised otherwise
+            __builtin_cpu_init();
+
+            if (!__builtin_cpu_supports("bmi2")) {
+                return false;
+            }
+
+            if (!__builtin_cpu_is("amd")) {
+                return true;
+            }
+
+            u32 eax{};
+            u32 ebx{};
+            u32 ecx{};
+            u32 edx{};
+
+            if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+                return false;
+            }
+
+            auto family = (eax >> 8) & 0xf;
+
+            if (family == 0xf) {
+                family += (eax >> 20) & 0xff;
+            }
+
+            // zen 3 and later
+            return family >= 0x19;
+        }
+#endif
+    } // namespace
+
+    Backend internal::g_backend = detectBackend();
+
+    Backend detectBackend() {
+#if ST_HAS_BMI2
+        if (hasFastPext()) {
+            return Backend::kBmi2;
+        }
+#endif
+
+        return Backend::kBlackMagic;
+    }
+
+    bool isSupported(Backend backend) {
+        switch (backend) {
+            case Backend::kBlackMagic:
+                return true;
+            case Backend::kBmi2:
+            case Backend::kBmi2Compact:
+#if ST_HAS_BMI2
+                return __builtin_cpu_supports("bmi2");
+#else
+                return false;
+#endif
+        }
+
+        return false;
+    }
+
+    bool setBackend(Backend backend) {
+        if (!isSupported(backend)) {
+            return false;
+        }
+
+        internal::g_backend = backend;
+        return true;
+    }
+
+    usize tableBytes(Backend backend) {
+        switch (backend) {
+            case Backend::kBlackMagic:
+                return sizeof(black_magic::g_bishopAttacks);
+#if ST_HAS_BMI2
+            case Backend::kBmi2:
+                return sizeof(bmi2::g_bishopAttacks);
+            case Backend::kBmi2Compact:
+                return sizeof(bmi2::g_compactBishopAttacks);
+#endif
+            default:
+                return 0;
+        }
+    }
+
+    std::string_view backendName(Backend backend) {
+        switch (backend) {
+            case Backend::kBlackMagic:
+                return "blackmagic";
+            case Backend::kBmi2:
+                return "bmi2";
+            case Backend::kBmi2Compact:
+                return "bmi2compact";
+        }
+
+        return "<unknown>";
+    }
+
+    std::optional<Backend> parseBackend(std::string_view name) {
+        if (name == "blackmagic") {
+            return Backend::kBlackMagic;
+        } else if (name == "bmi2") {
+            return Backend::kBmi2;
+        } else if (name == "bmi2compact") {
+            return Backend::kBmi2Compact;
+        }
+
+        return {};
+    }
+} // namespace stoat::attacks::sliders
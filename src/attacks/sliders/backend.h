@@ -0,0 +1,91 @@
+/*
+ * Stoat, a USI shogi engine
+ * Copyright (C) 2025 Ciekce
+ *
+ * Stoat is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Stoat is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Stoat. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "../../types.h"
+
+#include <optional>
+#include <string_view>
+
+#include "../../arch.h"
+#include "../../bitboard.h"
+#include "../../core.h"
+#include "black_magic.h"
+#include "lines.h"
+
+#if ST_HAS_BMI2
+    #include "bmi2.h"
+#endif
+
+// Lances and rooks avoid the large tables, see lines.h. For bishops, both table backends are built when
+// the target has bmi2, as pext is microcoded on amd cpus before zen 3. The one to use is picked from cpuid at startup
+namespace stoat::attacks::sliders {
+    enum class Backend : u8 {
+        kBlackMagic = 0,
+        kBmi2,
+        // bmi2 with 16-bit entries expanded by pdep, for when the full table does not stay in cache
+        kBmi2Compact,
+    };
+
+    namespace internal {
+        // only changed while no search is running
+        extern Backend g_backend;
+    } // namespace internal
+
+    [[nodiscard]] inline Backend backend() {
+        return internal::g_backend;
+    }
+
+    // the fastest backend supported by this cpu and build
+    [[nodiscard]] Backend detectBackend();
+
+    [[nodiscard]] bool isSupported(Backend backend);
+
+    // false if the backend is not supported
+    bool setBackend(Backend backend);
+
+    // size of the bishop attack table used by the backend
+    [[nodiscard]] usize tableBytes(Backend backend);
+
+    [[nodiscard]] std::string_view backendName(Backend backend);
+    [[nodiscard]] std::optional<Backend> parseBackend(std::string_view name);
+
+    [[nodiscard]] inline Bitboard lanceAttacks(Square sq, Color c, Bitboard occ) {
+        return lines::lanceAttacks(sq, c, occ);
+    }
+
+    [[nodiscard]] inline Bitboard bishopAttacks(Square sq, Bitboard occ) {
+#if ST_HAS_BMI2
+        switch (backend()) {
+            case Backend::kBmi2:
+                return bmi2::bishopAttacks(sq, occ);
+            case Backend::kBmi2Compact:
+                return bmi2::compactBishopAttacks(sq, occ);
+            default:
+                break;
+        }
+#endif
+
+        return black_magic::bishopAttacks(sq, occ);
+    }
+
+    [[nodiscard]] inline Bitboard rookAttacks(Square sq, Bitboard occ) {
+        return lines::rookAttacks(sq, occ);
+    }
+} // namespace stoat::attacks::sliders
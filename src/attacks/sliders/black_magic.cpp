@@ -16,10 +16,7 @@
  * along with Stoat. If not, see <https://www.gnu.org/licenses/>.
  */
 
-#include "../../arch.h"
-
-#if !ST_HAS_FAST_PEXT
-    #include "black_magic.h"
+#include "black_magic.h"
 
 namespace stoat::attacks::sliders::black_magic {
     namespace {
@@ -60,31 +57,10 @@ namespace stoat::attacks::sliders::black_magic {
         }
     } // namespace
 
-    const util::MultiArray<Bitboard, Colors::kCount, kLanceDataTableSize> g_lanceAttacks = {
-        generateAttacks<kLanceDataTableSize, offsets::kNorth>(
-            lanceData(Colors::kBlack),
-            lanceMagics(Colors::kBlack),
-            lanceShifts(Colors::kBlack)
-        ),
-        generateAttacks<kLanceDataTableSize, offsets::kSouth>(
-            lanceData(Colors::kWhite),
-            lanceMagics(Colors::kWhite),
-            lanceShifts(Colors::kWhite)
-        ),
-    };
-
     const std::array<Bitboard, kBishopData.tableSize> g_bishopAttacks = generateAttacks<
         kBishopData.tableSize,
         offsets::kNorthWest,
         offsets::kNorthEast,
         offsets::kSouthWest,
         offsets::kSouthEast>(kBishopData, kBishopMagics, kBishopShifts);
-
-    const std::array<Bitboard, kRookData.tableSize> g_rookAttacks =
-        generateAttacks<kRookData.tableSize, offsets::kNorth, offsets::kSouth, offsets::kWest, offsets::kEast>(
-            kRookData,
-            kRookMagics,
-            kRookShifts
-        );
 } // namespace stoat::attacks::sliders::black_magic
-#endif
@@ -25,53 +25,47 @@
 
 #include "../../core.h"
 #include "../../util/bits.h"
-#include "../../util/multi_array.h"
 #include "data.h"
+#include "magics.h"
 
-namespace stoat::attacks::sliders {
-    namespace black_magic {
-        extern const util::MultiArray<Bitboard, Colors::kCount, kLanceDataTableSize> g_lanceAttacks;
+namespace stoat::attacks::sliders::black_magic {
+    template <i32... kDirs>
+    consteval internal::PieceData generatePieceData(std::span<const i32, Squares::kCount> shifts) {
+        internal::PieceData dst{};
 
-        [[nodiscard]] inline std::span<const Bitboard, kLanceDataTableSize> lanceAttacks(Color c) {
-            assert(c);
-            return g_lanceAttacks[c.idx()];
-        }
-
-        extern const std::array<Bitboard, kBishopData.tableSize> g_bishopAttacks;
-        extern const std::array<Bitboard, kRookData.tableSize> g_rookAttacks;
+        for (i32 sqIdx = 0; sqIdx < Squares::kCount; ++sqIdx) {
+            const auto sq = Square::fromRaw(sqIdx);
+            auto& sqData = dst.squares[sq.idx()];
 
-        [[nodiscard]] inline usize calcIdx(Bitboard occ, u128 mask, u128 magic, i32 shift) {
-            return static_cast<usize>(((occ.raw() | mask) * magic) >> shift);
-        }
-    } // namespace black_magic
+            const auto mask = internal::relevantOccupancy<kDirs...>(sq);
 
-    [[nodiscard]] inline Bitboard lanceAttacks(Square sq, Color c, Bitboard occ) {
-        const auto& sqData = lanceData(c).squares[sq.idx()];
+            sqData.offset = dst.tableSize;
+            sqData.mask = ~mask.raw();
 
-        const auto magic = black_magic::lanceMagics(c)[sq.idx()];
-        const auto shift = black_magic::lanceShifts(c)[sq.idx()];
+            dst.tableSize += 1 << (128 - shifts[sq.idx()]);
+        }
 
-        const usize idx = black_magic::calcIdx(occ, sqData.mask, magic, shift);
-        return black_magic::lanceAttacks(c)[sqData.offset + idx];
+        return dst;
     }
 
-    [[nodiscard]] inline Bitboard bishopAttacks(Square sq, Bitboard occ) {
-        const auto& sqData = kBishopData.squares[sq.idx()];
+    constexpr auto kBishopData =
+        generatePieceData<offsets::kNorthWest, offsets::kNorthEast, offsets::kSouthWest, offsets::kSouthEast>(
+            kBishopShifts
+        );
 
-        const auto magic = black_magic::kBishopMagics[sq.idx()];
-        const auto shift = black_magic::kBishopShifts[sq.idx()];
+    extern const std::array<Bitboard, kBishopData.tableSize> g_bishopAttacks;
 
-        const usize idx = black_magic::calcIdx(occ, sqData.mask, magic, shift);
-        return black_magic::g_bishopAttacks[sqData.offset + idx];
+    [[nodiscard]] inline usize calcIdx(Bitboard occ, u128 mask, u128 magic, i32 shift) {
+        return static_cast<usize>(((occ.raw() | mask) * magic) >> shift);
     }
 
-    [[nodiscard]] inline Bitboard rookAttacks(Square sq, Bitboard occ) {
-        const auto& sqData = kRookData.squares[sq.idx()];
+    [[nodiscard]] inline Bitboard bishopAttacks(Square sq, Bitboard occ) {
+        const auto& sqData = kBishopData.squares[sq.idx()];
 
-        const auto magic = black_magic::kRookMagics[sq.idx()];
-        const auto shift = black_magic::kRookShifts[sq.idx()];
+        const auto magic = kBishopMagics[sq.idx()];
+        const auto shift = kBishopShifts[sq.idx()];
 
-        const usize idx = black_magic::calcIdx(occ, sqData.mask, magic, shift);
-        return black_magic::g_rookAttacks[sqData.offset + idx];
+        const usize idx = calcIdx(occ, sqData.mask, magic, shift);
+        return g_bishopAttacks[sqData.offset + idx];
     }
-} // namespace stoat::attacks::sliders
+} // namespace stoat::attacks::sliders::black_magic
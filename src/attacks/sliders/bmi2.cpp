@@ -18,7 +18,7 @@
 
 #include "../../arch.h"
 
-#if ST_HAS_FAST_PEXT
+#if ST_HAS_BMI2
     #include "bmi2.h"
 
 namespace stoat::attacks::sliders::bmi2 {
@@ -46,12 +46,34 @@ namespace stoat::attacks::sliders::bmi2 {
 
             return dst;
         }
-    } // namespace
 
-    const util::MultiArray<Bitboard, Colors::kCount, kLanceDataTableSize> g_lanceAttacks = {
-        generateAttacks<kLanceDataTableSize, offsets::kNorth>(lanceData(Colors::kBlack)),
-        generateAttacks<kLanceDataTableSize, offsets::kSouth>(lanceData(Colors::kWhite)),
-    };
+        template <usize kTableSize>
+        std::array<u16, kTableSize> compressAttacks(
+            const std::array<Bitboard, kTableSize>& attacks,
+            const internal::PieceData& data,
+            const internal::PieceData& compactData
+        ) {
+            std::array<u16, kTableSize> dst{};
+
+            for (i32 sqIdx = 0; sqIdx < Squares::kCount; ++sqIdx) {
+                const auto& sqData = data.squares[sqIdx];
+                const auto& compactSqData = compactData.squares[sqIdx];
+
+                assert(util::popcount(compactSqData.mask) <= 16);
+
+                const auto entries = 1 << util::popcount(sqData.mask);
+
+                for (i32 i = 0; i < entries; ++i) {
+                    const auto idx = sqData.offset + i;
+                    const auto packed = util::pext(attacks[idx].raw(), compactSqData.mask, compactSqData.shift);
+
+                    dst[idx] = static_cast<u16>(packed);
+                }
+            }
+
+            return dst;
+        }
+    } // namespace
 
     const std::array<Bitboard, kBishopData.tableSize> g_bishopAttacks = generateAttacks<
         kBishopData.tableSize,
@@ -60,8 +82,7 @@ namespace stoat::attacks::sliders::bmi2 {
         offsets::kSouthWest,
         offsets::kSouthEast>(kBishopData);
 
-    const std::array<Bitboard, kRookData.tableSize> g_rookAttacks =
-        generateAttacks<kRookData.tableSize, offsets::kNorth, offsets::kSouth, offsets::kWest, offsets::kEast>(kRookData
-        );
+    const std::array<u16, kBishopData.tableSize> g_compactBishopAttacks =
+        compressAttacks(g_bishopAttacks, kBishopData, kCompactBishopData);
 } // namespace stoat::attacks::sliders::bmi2
 #endif
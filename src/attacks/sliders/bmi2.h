@@ -21,44 +21,81 @@
 #include "../../types.h"
 
 #include <array>
-#include <span>
 
 #include "../../core.h"
 #include "../../util/bits.h"
-#include "../../util/multi_array.h"
 #include "data.h"
 
-namespace stoat::attacks::sliders {
-    namespace bmi2 {
-        extern const util::MultiArray<Bitboard, Colors::kCount, kLanceDataTableSize> g_lanceAttacks;
+namespace stoat::attacks::sliders::bmi2 {
+    template <i32... kDirs>
+    consteval internal::PieceData generatePieceData() {
+        internal::PieceData dst{};
 
-        [[nodiscard]] inline std::span<const Bitboard, kLanceDataTableSize> lanceAttacks(Color c) {
-            assert(c);
-            return g_lanceAttacks[c.idx()];
+        for (i32 sqIdx = 0; sqIdx < Squares::kCount; ++sqIdx) {
+            const auto sq = Square::fromRaw(sqIdx);
+            auto& sqData = dst.squares[sq.idx()];
+
+            const auto mask = internal::relevantOccupancy<kDirs...>(sq);
+
+            sqData.offset = dst.tableSize;
+            sqData.mask = mask.raw();
+            sqData.shift = std::popcount(static_cast<u64>(mask.raw()));
+
+            dst.tableSize += 1 << mask.popcount();
         }
 
-        extern const std::array<Bitboard, kBishopData.tableSize> g_bishopAttacks;
-        extern const std::array<Bitboard, kRookData.tableSize> g_rookAttacks;
-    } // namespace bmi2
+        return dst;
+    }
 
-    [[nodiscard]] inline Bitboard lanceAttacks(Square sq, Color c, Bitboard occ) {
-        const auto& sqData = lanceData(c).squares[sq.idx()];
+    // same layout as the full table, but each entry only holds the attacked squares
+    // packed down to the bits of the empty board attack set, at most 16 for a bishop
+    template <i32... kDirs>
+    consteval internal::PieceData generateCompactPieceData(const internal::PieceData& full) {
+        internal::PieceData dst{full};
 
-        const usize idx = util::pext(occ.raw(), sqData.mask, sqData.shift);
-        return bmi2::lanceAttacks(c)[sqData.offset + idx];
+        for (i32 sqIdx = 0; sqIdx < Squares::kCount; ++sqIdx) {
+            const auto sq = Square::fromRaw(sqIdx);
+            auto& sqData = dst.squares[sq.idx()];
+
+            Bitboard mask{};
+
+            for (const auto dir : {kDirs...}) {
+                mask |= internal::generateSlidingAttacks(sq, dir, Bitboards::kEmpty);
+            }
+
+            sqData.mask = mask.raw();
+            sqData.shift = std::popcount(static_cast<u64>(mask.raw()));
+        }
+
+        return dst;
     }
 
+    constexpr auto kBishopData =
+        generatePieceData<offsets::kNorthWest, offsets::kNorthEast, offsets::kSouthWest, offsets::kSouthEast>();
+    constexpr auto kCompactBishopData = generateCompactPieceData<
+        offsets::kNorthWest,
+        offsets::kNorthEast,
+        offsets::kSouthWest,
+        offsets::kSouthEast>(kBishopData);
+
+    extern const std::array<Bitboard, kBishopData.tableSize> g_bishopAttacks;
+    extern const std::array<u16, kBishopData.tableSize> g_compactBishopAttacks;
+
     [[nodiscard]] inline Bitboard bishopAttacks(Square sq, Bitboard occ) {
         const auto& sqData = kBishopData.squares[sq.idx()];
 
         const usize idx = util::pext(occ.raw(), sqData.mask, sqData.shift);
-        return bmi2::g_bishopAttacks[sqData.offset + idx];
+        return g_bishopAttacks[sqData.offset + idx];
     }
 
-    [[nodiscard]] inline Bitboard rookAttacks(Square sq, Bitboard occ) {
-        const auto& sqData = kRookData.squares[sq.idx()];
+    // an eighth of the size of the full table, at the cost of a pdep per lookup
+    [[nodiscard]] inline Bitboard compactBishopAttacks(Square sq, Bitboard occ) {
+        const auto& sqData = kBishopData.squares[sq.idx()];
+        const auto& compactData = kCompactBishopData.squares[sq.idx()];
 
         const usize idx = util::pext(occ.raw(), sqData.mask, sqData.shift);
-        return bmi2::g_rookAttacks[sqData.offset + idx];
+        const auto packed = g_compactBishopAttacks[sqData.offset + idx];
+
+        return Bitboard{util::pdep(packed, compactData.mask, compactData.shift)};
     }
-} // namespace stoat::attacks::sliders
+} // namespace stoat::attacks::sliders::bmi2
@@ -20,109 +20,35 @@
 
 #include "../../types.h"
 
-#include <span>
+#include <array>
 
 #include "../../bitboard.h"
 #include "../../core.h"
 #include "util.h"
 
-#if !ST_HAS_FAST_PEXT
-    #include "magics.h"
-#endif
-
-namespace stoat::attacks::sliders {
-    namespace internal {
-        struct SquareData {
-            u128 mask;
-            u32 offset;
-#if ST_HAS_FAST_PEXT
-            i32 shift;
-#endif
-        };
-
-        struct PieceData {
-            std::array<SquareData, Squares::kCount> squares;
-            u32 tableSize;
-        };
-
-        template <i32... kDirs>
-        consteval PieceData generatePieceData(
-#if !ST_HAS_FAST_PEXT
-            std::span<const i32, Squares::kCount> shifts
-#endif
-        ) {
-            PieceData dst{};
-
-            for (i32 sqIdx = 0; sqIdx < Squares::kCount; ++sqIdx) {
-                const auto sq = Square::fromRaw(sqIdx);
-                auto& sqData = dst.squares[sq.idx()];
-
-#if !ST_HAS_FAST_PEXT
-                // lances
-                if (shifts[sq.idx()] == 0) {
-                    sqData.offset = dst.tableSize;
-                    ++dst.tableSize;
-                    continue;
-                }
-#endif
-
-                Bitboard mask{};
-
-                for (const auto dir : {kDirs...}) {
-                    const auto attacks = internal::generateSlidingAttacks(sq, dir, Bitboards::kEmpty);
-
-                    mask |= attacks & ~internal::edges(dir);
-                }
+namespace stoat::attacks::sliders::internal {
+    struct SquareData {
+        u128 mask;
+        u32 offset;
+        // popcount of the low half of the mask, only used by the bmi2 backend
+        i32 shift;
+    };
 
-                sqData.offset = dst.tableSize;
+    struct PieceData {
+        std::array<SquareData, Squares::kCount> squares;
+        u32 tableSize;
+    };
 
-#if ST_HAS_FAST_PEXT
-                sqData.mask = mask.raw();
-                sqData.shift = std::popcount(static_cast<u64>(mask.raw()));
-                dst.tableSize += 1 << mask.popcount();
-#else
-                sqData.mask = ~mask.raw();
-                dst.tableSize += 1 << (128 - shifts[sq.idx()]);
-#endif
-            }
+    // squares whose occupancy affects the attacks of a slider on sq, excluding the edges
+    template <i32... kDirs>
+    consteval Bitboard relevantOccupancy(Square sq) {
+        Bitboard mask{};
 
-            return dst;
+        for (const auto dir : {kDirs...}) {
+            const auto attacks = generateSlidingAttacks(sq, dir, Bitboards::kEmpty);
+            mask |= attacks & ~edges(dir);
         }
-    } // namespace internal
-
-    constexpr std::array<internal::PieceData, Colors::kCount> kLanceData = {
-        internal::generatePieceData<offsets::kNorth>(
-#if !ST_HAS_FAST_PEXT
-            black_magic::lanceShifts(Colors::kBlack)
-#endif
-        ),
-        internal::generatePieceData<offsets::kSouth>(
-#if !ST_HAS_FAST_PEXT
-            black_magic::lanceShifts(Colors::kWhite)
-#endif
-        ),
-    };
 
-    static_assert(kLanceData[0].tableSize == kLanceData[1].tableSize);
-
-    [[nodiscard]] constexpr const internal::PieceData& lanceData(Color c) {
-        assert(c);
-        return kLanceData[c.idx()];
+        return mask;
     }
-
-    constexpr usize kLanceDataTableSize = kLanceData[0].tableSize;
-
-    constexpr auto kBishopData =
-        internal::generatePieceData<offsets::kNorthWest, offsets::kNorthEast, offsets::kSouthWest, offsets::kSouthEast>(
-#if !ST_HAS_FAST_PEXT
-            black_magic::kBishopShifts
-#endif
-        );
-
-    constexpr auto kRookData =
-        internal::generatePieceData<offsets::kNorth, offsets::kSouth, offsets::kWest, offsets::kEast>(
-#if !ST_HAS_FAST_PEXT
-            black_magic::kRookShifts
-#endif
-        );
-} // namespace stoat::attacks::sliders
+} // namespace stoat::attacks::sliders::internal
@@ -0,0 +1,89 @@
+/*
+ * Stoat, a USI shogi engine
+ * Copyright (C) 2025 Ciekce
+ *
+ * Stoat is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Stoat is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Stoat. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "../../types.h"
+
+#include "../../bitboard.h"
+#include "../../core.h"
+#include "../../util/bits.h"
+#include "../../util/multi_array.h"
+#include "util.h"
+
+// Table-free attacks along files, and a tiny table for ranks. Files are strided by 9
+// bits, so the nearest blocker on each side is found with a borrow and a clz instead
+namespace stoat::attacks::sliders::lines {
+    // rank attacks of a slider on each file of the first rank, by the occupancy of the 7 inner squares
+    constexpr auto kRankAttacks = [] {
+        util::MultiArray<u16, 9, 128> dst{};
+
+        for (i32 file = 0; file < 9; ++file) {
+            const auto sq = Square::fromFileRank(file, 0);
+
+            for (u32 inner = 0; inner < 128; ++inner) {
+                const Bitboard occ{static_cast<u128>(inner) << 1};
+
+                const auto attacks = internal::generateSlidingAttacks(sq, offsets::kWest, occ)
+                                   | internal::generateSlidingAttacks(sq, offsets::kEast, occ);
+
+                dst[file][inner] = static_cast<u16>(attacks.raw());
+            }
+        }
+
+        return dst;
+    }();
+
+    [[nodiscard]] inline Bitboard northAttacks(Square sq, Bitboard occ) {
+        const auto ray = kEmptyBoardLanceAttacks[Colors::kBlack.idx()][sq.idx()].raw();
+        const auto blockers = occ.raw() & ray;
+
+        // everything up to and including the lowest blocker, the whole ray if there is none
+        return Bitboard{ray & (blockers ^ (blockers - 1))};
+    }
+
+    [[nodiscard]] inline Bitboard southAttacks(Square sq, Bitboard occ) {
+        const auto ray = kEmptyBoardLanceAttacks[Colors::kWhite.idx()][sq.idx()].raw();
+
+        // bit 0 cannot be above the highest blocker, and selects the whole ray if there is none
+        const auto blockers = (occ.raw() & ray) | 1;
+        const auto highest = 127 - util::clz(blockers);
+
+        return Bitboard{ray & ~((u128{1} << highest) - 1)};
+    }
+
+    [[nodiscard]] inline Bitboard lanceAttacks(Square sq, Color c, Bitboard occ) {
+        assert(c);
+        return c == Colors::kBlack ? northAttacks(sq, occ) : southAttacks(sq, occ);
+    }
+
+    [[nodiscard]] inline Bitboard fileAttacks(Square sq, Bitboard occ) {
+        return northAttacks(sq, occ) | southAttacks(sq, occ);
+    }
+
+    [[nodiscard]] inline Bitboard rankAttacks(Square sq, Bitboard occ) {
+        const auto shift = sq.rank() * 9;
+        const auto inner = static_cast<u32>(occ.raw() >> (shift + 1)) & 0x7f;
+
+        return Bitboard{static_cast<u128>(kRankAttacks[sq.file()][inner]) << shift};
+    }
+
+    [[nodiscard]] inline Bitboard rookAttacks(Square sq, Bitboard occ) {
+        return fileAttacks(sq, occ) | rankAttacks(sq, occ);
+    }
+} // namespace stoat::attacks::sliders::lines
@@ -18,53 +18,427 @@
 
 #include "bench.h"
 
+#include <algorithm>
 #include <array>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <span>
 #include <string_view>
+#include <vector>
 
+#include "attacks/sliders/backend.h"
 #include "position.h"
+#include "protocol/output.h"
 #include "search.h"
+#include "util/args.h"
+#include "util/rng.h"
+#include "util/timer.h"
 
 namespace stoat::bench {
     namespace {
-        using namespace std::string_view_literals;
-
-        // partially from the USI spec, partially from YaneuraOu
-        constexpr std::array kBenchSfens = {
-            "lnsgkgsnl/1r5b1/ppppppppp/9/9/9/PPPPPPPPP/1B5R1/LNSGKGSNL b - 1"sv,
-            "8l/1l+R2P3/p2pBG1pp/kps1p4/Nn1P2G2/P1P1P2PP/1PS6/1KSG3+r1/LN2+p3L w Sbgn3p 124"sv,
-            "lnsgkgsnl/1r7/p1ppp1bpp/1p3pp2/7P1/2P6/PP1PPPP1P/1B3S1R1/LNSGKG1NL b - 9"sv,
-            "l4S2l/4g1gs1/5p1p1/pr2N1pkp/4Gn3/PP3PPPP/2GPP4/1K7/L3r+s2L w BS2N5Pb 1"sv,
-            "6n1l/2+S1k4/2lp4p/1np1B2b1/3PP4/1N1S3rP/1P2+pPP+p1/1p1G5/3KG2r1 b GSN2L4Pgs2p 1"sv,
-            "l6nl/5+P1gk/2np1S3/p1p4Pp/3P2Sp1/1PPb2P1P/P5GS1/R8/LN4bKL w RGgsn5p 1"sv,
+        struct PositionResult {
+            std::string sfen{};
+            usize nodes{};
+            // one per run
+            std::vector<f64> times{};
         };
 
-        constexpr usize kTtSizeMib = 16;
+        [[nodiscard]] f64 median(std::vector<f64> values) {
+            assert(!values.empty());
+
+            std::ranges::sort(values);
+
+            const auto mid = values.size() / 2;
+            return values.size() % 2 == 0 ? (values[mid - 1] + values[mid]) / 2.0 : values[mid];
+        }
+
+        [[nodiscard]] f64 stddev(std::span<const f64> values) {
+            f64 mean{};
+
+            for (const auto value : values) {
+                mean += value;
+            }
+
+            mean /= static_cast<f64>(values.size());
+
+            f64 variance{};
+
+            for (const auto value : values) {
+                variance += (value - mean) * (value - mean);
+            }
+
+            return std::sqrt(variance / static_cast<f64>(values.size()));
+        }
+
+        [[nodiscard]] bool loadSfens(std::vector<std::string>& dst, const std::string& path) {
+            std::ifstream stream{path};
+
+            if (!stream) {
+                std::cerr << "Failed to open sfen file '" << path << "'" << std::endl;
+                return false;
+            }
+
+            std::string line{};
+            while (std::getline(stream, line)) {
+                if (!line.empty() && line.back() == '\r') {
+                    line.pop_back();
+                }
+
+                if (line.empty() || line[0] == '#') {
+                    continue;
+                }
+
+                if (auto pos = Position::fromSfen(line); !pos) {
+                    std::cerr << "Invalid sfen '" << line << "': " << pos.takeErr().message() << std::endl;
+                    return false;
+                }
+
+                dst.push_back(std::move(line));
+            }
+
+            if (dst.empty()) {
+                std::cerr << "No positions in sfen file '" << path << "'" << std::endl;
+                return false;
+            }
+
+            return true;
+        }
+
+        // nps is per run, not per position
+        void writeJson(
+            std::ostream& stream,
+            const BenchConfig& config,
+            std::span<const PositionResult> results,
+            std::span<const f64> runNps,
+            usize totalNodes
+        ) {
+            stream << std::fixed << std::setprecision(6);
+
+            stream << "{\n";
+            stream << "  \"depth\": " << config.depth << ",\n";
+            stream << "  \"threads\": " << config.threads << ",\n";
+            stream << "  \"hash\": " << config.hashMib << ",\n";
+            stream << "  \"runs\": " << config.runs << ",\n";
+            stream << "  \"signature\": " << totalNodes << ",\n";
+            stream << "  \"positions\": [\n";
+
+            for (usize idx = 0; idx < results.size(); ++idx) {
+                const auto& result = results[idx];
+                const auto time = median(result.times);
+
+                stream << "    {\"sfen\": \"" << result.sfen << "\", \"nodes\": " << result.nodes
+                       << ", \"time\": " << time << ", \"nps\": "
+                       << static_cast<usize>(static_cast<f64>(result.nodes) / time) << "}"
+                       << (idx + 1 < results.size() ? "," : "") << "\n";
+            }
+
+            stream << "  ],\n";
+            stream << "  \"nps\": {\"median\": " << median({runNps.begin(), runNps.end()})
+                   << ", \"stddev\": " << stddev(runNps) << ", \"runs\": [";
+
+            for (usize idx = 0; idx < runNps.size(); ++idx) {
+                stream << (idx > 0 ? ", " : "") << runNps[idx];
+            }
+
+            stream << "]}\n";
+            stream << "}" << std::endl;
+        }
+
+        constexpr usize kSliderInputCount = 1 << 16;
+        constexpr usize kSliderIterations = 1 << 25;
+
+        struct SliderInput {
+            Square sq;
+            Bitboard occ;
+        };
+
+        [[nodiscard]] std::vector<SliderInput> generateSliderInputs() {
+            util::rng::Jsf64Rng rng{UINT64_C(0xb15b0f)};
+
+            std::vector<SliderInput> inputs{};
+            inputs.reserve(kSliderInputCount);
+
+            for (usize i = 0; i < kSliderInputCount; ++i) {
+                const auto sq = Square::fromRaw(static_cast<i32>(rng.nextU32(Squares::kCount)));
+                // roughly a quarter of the board occupied, as in a typical middlegame
+                const auto occ = Bitboard{rng.nextU128() & rng.nextU128()} & Bitboards::kAll;
+
+                inputs.push_back({sq, occ});
+            }
+
+            return inputs;
+        }
+
+        // each lookup depends on the previous one, so this measures latency rather than throughput
+        [[nodiscard]] f64 timeSliderLatency(std::span<const SliderInput> inputs, usize& sink) {
+            const auto start = util::Instant::now();
+
+            usize idx{};
+            Bitboard attacks{};
+
+            for (usize i = 0; i < kSliderIterations; ++i) {
+                const auto& input = inputs[(idx + (attacks.raw() & 1)) % inputs.size()];
+                attacks = attacks::sliders::bishopAttacks(input.sq, input.occ);
+                ++idx;
+            }
+
+            sink += static_cast<usize>(attacks.raw());
+
+            return start.elapsed() / static_cast<f64>(kSliderIterations) * 1000000000.0;
+        }
+
+        [[nodiscard]] f64 timeSliderThroughput(std::span<const SliderInput> inputs, usize& sink) {
+            const auto start = util::Instant::now();
+
+            usize total{};
+
+            for (usize i = 0; i < kSliderIterations; ++i) {
+                const auto& input = inputs[i % inputs.size()];
+                total += attacks::sliders::bishopAttacks(input.sq, input.occ).popcount();
+            }
+
+            sink += total;
+
+            return start.elapsed() / static_cast<f64>(kSliderIterations) * 1000000000.0;
+        }
     } // namespace
 
-    void run(i32 depth) {
-        Searcher searcher{kTtSizeMib};
+    bool run(const BenchConfig& config) {
+        std::vector<std::string> sfens{};
+
+        if (config.sfenFile.empty()) {
+            sfens.assign(kBenchSfens.begin(), kBenchSfens.end());
+        } else if (!loadSfens(sfens, config.sfenFile)) {
+            return false;
+        }
+
+        const auto runs = std::max<u32>(config.runs, 1);
+
+        Searcher searcher{config.hashMib};
+
+        searcher.setThreads(config.threads);
         searcher.ensureReady();
 
+        std::vector<PositionResult> results(sfens.size());
+        std::vector<f64> runNps{};
+
         usize totalNodes{};
         f64 totalTime{};
 
-        for (const auto sfen : kBenchSfens) {
-            std::cout << "SFEN: " << sfen << std::endl;
+        bool nondeterministic{};
 
-            const auto pos = Position::fromSfen(sfen).take();
+        for (u32 run = 0; run < runs; ++run) {
+            // every run starts from the same state, so that node counts match
+            searcher.newGame();
 
-            BenchInfo info{};
-            searcher.runBenchSearch(info, pos, depth);
+            usize runNodes{};
+            f64 runTime{};
+
+            for (usize idx = 0; idx < sfens.size(); ++idx) {
+                const auto& sfen = sfens[idx];
+
+                std::cout << "SFEN: " << sfen << std::endl;
+
+                const auto pos = Position::fromSfen(sfen).take();
+
+                BenchInfo info{};
+                searcher.runBenchSearch(info, pos, config.depth);
+
+                auto& result = results[idx];
+
+                // only deterministic with one thread
+                if (run > 0 && info.nodes != result.nodes) {
+                    nondeterministic = true;
+                }
 
-            totalNodes += info.nodes;
-            totalTime += info.time;
+                result.sfen = sfen;
+                result.nodes = info.nodes;
+                result.times.push_back(info.time);
 
-            std::cout << std::endl;
+                runNodes += info.nodes;
+                runTime += info.time;
+
+                std::cout << std::endl;
+            }
+
+            runNps.push_back(static_cast<f64>(runNodes) / runTime);
+
+            if (run == 0) {
+                totalNodes = runNodes;
+                totalTime = runTime;
+            }
         }
 
-        const auto nps = static_cast<usize>(static_cast<f64>(totalNodes) / totalTime);
+        const auto threads = config.threads;
 
+        std::cout << threads << (threads == 1 ? " thread, " : " threads, ") << "depth " << config.depth << std::endl;
         std::cout << totalTime << " seconds" << std::endl;
+
+        // every node copies a Position in copy-make
+        const auto bytesCopied = static_cast<f64>(totalNodes * sizeof(Position));
+        const auto copyRate = static_cast<usize>(bytesCopied / totalTime / (1024.0 * 1024.0));
+
+        std::cout << sizeof(Position) << " bytes copied per node, " << copyRate << " MiB/s" << std::endl;
+
+        const auto nps = static_cast<usize>(median(runNps));
+
+        if (runs > 1) {
+            std::cout << runs << " runs, nps stddev " << static_cast<usize>(stddev(runNps)) << std::endl;
+
+            if (nondeterministic) {
+                std::cout << "node counts differed between runs, signature is from the first" << std::endl;
+            }
+        }
+
+        if (!config.jsonFile.empty()) {
+            std::ofstream stream{config.jsonFile};
+
+            if (!stream) {
+                std::cerr << "Failed to open json file '" << config.jsonFile << "'" << std::endl;
+            } else {
+                writeJson(stream, config, results, runNps, totalNodes);
+            }
+        }
+
+        // median over all runs, kept last for tools that parse it
         std::cout << totalNodes << " nodes " << nps << " nps" << std::endl;
+
+        return true;
+    }
+
+    std::optional<BenchConfig> parseArgs(std::span<const std::string_view> args) {
+        BenchConfig config{};
+
+        u32 positional{};
+
+        const auto onOption = [&](std::string_view name, std::string_view value) {
+            if (name == "--sfens") {
+                config.sfenFile = value;
+            } else if (name == "--json") {
+                config.jsonFile = value;
+            } else if (name == "--runs") {
+                if (!util::tryParse(config.runs, value) || config.runs == 0) {
+                    return util::invalidArg("run count", value);
+                }
+            } else {
+                return util::unknownOption("bench", name);
+            }
+
+            return true;
+        };
+
+        const auto onPositional = [&](std::string_view arg) {
+            switch (positional++) {
+                case 0:
+                    return util::parseArg(config.depth, arg, "depth");
+                case 1:
+                    if (!util::parseArg(config.threads, arg, "thread count")) {
+                        return false;
+                    }
+
+                    config.threads = kThreadCountRange.clamp(config.threads);
+                    return true;
+                case 2:
+                    if (!util::parseArg(config.hashMib, arg, "hash size")) {
+                        return false;
+                    }
+
+                    config.hashMib = tt::kTtSizeRange.clamp(config.hashMib);
+                    return true;
+                default:
+                    return util::unexpectedArg(arg);
+            }
+        };
+
+        if (!util::parseArgs(args, onOption, onPositional)) {
+            return {};
+        }
+
+        return config;
+    }
+
+    void runSliders() {
+        using attacks::sliders::Backend;
+
+        const auto inputs = generateSliderInputs();
+        const auto prevBackend = attacks::sliders::backend();
+
+        // keeps the lookups from being optimised out
+        usize sink{};
+
+        std::cout << std::fixed << std::setprecision(2);
+
+        for (const auto backend : {Backend::kBlackMagic, Backend::kBmi2, Backend::kBmi2Compact}) {
+            if (!attacks::sliders::setBackend(backend)) {
+                continue;
+            }
+
+            const auto kib = static_cast<f64>(attacks::sliders::tableBytes(backend)) / 1024.0;
+
+            const auto latency = timeSliderLatency(inputs, sink);
+            const auto throughput = timeSliderThroughput(inputs, sink);
+
+            std::cout << attacks::sliders::backendName(backend) << ": " << kib << " KiB, " << latency
+                      << " ns latency, " << throughput << " ns throughput" << std::endl;
+        }
+
+        attacks::sliders::setBackend(prevBackend);
+
+        std::cout << std::defaultfloat;
+        std::cout << "checksum " << sink << std::endl;
+    }
+
+    void runGoLatency(u32 threads) {
+        constexpr u32 kWarmupSearches = 100;
+        constexpr u32 kSearches = 2000;
+
+        Searcher searcher{kDefaultBenchHashMib};
+
+        searcher.setThreads(threads);
+        searcher.newGame();
+
+        const auto pos = Position::startpos();
+
+        // the gui's side of the pipe is not being measured
+        protocol::output::setSuppressed(true);
+
+        std::vector<f64> latencies{};
+        latencies.reserve(kSearches);
+
+        for (u32 idx = 0; idx < kWarmupSearches + kSearches; ++idx) {
+            BenchInfo info{};
+
+            const auto start = util::Instant::now();
+            searcher.runBenchSearch(info, pos, 1);
+            const auto time = start.elapsed();
+
+            if (idx >= kWarmupSearches) {
+                latencies.push_back(time * 1000000.0);
+            }
+        }
+
+        protocol::output::setSuppressed(false);
+
+        std::ranges::sort(latencies);
+
+        f64 total{};
+
+        for (const auto latency : latencies) {
+            total += latency;
+        }
+
+        const auto percentile = [&](f64 fraction) {
+            return latencies[static_cast<usize>(fraction * static_cast<f64>(latencies.size() - 1))];
+        };
+
+        std::cout << std::fixed << std::setprecision(1);
+
+        std::cout << threads << (threads == 1 ? " thread, " : " threads, ") << kSearches << " depth 1 searches"
+                  << std::endl;
+        std::cout << "mean " << total / static_cast<f64>(kSearches) << " us, median " << percentile(0.5)
+                  << " us, p99 " << percentile(0.99) << " us, max " << latencies.back() << " us" << std::endl;
+
+        std::cout << std::defaultfloat;
     }
 } // namespace stoat::bench
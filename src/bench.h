@@ -20,7 +20,51 @@
 
 #include "types.h"
 
+#include <array>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+
 namespace stoat::bench {
+    // partially from the USI spec, partially from YaneuraOu
+    constexpr std::array<std::string_view, 6> kBenchSfens = {
+        "lnsgkgsnl/1r5b1/ppppppppp/9/9/9/PPPPPPPPP/1B5R1/LNSGKGSNL b - 1",
+        "8l/1l+R2P3/p2pBG1pp/kps1p4/Nn1P2G2/P1P1P2PP/1PS6/1KSG3+r1/LN2+p3L w Sbgn3p 124",
+        "lnsgkgsnl/1r7/p1ppp1bpp/1p3pp2/7P1/2P6/PP1PPPP1P/1B3S1R1/LNSGKG1NL b - 9",
+        "l4S2l/4g1gs1/5p1p1/pr2N1pkp/4Gn3/PP3PPPP/2GPP4/1K7/L3r+s2L w BS2N5Pb 1",
+        "6n1l/2+S1k4/2lp4p/1np1B2b1/3PP4/1N1S3rP/1P2+pPP+p1/1p1G5/3KG2r1 b GSN2L4Pgs2p 1",
+        "l6nl/5+P1gk/2np1S3/p1p4Pp/3P2Sp1/1PPb2P1P/P5GS1/R8/LN4bKL w RGgsn5p 1",
+    };
+
     constexpr i32 kDefaultBenchDepth = 11;
-    void run(i32 depth = kDefaultBenchDepth);
+    constexpr u32 kDefaultBenchThreads = 1;
+    constexpr usize kDefaultBenchHashMib = 16;
+
+    struct BenchConfig {
+        i32 depth{kDefaultBenchDepth};
+        u32 threads{kDefaultBenchThreads};
+        usize hashMib{kDefaultBenchHashMib};
+
+        // one sfen per line, the built in positions if empty
+        std::string sfenFile{};
+        // json results are only written if set
+        std::string jsonFile{};
+
+        // the whole suite is searched from a fresh state each time, for nps statistics
+        u32 runs{1};
+    };
+
+    // returns false if the positions could not be loaded
+    bool run(const BenchConfig& config);
+
+    // [depth] [threads] [hash mib] [--sfens <path>] [--json <path>] [--runs <count>]
+    // prints an error and returns nothing if the arguments are invalid
+    [[nodiscard]] std::optional<BenchConfig> parseArgs(std::span<const std::string_view> args);
+
+    // times bishop attack lookups with each supported slider backend
+    void runSliders();
+
+    // times depth 1 searches from start to final report, i.e. the fixed cost of a go
+    void runGoLatency(u32 threads);
 } // namespace stoat::bench
@@ -21,12 +21,25 @@
 #include "types.h"
 
 #include <array>
+#include <bit>
 #include <cassert>
 #include <iostream>
 
+#include "arch.h"
 #include "core.h"
 #include "util/bits.h"
 
+#if ST_HAS_VECTOR_BITBOARD
+    #if ST_HAS_NEON
+        #include <arm_neon.h>
+    #else
+        #include <emmintrin.h>
+        #if __SSE4_1__
+            #include <smmintrin.h>
+        #endif
+    #endif
+#endif
+
 namespace stoat {
     namespace offsets {
         constexpr i32 kNorth = 9;
@@ -50,130 +63,130 @@ namespace stoat {
         constexpr Bitboard() = default;
 
         explicit constexpr Bitboard(u128 bb) :
-                m_bb{bb} {}
+                m_bb{pack(bb)} {}
 
         constexpr Bitboard(const Bitboard&) = default;
         constexpr Bitboard(Bitboard&&) = default;
 
         [[nodiscard]] constexpr Bitboard operator&(Bitboard rhs) const {
-            return Bitboard{m_bb & rhs.raw()};
+            return fromStorage(m_bb & rhs.m_bb);
         }
 
         [[nodiscard]] constexpr Bitboard operator|(Bitboard rhs) const {
-            return Bitboard{m_bb | rhs.raw()};
+            return fromStorage(m_bb | rhs.m_bb);
         }
 
         [[nodiscard]] constexpr Bitboard operator^(Bitboard rhs) const {
-            return Bitboard{m_bb ^ rhs.raw()};
+            return fromStorage(m_bb ^ rhs.m_bb);
         }
 
         constexpr Bitboard& operator&=(Bitboard rhs) {
-            m_bb &= rhs.raw();
+            m_bb &= rhs.m_bb;
             return *this;
         }
 
         constexpr Bitboard& operator|=(Bitboard rhs) {
-            m_bb |= rhs.raw();
+            m_bb |= rhs.m_bb;
             return *this;
         }
 
         constexpr Bitboard& operator^=(Bitboard rhs) {
-            m_bb ^= rhs.raw();
+            m_bb ^= rhs.m_bb;
             return *this;
         }
 
         [[nodiscard]] constexpr Bitboard operator&(u128 rhs) const {
-            return Bitboard{m_bb & rhs};
+            return fromStorage(m_bb & pack(rhs));
         }
 
         [[nodiscard]] constexpr Bitboard operator|(u128 rhs) const {
-            return Bitboard{m_bb | rhs};
+            return fromStorage(m_bb | pack(rhs));
         }
 
         [[nodiscard]] constexpr Bitboard operator^(u128 rhs) const {
-            return Bitboard{m_bb ^ rhs};
+            return fromStorage(m_bb ^ pack(rhs));
         }
 
         constexpr Bitboard& operator&=(u128 rhs) {
-            m_bb &= rhs;
+            m_bb &= pack(rhs);
             return *this;
         }
 
         constexpr Bitboard& operator|=(u128 rhs) {
-            m_bb |= rhs;
+            m_bb |= pack(rhs);
             return *this;
         }
 
         constexpr Bitboard& operator^=(u128 rhs) {
-            m_bb ^= rhs;
+            m_bb ^= pack(rhs);
             return *this;
         }
 
         [[nodiscard]] constexpr Bitboard operator&(i32 rhs) const {
-            return Bitboard{m_bb & static_cast<u128>(rhs)};
+            return fromStorage(m_bb & pack(static_cast<u128>(rhs)));
         }
 
         [[nodiscard]] constexpr Bitboard operator|(i32 rhs) const {
-            return Bitboard{m_bb | static_cast<u128>(rhs)};
+            return fromStorage(m_bb | pack(static_cast<u128>(rhs)));
         }
 
         [[nodiscard]] constexpr Bitboard operator^(i32 rhs) const {
-            return Bitboard{m_bb ^ static_cast<u128>(rhs)};
+            return fromStorage(m_bb ^ pack(static_cast<u128>(rhs)));
         }
 
         constexpr Bitboard& operator&=(i32 rhs) {
-            m_bb &= static_cast<u128>(rhs);
+            m_bb &= pack(static_cast<u128>(rhs));
             return *this;
         }
 
         constexpr Bitboard& operator|=(i32 rhs) {
-            m_bb |= static_cast<u128>(rhs);
+            m_bb |= pack(static_cast<u128>(rhs));
             return *this;
         }
 
         constexpr Bitboard& operator^=(i32 rhs) {
-            m_bb ^= static_cast<u128>(rhs);
+            m_bb ^= pack(static_cast<u128>(rhs));
             return *this;
         }
 
         [[nodiscard]] constexpr Bitboard operator~() const {
-            return Bitboard{~m_bb & kAll};
+            return fromStorage(~m_bb & pack(kAll));
         }
 
         [[nodiscard]] constexpr Bitboard operator<<(i32 rhs) const {
-            return Bitboard{m_bb << rhs};
+            return fromStorage(shl(m_bb, rhs));
         }
 
         [[nodiscard]] constexpr Bitboard operator>>(i32 rhs) const {
-            return Bitboard{m_bb >> rhs};
+            return fromStorage(shr(m_bb, rhs));
         }
 
         constexpr Bitboard& operator<<=(i32 rhs) {
-            m_bb <<= rhs;
+            m_bb = shl(m_bb, rhs);
             return *this;
         }
 
         constexpr Bitboard& operator>>=(i32 rhs) {
-            m_bb >>= rhs;
+            m_bb = shr(m_bb, rhs);
             return *this;
         }
 
         [[nodiscard]] constexpr bool getSquare(Square square) const {
-            return (m_bb & square.bit()) != 0;
+            return !isZero(m_bb & pack(square.bit()));
         }
 
         constexpr Bitboard& setSquare(Square square) {
-            m_bb |= square.bit();
+            m_bb |= pack(square.bit());
             return *this;
         }
 
         constexpr Bitboard& clearSquare(Square square) {
-            m_bb &= ~square.bit();
+            m_bb &= pack(~square.bit());
             return *this;
         }
 
         constexpr Bitboard& toggleSquare(Square square) {
-            m_bb ^= square.bit();
+            m_bb ^= pack(square.bit());
             return *this;
         }
 
@@ -186,20 +199,21 @@ namespace stoat {
         }
 
         constexpr Bitboard& clear() {
-            m_bb = 0;
+            m_bb = Storage{};
             return *this;
         }
 
         [[nodiscard]] constexpr i32 popcount() const {
-            return util::popcount(m_bb);
+            return util::popcount(raw());
         }
 
         [[nodiscard]] constexpr bool empty() const {
-            return m_bb == 0;
+            return isZero(m_bb);
         }
 
         [[nodiscard]] constexpr bool multiple() const {
-            return (m_bb & (m_bb - 1)) != 0;
+            const auto bb = raw();
+            return (bb & (bb - 1)) != 0;
         }
 
         [[nodiscard]] constexpr bool one() const {
@@ -207,51 +221,51 @@ namespace stoat {
         }
 
         [[nodiscard]] constexpr Square lsb() const {
-            const auto idx = util::ctz(m_bb);
+            const auto idx = util::ctz(raw());
             return Square::fromRaw(idx);
         }
 
         [[nodiscard]] constexpr Bitboard isolateLsb() const {
-            const auto bit = m_bb & -m_bb;
-            return Bitboard{bit};
+            const auto bb = raw();
+            return Bitboard{bb & -bb};
         }
 
         constexpr Square popLsb() {
-            const auto square = lsb();
-            m_bb &= m_bb - 1;
-            return square;
+            const auto bb = raw();
+            m_bb = pack(bb & (bb - 1));
+            return Square::fromRaw(util::ctz(bb));
         }
 
         [[nodiscard]] constexpr Bitboard shiftNorth() const {
-            return Bitboard{(m_bb & ~kRankA) << offsets::kNorth};
+            return fromStorage(shl(m_bb & pack(~kRankA), offsets::kNorth));
         }
 
         [[nodiscard]] constexpr Bitboard shiftSouth() const {
-            return Bitboard{m_bb >> -offsets::kSouth};
+            return fromStorage(shr(m_bb, -offsets::kSouth));
         }
 
         [[nodiscard]] constexpr Bitboard shiftWest() const {
-            return Bitboard{(m_bb & ~kFile9) >> -offsets::kWest};
+            return fromStorage(shr(m_bb & pack(~kFile9), -offsets::kWest));
         }
 
         [[nodiscard]] constexpr Bitboard shiftEast() const {
-            return Bitboard{(m_bb & ~kFile1) << offsets::kEast};
+            return fromStorage(shl(m_bb & pack(~kFile1), offsets::kEast));
         }
 
         [[nodiscard]] constexpr Bitboard shiftNorthWest() const {
-            return Bitboard{(m_bb & ~(kRankA | kFile9)) << offsets::kNorthWest};
+            return fromStorage(shl(m_bb & pack(~(kRankA | kFile9)), offsets::kNorthWest));
         }
 
         [[nodiscard]] constexpr Bitboard shiftNorthEast() const {
-            return Bitboard{(m_bb & ~(kRankA | kFile1)) << offsets::kNorthEast};
+            return fromStorage(shl(m_bb & pack(~(kRankA | kFile1)), offsets::kNorthEast));
         }
 
         [[nodiscard]] constexpr Bitboard shiftSouthWest() const {
-            return Bitboard{(m_bb & ~kFile9) >> -offsets::kSouthWest};
+            return fromStorage(shr(m_bb & pack(~kFile9), -offsets::kSouthWest));
         }
 
         [[nodiscard]] constexpr Bitboard shiftSouthEast() const {
-            return Bitboard{(m_bb & ~kFile1) >> -offsets::kSouthEast};
+            return fromStorage(shr(m_bb & pack(~kFile1), -offsets::kSouthEast));
         }
 
         [[nodiscard]] constexpr Bitboard shiftNorthRelative(Color c) const {
@@ -328,20 +342,20 @@ namespace stoat {
 
         [[nodiscard]] constexpr Bitboard fillUp() const {
             auto b = m_bb;
-            b |= b << 9;
-            b |= b << 18;
-            b |= b << 36;
-            b |= b << 72;
-            return Bitboard{b & kAll};
+            b |= shl(b, 9);
+            b |= shl(b, 18);
+            b |= shl(b, 36);
+            b |= shl(b, 72);
+            return fromStorage(b & pack(kAll));
         }
 
         [[nodiscard]] constexpr Bitboard fillDown() const {
             auto b = m_bb;
-            b |= b >> 9;
-            b |= b >> 18;
-            b |= b >> 36;
-            b |= b >> 72;
-            return Bitboard{b & kAll};
+            b |= shr(b, 9);
+            b |= shr(b, 18);
+            b |= shr(b, 36);
+            b |= shr(b, 72);
+            return fromStorage(b & pack(kAll));
         }
 
         [[nodiscard]] constexpr Bitboard fillFile() const {
@@ -349,10 +363,12 @@ namespace stoat {
         }
 
         [[nodiscard]] constexpr u128 raw() const {
-            return m_bb;
+            return unpack(m_bb);
         }
 
-        [[nodiscard]] constexpr bool operator==(const Bitboard&) const = default;
+        [[nodiscard]] constexpr bool operator==(const Bitboard& other) const {
+            return raw() == other.raw();
+        }
 
         constexpr Bitboard& operator=(const Bitboard&) = default;
         constexpr Bitboard& operator=(Bitboard&&) = default;
@@ -368,7 +384,127 @@ namespace stoat {
         }
 
     private:
-        u128 m_bb{};
+#if ST_HAS_VECTOR_BITBOARD
+    #if ST_HAS_NEON
+        using Storage = uint64x2_t;
+    #else
+        using Storage = __m128i;
+    #endif
+#else
+        using Storage = u128;
+#endif
+
+        Storage m_bb{};
+
+        // the vector backend keeps the low 64 squares in the first lane. Anything that
+        // is not a plain bitwise op goes through a u128 when constant evaluated
+        [[nodiscard]] static constexpr Storage pack(u128 bb) {
+#if ST_HAS_VECTOR_BITBOARD
+            if (!std::is_constant_evaluated()) {
+                const auto [high, low] = fromU128(bb);
+    #if ST_HAS_NEON
+                return vcombine_u64(vcreate_u64(low), vcreate_u64(high));
+    #else
+                return _mm_set_epi64x(static_cast<i64>(high), static_cast<i64>(low));
+    #endif
+            }
+#endif
+
+            return std::bit_cast<Storage>(bb);
+        }
+
+        [[nodiscard]] static constexpr u128 unpack(Storage bb) {
+#if ST_HAS_VECTOR_BITBOARD
+            if (!std::is_constant_evaluated()) {
+    #if ST_HAS_NEON
+                return toU128(vgetq_lane_u64(bb, 1), vgetq_lane_u64(bb, 0));
+    #else
+                const auto low = static_cast<u64>(_mm_cvtsi128_si64(bb));
+                const auto high = static_cast<u64>(_mm_cvtsi128_si64(_mm_unpackhi_epi64(bb, bb)));
+                return toU128(high, low);
+    #endif
+            }
+#endif
+
+            return std::bit_cast<u128>(bb);
+        }
+
+        [[nodiscard]] static constexpr Bitboard fromStorage(Storage bb) {
+            Bitboard result{};
+            result.m_bb = bb;
+            return result;
+        }
+
+        [[nodiscard]] static constexpr bool isZero(Storage bb) {
+#if ST_HAS_VECTOR_BITBOARD
+            if (!std::is_constant_evaluated()) {
+    #if ST_HAS_NEON
+                return (vgetq_lane_u64(bb, 0) | vgetq_lane_u64(bb, 1)) == 0;
+    #elif __SSE4_1__
+                return _mm_testz_si128(bb, bb) != 0;
+    #else
+                return _mm_movemask_epi8(_mm_cmpeq_epi8(bb, _mm_setzero_si128())) == 0xffff;
+    #endif
+            }
+#endif
+
+            return unpack(bb) == 0;
+        }
+
+        // shifts within each lane, then carries the bits that crossed lanes
+        [[nodiscard]] static constexpr Storage shl(Storage bb, i32 shift) {
+            assert(shift >= 0 && shift < 128);
+
+#if ST_HAS_VECTOR_BITBOARD
+            if (!std::is_constant_evaluated()) {
+    #if ST_HAS_NEON
+                const auto carried = vextq_u64(vdupq_n_u64(0), bb, 1);
+                if (shift >= 64) {
+                    return vshlq_u64(carried, vdupq_n_s64(shift - 64));
+                }
+                return vorrq_u64(vshlq_u64(bb, vdupq_n_s64(shift)), vshlq_u64(carried, vdupq_n_s64(shift - 64)));
+    #else
+                const auto carried = _mm_slli_si128(bb, 8);
+                if (shift >= 64) {
+                    return _mm_sll_epi64(carried, _mm_cvtsi32_si128(shift - 64));
+                }
+                return _mm_or_si128(
+                    _mm_sll_epi64(bb, _mm_cvtsi32_si128(shift)),
+                    _mm_srl_epi64(carried, _mm_cvtsi32_si128(64 - shift))
+                );
+    #endif
+            }
+#endif
+
+            return pack(unpack(bb) << shift);
+        }
+
+        [[nodiscard]] static constexpr Storage shr(Storage bb, i32 shift) {
+            assert(shift >= 0 && shift < 128);
+
+#if ST_HAS_VECTOR_BITBOARD
+            if (!std::is_constant_evaluated()) {
+    #if ST_HAS_NEON
+                const auto carried = vextq_u64(bb, vdupq_n_u64(0), 1);
+                if (shift >= 64) {
+                    return vshlq_u64(carried, vdupq_n_s64(64 - shift));
+                }
+                return vorrq_u64(vshlq_u64(bb, vdupq_n_s64(-shift)), vshlq_u64(carried, vdupq_n_s64(64 - shift)));
+    #else
+                const auto carried = _mm_srli_si128(bb, 8);
+                if (shift >= 64) {
+                    return _mm_srl_epi64(carried, _mm_cvtsi32_si128(shift - 64));
+                }
+                return _mm_or_si128(
+                    _mm_srl_epi64(bb, _mm_cvtsi32_si128(shift)),
+                    _mm_sll_epi64(carried, _mm_cvtsi32_si128(64 - shift))
+                );
+    #endif
+            }
+#endif
+
+            return pack(unpack(bb) >> shift);
+        }
 
         static constexpr u128 kAll = U128(0x1ffff, 0xffffffffffffffff);
         static constexpr u128 kEmpty = 0;
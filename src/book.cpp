@@ -0,0 +1,231 @@
+/*
+ * Stoat, a USI shogi engine
+ * Copyright (C) 2025 Ciekce
+ *
+ * Stoat is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Stoat is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Stoat. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "book.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "util/split.h"
+
+namespace stoat::book {
+    namespace {
+        constexpr std::array<char, 8> kFileMagic = {'S', 'T', 'O', 'A', 'T', 'B', 'K', '\0'};
+        // bump whenever the entry layout or key packing changes
+        constexpr u32 kFileVersion = 1;
+
+        struct FileHeader {
+            std::array<char, 8> magic;
+            u32 version;
+            u32 entrySize;
+            u64 entryCount;
+        };
+
+        static_assert(sizeof(FileHeader) % alignof(Entry) == 0);
+
+        [[nodiscard]] u64 rngSeed() {
+            return static_cast<u64>(std::chrono::steady_clock::now().time_since_epoch().count());
+        }
+    } // namespace
+
+    Book::Book() :
+            m_rng{rngSeed()} {}
+
+    std::optional<std::string> Book::load(const std::string& path) {
+        auto mapping = util::MappedFile::open(path);
+
+        if (!mapping) {
+            return "Failed to open '" + path + "'";
+        }
+
+        if (mapping->size() < sizeof(FileHeader)) {
+            return "'" + path + "' is not a book file";
+        }
+
+        FileHeader header{};
+        std::memcpy(&header, mapping->data(), sizeof(FileHeader));
+
+        if (header.magic != kFileMagic) {
+            return "'" + path + "' is not a book file";
+        }
+
+        if (header.version != kFileVersion || header.entrySize != sizeof(Entry)) {
+            return "'" + path + "' was built with an incompatible book layout";
+        }
+
+        if (header.entryCount == 0 || mapping->size() != sizeof(FileHeader) + header.entryCount * sizeof(Entry)) {
+            return "'" + path + "' has the wrong size for its header";
+        }
+
+        m_mapping = std::move(*mapping);
+        m_entries = {reinterpret_cast<const Entry*>(m_mapping.data() + sizeof(FileHeader)), header.entryCount};
+
+        return {};
+    }
+
+    void Book::unload() {
+        m_entries = {};
+        m_mapping = util::MappedFile{};
+    }
+
+    Move Book::probe(const Position& pos) {
+        const auto [first, last] = std::ranges::equal_range(m_entries, pos.key(), {}, &Entry::key);
+
+        // a key collision could bring in moves that are not legal here
+        std::array<Entry, 64> candidates{};
+        usize count{};
+
+        u32 totalWeight{};
+
+        for (auto itr = first; itr != last && count < candidates.size(); ++itr) {
+            if (itr->weight > 0 && pos.isPseudolegal(itr->move) && pos.isLegal(itr->move)) {
+                candidates[count++] = *itr;
+                totalWeight += itr->weight;
+            }
+        }
+
+        if (totalWeight == 0) {
+            return kNullMove;
+        }
+
+        auto choice = m_rng.nextU32(totalWeight);
+
+        for (usize idx = 0; idx < count; ++idx) {
+            if (choice < candidates[idx].weight) {
+                return candidates[idx].move;
+            }
+
+            choice -= candidates[idx].weight;
+        }
+
+        assert(false);
+        return kNullMove;
+    }
+
+    bool build(const std::string& gamesFile, const std::string& bookFile, u32 plies) {
+        std::ifstream input{gamesFile};
+
+        if (!input) {
+            std::cerr << "Failed to open games file '" << gamesFile << "'" << std::endl;
+            return false;
+        }
+
+        // ordered by key, and then by move so that output is deterministic
+        std::map<std::pair<u64, u16>, u32> counts{};
+
+        usize games{};
+
+        std::vector<std::string_view> args{};
+        // counted once the whole game has parsed
+        std::vector<std::pair<u64, u16>> gameMoves{};
+
+        std::string line{};
+        for (usize lineIdx = 1; std::getline(input, line); ++lineIdx) {
+            if (!line.empty() && line.back() == '\r') {
+                line.pop_back();
+            }
+
+            if (line.empty() || line[0] == '#') {
+                continue;
+            }
+
+            args.clear();
+            util::split(args, line);
+
+            if (args.empty()) {
+                continue;
+            }
+
+            gameMoves.clear();
+
+            auto parsed = Position::fromPositionCommand(
+                args,
+                [&](const Position& pos, Move move) { gameMoves.emplace_back(pos.key(), std::bit_cast<u16>(move)); },
+                plies
+            );
+
+            if (!parsed) {
+                std::cerr << "Invalid game on line " << lineIdx << ": " << parsed.takeErr() << std::endl;
+                continue;
+            }
+
+            for (const auto& keyMove : gameMoves) {
+                ++counts[keyMove];
+            }
+
+            ++games;
+        }
+
+        std::vector<Entry> entries{};
+        entries.reserve(counts.size());
+
+        for (const auto& [keyMove, count] : counts) {
+            entries.push_back({
+                .key = keyMove.first,
+                .move = std::bit_cast<Move>(keyMove.second),
+                .weight = static_cast<u16>(std::min<u32>(count, std::numeric_limits<u16>::max())),
+                .padding = 0,
+            });
+        }
+
+        if (entries.empty()) {
+            std::cerr << "No book moves in '" << gamesFile << "'" << std::endl;
+            return false;
+        }
+
+        std::ofstream output{bookFile, std::ios::binary | std::ios::trunc};
+
+        if (!output) {
+            std::cerr << "Failed to open '" << bookFile << "' for writing" << std::endl;
+            return false;
+        }
+
+        const FileHeader header = {
+            .magic = kFileMagic,
+            .version = kFileVersion,
+            .entrySize = sizeof(Entry),
+            .entryCount = entries.size(),
+        };
+
+        output.write(reinterpret_cast<const char*>(&header), sizeof(FileHeader));
+        output.write(
+            reinterpret_cast<const char*>(entries.data()),
+            static_cast<std::streamsize>(entries.size() * sizeof(Entry))
+        );
+
+        if (!output) {
+            std::cerr << "Failed to write to '" << bookFile << "'" << std::endl;
+            return false;
+        }
+
+        std::cout << "Wrote " << entries.size() << " book moves from " << games << " games to '" << bookFile << "'"
+                  << std::endl;
+
+        return true;
+    }
+} // namespace stoat::book
@@ -0,0 +1,81 @@
+/*
+ * Stoat, a USI shogi engine
+ * Copyright (C) 2025 Ciekce
+ *
+ * Stoat is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Stoat is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Stoat. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "types.h"
+
+#include <optional>
+#include <span>
+#include <string>
+
+#include "move.h"
+#include "position.h"
+#include "util/mapped_file.h"
+#include "util/rng.h"
+
+namespace stoat::book {
+    // positions more than this many plies into a game are not added by build()
+    constexpr u32 kDefaultBookPlies = 24;
+
+    struct Entry {
+        u64 key;
+        Move move;
+        // relative to the other moves of the same position
+        u16 weight;
+        u32 padding;
+    };
+
+    static_assert(sizeof(Entry) == 16);
+
+    // An opening book, mapped rather than read, so that loading is
+    // instant and only the pages actually probed are ever read. Entries
+    // are sorted by position key, with every move of a position adjacent
+    class Book {
+    public:
+        Book();
+
+        // returns an error message on failure
+        [[nodiscard]] std::optional<std::string> load(const std::string& path);
+        void unload();
+
+        [[nodiscard]] inline bool loaded() const {
+            return !m_entries.empty();
+        }
+
+        [[nodiscard]] inline usize size() const {
+            return m_entries.size();
+        }
+
+        // a legal book move picked with probability proportional
+        // to its weight, or a null move if the position is not in the book
+        [[nodiscard]] Move probe(const Position& pos);
+
+    private:
+        util::MappedFile m_mapping{};
+        std::span<const Entry> m_entries{};
+
+        util::rng::Jsf64Rng m_rng;
+    };
+
+    // Builds a book from a file of games, one per line as the arguments of a position
+    // command ("startpos moves ..." or "sfen <sfen> moves ..."). Every position in the
+    // first `plies` plies of a game is added, each move weighted by how often it was played
+    // returns false on failure
+    bool build(const std::string& gamesFile, const std::string& bookFile, u32 plies);
+} // namespace stoat::book
@@ -0,0 +1,830 @@
+/*
+ * Stoat, a USI shogi engine
+ * Copyright (C) 2025 Ciekce
+ *
+ * Stoat is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Stoat is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Stoat. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "cluster.h"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+
+#include "limit.h"
+#include "search.h"
+#include "util/args.h"
+#include "util/parse.h"
+#include "util/split.h"
+
+#ifndef _WIN32
+    #include <netdb.h>
+    #include <netinet/in.h>
+    #include <netinet/tcp.h>
+    #include <sys/socket.h>
+    #include <unistd.h>
+#endif
+
+namespace stoat::cluster {
+    namespace {
+        // how often queued entries are sent
+        constexpr auto kPumpInterval = std::chrono::milliseconds{10};
+        // how long the main node waits for the workers' results after stopping them
+        constexpr auto kResultTimeout = std::chrono::milliseconds{500};
+        // far longer than any valid message, including a search with a full game of key history
+        constexpr usize kMaxLineLength = 1024 * 1024;
+
+        [[nodiscard]] std::optional<SharedEntry> parseEntry(std::span<const std::string_view> tokens) {
+            assert(tokens.size() == 5);
+
+            SharedEntry entry{};
+
+            if (!util::tryParse(entry.key, tokens[0], 16) || !util::tryParse(entry.score, tokens[1])
+                || !util::tryParse(entry.depth, tokens[3]))
+            {
+                return {};
+            }
+
+            if (tokens[2] != "-") {
+                auto move = Move::fromStr(tokens[2]);
+
+                if (!move) {
+                    return {};
+                }
+
+                entry.move = move.take();
+            }
+
+            u32 flag{};
+
+            if (!util::tryParse(flag, tokens[4]) || flag == 0 || flag > static_cast<u32>(tt::Flag::kExact)) {
+                return {};
+            }
+
+            entry.flag = static_cast<tt::Flag>(flag);
+
+            if (std::abs(entry.score) >= kScoreWin || entry.depth < 0 || entry.depth > kMaxDepth) {
+                return {};
+            }
+
+            return entry;
+        }
+
+        // "tt" followed by 5 tokens per entry, see formatEntries()
+        [[nodiscard]] bool parseEntries(std::vector<SharedEntry>& dst, std::span<const std::string_view> tokens) {
+            if (tokens.size() % 5 != 0) {
+                return false;
+            }
+
+            dst.clear();
+
+            for (usize idx = 0; idx < tokens.size(); idx += 5) {
+                const auto entry = parseEntry(tokens.subspan(idx, 5));
+
+                if (!entry) {
+                    return false;
+                }
+
+                dst.push_back(*entry);
+            }
+
+            return true;
+        }
+
+        void formatEntries(std::ostream& stream, std::span<const SharedEntry> entries) {
+            stream << "tt";
+
+            for (const auto& entry : entries) {
+                stream << ' ' << std::hex << entry.key << std::dec << ' ' << entry.score << ' ';
+
+                if (entry.move) {
+                    stream << entry.move;
+                } else {
+                    stream << '-';
+                }
+
+                stream << ' ' << entry.depth << ' ' << static_cast<u32>(entry.flag);
+            }
+        }
+
+        // sends every queued entry, in messages of at most kBatchSize entries
+        void sendQueued(EntryQueue& queue, std::vector<SharedEntry>& buffer, const auto& send) {
+            buffer.clear();
+            queue.take(buffer);
+
+            for (usize start = 0; start < buffer.size(); start += kBatchSize) {
+                const auto count = std::min(kBatchSize, buffer.size() - start);
+
+                std::ostringstream line{};
+                formatEntries(line, std::span{buffer}.subspan(start, count));
+
+                send(line.str());
+            }
+        }
+
+        void formatSearch(
+            std::ostream& stream,
+            u64 id,
+            const Position& pos,
+            std::span<const u64> keyHistory,
+            i32 maxDepth
+        ) {
+            stream << "search " << id << ' ' << maxDepth << ' ' << keyHistory.size();
+
+            for (const auto key : keyHistory) {
+                stream << ' ' << std::hex << key << std::dec;
+            }
+
+            stream << ' ' << pos.sfen();
+        }
+
+        void formatResult(std::ostream& stream, u64 id, const AnalysisResult& result) {
+            stream << "result " << id << ' ' << result.depth << ' ' << result.score;
+
+            for (u32 idx = 0; idx < result.pv.length; ++idx) {
+                stream << ' ' << result.pv.moves[idx];
+            }
+        }
+
+        // stops a worker's search once the main node asks it to
+        class FlagLimiter final : public limit::ISearchLimiter {
+        public:
+            explicit FlagLimiter(const std::atomic_bool& flag) :
+                    m_flag{flag} {}
+
+            ~FlagLimiter() final = default;
+
+            [[nodiscard]] inline bool stopSoft([[maybe_unused]] usize nodes) final {
+                return m_flag.load(std::memory_order::relaxed);
+            }
+
+            [[nodiscard]] inline bool stopHard([[maybe_unused]] usize nodes) final {
+                return m_flag.load(std::memory_order::relaxed);
+            }
+
+        private:
+            const std::atomic_bool& m_flag;
+        };
+    } // namespace
+
+    void EntryQueue::push(std::span<const SharedEntry> entries) {
+        const std::unique_lock lock{m_mutex};
+        m_entries.insert(m_entries.end(), entries.begin(), entries.end());
+    }
+
+    void EntryQueue::take(std::vector<SharedEntry>& dst) {
+        assert(dst.empty());
+
+        const std::unique_lock lock{m_mutex};
+        std::swap(dst, m_entries);
+    }
+
+    // a line-based tcp connection. sending is thread safe, receiving is not
+    class Connection {
+    public:
+        Connection() = default;
+
+        inline explicit Connection(i32 socket) :
+                m_socket{socket} {}
+
+        inline ~Connection() {
+            close();
+        }
+
+        Connection(const Connection&) = delete;
+        Connection(Connection&&) = delete;
+
+        [[nodiscard]] inline bool connected() const {
+            return m_socket >= 0;
+        }
+
+        // returns an error message on failure
+        [[nodiscard]] std::optional<std::string> connect(const std::string& host, u16 port);
+
+        // the newline is appended, returns false once the connection is gone
+        bool sendLine(std::string_view line);
+        // without the newline, returns false once the connection is gone
+        bool readLine(std::string& dst);
+
+        // wakes up a thread blocked in readLine(), which then fails
+        void shutdown();
+
+    private:
+        i32 m_socket{-1};
+
+        std::mutex m_sendMutex{};
+
+        std::string m_buffer{};
+        usize m_bufferPos{};
+
+        void close();
+    };
+
+#ifdef _WIN32
+    std::optional<std::string> Connection::connect(
+        [[maybe_unused]] const std::string& host,
+        [[maybe_unused]] u16 port
+    ) {
+        return "Cluster mode is not supported on Windows";
+    }
+
+    bool Connection::sendLine([[maybe_unused]] std::string_view line) {
+        return false;
+    }
+
+    bool Connection::readLine([[maybe_unused]] std::string& dst) {
+        return false;
+    }
+
+    void Connection::shutdown() {}
+
+    void Connection::close() {
+        m_socket = -1;
+    }
+#else
+    std::optional<std::string> Connection::connect(const std::string& host, u16 port) {
+        addrinfo hints{};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+
+        addrinfo* addresses{};
+
+        if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &addresses) != 0) {
+            return "Failed to resolve '" + host + "'";
+        }
+
+        for (auto* address = addresses; address; address = address->ai_next) {
+            const auto socket = ::socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+
+            if (socket < 0) {
+                continue;
+            }
+
+            if (::connect(socket, address->ai_addr, address->ai_addrlen) == 0) {
+                m_socket = socket;
+                break;
+            }
+
+            ::close(socket);
+        }
+
+        freeaddrinfo(addresses);
+
+        if (m_socket < 0) {
+            return "Failed to connect to " + host + ":" + std::to_string(port);
+        }
+
+        // stop messages should not wait for more to send
+        const i32 noDelay = 1;
+        setsockopt(m_socket, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+
+        return {};
+    }
+
+    bool Connection::sendLine(std::string_view line) {
+        const std::unique_lock lock{m_sendMutex};
+
+        if (m_socket < 0) {
+            return false;
+        }
+
+        std::string data{line};
+        data += '\n';
+
+        usize sent = 0;
+
+        while (sent < data.size()) {
+            const auto result = send(m_socket, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+
+            if (result <= 0) {
+                return false;
+            }
+
+            sent += static_cast<usize>(result);
+        }
+
+        return true;
+    }
+
+    bool Connection::readLine(std::string& dst) {
+        while (true) {
+            if (const auto end = m_buffer.find('\n', m_bufferPos); end != std::string::npos) {
+                dst.assign(m_buffer, m_bufferPos, end - m_bufferPos);
+                m_bufferPos = end + 1;
+
+                return true;
+            }
+
+            m_buffer.erase(0, m_bufferPos);
+            m_bufferPos = 0;
+
+            // the peer is broken or hostile, don't buffer its output forever. shut down rather
+            // than closed, as another thread may be sending on the socket
+            if (m_buffer.size() > kMaxLineLength) {
+                shutdown();
+                return false;
+            }
+
+            std::array<char, 65536> chunk{};
+            const auto result = recv(m_socket, chunk.data(), chunk.size(), 0);
+
+            if (result <= 0) {
+                return false;
+            }
+
+            m_buffer.append(chunk.data(), static_cast<usize>(result));
+        }
+    }
+
+    void Connection::shutdown() {
+        if (m_socket >= 0) {
+            ::shutdown(m_socket, SHUT_RDWR);
+        }
+    }
+
+    void Connection::close() {
+        if (m_socket >= 0) {
+            ::close(m_socket);
+        }
+
+        m_socket = -1;
+    }
+#endif
+
+    struct Client::Node {
+        std::string name{};
+        Connection connection{};
+
+        std::thread reader{};
+
+        // guarded by the client's result mutex
+        bool alive{true};
+        std::optional<RemoteResult> result{};
+    };
+
+    Client::Client(Importer importer) :
+            m_importer{std::move(importer)} {}
+
+    Client::~Client() {
+        {
+            const std::unique_lock lock{m_pumpMutex};
+            m_quit.store(true);
+        }
+
+        m_pumpSignal.notify_all();
+
+        if (m_pump.joinable()) {
+            m_pump.join();
+        }
+
+        for (auto& node : m_nodes) {
+            node->connection.shutdown();
+
+            if (node->reader.joinable()) {
+                node->reader.join();
+            }
+        }
+    }
+
+    std::optional<std::string> Client::connect(std::string_view nodes) {
+        assert(m_nodes.empty());
+
+        std::vector<std::string_view> names{};
+        util::split(names, nodes, ',');
+
+        for (const auto name : names) {
+            auto host = std::string{name};
+            u16 port = kDefaultPort;
+
+            if (const auto colon = name.rfind(':'); colon != std::string_view::npos) {
+                if (!util::tryParse(port, name.substr(colon + 1))) {
+                    return "Invalid port in '" + std::string{name} + "'";
+                }
+
+                host = name.substr(0, colon);
+            }
+
+            if (host.empty()) {
+                continue;
+            }
+
+            auto node = std::make_unique<Node>();
+            node->name = name;
+
+            if (const auto err = node->connection.connect(host, port)) {
+                return err;
+            }
+
+            m_nodes.push_back(std::move(node));
+        }
+
+        if (m_nodes.empty()) {
+            return "No cluster nodes given";
+        }
+
+        for (auto& node : m_nodes) {
+            node->reader = std::thread{[this, &node = *node] { runReader(node); }};
+        }
+
+        m_pump = std::thread{[this] { runPump(); }};
+
+        return {};
+    }
+
+    void Client::newGame() {
+        for (auto& node : m_nodes) {
+            node->connection.sendLine("newgame");
+        }
+    }
+
+    void Client::startSearch(const Position& pos, std::span<const u64> keyHistory, i32 maxDepth) {
+        {
+            const std::unique_lock lock{m_resultMutex};
+
+            ++m_searchId;
+            m_searching = true;
+
+            for (auto& node : m_nodes) {
+                node->result = {};
+            }
+        }
+
+        std::ostringstream line{};
+        formatSearch(line, m_searchId, pos, keyHistory, maxDepth);
+
+        for (auto& node : m_nodes) {
+            node->connection.sendLine(line.str());
+        }
+    }
+
+    std::optional<RemoteResult> Client::finishSearch() {
+        std::unique_lock lock{m_resultMutex};
+
+        if (!m_searching) {
+            return {};
+        }
+
+        m_searching = false;
+
+        for (auto& node : m_nodes) {
+            node->connection.sendLine("stop");
+        }
+
+        const auto answered = [&] {
+            return std::ranges::all_of(m_nodes, [](const auto& node) { return !node->alive || node->result; });
+        };
+
+        m_resultSignal.wait_for(lock, kResultTimeout, answered);
+
+        std::optional<RemoteResult> best{};
+
+        for (const auto& node : m_nodes) {
+            if (node->result && node->result->depth > 0 && node->result->pv.length > 0
+                && (!best || node->result->depth > best->depth))
+            {
+                best = node->result;
+            }
+        }
+
+        return best;
+    }
+
+    void Client::runReader(Node& node) {
+        std::string line{};
+        std::vector<std::string_view> tokens{};
+        std::vector<SharedEntry> entries{};
+
+        while (node.connection.readLine(line)) {
+            tokens.clear();
+            util::split(tokens, line);
+
+            if (tokens.empty()) {
+                continue;
+            }
+
+            if (tokens[0] == "tt") {
+                if (!parseEntries(entries, std::span{tokens}.subspan(1))) {
+                    continue;
+                }
+
+                m_importer(entries);
+
+                // relayed as is, workers only talk to the main node
+                for (auto& other : m_nodes) {
+                    if (other.get() != &node) {
+                        other->connection.sendLine(line);
+                    }
+                }
+            } else if (tokens[0] == "result" && tokens.size() >= 4) {
+                u64 id{};
+                RemoteResult result{};
+
+                if (!util::tryParse(id, tokens[1]) || !util::tryParse(result.depth, tokens[2])
+                    || !util::tryParse(result.score, tokens[3]))
+                {
+                    continue;
+                }
+
+                for (const auto moveStr : std::span{tokens}.subspan(4)) {
+                    auto move = Move::fromStr(moveStr);
+
+                    if (!move || result.pv.length >= result.pv.moves.size()) {
+                        break;
+                    }
+
+                    result.pv.moves[result.pv.length++] = move.take();
+                }
+
+                const std::unique_lock lock{m_resultMutex};
+
+                // a late answer to a search that has already been given up on
+                if (id != m_searchId) {
+                    continue;
+                }
+
+                node.result = result;
+            } else {
+                continue;
+            }
+
+            m_resultSignal.notify_all();
+        }
+
+        if (!m_quit.load()) {
+            std::cerr << "Lost connection to cluster node " << node.name << std::endl;
+        }
+
+        {
+            const std::unique_lock lock{m_resultMutex};
+            node.alive = false;
+        }
+
+        m_resultSignal.notify_all();
+    }
+
+    void Client::runPump() {
+        std::vector<SharedEntry> buffer{};
+
+        std::unique_lock lock{m_pumpMutex};
+
+        while (!m_pumpSignal.wait_for(lock, kPumpInterval, [this] { return m_quit.load(); })) {
+            sendQueued(m_queue, buffer, [&](const std::string& line) {
+                for (auto& node : m_nodes) {
+                    node->connection.sendLine(line);
+                }
+            });
+        }
+    }
+
+    std::optional<WorkerConfig> parseWorkerArgs(std::span<const std::string_view> args) {
+        WorkerConfig config{};
+
+        const auto onOption = [&](std::string_view name, std::string_view value) {
+            if (name == "--bind") {
+                config.address = value;
+            } else if (name == "--port") {
+                return util::parseArg(config.port, value, "port");
+            } else if (name == "--threads") {
+                if (!util::parseArg(config.threads, value, "thread count")) {
+                    return false;
+                }
+
+                config.threads = kThreadCountRange.clamp(config.threads);
+            } else if (name == "--hash") {
+                if (!util::parseArg(config.hashMib, value, "hash size")) {
+                    return false;
+                }
+
+                config.hashMib = tt::kTtSizeRange.clamp(config.hashMib);
+            } else {
+                return util::unknownOption("cluster worker", name);
+            }
+
+            return true;
+        };
+
+        if (!util::parseArgs(args, onOption)) {
+            return {};
+        }
+
+        return config;
+    }
+
+#ifdef _WIN32
+    bool runWorker([[maybe_unused]] const WorkerConfig& config) {
+        std::cerr << "Cluster mode is not supported on Windows" << std::endl;
+        return false;
+    }
+#else
+    namespace {
+        // serves a main node until it disconnects
+        void serve(Searcher& searcher, EntryQueue& queue, Connection& connection) {
+            std::atomic_bool stopFlag{};
+
+            std::thread searchThread{};
+            u64 searchId{};
+            AnalysisResult result{};
+
+            Position pos{};
+            std::vector<u64> keyHistory{};
+
+            std::atomic_bool quitPump{};
+
+            std::thread pump{[&] {
+                std::vector<SharedEntry> buffer{};
+
+                while (!quitPump.load()) {
+                    std::this_thread::sleep_for(kPumpInterval);
+                    sendQueued(queue, buffer, [&](const std::string& line) { connection.sendLine(line); });
+                }
+            }};
+
+            const auto finishSearch = [&](bool report) {
+                if (!searchThread.joinable()) {
+                    return;
+                }
+
+                stopFlag.store(true);
+                searchThread.join();
+
+                if (report) {
+                    std::ostringstream line{};
+                    formatResult(line, searchId, result);
+
+                    connection.sendLine(line.str());
+                }
+            };
+
+            std::string line{};
+            std::vector<std::string_view> tokens{};
+            std::vector<SharedEntry> entries{};
+
+            while (connection.readLine(line)) {
+                tokens.clear();
+                util::split(tokens, line);
+
+                if (tokens.empty()) {
+                    continue;
+                }
+
+                if (tokens[0] == "tt") {
+                    if (parseEntries(entries, std::span{tokens}.subspan(1))) {
+                        searcher.importEntries(entries);
+                    }
+                } else if (tokens[0] == "search" && tokens.size() >= 4) {
+                    finishSearch(false);
+
+                    i32 maxDepth{};
+                    usize keyCount{};
+
+                    // keyCount comes straight off the wire, so that 4 + keyCount could overflow
+                    if (!util::tryParse(searchId, tokens[1]) || !util::tryParse(maxDepth, tokens[2])
+                        || !util::tryParse(keyCount, tokens[3]) || keyCount > tokens.size() - 4)
+                    {
+                        std::cerr << "Invalid search message" << std::endl;
+                        continue;
+                    }
+
+                    maxDepth = std::clamp(maxDepth, 1, kMaxDepth);
+
+                    keyHistory.resize(keyCount);
+
+                    bool valid = true;
+
+                    for (usize idx = 0; idx < keyCount; ++idx) {
+                        valid = valid && util::tryParse(keyHistory[idx], tokens[4 + idx], 16);
+                    }
+
+                    auto parsed = Position::fromSfenParts(std::span{tokens}.subspan(4 + keyCount));
+
+                    if (!valid || !parsed) {
+                        std::cerr << "Invalid search message" << std::endl;
+                        continue;
+                    }
+
+                    pos = parsed.take();
+
+                    stopFlag.store(false);
+                    searchThread = std::thread{[&, maxDepth] {
+                        searcher.runAnalysisSearch(
+                            result,
+                            pos,
+                            keyHistory,
+                            maxDepth,
+                            std::make_unique<FlagLimiter>(stopFlag)
+                        );
+                    }};
+                } else if (tokens[0] == "stop") {
+                    finishSearch(true);
+                } else if (tokens[0] == "newgame") {
+                    finishSearch(false);
+                    searcher.newGame();
+                }
+            }
+
+            finishSearch(false);
+
+            quitPump.store(true);
+            pump.join();
+        }
+    } // namespace
+
+    bool runWorker(const WorkerConfig& config) {
+        addrinfo hints{};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_flags = AI_PASSIVE;
+
+        addrinfo* addresses{};
+
+        if (getaddrinfo(config.address.c_str(), std::to_string(config.port).c_str(), &hints, &addresses) != 0) {
+            std::cerr << "Failed to resolve '" << config.address << "'" << std::endl;
+            return false;
+        }
+
+        i32 listener = -1;
+
+        for (auto* address = addresses; address; address = address->ai_next) {
+            listener = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+
+            if (listener < 0) {
+                continue;
+            }
+
+            const i32 enable = 1;
+            setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+
+            // accept ipv4 too when listening on an ipv6 wildcard
+            if (address->ai_family == AF_INET6) {
+                const i32 disable = 0;
+                setsockopt(listener, IPPROTO_IPV6, IPV6_V6ONLY, &disable, sizeof(disable));
+            }
+
+            if (bind(listener, address->ai_addr, address->ai_addrlen) == 0 && listen(listener, 1) == 0) {
+                break;
+            }
+
+            close(listener);
+            listener = -1;
+        }
+
+        freeaddrinfo(addresses);
+
+        if (listener < 0) {
+            std::cerr << "Failed to listen on " << config.address << " port " << config.port << std::endl;
+            return false;
+        }
+
+        Searcher searcher{config.hashMib};
+
+        searcher.setThreads(config.threads);
+        searcher.ensureReady();
+
+        EntryQueue queue{};
+        searcher.setEntryExport(&queue);
+
+        std::cout << "Listening on " << config.address << " port " << config.port << std::endl;
+
+        while (true) {
+            const auto socket = accept(listener, nullptr, nullptr);
+
+            if (socket < 0) {
+                continue;
+            }
+
+            const i32 noDelay = 1;
+            setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+
+            std::cout << "Main node connected" << std::endl;
+
+            {
+                Connection connection{socket};
+                serve(searcher, queue, connection);
+            }
+
+            // whatever the last search queued is of no use to the next main node
+            std::vector<SharedEntry> stale{};
+            queue.take(stale);
+
+            searcher.newGame();
+
+            std::cout << "Main node disconnected" << std::endl;
+        }
+    }
+#endif
+} // namespace stoat::cluster
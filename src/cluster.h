@@ -0,0 +1,153 @@
+/*
+ * Stoat, a USI shogi engine
+ * Copyright (C) 2025 Ciekce
+ *
+ * Stoat is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Stoat is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Stoat. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "types.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "core.h"
+#include "move.h"
+#include "position.h"
+#include "pv.h"
+#include "ttable.h"
+
+// Lazy SMP across machines. Worker nodes run `stoat clusterworker` and search the
+// same root as the main node, which reports the deepest result of any node. All
+// nodes send each other the tt entries they store from deep enough searches
+namespace stoat::cluster {
+    constexpr u16 kDefaultPort = 27235;
+    // workers only accept local main nodes unless told otherwise, the protocol has no authentication
+    constexpr std::string_view kDefaultBindAddress = "localhost";
+
+    // entries stored from searches at least this deep are sent to the other nodes
+    constexpr i32 kShareDepth = 8;
+    // entries per message
+    constexpr usize kBatchSize = 64;
+
+    struct SharedEntry {
+        u64 key;
+        // never a mate score, those are relative to the ply they were stored at
+        Score score;
+        Move move;
+        i32 depth;
+        tt::Flag flag;
+    };
+
+    // filled by the search threads, drained by whatever sends the entries to other nodes
+    class EntryQueue {
+    public:
+        void push(std::span<const SharedEntry> entries);
+        // swaps the queued entries into dst, which should be empty
+        void take(std::vector<SharedEntry>& dst);
+
+    private:
+        std::mutex m_mutex{};
+        std::vector<SharedEntry> m_entries{};
+    };
+
+    struct RemoteResult {
+        // 0 if not even depth 1 completed
+        i32 depth{};
+        Score score{};
+        PvList pv{};
+    };
+
+    class Connection;
+
+    // the main node's side of the cluster
+    class Client {
+    public:
+        using Importer = std::function<void(std::span<const SharedEntry>)>;
+
+        // entries received from workers are passed to the importer,
+        // from the threads that receive them, while the client lives
+        explicit Client(Importer importer);
+        ~Client();
+
+        // nodes are a comma-separated list of host:port pairs, the port is optional.
+        // Returns an error message on failure, after which the client is unusable
+        [[nodiscard]] std::optional<std::string> connect(std::string_view nodes);
+
+        [[nodiscard]] inline usize nodeCount() const {
+            return m_nodes.size();
+        }
+
+        // entries pushed here are sent to every worker
+        [[nodiscard]] inline EntryQueue& queue() {
+            return m_queue;
+        }
+
+        void newGame();
+
+        void startSearch(const Position& pos, std::span<const u64> keyHistory, i32 maxDepth);
+        // stops the workers and waits a little while for their results. empty if no search was
+        // started, or if no worker answered with at least one completed depth
+        [[nodiscard]] std::optional<RemoteResult> finishSearch();
+
+    private:
+        struct Node;
+
+        Importer m_importer;
+
+        std::vector<std::unique_ptr<Node>> m_nodes{};
+
+        EntryQueue m_queue{};
+
+        std::mutex m_resultMutex{};
+        std::condition_variable m_resultSignal{};
+
+        u64 m_searchId{};
+        bool m_searching{};
+
+        std::atomic_bool m_quit{};
+
+        std::mutex m_pumpMutex{};
+        std::condition_variable m_pumpSignal{};
+        std::thread m_pump{};
+
+        void runReader(Node& node);
+        void runPump();
+    };
+
+    struct WorkerConfig {
+        // a host name or address to listen on, "::" for every interface
+        std::string address{kDefaultBindAddress};
+        u16 port{kDefaultPort};
+        u32 threads{1};
+        usize hashMib{tt::kDefaultTtSizeMib};
+    };
+
+    // serves one main node at a time, forever. returns false if the address could not be listened on
+    bool runWorker(const WorkerConfig& config);
+
+    // [--bind <address>] [--port <port>] [--threads <count>] [--hash <mib>]
+    // prints an error and returns nothing if the arguments are invalid
+    [[nodiscard]] std::optional<WorkerConfig> parseWorkerArgs(std::span<const std::string_view> args);
+} // namespace stoat::cluster
@@ -870,4 +870,11 @@ namespace stoat {
     constexpr i32 kMaxDepth = 255;
 
     constexpr auto kScoreMaxMate = kScoreMate - kMaxDepth;
+
+    // bound of a reported root score, non-exact after an aspiration window fail
+    enum class ScoreBound : u8 {
+        kExact = 0,
+        kLowerBound,
+        kUpperBound,
+    };
 } // namespace stoat
@@ -0,0 +1,265 @@
+/*
+ * Stoat, a USI shogi engine
+ * Copyright (C) 2025 Ciekce
+ *
+ * Stoat is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Stoat is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Stoat. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "datagen.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <vector>
+
+#include "position.h"
+#include "search.h"
+#include "selfplay.h"
+#include "util/args.h"
+#include "util/rng.h"
+#include "util/timer.h"
+
+namespace stoat::datagen {
+    namespace {
+        // records are appended per game, and written whenever this many are buffered
+        constexpr usize kWriteBufferRecords = 16384;
+
+        constexpr u32 kReportInterval = 100;
+
+        class RecordWriter {
+        public:
+            explicit RecordWriter(std::ofstream& stream) :
+                    m_stream{stream} {
+                m_buffer.reserve(kWriteBufferRecords);
+            }
+
+            ~RecordWriter() {
+                flush();
+            }
+
+            void append(std::span<const Record> records) {
+                const std::unique_lock lock{m_mutex};
+
+                m_buffer.insert(m_buffer.end(), records.begin(), records.end());
+
+                if (m_buffer.size() >= kWriteBufferRecords) {
+                    flushUnlocked();
+                }
+            }
+
+            void flush() {
+                const std::unique_lock lock{m_mutex};
+                flushUnlocked();
+            }
+
+        private:
+            std::mutex m_mutex{};
+            std::ofstream& m_stream;
+
+            std::vector<Record> m_buffer{};
+
+            void flushUnlocked() {
+                m_stream.write(
+                    reinterpret_cast<const char*>(m_buffer.data()),
+                    static_cast<std::streamsize>(m_buffer.size() * sizeof(Record))
+                );
+                m_buffer.clear();
+            }
+        };
+
+        enum class Outcome {
+            kBlackWin = 0,
+            kDraw,
+            kWhiteWin,
+        };
+
+        [[nodiscard]] Outcome winFor(Color c) {
+            return c == Colors::kBlack ? Outcome::kBlackWin : Outcome::kWhiteWin;
+        }
+
+        struct PendingRecord {
+            Record record{};
+            Color stm{};
+        };
+    } // namespace
+
+    bool run(const DatagenConfig& config) {
+        std::ofstream stream{config.outputFile, std::ios::binary | std::ios::app};
+
+        if (!stream) {
+            std::cerr << "Failed to open output file '" << config.outputFile << "'" << std::endl;
+            return false;
+        }
+
+        const auto threadCount = std::max<u32>(1, std::min(config.threads, config.games));
+
+        const auto searchers = selfplay::createSearchers(threadCount, config.hashMib);
+
+        RecordWriter writer{stream};
+
+        std::atomic<u32> nextGame{};
+
+        std::atomic<u32> gamesDone{};
+        std::atomic<usize> positionsDone{};
+
+        const auto start = util::Instant::now();
+
+        const auto runThread = [&](Searcher& searcher) {
+            Position startPos{};
+            std::vector<u64> startKeys{};
+
+            std::vector<PendingRecord> pending{};
+            std::vector<Record> records{};
+
+            while (true) {
+                const auto gameIdx = nextGame.fetch_add(1, std::memory_order::relaxed);
+
+                if (gameIdx >= config.games) {
+                    break;
+                }
+
+                util::rng::Jsf64Rng rng{config.seed + gameIdx};
+
+                selfplay::playRandomOpening(startPos, startKeys, rng, config.randomPlies);
+
+                pending.clear();
+
+                const auto onMove = [&](const Position& pos, Move move, const AnalysisResult& result) {
+                    // the score of a capture or evasion mostly depends on
+                    // the next few plies, not on the position itself
+                    if (pos.isInCheck() || pos.isCapture(move)) {
+                        return;
+                    }
+
+                    auto& entry = pending.emplace_back();
+
+                    [[maybe_unused]] const auto packed = pos.pack(entry.record.pos);
+                    assert(packed);
+
+                    entry.record.score = static_cast<i16>(result.score);
+                    entry.stm = pos.stm();
+                };
+
+                const selfplay::Player player{&searcher, config.nodes};
+                const auto winner = selfplay::playGame({player, player}, startPos, startKeys, onMove);
+
+                const auto outcome = winner ? winFor(*winner) : Outcome::kDraw;
+
+                records.clear();
+
+                for (auto& entry : pending) {
+                    if (outcome == Outcome::kDraw) {
+                        entry.record.wdl = 1;
+                    } else {
+                        entry.record.wdl = outcome == winFor(entry.stm) ? 2 : 0;
+                    }
+
+                    records.push_back(entry.record);
+                }
+
+                writer.append(records);
+
+                const auto positions = positionsDone.fetch_add(records.size()) + records.size();
+                const auto games = gamesDone.fetch_add(1) + 1;
+
+                if (games % kReportInterval == 0 || games == config.games) {
+                    const auto time = start.elapsed();
+
+                    std::cerr << "games " << games << "/" << config.games << ", positions " << positions << ", "
+                              << static_cast<usize>(static_cast<f64>(positions) / time) << " positions/s"
+                              << std::endl;
+                }
+            }
+        };
+
+        std::vector<std::thread> threads{};
+        threads.reserve(threadCount);
+
+        for (u32 idx = 0; idx < threadCount; ++idx) {
+            threads.emplace_back(runThread, std::ref(*searchers[idx]));
+        }
+
+        for (auto& thread : threads) {
+            thread.join();
+        }
+
+        writer.flush();
+
+        std::cerr << "Wrote " << positionsDone.load() << " positions from " << config.games << " games to '"
+                  << config.outputFile << "' in " << std::fixed << std::setprecision(3) << start.elapsed() << " s"
+                  << std::defaultfloat << std::endl;
+
+        return true;
+    }
+
+    std::optional<DatagenConfig> parseArgs(std::span<const std::string_view> args) {
+        DatagenConfig config{};
+
+        const auto onOption = [&](std::string_view name, std::string_view value) {
+            if (name == "--threads") {
+                if (!util::parseArg(config.threads, value, "thread count")) {
+                    return false;
+                }
+
+                config.threads = kThreadCountRange.clamp(config.threads);
+            } else if (name == "--games") {
+                return util::parseArg(config.games, value, "game count");
+            } else if (name == "--nodes") {
+                if (!util::tryParse(config.nodes, value) || config.nodes == 0) {
+                    return util::invalidArg("node count", value);
+                }
+            } else if (name == "--hash") {
+                if (!util::parseArg(config.hashMib, value, "hash size")) {
+                    return false;
+                }
+
+                config.hashMib = tt::kTtSizeRange.clamp(config.hashMib);
+            } else if (name == "--random-plies") {
+                return util::parseArg(config.randomPlies, value, "random ply count");
+            } else if (name == "--seed") {
+                return util::parseArg(config.seed, value, "seed");
+            } else {
+                return util::unknownOption("datagen", name);
+            }
+
+            return true;
+        };
+
+        const auto onPositional = [&](std::string_view arg) {
+            if (!config.outputFile.empty()) {
+                return util::unexpectedArg(arg);
+            }
+
+            config.outputFile = arg;
+            return true;
+        };
+
+        if (!util::parseArgs(args, onOption, onPositional)) {
+            return {};
+        }
+
+        if (config.outputFile.empty()) {
+            std::cerr << "Missing output file" << std::endl;
+            return {};
+        }
+
+        return config;
+    }
+} // namespace stoat::datagen
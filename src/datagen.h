@@ -0,0 +1,73 @@
+/*
+ * Stoat, a USI shogi engine
+ * Copyright (C) 2025 Ciekce
+ *
+ * Stoat is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Stoat is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Stoat. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "types.h"
+
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+
+#include "position.h"
+
+namespace stoat::datagen {
+    constexpr u32 kDefaultDatagenThreads = 1;
+    constexpr u32 kDefaultDatagenGames = 1000;
+    constexpr usize kDefaultDatagenNodes = 5000;
+    constexpr usize kDefaultDatagenHashMib = 16;
+    constexpr u32 kDefaultRandomPlies = 8;
+
+    struct Record {
+        // see Position::pack()
+        PackedPosition pos{};
+        // from the side to move's perspective
+        i16 score{};
+        // for the side to move, 0 for a loss, 1 for a draw and 2 for a win
+        u8 wdl{};
+        u8 reserved{};
+    };
+
+    // written to disk as is, little endian
+    static_assert(sizeof(Record) == 36);
+
+    struct DatagenConfig {
+        std::string outputFile{};
+
+        u32 threads{kDefaultDatagenThreads};
+        u32 games{kDefaultDatagenGames};
+
+        // per move, every thread searches with a single search thread and its own tt
+        usize nodes{kDefaultDatagenNodes};
+        usize hashMib{kDefaultDatagenHashMib};
+
+        // uniformly random legal moves played from startpos before the recorded part of each game
+        u32 randomPlies{kDefaultRandomPlies};
+        // game n is played with seed + n, regardless of which thread plays it
+        u64 seed{};
+    };
+
+    // returns false if the output file could not be opened
+    bool run(const DatagenConfig& config);
+
+    // <file> [--threads <count>] [--games <count>] [--nodes <nodes>] [--hash <mib>]
+    //     [--random-plies <plies>] [--seed <seed>]
+    // prints an error and returns nothing if the arguments are invalid
+    [[nodiscard]] std::optional<DatagenConfig> parseArgs(std::span<const std::string_view> args);
+} // namespace stoat::datagen
@@ -0,0 +1,354 @@
+/*
+ * Stoat, a USI shogi engine
+ * Copyright (C) 2025 Ciekce
+ *
+ * Stoat is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Stoat is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Stoat. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "dfpn.h"
+
+#include <algorithm>
+#include <cassert>
+#include <limits>
+
+namespace stoat::mate {
+    namespace {
+        [[nodiscard]] constexpr u32 saturatingAdd(u32 a, u32 b) {
+            return static_cast<u32>(std::min<u64>(static_cast<u64>(a) + b, kProofInf));
+        }
+
+        [[nodiscard]] constexpr ProofNumbers provenNumbers(u16 dist) {
+            return {.pn = 0, .dn = kProofInf, .dist = dist};
+        }
+
+        [[nodiscard]] constexpr ProofNumbers disprovenNumbers(u16 dist) {
+            return {.pn = kProofInf, .dn = 0, .dist = dist};
+        }
+    } // namespace
+
+    DfpnTable::DfpnTable(usize mib) {
+        resize(mib);
+    }
+
+    void DfpnTable::resize(usize mib) {
+        const auto clusters = std::max<usize>(1, mib * 1024 * 1024 / sizeof(Cluster));
+
+        m_clusters.clear();
+        m_clusters.shrink_to_fit();
+
+        m_clusters.resize(clusters);
+    }
+
+    void DfpnTable::clear() {
+        std::ranges::fill(m_clusters, Cluster{});
+    }
+
+    ProofNumbers DfpnTable::probe(u64 key) const {
+        const auto idx = index(key);
+
+        std::unique_lock<std::mutex> lock{};
+        if (m_shared) {
+            lock = std::unique_lock{m_locks[idx % kLockCount]};
+        }
+
+        for (const auto& entry : m_clusters[idx]) {
+            if (entry.key == key && entry.work > 0) {
+                return {.pn = entry.pn, .dn = entry.dn, .dist = entry.dist};
+            }
+        }
+
+        return {};
+    }
+
+    void DfpnTable::put(u64 key, const ProofNumbers& numbers, u32 work) {
+        const auto idx = index(key);
+
+        std::unique_lock<std::mutex> lock{};
+        if (m_shared) {
+            lock = std::unique_lock{m_locks[idx % kLockCount]};
+        }
+
+        auto& cluster = m_clusters[idx];
+
+        // replace the entry for this position if there is one, otherwise the one with the least work behind it.
+        // empty entries have no work, solved positions are worth keeping over work on unsolved ones
+        const auto worth = [](const Entry& entry) {
+            const bool solved = entry.pn == 0 || entry.dn == 0;
+            return static_cast<u64>(solved) << 32 | entry.work;
+        };
+
+        auto* replace = &cluster[0];
+
+        for (auto& entry : cluster) {
+            if (entry.key == key) {
+                replace = &entry;
+                break;
+            }
+
+            if (worth(entry) < worth(*replace)) {
+                replace = &entry;
+            }
+        }
+
+        *replace = {
+            .key = key,
+            .pn = numbers.pn,
+            .dn = numbers.dn,
+            .work = std::max<u32>(work, 1),
+            .dist = numbers.dist,
+        };
+    }
+
+    DfpnSolver::DfpnSolver(DfpnTable& table, u32 threadId, StopCheck stopCheck) :
+            m_table{table}, m_threadId{threadId}, m_stopCheck{std::move(stopCheck)}, m_plies(kMaxMatePly) {}
+
+    SolveResult DfpnSolver::solve(const Position& root, std::span<const u64> gameKeys) {
+        m_stopped = false;
+        m_path.clear();
+
+        m_gameKeys.assign(gameKeys.begin(), gameKeys.end());
+        std::ranges::sort(m_gameKeys);
+
+        while (!m_stopped) {
+            // other solvers may overwrite the root's entry, in which case it is searched again
+            const auto numbers = m_table.probe(root.key());
+
+            if (numbers.pn == 0) {
+                return SolveResult::kProven;
+            }
+
+            if (numbers.dn == 0) {
+                return SolveResult::kDisproven;
+            }
+
+            mid(root, kProofInf, kProofInf, 0, true);
+        }
+
+        return SolveResult::kUnknown;
+    }
+
+    void DfpnSolver::mid(const Position& pos, u32 thPhi, u32 thDelta, i32 ply, bool attacker) {
+        ++m_nodes;
+
+        if (m_nodes % kStopCheckInterval == 0 && m_stopCheck(m_nodes)) {
+            m_stopped = true;
+        }
+
+        if (m_stopped) {
+            return;
+        }
+
+        // children beyond the ply limit are never searched
+        assert(ply < kMaxMatePly);
+
+        const auto key = pos.key();
+
+        auto& [moves, childKeys] = m_plies[ply];
+
+        moves.clear();
+        generateMateMoves(moves, pos, attacker);
+
+        // the attacker has run out of checks, or the defender is mated
+        if (moves.empty()) {
+            m_table.put(key, attacker ? disprovenNumbers(0) : provenNumbers(0), 1);
+            return;
+        }
+
+        childKeys.clear();
+
+        for (const auto move : moves) {
+            childKeys.push(pos.keyAfter(move));
+        }
+
+        m_path.push(key);
+
+        const auto startNodes = m_nodes;
+
+        // helpers start scanning children at different moves, so that ties send them down different lines
+        const auto offset = m_threadId % moves.size();
+
+        u32 phi{};
+        u32 delta{};
+        u16 dist{};
+
+        while (true) {
+            phi = kProofInf;
+            delta = 0;
+
+            usize bestIdx = 0;
+            u32 bestPhi = kProofInf;
+            u32 secondDelta = kProofInf;
+
+            u16 winDist = std::numeric_limits<u16>::max();
+            u16 lossDist = 0;
+
+            for (usize i = 0; i < moves.size(); ++i) {
+                const auto idx = (i + offset) % moves.size();
+                const auto childKey = childKeys[idx];
+
+                // the side to move at the child also moved two plies before this node
+                bool repeated = std::ranges::binary_search(m_gameKeys, childKey);
+                for (usize back = 2; back <= m_path.size() && !repeated; back += 2) {
+                    repeated = m_path[m_path.size() - back] == childKey;
+                }
+
+                // a repetition, or running into the ply limit, is a failure for the attacker
+                // but only on this path, so it is not stored
+                const auto numbers =
+                    repeated || ply + 1 >= kMaxMatePly ? disprovenNumbers(0) : m_table.probe(childKey);
+
+                // child proof numbers from the point of view of its side to move
+                const auto childPhi = attacker ? numbers.dn : numbers.pn;
+                const auto childDelta = attacker ? numbers.pn : numbers.dn;
+
+                delta = saturatingAdd(delta, childPhi);
+
+                if (childDelta < phi) {
+                    secondDelta = phi;
+                    phi = childDelta;
+                    bestPhi = childPhi;
+                    bestIdx = idx;
+                } else if (childDelta < secondDelta) {
+                    secondDelta = childDelta;
+                }
+
+                if (childDelta == 0) {
+                    winDist = std::min<u16>(winDist, numbers.dist + 1);
+                }
+
+                lossDist = std::max<u16>(lossDist, numbers.dist + 1);
+            }
+
+            if (phi == 0) {
+                dist = winDist;
+                break;
+            }
+
+            if (delta == 0) {
+                dist = lossDist;
+                break;
+            }
+
+            if (phi >= thPhi || delta >= thDelta || m_stopped) {
+                dist = 0;
+                break;
+            }
+
+            // delta < thDelta here
+            const auto childThPhi = saturatingAdd(thDelta - delta, bestPhi);
+            const auto childThDelta = std::min(thPhi, saturatingAdd(secondDelta, 1));
+
+            const auto newPos = pos.applyMove(moves[bestIdx]);
+            mid(newPos, childThPhi, childThDelta, ply + 1, !attacker);
+        }
+
+        m_path.resize(m_path.size() - 1);
+
+        const auto work = static_cast<u32>(std::min<usize>(m_nodes - startNodes + 1, std::numeric_limits<u32>::max()));
+        const ProofNumbers numbers{
+            .pn = attacker ? phi : delta,
+            .dn = attacker ? delta : phi,
+            .dist = dist,
+        };
+
+        m_table.put(key, numbers, work);
+    }
+
+    void generateMateMoves(movegen::MoveList& dst, const Position& pos, bool attacker) {
+        if (!attacker) {
+            movegen::generateLegal(dst, pos);
+            return;
+        }
+
+        if (!pos.isInCheck()) {
+            movegen::generateLegalChecks(dst, pos, ~pos.colorBb(pos.stm()));
+            return;
+        }
+
+        // evasions that check back, rare enough that filtering is fine
+        movegen::MoveList evasions{};
+        movegen::generateLegal(evasions, pos);
+
+        for (const auto move : evasions) {
+            if (pos.applyMove(move).isInCheck()) {
+                dst.push(move);
+            }
+        }
+    }
+
+    bool extractMateLine(MateLine& dst, const DfpnTable& table, const Position& root, std::span<const u64> gameKeys) {
+        dst.clear();
+
+        auto pos = root;
+        bool attacker = true;
+
+        util::StaticVector<u64, kMaxMatePly + 1> path{};
+
+        while (dst.size() < kMaxMatePly) {
+            movegen::MoveList moves{};
+            generateMateMoves(moves, pos, attacker);
+
+            if (!attacker && moves.empty()) {
+                return !dst.empty();
+            }
+
+            path.push(pos.key());
+
+            Move best = kNullMove;
+            i32 bestDist = attacker ? std::numeric_limits<i32>::max() : -1;
+
+            for (const auto move : moves) {
+                const auto childKey = pos.keyAfter(move);
+
+                if (std::ranges::find(path, childKey) != path.end()
+                    || std::ranges::find(gameKeys, childKey) != gameKeys.end())
+                {
+                    // every defence must be refuted, a repetition is not
+                    if (!attacker) {
+                        return false;
+                    }
+
+                    continue;
+                }
+
+                const auto numbers = table.probe(childKey);
+
+                if (numbers.pn != 0) {
+                    if (!attacker) {
+                        return false;
+                    }
+
+                    continue;
+                }
+
+                // shortest mate for the attacker, longest resistance for the defender
+                if (attacker ? numbers.dist < bestDist : numbers.dist > bestDist) {
+                    best = move;
+                    bestDist = numbers.dist;
+                }
+            }
+
+            if (best.isNull()) {
+                return false;
+            }
+
+            dst.push(best);
+
+            pos = pos.applyMove(best);
+            attacker = !attacker;
+        }
+
+        return false;
+    }
+} // namespace stoat::mate
@@ -0,0 +1,158 @@
+/*
+ * Stoat, a USI shogi engine
+ * Copyright (C) 2025 Ciekce
+ *
+ * Stoat is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Stoat is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Stoat. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "types.h"
+
+#include <array>
+#include <functional>
+#include <mutex>
+#include <span>
+#include <vector>
+
+#include "move.h"
+#include "movegen.h"
+#include "position.h"
+#include "util/range.h"
+#include "util/static_vector.h"
+
+// Depth-first proof-number search (Nagai 2002) for tsume problems: proving that
+// the side to move can force mate with a sequence of checks, or that it cannot
+namespace stoat::mate {
+    constexpr usize kDefaultMateTableSizeMib = 16;
+    constexpr util::Range<usize> kMateTableSizeRange{1, 131072};
+
+    constexpr u32 kProofInf = 1U << 30;
+
+    // proving plies deeper than this is not attempted
+    constexpr i32 kMaxMatePly = 255;
+
+    struct ProofNumbers {
+        u32 pn{1};
+        u32 dn{1};
+        // plies until the end of a solved line, 0 otherwise
+        u16 dist{};
+    };
+
+    // proof and disproof numbers of positions, always from the
+    // point of view of the attacker, shared between solver threads
+    class DfpnTable {
+    public:
+        explicit DfpnTable(usize mib);
+
+        void resize(usize mib);
+        void clear();
+
+        // locking is only needed when several solvers share the table
+        inline void setShared(bool shared) {
+            m_shared = shared;
+        }
+
+        // unsolved defaults for missing positions
+        [[nodiscard]] ProofNumbers probe(u64 key) const;
+        void put(u64 key, const ProofNumbers& numbers, u32 work);
+
+    private:
+        struct Entry {
+            u64 key;
+            u32 pn;
+            u32 dn;
+            // nodes spent on this position, saturating
+            u32 work;
+            u16 dist;
+        };
+
+        static constexpr usize kClusterSize = 4;
+        using Cluster = std::array<Entry, kClusterSize>;
+
+        static constexpr usize kLockCount = 1024;
+
+        [[nodiscard]] inline usize index(u64 key) const {
+            return static_cast<usize>((static_cast<u128>(key) * static_cast<u128>(m_clusters.size())) >> 64);
+        }
+
+        std::vector<Cluster> m_clusters{};
+
+        bool m_shared{};
+        mutable std::array<std::mutex, kLockCount> m_locks{};
+    };
+
+    enum class SolveResult {
+        kUnknown = 0,
+        kProven,
+        kDisproven,
+    };
+
+    using MateLine = util::StaticVector<Move, kMaxMatePly>;
+
+    class DfpnSolver {
+    public:
+        // polled every few nodes with the current node count, true stops the solver
+        using StopCheck = std::function<bool(usize nodes)>;
+
+        DfpnSolver(DfpnTable& table, u32 threadId, StopCheck stopCheck);
+
+        // runs until the root is solved or stopCheck returns true. gameKeys are the
+        // keys of the positions before the root, which the attacker may not repeat either
+        [[nodiscard]] SolveResult solve(const Position& root, std::span<const u64> gameKeys);
+
+        [[nodiscard]] inline usize nodes() const {
+            return m_nodes;
+        }
+
+    private:
+        static constexpr usize kStopCheckInterval = 256;
+
+        DfpnTable& m_table;
+        u32 m_threadId;
+
+        StopCheck m_stopCheck;
+        bool m_stopped{};
+
+        usize m_nodes{};
+
+        // keys of the positions on the current line, repeating one of them fails for the attacker
+        util::StaticVector<u64, kMaxMatePly + 1> m_path{};
+        // likewise for the game history before the root, sorted
+        std::vector<u64> m_gameKeys{};
+
+        struct PlyBuffers {
+            movegen::MoveList moves;
+            util::StaticVector<u64, movegen::kMaxMoves> childKeys;
+        };
+
+        // [ply], on the heap rather than in every frame of mid(), which recurses up to kMaxMatePly deep
+        std::vector<PlyBuffers> m_plies;
+
+        // thPhi and thDelta bound the proof numbers from the point of view of the side to move:
+        // pn and dn when the attacker is to move, dn and pn otherwise
+        void mid(const Position& pos, u32 thPhi, u32 thDelta, i32 ply, bool attacker);
+    };
+
+    // candidate moves at a node: checks for the attacker, evasions for the defender
+    void generateMateMoves(movegen::MoveList& dst, const Position& pos, bool attacker);
+
+    // the mating line of a proven root, read back from the table. false if it is no longer intact
+    [[nodiscard]] bool extractMateLine(
+        MateLine& dst,
+        const DfpnTable& table,
+        const Position& root,
+        std::span<const u64> gameKeys
+    );
+} // namespace stoat::mate
@@ -0,0 +1,84 @@
+/*
+ * Stoat, a USI shogi engine
+ * Copyright (C) 2025 Ciekce
+ *
+ * Stoat is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Stoat is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Stoat. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "../types.h"
+
+#include <algorithm>
+#include <optional>
+#include <vector>
+
+#include "../core.h"
+
+namespace stoat::eval {
+    // Small direct-mapped cache of static evals, owned by a single search
+    // thread. Only worth probing for evals more expensive than a cache miss
+    class EvalCache {
+    public:
+        static constexpr usize kEntryCount = 1 << 15;
+
+        EvalCache() :
+                m_entries(kEntryCount) {}
+
+        [[nodiscard]] inline std::optional<Score> probe(u64 key) const {
+            const auto& entry = m_entries[index(key)];
+
+            if (entry.key != packKey(key)) {
+                return {};
+            }
+
+            return entry.score;
+        }
+
+        inline void put(u64 key, Score score) {
+            m_entries[index(key)] = {packKey(key), score};
+        }
+
+        // cached evals are only valid for the network they were computed with
+        inline void setNetwork(u32 networkId) {
+            if (networkId != m_networkId) {
+                clear();
+                m_networkId = networkId;
+            }
+        }
+
+        inline void clear() {
+            std::ranges::fill(m_entries, Entry{});
+        }
+
+    private:
+        struct Entry {
+            u32 key;
+            Score score;
+        };
+
+        static_assert(sizeof(Entry) == 8);
+
+        std::vector<Entry> m_entries;
+        u32 m_networkId{};
+
+        [[nodiscard]] static constexpr usize index(u64 key) {
+            return static_cast<usize>(key) % kEntryCount;
+        }
+
+        [[nodiscard]] static constexpr u32 packKey(u64 key) {
+            return static_cast<u32>(key >> 32);
+        }
+    };
+} // namespace stoat::eval
@@ -22,63 +22,32 @@
 #include <cmath>
 
 #include "../attacks/attacks.h"
+#include "../util/multi_array.h"
 #include "material.h"
 
 namespace stoat::eval {
     namespace {
         constexpr Score kKingRingPieceScale = 8;
 
-        [[nodiscard]] Score evalMaterial(const Position& pos, Color c) {
-            const auto materialCount = [&](PieceType pt) {
-                const auto count = pos.pieceBb(pt, c).popcount();
-                return count * pieceValue(pt);
-            };
+        // indexed by king square and number of own pieces in the king ring
+        const auto s_kingSafety = [] {
+            util::MultiArray<Score, Squares::kCount, 9> table{};
 
-            Score score{};
+            for (u8 sqIdx = 0; sqIdx < Squares::kCount; ++sqIdx) {
+                const auto kingRing = attacks::kingAttacks(Square::fromRaw(sqIdx));
+                const auto kingRingSquareCount = static_cast<f64>(kingRing.popcount());
 
-            score += materialCount(PieceTypes::kPawn);
-            score += materialCount(PieceTypes::kPromotedPawn);
-            score += materialCount(PieceTypes::kLance);
-            score += materialCount(PieceTypes::kKnight);
-            score += materialCount(PieceTypes::kPromotedLance);
-            score += materialCount(PieceTypes::kPromotedKnight);
-            score += materialCount(PieceTypes::kSilver);
-            score += materialCount(PieceTypes::kPromotedSilver);
-            score += materialCount(PieceTypes::kGold);
-            score += materialCount(PieceTypes::kBishop);
-            score += materialCount(PieceTypes::kRook);
-            score += materialCount(PieceTypes::kPromotedBishop);
-            score += materialCount(PieceTypes::kPromotedRook);
-
-            const auto& hand = pos.hand(c);
-
-            if (hand.empty()) {
-                return score;
+                for (u32 pieces = 0; pieces <= kingRing.popcount(); ++pieces) {
+                    const auto filled = 8.0 * std::min(static_cast<f64>(pieces) / kingRingSquareCount, 0.75);
+                    table[sqIdx][pieces] = kKingRingPieceScale * static_cast<i32>(std::pow(filled, 1.6));
+                }
             }
 
-            const auto handPieceValue = [&](PieceType pt) { return static_cast<i32>(hand.count(pt)) * pieceValue(pt); };
-
-            score += handPieceValue(PieceTypes::kPawn);
-            score += handPieceValue(PieceTypes::kLance);
-            score += handPieceValue(PieceTypes::kKnight);
-            score += handPieceValue(PieceTypes::kSilver);
-            score += handPieceValue(PieceTypes::kGold);
-            score += handPieceValue(PieceTypes::kBishop);
-            score += handPieceValue(PieceTypes::kRook);
-
-            return score;
-        }
+            return table;
+        }();
 
         [[nodiscard]] Score evalKingSafety(const Position& pos, Color c) {
-            const auto stmPieces = pos.colorBb(c);
-            const auto kingRing = attacks::kingAttacks(pos.king(c));
-
-            const auto kingRingSquareCount = static_cast<f64>(kingRing.popcount());
-            const auto kingRingPieceCount = static_cast<f64>((stmPieces & kingRing).popcount());
-
-            const auto filled = 8.0 * std::min(kingRingPieceCount / kingRingSquareCount, 0.75);
-
-            return kKingRingPieceScale * static_cast<i32>(std::pow(filled, 1.6));
+            return s_kingSafety[pos.king(c).idx()][pos.kingRingPieces(c)];
         }
     } // namespace
 
@@ -88,9 +57,17 @@ namespace stoat::eval {
 
         Score score{};
 
-        score += evalMaterial(pos, stm) - evalMaterial(pos, nstm);
+        score += stm == Colors::kBlack ? pos.material() : -pos.material();
         score += evalKingSafety(pos, stm) - evalKingSafety(pos, nstm);
 
         return std::clamp(score, -kScoreWin + 1, kScoreWin - 1);
     }
+
+    Score staticEval(const Position& pos, const nnue::NnueState& nnueState) {
+        if (!nnueState.enabled()) {
+            return staticEval(pos);
+        }
+
+        return std::clamp(nnueState.evaluate(pos), -kScoreWin + 1, kScoreWin - 1);
+    }
 } // namespace stoat::eval
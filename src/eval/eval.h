@@ -22,7 +22,11 @@
 
 #include "../core.h"
 #include "../position.h"
+#include "nnue.h"
 
 namespace stoat::eval {
+    // hand-written eval, used when no network is loaded
     [[nodiscard]] Score staticEval(const Position& pos);
+
+    [[nodiscard]] Score staticEval(const Position& pos, const nnue::NnueState& nnueState);
 }
@@ -0,0 +1,372 @@
+/*
+ * Stoat, a USI shogi engine
+ * Copyright (C) 2025 Ciekce
+ *
+ * Stoat is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Stoat is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Stoat. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "nnue.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include "../util/static_vector.h"
+
+#ifdef ST_EMBEDDED_NETWORK
+// Embeds the network file into the binary. The path is passed in from the build
+    #if defined(__APPLE__)
+        #define ST_INCBIN_SECTION ".const_data"
+        #define ST_INCBIN_PREFIX "_"
+    #elif defined(_WIN32)
+        #define ST_INCBIN_SECTION ".rdata"
+        #define ST_INCBIN_PREFIX ""
+    #else
+        #define ST_INCBIN_SECTION ".rodata"
+        #define ST_INCBIN_PREFIX ""
+    #endif
+
+__asm__(".section " ST_INCBIN_SECTION "\n"
+        ".balign 64\n"
+        ".globl " ST_INCBIN_PREFIX "g_stoatEmbeddedNetwork\n" ST_INCBIN_PREFIX "g_stoatEmbeddedNetwork:\n"
+        ".incbin \"" ST_EMBEDDED_NETWORK "\"\n"
+        ".globl " ST_INCBIN_PREFIX "g_stoatEmbeddedNetworkEnd\n" ST_INCBIN_PREFIX "g_stoatEmbeddedNetworkEnd:\n"
+        ".byte 0\n"
+        ".text\n");
+
+extern "C" const std::byte g_stoatEmbeddedNetwork[];
+extern "C" const std::byte g_stoatEmbeddedNetworkEnd[];
+#endif
+
+namespace stoat::eval::nnue {
+    namespace {
+        constexpr std::array kHandPieces = {
+            PieceTypes::kPawn,
+            PieceTypes::kLance,
+            PieceTypes::kKnight,
+            PieceTypes::kSilver,
+            PieceTypes::kGold,
+            PieceTypes::kBishop,
+            PieceTypes::kRook,
+        };
+
+        constexpr auto kHandFeatureOffsets = [] {
+            std::array<u32, PieceTypes::kCount> offsets{};
+
+            offsets[PieceTypes::kPawn.idx()] = 0;
+            offsets[PieceTypes::kLance.idx()] = 18;
+            offsets[PieceTypes::kKnight.idx()] = 22;
+            offsets[PieceTypes::kSilver.idx()] = 26;
+            offsets[PieceTypes::kGold.idx()] = 30;
+            offsets[PieceTypes::kBishop.idx()] = 34;
+            offsets[PieceTypes::kRook.idx()] = 36;
+
+            return offsets;
+        }();
+
+        static_assert(kHandFeatureOffsets[PieceTypes::kRook.idx()] + 2 == kHandFeaturesPerColor);
+
+        // for a single update, a capture is at most 2 adds and 2 subs
+        using FeatureList = util::StaticVector<u32, 2>;
+
+        std::unique_ptr<Network> s_network{};
+        u32 s_networkId{};
+
+        [[nodiscard]] constexpr Square relativeSquare(Color perspective, Square sq) {
+            return perspective == Colors::kBlack ? sq : Square::fromRaw(Squares::kCount - 1 - sq.idx());
+        }
+
+        [[nodiscard]] u32 kingBucket(Color perspective, Square king) {
+            const auto relative = relativeSquare(perspective, king);
+            return (relative.rank() / 3) * 3 + relative.file() / 3;
+        }
+
+        [[nodiscard]] u32 boardFeature(Color perspective, u32 bucket, Piece piece, Square sq) {
+            const auto relativePiece = piece.type().idx() * 2 + (piece.color() == perspective ? 0 : 1);
+            return bucket * kFeaturesPerBucket + relativePiece * Squares::kCount
+                 + relativeSquare(perspective, sq).idx();
+        }
+
+        // the feature of the nth (from 0) piece of type pt in c's hand
+        [[nodiscard]] u32 handFeature(Color perspective, u32 bucket, Color c, PieceType pt, u32 n) {
+            assert(n < 18);
+            return bucket * kFeaturesPerBucket + kBoardFeatures + (c == perspective ? 0 : kHandFeaturesPerColor)
+                 + kHandFeatureOffsets[pt.idx()] + n;
+        }
+
+        void applyUpdates(
+            const Network& network,
+            const std::array<i16, kL1Size>& src,
+            std::array<i16, kL1Size>& dst,
+            const FeatureList& adds,
+            const FeatureList& subs
+        ) {
+            for (usize i = 0; i < kL1Size; i += simd::kChunkSize) {
+                auto v = simd::loadI16(&src[i]);
+
+                for (const auto feature : adds) {
+                    v = simd::addI16(v, simd::loadI16(&network.ftWeights[feature][i]));
+                }
+
+                for (const auto feature : subs) {
+                    v = simd::subI16(v, simd::loadI16(&network.ftWeights[feature][i]));
+                }
+
+                simd::storeI16(&dst[i], v);
+            }
+        }
+
+        [[nodiscard]] i32 screluDot(const std::array<i16, kL1Size>& inputs, const i16* weights) {
+            const auto zero = simd::zeroI16();
+            const auto one = simd::set1I16(kFtQ);
+
+            auto sum = simd::zeroI32();
+
+            for (usize i = 0; i < kL1Size; i += simd::kChunkSize) {
+                const auto v = simd::minI16(simd::maxI16(simd::loadI16(&inputs[i]), zero), one);
+                const auto w = simd::loadI16(&weights[i]);
+
+                // v * w fits in an i16 as long as |w| <= 127, then multiplying
+                // by v again in the multiply-add gives v^2 * w without overflow
+                const auto product = simd::mulLoI16(v, w);
+                sum = simd::addI32(sum, simd::mulAddAdjI16(product, v));
+            }
+
+            return simd::hsumI32(sum);
+        }
+
+        [[nodiscard]] std::optional<std::string> loadFromMemory(const std::byte* data, usize size) {
+            if (size != kNetworkFileSize) {
+                return "wrong network size " + std::to_string(size) + ", expected " + std::to_string(kNetworkFileSize);
+            }
+
+            auto network = std::make_unique<Network>();
+
+            const auto read = [&](void* dst, usize bytes) {
+                std::memcpy(dst, data, bytes);
+                data += bytes;
+            };
+
+            read(network->ftWeights.data(), sizeof(network->ftWeights));
+            read(network->ftBiases.data(), sizeof(network->ftBiases));
+            read(network->l1Weights.data(), sizeof(network->l1Weights));
+            read(&network->l1Bias, sizeof(network->l1Bias));
+
+            if (std::ranges::any_of(network->l1Weights, [](i16 w) { return w < -127 || w > 127; })) {
+                return "output weights out of range";
+            }
+
+            s_network = std::move(network);
+            ++s_networkId;
+
+            return {};
+        }
+    } // namespace
+
+    const Network* network() {
+        return s_network.get();
+    }
+
+    void loadDefaultNetwork() {
+#ifdef ST_EMBEDDED_NETWORK
+        const auto size = static_cast<usize>(g_stoatEmbeddedNetworkEnd - g_stoatEmbeddedNetwork);
+        if (const auto err = loadFromMemory(g_stoatEmbeddedNetwork, size)) {
+            std::cerr << "Failed to load embedded network: " << *err << std::endl;
+            unloadNetwork();
+        }
+#else
+        unloadNetwork();
+#endif
+    }
+
+    void unloadNetwork() {
+        s_network.reset();
+        ++s_networkId;
+    }
+
+    u32 networkId() {
+        return s_networkId;
+    }
+
+    std::optional<std::string> loadNetwork(const std::string& path) {
+        std::ifstream stream{path, std::ios::binary | std::ios::ate};
+
+        if (!stream) {
+            return "failed to open " + path;
+        }
+
+        const auto size = static_cast<usize>(stream.tellg());
+        stream.seekg(0);
+
+        std::vector<std::byte> data(size);
+
+        if (!stream.read(reinterpret_cast<char*>(data.data()), static_cast<std::streamsize>(size))) {
+            return "failed to read " + path;
+        }
+
+        return loadFromMemory(data.data(), data.size());
+    }
+
+    bool hasEmbeddedNetwork() {
+#ifdef ST_EMBEDDED_NETWORK
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    NnueState::NnueState() {
+        m_accumulatorStack.resize(kMaxDepth + 1);
+    }
+
+    void NnueState::reset(const Position& pos) {
+        m_network = network();
+        m_curr = m_accumulatorStack.data();
+
+        if (!m_network) {
+            return;
+        }
+
+        for (const auto c : {Colors::kBlack, Colors::kWhite}) {
+            refresh(*m_curr, c, pos, kingBucket(c, pos.king(c)));
+        }
+    }
+
+    void NnueState::push(const Position& pos, Move move) {
+        if (!m_network) {
+            return;
+        }
+
+        assert(m_curr < &m_accumulatorStack.back());
+
+        const auto& src = *m_curr;
+        auto& dst = *++m_curr;
+
+        const auto stm = pos.stm();
+        const auto moving = pos.movingPiece(move);
+
+        for (const auto perspective : {Colors::kBlack, Colors::kWhite}) {
+            const auto oldBucket = kingBucket(perspective, pos.king(perspective));
+            auto bucket = oldBucket;
+
+            if (moving == PieceTypes::kKing.withColor(perspective)) {
+                bucket = kingBucket(perspective, move.to());
+            }
+
+            FeatureList adds{};
+            FeatureList subs{};
+
+            if (move.isDrop()) {
+                const auto pt = move.dropPiece();
+                const auto count = pos.hand(stm).count(pt);
+
+                subs.push(handFeature(perspective, bucket, stm, pt, count - 1));
+                adds.push(boardFeature(perspective, bucket, moving, move.to()));
+            } else {
+                subs.push(boardFeature(perspective, bucket, moving, move.from()));
+                adds.push(boardFeature(perspective, bucket, move.isPromo() ? moving.promoted() : moving, move.to()));
+
+                if (const auto captured = pos.pieceOn(move.to())) {
+                    const auto handPt = captured.type().unpromoted();
+                    const auto count = pos.hand(stm).count(handPt);
+
+                    subs.push(boardFeature(perspective, bucket, captured, move.to()));
+                    adds.push(handFeature(perspective, bucket, stm, handPt, count));
+                }
+            }
+
+            if (bucket != oldBucket) {
+                // rebuild the old position's features in the new bucket, then apply the move on top
+                refresh(dst, perspective, pos, bucket);
+                applyUpdates(*m_network, dst.forColor(perspective), dst.forColor(perspective), adds, subs);
+            } else {
+                applyUpdates(*m_network, src.forColor(perspective), dst.forColor(perspective), adds, subs);
+            }
+        }
+    }
+
+    void NnueState::pushNull() {
+        if (!m_network) {
+            return;
+        }
+
+        assert(m_curr < &m_accumulatorStack.back());
+
+        const auto& src = *m_curr;
+        *++m_curr = src;
+    }
+
+    void NnueState::pop() {
+        if (!m_network) {
+            return;
+        }
+
+        assert(m_curr > m_accumulatorStack.data());
+        --m_curr;
+    }
+
+    Score NnueState::evaluate(const Position& pos) const {
+        assert(m_network);
+
+        const auto stm = pos.stm();
+        const auto nstm = stm.flip();
+
+        i32 sum{};
+
+        sum += screluDot(m_curr->forColor(stm), &m_network->l1Weights[0]);
+        sum += screluDot(m_curr->forColor(nstm), &m_network->l1Weights[kL1Size]);
+
+        // activations are in Q(ft)^2 after squaring, bring back to Q(ft) first
+        const auto out = sum / kFtQ + m_network->l1Bias;
+
+        return out * kScale / (kFtQ * kL1Q);
+    }
+
+    void NnueState::refresh(Accumulator& acc, Color perspective, const Position& pos, u32 bucket) const {
+        assert(m_network);
+
+        auto& values = acc.forColor(perspective);
+        values = m_network->ftBiases;
+
+        const auto add = [&](u32 feature) {
+            for (usize i = 0; i < kL1Size; i += simd::kChunkSize) {
+                const auto v = simd::loadI16(&values[i]);
+                const auto w = simd::loadI16(&m_network->ftWeights[feature][i]);
+                simd::storeI16(&values[i], simd::addI16(v, w));
+            }
+        };
+
+        auto occ = pos.occupancy();
+        while (!occ.empty()) {
+            const auto sq = occ.popLsb();
+            add(boardFeature(perspective, bucket, pos.pieceOn(sq), sq));
+        }
+
+        for (const auto c : {Colors::kBlack, Colors::kWhite}) {
+            const auto& hand = pos.hand(c);
+
+            if (hand.empty()) {
+                continue;
+            }
+
+            for (const auto pt : kHandPieces) {
+                const auto count = hand.count(pt);
+                for (u32 n = 0; n < count; ++n) {
+                    add(handFeature(perspective, bucket, c, pt, n));
+                }
+            }
+        }
+    }
+} // namespace stoat::eval::nnue
@@ -0,0 +1,134 @@
+/*
+ * Stoat, a USI shogi engine
+ * Copyright (C) 2025 Ciekce
+ *
+ * Stoat is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Stoat is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Stoat. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "../types.h"
+
+#include <array>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "../core.h"
+#include "../move.h"
+#include "../position.h"
+#include "../util/multi_array.h"
+#include "simd.h"
+
+// Simple (inputs -> L1)x2 -> 1 perspective network, with SCReLU activation.
+// Inputs are king-bucketed: every piece on the board and every piece in
+// hand is a feature, relative to the perspective's side and king bucket
+namespace stoat::eval::nnue {
+    constexpr u32 kKingBuckets = 9;
+
+    constexpr u32 kBoardFeatures = Pieces::kCount * Squares::kCount;
+
+    // one feature per piece in hand, so maximum hand counts of
+    // pawn 18, lance/knight/silver/gold 4, bishop/rook 2
+    constexpr u32 kHandFeaturesPerColor = 18 + 4 * 4 + 2 * 2;
+    constexpr u32 kHandFeatures = kHandFeaturesPerColor * Colors::kCount;
+
+    constexpr u32 kFeaturesPerBucket = kBoardFeatures + kHandFeatures;
+    constexpr u32 kInputSize = kKingBuckets * kFeaturesPerBucket;
+
+    constexpr u32 kL1Size = 256;
+
+    constexpr i32 kFtQ = 255;
+    constexpr i32 kL1Q = 64;
+
+    constexpr i32 kScale = 400;
+
+    static_assert(kL1Size % simd::kChunkSize == 0);
+
+    // File layout, all little-endian i16s with no header or padding:
+    //   feature transformer weights [kInputSize][kL1Size]
+    //   feature transformer biases  [kL1Size]
+    //   output weights              [2][kL1Size] (side to move first)
+    //   output bias
+    // Output weights must be within [-127, 127]
+    struct alignas(simd::kAlignment) Network {
+        util::MultiArray<i16, kInputSize, kL1Size> ftWeights;
+        alignas(simd::kAlignment) std::array<i16, kL1Size> ftBiases;
+        alignas(simd::kAlignment) std::array<i16, kL1Size * 2> l1Weights;
+        i16 l1Bias;
+    };
+
+    constexpr usize kNetworkFileSize = sizeof(i16) * (kInputSize * kL1Size + kL1Size + kL1Size * 2 + 1);
+
+    // null if no network is loaded, in which case the classical eval is used
+    [[nodiscard]] const Network* network();
+
+    // loads the network embedded at build time, if any, otherwise unloads
+    void loadDefaultNetwork();
+
+    // falls back to the classical eval
+    void unloadNetwork();
+
+    // returns an error message on failure, and leaves the current network in place
+    [[nodiscard]] std::optional<std::string> loadNetwork(const std::string& path);
+
+    [[nodiscard]] bool hasEmbeddedNetwork();
+
+    // changes whenever a network is loaded or unloaded
+    [[nodiscard]] u32 networkId();
+
+    struct alignas(simd::kAlignment) Accumulator {
+        std::array<std::array<i16, kL1Size>, Colors::kCount> perspectives;
+
+        [[nodiscard]] inline std::array<i16, kL1Size>& forColor(Color c) {
+            assert(c);
+            return perspectives[c.idx()];
+        }
+
+        [[nodiscard]] inline const std::array<i16, kL1Size>& forColor(Color c) const {
+            assert(c);
+            return perspectives[c.idx()];
+        }
+    };
+
+    // stack of accumulators along the search stack of one thread
+    class NnueState {
+    public:
+        NnueState();
+
+        // picks up the currently loaded network, if any
+        void reset(const Position& pos);
+
+        // must be called before the move is made
+        void push(const Position& pos, Move move);
+        void pushNull();
+        void pop();
+
+        [[nodiscard]] inline bool enabled() const {
+            return m_network != nullptr;
+        }
+
+        [[nodiscard]] Score evaluate(const Position& pos) const;
+
+    private:
+        const Network* m_network{};
+
+        std::vector<Accumulator> m_accumulatorStack{};
+        Accumulator* m_curr{};
+
+        void refresh(Accumulator& acc, Color perspective, const Position& pos, u32 bucket) const;
+    };
+} // namespace stoat::eval::nnue
@@ -0,0 +1,281 @@
+/*
+ * Stoat, a USI shogi engine
+ * Copyright (C) 2025 Ciekce
+ *
+ * Stoat is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Stoat is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Stoat. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "../types.h"
+
+#include "../arch.h"
+
+#if ST_HAS_AVX512 || ST_HAS_AVX2
+    #include <immintrin.h>
+#elif ST_HAS_NEON
+    #include <arm_neon.h>
+#endif
+
+// Thin wrappers over the vector instructions used for nnue inference.
+// Without any supported instruction set, a vector is a single element
+namespace stoat::eval::simd {
+#if ST_HAS_AVX512
+    using VectorI16 = __m512i;
+    using VectorI32 = __m512i;
+
+    constexpr usize kAlignment = 64;
+
+    [[nodiscard]] inline VectorI16 zeroI16() {
+        return _mm512_setzero_si512();
+    }
+
+    [[nodiscard]] inline VectorI16 set1I16(i16 v) {
+        return _mm512_set1_epi16(v);
+    }
+
+    [[nodiscard]] inline VectorI16 loadI16(const i16* ptr) {
+        return _mm512_load_si512(ptr);
+    }
+
+    inline void storeI16(i16* ptr, VectorI16 v) {
+        _mm512_store_si512(ptr, v);
+    }
+
+    [[nodiscard]] inline VectorI16 addI16(VectorI16 a, VectorI16 b) {
+        return _mm512_add_epi16(a, b);
+    }
+
+    [[nodiscard]] inline VectorI16 subI16(VectorI16 a, VectorI16 b) {
+        return _mm512_sub_epi16(a, b);
+    }
+
+    [[nodiscard]] inline VectorI16 minI16(VectorI16 a, VectorI16 b) {
+        return _mm512_min_epi16(a, b);
+    }
+
+    [[nodiscard]] inline VectorI16 maxI16(VectorI16 a, VectorI16 b) {
+        return _mm512_max_epi16(a, b);
+    }
+
+    [[nodiscard]] inline VectorI16 mulLoI16(VectorI16 a, VectorI16 b) {
+        return _mm512_mullo_epi16(a, b);
+    }
+
+    [[nodiscard]] inline VectorI32 zeroI32() {
+        return _mm512_setzero_si512();
+    }
+
+    [[nodiscard]] inline VectorI32 addI32(VectorI32 a, VectorI32 b) {
+        return _mm512_add_epi32(a, b);
+    }
+
+    // multiplies adjacent pairs of i16s and sums each pair into an i32
+    [[nodiscard]] inline VectorI32 mulAddAdjI16(VectorI16 a, VectorI16 b) {
+        return _mm512_madd_epi16(a, b);
+    }
+
+    [[nodiscard]] inline i32 hsumI32(VectorI32 v) {
+        return _mm512_reduce_add_epi32(v);
+    }
+#elif ST_HAS_AVX2
+    using VectorI16 = __m256i;
+    using VectorI32 = __m256i;
+
+    constexpr usize kAlignment = 32;
+
+    [[nodiscard]] inline VectorI16 zeroI16() {
+        return _mm256_setzero_si256();
+    }
+
+    [[nodiscard]] inline VectorI16 set1I16(i16 v) {
+        return _mm256_set1_epi16(v);
+    }
+
+    [[nodiscard]] inline VectorI16 loadI16(const i16* ptr) {
+        return _mm256_load_si256(reinterpret_cast<const __m256i*>(ptr));
+    }
+
+    inline void storeI16(i16* ptr, VectorI16 v) {
+        _mm256_store_si256(reinterpret_cast<__m256i*>(ptr), v);
+    }
+
+    [[nodiscard]] inline VectorI16 addI16(VectorI16 a, VectorI16 b) {
+        return _mm256_add_epi16(a, b);
+    }
+
+    [[nodiscard]] inline VectorI16 subI16(VectorI16 a, VectorI16 b) {
+        return _mm256_sub_epi16(a, b);
+    }
+
+    [[nodiscard]] inline VectorI16 minI16(VectorI16 a, VectorI16 b) {
+        return _mm256_min_epi16(a, b);
+    }
+
+    [[nodiscard]] inline VectorI16 maxI16(VectorI16 a, VectorI16 b) {
+        return _mm256_max_epi16(a, b);
+    }
+
+    [[nodiscard]] inline VectorI16 mulLoI16(VectorI16 a, VectorI16 b) {
+        return _mm256_mullo_epi16(a, b);
+    }
+
+    [[nodiscard]] inline VectorI32 zeroI32() {
+        return _mm256_setzero_si256();
+    }
+
+    [[nodiscard]] inline VectorI32 addI32(VectorI32 a, VectorI32 b) {
+        return _mm256_add_epi32(a, b);
+    }
+
+    // multiplies adjacent pairs of i16s and sums each pair into an i32
+    [[nodiscard]] inline VectorI32 mulAddAdjI16(VectorI16 a, VectorI16 b) {
+        return _mm256_madd_epi16(a, b);
+    }
+
+    [[nodiscard]] inline i32 hsumI32(VectorI32 v) {
+        const auto high128 = _mm256_extracti128_si256(v, 1);
+        const auto low128 = _mm256_castsi256_si128(v);
+
+        const auto sum128 = _mm_add_epi32(high128, low128);
+
+        const auto high64 = _mm_unpackhi_epi64(sum128, sum128);
+        const auto sum64 = _mm_add_epi32(high64, sum128);
+
+        const auto high32 = _mm_shuffle_epi32(sum64, _MM_SHUFFLE(2, 3, 0, 1));
+        const auto sum32 = _mm_add_epi32(sum64, high32);
+
+        return _mm_cvtsi128_si32(sum32);
+    }
+#elif ST_HAS_NEON
+    using VectorI16 = int16x8_t;
+    using VectorI32 = int32x4_t;
+
+    constexpr usize kAlignment = 16;
+
+    [[nodiscard]] inline VectorI16 zeroI16() {
+        return vdupq_n_s16(0);
+    }
+
+    [[nodiscard]] inline VectorI16 set1I16(i16 v) {
+        return vdupq_n_s16(v);
+    }
+
+    [[nodiscard]] inline VectorI16 loadI16(const i16* ptr) {
+        return vld1q_s16(ptr);
+    }
+
+    inline void storeI16(i16* ptr, VectorI16 v) {
+        vst1q_s16(ptr, v);
+    }
+
+    [[nodiscard]] inline VectorI16 addI16(VectorI16 a, VectorI16 b) {
+        return vaddq_s16(a, b);
+    }
+
+    [[nodiscard]] inline VectorI16 subI16(VectorI16 a, VectorI16 b) {
+        return vsubq_s16(a, b);
+    }
+
+    [[nodiscard]] inline VectorI16 minI16(VectorI16 a, VectorI16 b) {
+        return vminq_s16(a, b);
+    }
+
+    [[nodiscard]] inline VectorI16 maxI16(VectorI16 a, VectorI16 b) {
+        return vmaxq_s16(a, b);
+    }
+
+    [[nodiscard]] inline VectorI16 mulLoI16(VectorI16 a, VectorI16 b) {
+        return vmulq_s16(a, b);
+    }
+
+    [[nodiscard]] inline VectorI32 zeroI32() {
+        return vdupq_n_s32(0);
+    }
+
+    [[nodiscard]] inline VectorI32 addI32(VectorI32 a, VectorI32 b) {
+        return vaddq_s32(a, b);
+    }
+
+    // multiplies adjacent pairs of i16s and sums each pair into an i32
+    [[nodiscard]] inline VectorI32 mulAddAdjI16(VectorI16 a, VectorI16 b) {
+        const auto low = vmull_s16(vget_low_s16(a), vget_low_s16(b));
+        const auto high = vmull_high_s16(a, b);
+        return vpaddq_s32(low, high);
+    }
+
+    [[nodiscard]] inline i32 hsumI32(VectorI32 v) {
+        return vaddvq_s32(v);
+    }
+#else
+    using VectorI16 = i16;
+    using VectorI32 = i32;
+
+    constexpr usize kAlignment = 16;
+
+    [[nodiscard]] inline VectorI16 zeroI16() {
+        return 0;
+    }
+
+    [[nodiscard]] inline VectorI16 set1I16(i16 v) {
+        return v;
+    }
+
+    [[nodiscard]] inline VectorI16 loadI16(const i16* ptr) {
+        return *ptr;
+    }
+
+    inline void storeI16(i16* ptr, VectorI16 v) {
+        *ptr = v;
+    }
+
+    [[nodiscard]] inline VectorI16 addI16(VectorI16 a, VectorI16 b) {
+        return static_cast<i16>(a + b);
+    }
+
+    [[nodiscard]] inline VectorI16 subI16(VectorI16 a, VectorI16 b) {
+        return static_cast<i16>(a - b);
+    }
+
+    [[nodiscard]] inline VectorI16 minI16(VectorI16 a, VectorI16 b) {
+        return a < b ? a : b;
+    }
+
+    [[nodiscard]] inline VectorI16 maxI16(VectorI16 a, VectorI16 b) {
+        return a > b ? a : b;
+    }
+
+    [[nodiscard]] inline VectorI16 mulLoI16(VectorI16 a, VectorI16 b) {
+        return static_cast<i16>(a * b);
+    }
+
+    [[nodiscard]] inline VectorI32 zeroI32() {
+        return 0;
+    }
+
+    [[nodiscard]] inline VectorI32 addI32(VectorI32 a, VectorI32 b) {
+        return a + b;
+    }
+
+    [[nodiscard]] inline VectorI32 mulAddAdjI16(VectorI16 a, VectorI16 b) {
+        return static_cast<i32>(a) * static_cast<i32>(b);
+    }
+
+    [[nodiscard]] inline i32 hsumI32(VectorI32 v) {
+        return v;
+    }
+#endif
+
+    constexpr usize kChunkSize = sizeof(VectorI16) / sizeof(i16);
+} // namespace stoat::eval::simd
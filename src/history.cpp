@@ -0,0 +1,91 @@
+/*
+ * Stoat, a USI shogi engine
+ * Copyright (C) 2025 Ciekce
+ *
+ * Stoat is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Stoat is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Stoat. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "history.h"
+
+#include <cstring>
+#include <type_traits>
+
+namespace stoat {
+    namespace {
+        template <typename T>
+        inline void zero(T& table) {
+            // assigning {} would construct a temporary the size of the table
+            static_assert(std::is_trivially_copyable_v<T>);
+            std::memset(&table, 0, sizeof(T));
+        }
+    } // namespace
+
+    void HistoryTables::clear() {
+        zero(m_butterfly);
+        zero(m_continuation);
+        zero(m_countermoves);
+        zero(m_pawnCorrection);
+        zero(m_handCorrection);
+    }
+
+    i32 HistoryTables::correction(const Position& pos) const {
+        const auto stm = pos.stm().idx();
+
+        const i32 total = m_pawnCorrection[stm][correctionIdx(pos.pawnKey())].value
+                        + m_handCorrection[stm][correctionIdx(pos.handKey())].value;
+
+        return total / kCorrectionGrain;
+    }
+
+    void HistoryTables::updateCorrection(const Position& pos, i32 depth, Score score, Score staticEval) {
+        const auto stm = pos.stm().idx();
+        const auto bonus = (score - staticEval) * depth * kCorrectionGrain / 8;
+
+        m_pawnCorrection[stm][correctionIdx(pos.pawnKey())].update(bonus);
+        m_handCorrection[stm][correctionIdx(pos.handKey())].update(bonus);
+    }
+
+    i32 HistoryTables::nonCaptureScore(
+        std::span<ContinuationSubtable* const> continuations,
+        Color stm,
+        Piece moving,
+        Move move
+    ) const {
+        i32 score = m_butterfly[stm.idx()][fromIdx(move)][move.to().idx()];
+
+        for (const auto* subtable : continuations) {
+            if (subtable) {
+                score += (*subtable)[moving.idx()][move.to().idx()];
+            }
+        }
+
+        return score;
+    }
+
+    void HistoryTables::updateNonCaptureScore(
+        std::span<ContinuationSubtable* const> continuations,
+        Color stm,
+        Piece moving,
+        Move move,
+        i32 bonus
+    ) {
+        m_butterfly[stm.idx()][fromIdx(move)][move.to().idx()].update(bonus);
+
+        for (auto* subtable : continuations) {
+            if (subtable) {
+                (*subtable)[moving.idx()][move.to().idx()].update(bonus);
+            }
+        }
+    }
+} // namespace stoat
@@ -0,0 +1,136 @@
+/*
+ * Stoat, a USI shogi engine
+ * Copyright (C) 2025 Ciekce
+ *
+ * Stoat is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Stoat is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Stoat. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "types.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <span>
+
+#include "core.h"
+#include "move.h"
+#include "position.h"
+#include "util/multi_array.h"
+
+namespace stoat {
+    using HistoryScore = i16;
+
+    constexpr i32 kMaxHistory = 16384;
+
+    struct HistoryEntry {
+        HistoryScore value{};
+
+        [[nodiscard]] inline operator i32() const { // NOLINT(google-explicit-constructor)
+            return value;
+        }
+
+        // history gravity - the closer to the limit, the smaller the change
+        inline void update(i32 bonus) {
+            bonus = std::clamp(bonus, -kMaxHistory, kMaxHistory);
+            value += bonus - value * std::abs(bonus) / kMaxHistory;
+        }
+    };
+
+    [[nodiscard]] constexpr i32 historyBonus(i32 depth) {
+        return std::min(depth * 300 - 300, 2500);
+    }
+
+    // corrections are kept in 1/kCorrectionGrain cp
+    constexpr i32 kCorrectionGrain = 16;
+    constexpr i32 kMaxCorrection = 128 * kCorrectionGrain;
+
+    struct CorrectionEntry {
+        i16 value{};
+
+        // same gravity as history, the bonus shrinks as the corrected eval converges on the search score
+        inline void update(i32 bonus) {
+            bonus = std::clamp(bonus, -kMaxCorrection / 4, kMaxCorrection / 4);
+            value += bonus - value * std::abs(bonus) / kMaxCorrection;
+        }
+    };
+
+    // [piece][to]
+    using ContinuationSubtable = util::MultiArray<HistoryEntry, Pieces::kCount, Squares::kCount>;
+
+    class HistoryTables {
+    public:
+        void clear();
+
+        // Continuation subtables are ordered by distance from the current
+        // position, with nulls for plies that have no usable previous move
+        [[nodiscard]] i32 nonCaptureScore(
+            std::span<ContinuationSubtable* const> continuations,
+            Color stm,
+            Piece moving,
+            Move move
+        ) const;
+
+        void updateNonCaptureScore(
+            std::span<ContinuationSubtable* const> continuations,
+            Color stm,
+            Piece moving,
+            Move move,
+            i32 bonus
+        );
+
+        [[nodiscard]] inline ContinuationSubtable& continuation(Piece moving, Square to) {
+            return m_continuation[moving.idx()][to.idx()];
+        }
+
+        [[nodiscard]] inline Move countermove(Piece prevMoving, Square prevTo) const {
+            return m_countermoves[prevMoving.idx()][prevTo.idx()];
+        }
+
+        inline void setCountermove(Piece prevMoving, Square prevTo, Move move) {
+            m_countermoves[prevMoving.idx()][prevTo.idx()] = move;
+        }
+
+        // learnt difference between search scores and the static eval
+        // of positions sharing the pawn structure or the hands, in cp
+        [[nodiscard]] i32 correction(const Position& pos) const;
+        // staticEval is the corrected eval
+        void updateCorrection(const Position& pos, i32 depth, Score score, Score staticEval);
+
+    private:
+        static constexpr usize kCorrectionEntries = 16384;
+
+        [[nodiscard]] static inline usize correctionIdx(u64 key) {
+            return key % kCorrectionEntries;
+        }
+
+        // drops are indexed by the dropped piece type in place of a from square
+        static constexpr usize kFromCount = Squares::kCount + PieceTypes::kCount;
+
+        [[nodiscard]] static inline usize fromIdx(Move move) {
+            return move.isDrop() ? Squares::kCount + move.dropPiece().idx() : move.from().idx();
+        }
+
+        // [stm][from or drop piece][to]
+        util::MultiArray<HistoryEntry, Colors::kCount, kFromCount, Squares::kCount> m_butterfly{};
+        // [previous piece][previous to][piece][to]
+        util::MultiArray<ContinuationSubtable, Pieces::kCount, Squares::kCount> m_continuation{};
+        // [previous piece][previous to]
+        util::MultiArray<Move, Pieces::kCount, Squares::kCount> m_countermoves{};
+
+        // [stm][key index]
+        util::MultiArray<CorrectionEntry, Colors::kCount, kCorrectionEntries> m_pawnCorrection{};
+        util::MultiArray<CorrectionEntry, Colors::kCount, kCorrectionEntries> m_handCorrection{};
+    };
+} // namespace stoat
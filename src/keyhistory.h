@@ -0,0 +1,163 @@
+/*
+ * Stoat, a USI shogi engine
+ * Copyright (C) 2025 Ciekce
+ *
+ * Stoat is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Stoat is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Stoat. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "types.h"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <span>
+
+#include "core.h"
+#include "position.h"
+
+namespace stoat {
+    // Keys of the positions leading up to the current one, plus small counting
+    // filters over them so that most positions can be ruled out of a repetition
+    // without scanning the history at all. Positions reached during search also
+    // have their board key and hand recorded, to find cycles in which only the
+    // hands changed
+    class KeyHistory {
+    public:
+        // game history kept before the search root, older keys are dropped
+        // and so can no longer be found, even with full-game repetition checks
+        static constexpr usize kMaxGameKeys = 2048;
+        static constexpr usize kCapacity = kMaxGameKeys + kMaxDepth + 1;
+
+        inline void clear() {
+            m_size = 0;
+            m_searchStart = 0;
+
+            m_keyFilter.fill(0);
+            m_boardFilter.fill(0);
+        }
+
+        // game history, before the search root
+        inline void assign(std::span<const u64> keys) {
+            clear();
+
+            if (keys.size() > kMaxGameKeys) {
+                keys = keys.last(kMaxGameKeys);
+            }
+
+            for (const auto key : keys) {
+                m_keys[m_size++] = key;
+                ++m_keyFilter[filterIdx(key)];
+            }
+
+            m_searchStart = m_size;
+        }
+
+        inline void push(const Position& pos) {
+            assert(m_size < kCapacity);
+
+            const auto key = pos.key();
+            const auto boardKey = pos.boardKey();
+
+            m_boards[m_size - m_searchStart] = {boardKey, pos.hand(pos.stm())};
+            ++m_boardFilter[filterIdx(boardKey)];
+
+            m_keys[m_size++] = key;
+            ++m_keyFilter[filterIdx(key)];
+        }
+
+        inline void pop() {
+            assert(m_size > m_searchStart);
+
+            const auto key = m_keys[--m_size];
+
+            assert(m_keyFilter[filterIdx(key)] > 0);
+            --m_keyFilter[filterIdx(key)];
+
+            const auto boardKey = m_boards[m_size - m_searchStart].key;
+
+            assert(m_boardFilter[filterIdx(boardKey)] > 0);
+            --m_boardFilter[filterIdx(boardKey)];
+        }
+
+        // never false if the key is in the history
+        [[nodiscard]] inline bool mayContain(u64 key) const {
+            return m_keyFilter[filterIdx(key)] != 0;
+        }
+
+        // whether the board of this position, with the same side to move, occurred earlier in
+        // the search within the last `limit` plies with the side to move holding strictly more,
+        // or strictly less, of every piece type in hand. exact repetitions are not included
+        [[nodiscard]] inline bool isHandDominated(const Position& pos, i32 limit) const {
+            const auto boardKey = pos.boardKey();
+
+            if (m_boardFilter[filterIdx(boardKey)] == 0) {
+                return false;
+            }
+
+            const auto& hand = pos.hand(pos.stm());
+
+            const auto size = static_cast<i32>(m_size - m_searchStart);
+            const auto end = std::max(0, size - limit - 1);
+
+            for (i32 i = size - 4; i >= end; i -= 2) {
+                const auto& entry = m_boards[i];
+
+                if (entry.key != boardKey || entry.hand == hand) {
+                    continue;
+                }
+
+                if (hand.covers(entry.hand) || entry.hand.covers(hand)) {
+                    return true;
+                }
+            }
+
+            return false;
+        }
+
+        [[nodiscard]] inline std::span<const u64> keys() const {
+            return std::span{m_keys}.first(m_size);
+        }
+
+        [[nodiscard]] inline usize size() const {
+            return m_size;
+        }
+
+    private:
+        static constexpr usize kFilterSize = 8192;
+
+        [[nodiscard]] static constexpr usize filterIdx(u64 key) {
+            return static_cast<usize>(key % kFilterSize);
+        }
+
+        struct BoardEntry {
+            u64 key;
+            // of the side to move
+            Hand hand;
+        };
+
+        // deliberately left uninitialised, only the first m_size keys are valid
+        std::array<u64, kCapacity> m_keys;
+        // one per key after m_searchStart
+        std::array<BoardEntry, kMaxDepth + 1> m_boards;
+
+        usize m_size{};
+        usize m_searchStart{};
+
+        // counts, so that popping a key does not clear another with the same index
+        std::array<u16, kFilterSize> m_keyFilter{};
+        std::array<u16, kFilterSize> m_boardFilter{};
+    };
+} // namespace stoat
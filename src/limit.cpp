@@ -18,12 +18,41 @@
 
 #include "limit.h"
 
+#include <array>
+#include <cmath>
+
 namespace stoat::limit {
     namespace {
-        constexpr usize kTimeCheckInterval = 2048;
-        constexpr f64 kMoveOverhead = 0.01;
+        // target time between clock reads in stopHard()
+        constexpr f64 kClockPollInterval = 0.0005;
+        // bounds the poll interval in nodes, the search only calls stopHard() every few hundred anyway
+        constexpr usize kMinPollNodes = 1;
+        constexpr usize kMaxPollNodes = 65536;
+
+        // byoyomi is lost if not used, so aim to use most of it
+        constexpr f64 kByoyomiOptScale = 0.8;
+
+        // indexed by the number of iterations the best move has not changed for
+        constexpr std::array kStabilityScales = {2.43, 1.35, 1.09, 0.88, 0.68};
+
+        constexpr i32 kMinScalingDepth = 4;
     } // namespace
 
+    void ClockPoller::update(usize nodes, f64 elapsed) {
+        auto interval = kMinPollNodes;
+
+        if (m_hasLastRead && elapsed > m_lastElapsed) {
+            const auto nps = static_cast<f64>(nodes - m_lastNodes) / (elapsed - m_lastElapsed);
+            interval = std::clamp(static_cast<usize>(nps * kClockPollInterval), kMinPollNodes, kMaxPollNodes);
+        }
+
+        m_nextRead = nodes + interval;
+
+        m_hasLastRead = true;
+        m_lastNodes = nodes;
+        m_lastElapsed = elapsed;
+    }
+
     NodeLimiter::NodeLimiter(usize maxNodes) :
             m_maxNodes{maxNodes} {}
 
@@ -43,33 +72,72 @@ namespace stoat::limit {
     }
 
     bool MoveTimeLimiter::stopHard(usize nodes) {
-        if (nodes == 0 || nodes % kTimeCheckInterval != 0) {
+        if (!m_poller.due(nodes)) {
             return false;
         }
 
-        return stopSoft(nodes);
+        const auto elapsed = m_startTime.elapsed();
+        m_poller.update(nodes, elapsed);
+
+        return elapsed >= m_maxTime;
     }
 
     TimeManager::TimeManager(util::Instant startTime, const TimeLimits& limits) :
             m_startTime{startTime} {
-        const auto remaining = limits.remaining - kMoveOverhead;
+        // in byoyomi the main time has already run out
+        const auto remaining = std::max(limits.remaining - limits.moveOverhead, 0.0);
+        const auto byoyomi = std::max(limits.byoyomi - limits.moveOverhead, 0.0);
 
-        const auto baseTime = std::min(remaining * 0.05 + limits.increment * 0.5, remaining);
-        const auto optTime = baseTime * 0.6;
+        const auto baseTime = std::max(std::min(remaining * 0.05 + limits.increment * 0.5, remaining), 0.0);
+        const auto optTime = baseTime * 0.6 + byoyomi * kByoyomiOptScale;
 
-        m_maxTime = remaining * 0.6;
+        m_maxTime = std::max(remaining * 0.6 + byoyomi, 0.001);
         m_optTime = std::min(optTime, m_maxTime);
     }
 
+    void TimeManager::update(const IterationResult& result) {
+        if (result.bestMove == m_prevBestMove) {
+            m_stability = std::min<u32>(m_stability + 1, kStabilityScales.size() - 1);
+        } else {
+            m_stability = 0;
+        }
+
+        m_prevBestMove = result.bestMove;
+
+        const auto prevScore = m_prevScore;
+        m_prevScore = result.score;
+
+        if (result.depth < kMinScalingDepth) {
+            return;
+        }
+
+        const auto stabilityScale = kStabilityScales[m_stability];
+
+        // spend more time when the best move takes few of the nodes, i.e. others look close
+        const auto nodeScale = (1.5 - result.bestMoveNodeFraction) * 1.35;
+
+        auto scoreScale = 1.0;
+
+        if (prevScore != kScoreNone && std::abs(prevScore) < kScoreWin && std::abs(result.score) < kScoreWin) {
+            const auto scoreDrop = static_cast<f64>(prevScore - result.score);
+            scoreScale = std::clamp(1.0 + scoreDrop * 0.005, 0.75, 1.5);
+        }
+
+        m_scale = stabilityScale * nodeScale * scoreScale;
+    }
+
     bool TimeManager::stopSoft(usize nodes) {
-        return m_startTime.elapsed() >= m_optTime;
+        return m_startTime.elapsed() >= std::min(m_optTime * m_scale, m_maxTime);
     }
 
     bool TimeManager::stopHard(usize nodes) {
-        if (nodes == 0 || nodes % kTimeCheckInterval != 0) {
+        if (!m_poller.due(nodes)) {
             return false;
         }
 
-        return m_startTime.elapsed() >= m_maxTime;
+        const auto elapsed = m_startTime.elapsed();
+        m_poller.update(nodes, elapsed);
+
+        return elapsed >= m_maxTime;
     }
 } // namespace stoat::limit
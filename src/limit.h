@@ -24,17 +24,57 @@
 #include <memory>
 #include <vector>
 
+#include "core.h"
+#include "move.h"
+#include "util/range.h"
 #include "util/timer.h"
 
 namespace stoat::limit {
+    constexpr u32 kDefaultMoveOverheadMs = 10;
+    constexpr util::Range<u32> kMoveOverheadRange{0, 5000};
+
+    struct IterationResult {
+        i32 depth;
+        Move bestMove;
+        Score score;
+        // fraction of the main thread's nodes spent on the best move
+        f64 bestMoveNodeFraction;
+    };
+
     class ISearchLimiter {
     public:
         virtual ~ISearchLimiter() = default;
 
+        // called by the main thread after every completed iteration, before stopSoft()
+        virtual void update([[maybe_unused]] const IterationResult& result) {}
+
         [[nodiscard]] virtual bool stopSoft(usize nodes) = 0;
         [[nodiscard]] virtual bool stopHard(usize nodes) = 0;
     };
 
+    // Decides when a time limiter next reads the clock, aiming for a fixed interval
+    // in time rather than in nodes from the speed measured between reads, so that
+    // slow searches still stop on time and fast ones do not read the clock needlessly
+    class ClockPoller {
+    public:
+        [[nodiscard]] inline bool due(usize nodes) const {
+            return nodes >= m_nextRead;
+        }
+
+        // called after every read, elapsed is the time since the limiter was started
+        void update(usize nodes, f64 elapsed);
+
+    private:
+        usize m_nextRead{};
+
+        // no speed is known until the second read, the node count may
+        // include nodes searched before the limiter started when pondering
+        bool m_hasLastRead{};
+
+        usize m_lastNodes{};
+        f64 m_lastElapsed{};
+    };
+
     class CompoundLimiter final : public ISearchLimiter {
     public:
         ~CompoundLimiter() final = default;
@@ -44,6 +84,12 @@ namespace stoat::limit {
             m_limiters.push_back(std::make_unique<T>(std::forward<Args>(args)...));
         }
 
+        inline void update(const IterationResult& result) final {
+            for (const auto& limiter : m_limiters) {
+                limiter->update(result);
+            }
+        }
+
         [[nodiscard]] inline bool stopSoft(usize nodes) final {
             return std::ranges::any_of(m_limiters, [&](const auto& limiter) { return limiter->stopSoft(nodes); });
         }
@@ -79,11 +125,16 @@ namespace stoat::limit {
     private:
         util::Instant m_startTime;
         f64 m_maxTime;
+
+        ClockPoller m_poller{};
     };
 
     struct TimeLimits {
         f64 remaining;
         f64 increment;
+        f64 byoyomi;
+        // time lost per move to communication with the gui, in seconds
+        f64 moveOverhead;
     };
 
     class TimeManager final : public ISearchLimiter {
@@ -91,13 +142,25 @@ namespace stoat::limit {
         TimeManager(util::Instant startTime, const TimeLimits& limits);
         ~TimeManager() final = default;
 
+        void update(const IterationResult& result) final;
+
         [[nodiscard]] bool stopSoft(usize nodes) final;
         [[nodiscard]] bool stopHard(usize nodes) final;
 
     private:
         util::Instant m_startTime;
 
+        ClockPoller m_poller{};
+
         f64 m_optTime;
         f64 m_maxTime;
+
+        // applied to the optimum time, from the last iteration
+        f64 m_scale{1.0};
+
+        Move m_prevBestMove{kNullMove};
+        u32 m_stability{};
+
+        Score m_prevScore{kScoreNone};
     };
 } // namespace stoat::limit
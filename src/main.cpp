@@ -21,8 +21,18 @@
 #include <string_view>
 #include <vector>
 
+#include "analyse.h"
 #include "bench.h"
+#include "book.h"
+#include "cluster.h"
+#include "datagen.h"
+#include "eval/nnue.h"
+#include "match.h"
 #include "protocol/handler.h"
+#include "protocol/output.h"
+#include "search.h"
+#include "tunable.h"
+#include "util/args.h"
 #include "util/split.h"
 
 using namespace stoat;
@@ -39,6 +49,8 @@ namespace stoat::protocol {
 } // namespace stoat::protocol
 
 i32 main(i32 argc, char* argv[]) {
+    eval::nnue::loadDefaultNetwork();
+
     protocol::EngineState state{};
 
     std::string currHandler{protocol::kDefaultHandler};
@@ -48,9 +60,58 @@ i32 main(i32 argc, char* argv[]) {
 
     if (argc > 1) {
         const auto subcommand = std::string_view{argv[1]};
+        const std::vector<std::string_view> args(argv + 2, argv + argc);
+
         if (subcommand == "bench") {
-            bench::run();
+            const auto config = bench::parseArgs(args);
+            return config && bench::run(*config) ? 0 : 1;
+        } else if (subcommand == "sliderbench") {
+            bench::runSliders();
             return 0;
+        } else if (subcommand == "golatency") {
+            // golatency [threads]
+            u32 threads = kDefaultThreadCount;
+
+            if (!args.empty() && !util::parseArg(threads, args[0], "thread count")) {
+                return 1;
+            }
+
+            bench::runGoLatency(kThreadCountRange.clamp(threads));
+            return 0;
+        } else if (subcommand == "analyse") {
+            const auto config = analyse::parseArgs(args);
+            return config && analyse::run(*config) ? 0 : 1;
+        } else if (subcommand == "datagen") {
+            const auto config = datagen::parseArgs(args);
+            return config && datagen::run(*config) ? 0 : 1;
+        } else if (subcommand == "makebook") {
+            // makebook <games file> <book file> [plies]
+            if (args.size() < 2) {
+                std::cerr << "Missing games or book file" << std::endl;
+                return 1;
+            }
+
+            u32 plies = book::kDefaultBookPlies;
+
+            if (args.size() > 2 && !util::parseArg(plies, args[2], "ply count")) {
+                return 1;
+            }
+
+            return book::build(std::string{args[0]}, std::string{args[1]}, plies) ? 0 : 1;
+        } else if (subcommand == "clusterworker") {
+            const auto config = cluster::parseWorkerArgs(args);
+            return config && cluster::runWorker(*config) ? 0 : 1;
+        } else if (subcommand == "match") {
+            const auto config = match::parseArgs(args);
+            return config && match::run(*config) ? 0 : 1;
+        } else if (subcommand == "spsa") {
+#ifdef ST_TUNE
+            tunable::printSpsaInputs(std::cout);
+            return 0;
+#else
+            std::cerr << "Not a tuning build" << std::endl;
+            return 1;
+#endif
         }
     }
 
@@ -74,6 +135,9 @@ i32 main(i32 argc, char* argv[]) {
         const auto command = tokens[0];
         const auto args = std::span{tokens}.subspan<1>();
 
+        // anything the handler prints must come after the search output so far
+        protocol::output::flush();
+
         if (command == currHandler) {
             handler->printInitialInfo();
             continue;
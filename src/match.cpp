@@ -0,0 +1,375 @@
+/*
+ * Stoat, a USI shogi engine
+ * Copyright (C) 2025 Ciekce
+ *
+ * Stoat is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Stoat is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Stoat. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "match.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "position.h"
+#include "search.h"
+#include "selfplay.h"
+#include "util/args.h"
+#include "util/rng.h"
+#include "util/split.h"
+#include "util/timer.h"
+
+namespace stoat::match {
+    namespace {
+        constexpr u32 kReportInterval = 20;
+
+        struct Opening {
+            Position pos{};
+            std::vector<u64> keyHistory{};
+        };
+
+        [[nodiscard]] bool loadOpenings(std::vector<Opening>& dst, const std::string& path) {
+            std::ifstream stream{path};
+
+            if (!stream) {
+                std::cerr << "Failed to open openings file '" << path << "'" << std::endl;
+                return false;
+            }
+
+            std::vector<std::string_view> args{};
+
+            std::string line{};
+            for (usize lineIdx = 1; std::getline(stream, line); ++lineIdx) {
+                if (!line.empty() && line.back() == '\r') {
+                    line.pop_back();
+                }
+
+                if (line.empty() || line[0] == '#') {
+                    continue;
+                }
+
+                args.clear();
+                util::split(args, line);
+
+                if (args.empty()) {
+                    continue;
+                }
+
+                auto& opening = dst.emplace_back();
+                auto parsed = Position::fromPositionCommand(args, opening.keyHistory);
+
+                if (!parsed) {
+                    std::cerr << "Invalid opening on line " << lineIdx << ": " << parsed.takeErr() << std::endl;
+                    return false;
+                }
+
+                opening.pos = parsed.take();
+            }
+
+            if (dst.empty()) {
+                std::cerr << "No openings in '" << path << "'" << std::endl;
+                return false;
+            }
+
+            return true;
+        }
+
+        struct Results {
+            // from the first engine's perspective
+            u32 wins{};
+            u32 draws{};
+            u32 losses{};
+
+            [[nodiscard]] inline u32 games() const {
+                return wins + draws + losses;
+            }
+
+            [[nodiscard]] inline f64 score() const {
+                return (static_cast<f64>(wins) + static_cast<f64>(draws) / 2.0) / static_cast<f64>(games());
+            }
+
+            // variance of the score of a single game. Every result is counted as having
+            // occurred at least half a time, so that a one-sided match is not certain
+            [[nodiscard]] inline f64 variance() const {
+                auto w = static_cast<f64>(wins) + 0.5;
+                auto d = static_cast<f64>(draws) + 0.5;
+                auto l = static_cast<f64>(losses) + 0.5;
+
+                const auto n = w + d + l;
+
+                const auto s = (w + d / 2.0) / n;
+
+                w /= n;
+                d /= n;
+                l /= n;
+
+                return w * (1.0 - s) * (1.0 - s) + d * (0.5 - s) * (0.5 - s) + l * s * s;
+            }
+        };
+
+        [[nodiscard]] f64 scoreToElo(f64 score) {
+            score = std::clamp(score, 1e-6, 1.0 - 1e-6);
+            return -400.0 * std::log10(1.0 / score - 1.0);
+        }
+
+        [[nodiscard]] f64 eloToScore(f64 elo) {
+            return 1.0 / (1.0 + std::pow(10.0, -elo / 400.0));
+        }
+
+        // 95% confidence
+        [[nodiscard]] f64 eloError(const Results& results) {
+            const auto stddev = std::sqrt(results.variance() / static_cast<f64>(results.games()));
+
+            const auto upper = scoreToElo(results.score() + 1.95996 * stddev);
+            const auto lower = scoreToElo(results.score() - 1.95996 * stddev);
+
+            return (upper - lower) / 2.0;
+        }
+
+        // generalised sprt, approximating the score distribution as normal
+        [[nodiscard]] f64 llr(const Results& results, const SprtConfig& sprt) {
+            const auto variance = results.variance();
+
+            const auto s0 = eloToScore(sprt.elo0);
+            const auto s1 = eloToScore(sprt.elo1);
+
+            const auto n = static_cast<f64>(results.games());
+            return n * (s1 - s0) * (2.0 * results.score() - s0 - s1) / (2.0 * variance);
+        }
+
+        struct SprtBounds {
+            f64 lower;
+            f64 upper;
+        };
+
+        [[nodiscard]] SprtBounds sprtBounds(const SprtConfig& sprt) {
+            return {
+                .lower = std::log(sprt.beta / (1.0 - sprt.alpha)),
+                .upper = std::log((1.0 - sprt.beta) / sprt.alpha),
+            };
+        }
+
+        void printResults(std::ostream& stream, const Results& results, const MatchConfig& config, f64 time) {
+            stream << "games " << results.games() << ": +" << results.wins << " =" << results.draws << " -"
+                   << results.losses << ", score " << std::fixed << std::setprecision(3) << results.score()
+                   << ", elo " << std::setprecision(1) << scoreToElo(results.score()) << " +- " << eloError(results);
+
+            if (config.sprt) {
+                const auto bounds = sprtBounds(*config.sprt);
+                stream << ", llr " << std::setprecision(2) << llr(results, *config.sprt) << " (" << bounds.lower
+                       << ", " << bounds.upper << ")";
+            }
+
+            stream << ", " << std::setprecision(2) << static_cast<f64>(results.games()) / time << " games/s"
+                   << std::defaultfloat << std::endl;
+        }
+    } // namespace
+
+    bool run(const MatchConfig& config) {
+        std::vector<Opening> openings{};
+
+        if (!config.openingsFile.empty() && !loadOpenings(openings, config.openingsFile)) {
+            return false;
+        }
+
+        const auto games = config.pairs * 2;
+        const auto concurrency = std::max<u32>(1, std::min(config.concurrency, games));
+
+        // [engine][concurrent game]
+        std::array<std::vector<std::unique_ptr<Searcher>>, 2> searchers{};
+
+        for (u32 engine = 0; engine < 2; ++engine) {
+            const auto& engineConfig = config.engines[engine];
+            searchers[engine] = selfplay::createSearchers(concurrency, engineConfig.hashMib, engineConfig.threads);
+        }
+
+        std::atomic<u32> nextGame{};
+        std::atomic_bool stop{};
+
+        std::mutex resultsMutex{};
+        Results results{};
+
+        const auto start = util::Instant::now();
+
+        const auto runThread = [&](u32 threadIdx) {
+            const std::array<selfplay::Player, 2> players{{
+                {searchers[0][threadIdx].get(), config.engines[0].nodes},
+                {searchers[1][threadIdx].get(), config.engines[1].nodes},
+            }};
+
+            Opening opening{};
+
+            while (!stop.load(std::memory_order::relaxed)) {
+                const auto gameIdx = nextGame.fetch_add(1, std::memory_order::relaxed);
+
+                if (gameIdx >= games) {
+                    break;
+                }
+
+                const auto pairIdx = gameIdx / 2;
+
+                if (openings.empty()) {
+                    util::rng::Jsf64Rng rng{config.seed + pairIdx};
+                    selfplay::playRandomOpening(opening.pos, opening.keyHistory, rng, config.randomPlies);
+                } else {
+                    opening = openings[pairIdx % openings.size()];
+                }
+
+                // the first engine is black in the first game of each pair
+                const bool swapped = gameIdx % 2 != 0;
+
+                const auto black = swapped ? 1 : 0;
+                const auto white = 1 - black;
+
+                const auto winner =
+                    selfplay::playGame({players[black], players[white]}, opening.pos, opening.keyHistory);
+
+                const std::unique_lock lock{resultsMutex};
+
+                if (!winner) {
+                    ++results.draws;
+                } else if ((*winner == Colors::kBlack) == !swapped) {
+                    ++results.wins;
+                } else {
+                    ++results.losses;
+                }
+
+                if (results.games() % kReportInterval == 0) {
+                    printResults(std::cerr, results, config, start.elapsed());
+                }
+
+                if (config.sprt) {
+                    const auto bounds = sprtBounds(*config.sprt);
+                    const auto ratio = llr(results, *config.sprt);
+
+                    if (ratio <= bounds.lower || ratio >= bounds.upper) {
+                        stop.store(true, std::memory_order::relaxed);
+                    }
+                }
+            }
+        };
+
+        std::vector<std::thread> threads{};
+        threads.reserve(concurrency);
+
+        for (u32 idx = 0; idx < concurrency; ++idx) {
+            threads.emplace_back(runThread, idx);
+        }
+
+        for (auto& thread : threads) {
+            thread.join();
+        }
+
+        if (results.games() == 0) {
+            std::cerr << "No games played" << std::endl;
+            return true;
+        }
+
+        printResults(std::cout, results, config, start.elapsed());
+
+        if (config.sprt) {
+            const auto bounds = sprtBounds(*config.sprt);
+            const auto ratio = llr(results, *config.sprt);
+
+            if (ratio >= bounds.upper) {
+                std::cout << "H1 accepted" << std::endl;
+            } else if (ratio <= bounds.lower) {
+                std::cout << "H0 accepted" << std::endl;
+            } else {
+                std::cout << "SPRT inconclusive" << std::endl;
+            }
+        }
+
+        return true;
+    }
+
+    std::optional<MatchConfig> parseArgs(std::span<const std::string_view> args) {
+        MatchConfig config{};
+
+        auto& [first, second] = config.engines;
+
+        // splits "a,b" or "a" into one value per engine
+        const auto parsePerEngine = [](auto& a, auto& b, std::string_view value) {
+            const auto comma = value.find(',');
+
+            if (comma == std::string_view::npos) {
+                return util::tryParse(a, value) && util::tryParse(b, value);
+            }
+
+            return util::tryParse(a, value.substr(0, comma)) && util::tryParse(b, value.substr(comma + 1));
+        };
+
+        const auto onOption = [&](std::string_view name, std::string_view value) {
+            if (name == "--pairs") {
+                return util::parseArg(config.pairs, value, "pair count");
+            } else if (name == "--concurrency") {
+                if (!util::parseArg(config.concurrency, value, "concurrency")) {
+                    return false;
+                }
+
+                config.concurrency = kThreadCountRange.clamp(config.concurrency);
+            } else if (name == "--openings") {
+                config.openingsFile = value;
+            } else if (name == "--random-plies") {
+                return util::parseArg(config.randomPlies, value, "random ply count");
+            } else if (name == "--seed") {
+                return util::parseArg(config.seed, value, "seed");
+            } else if (name == "--nodes") {
+                if (!parsePerEngine(first.nodes, second.nodes, value) || first.nodes == 0 || second.nodes == 0) {
+                    return util::invalidArg("node count", value);
+                }
+            } else if (name == "--hash") {
+                if (!parsePerEngine(first.hashMib, second.hashMib, value)) {
+                    return util::invalidArg("hash size", value);
+                }
+
+                first.hashMib = tt::kTtSizeRange.clamp(first.hashMib);
+                second.hashMib = tt::kTtSizeRange.clamp(second.hashMib);
+            } else if (name == "--threads") {
+                if (!parsePerEngine(first.threads, second.threads, value)) {
+                    return util::invalidArg("thread count", value);
+                }
+
+                first.threads = kThreadCountRange.clamp(first.threads);
+                second.threads = kThreadCountRange.clamp(second.threads);
+            } else if (name == "--sprt") {
+                SprtConfig sprt{};
+
+                if (!parsePerEngine(sprt.elo0, sprt.elo1, value) || sprt.elo0 >= sprt.elo1) {
+                    return util::invalidArg("sprt bounds", value);
+                }
+
+                config.sprt = sprt;
+            } else {
+                return util::unknownOption("match", name);
+            }
+
+            return true;
+        };
+
+        if (!util::parseArgs(args, onOption)) {
+            return {};
+        }
+
+        return config;
+    }
+} // namespace stoat::match
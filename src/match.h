@@ -0,0 +1,86 @@
+/*
+ * Stoat, a USI shogi engine
+ * Copyright (C) 2025 Ciekce
+ *
+ * Stoat is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Stoat is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Stoat. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "types.h"
+
+#include <array>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+
+namespace stoat::match {
+    constexpr u32 kDefaultMatchPairs = 50;
+    constexpr u32 kDefaultMatchConcurrency = 1;
+    constexpr usize kDefaultMatchNodes = 5000;
+    constexpr usize kDefaultMatchHashMib = 16;
+    constexpr u32 kDefaultRandomPlies = 8;
+
+    struct EngineConfig {
+        // per move
+        usize nodes{kDefaultMatchNodes};
+        // per game, every concurrent game has its own searcher for each engine
+        usize hashMib{kDefaultMatchHashMib};
+        u32 threads{1};
+    };
+
+    struct SprtConfig {
+        // logistic elo
+        f64 elo0{};
+        f64 elo1{};
+
+        f64 alpha{0.05};
+        f64 beta{0.05};
+    };
+
+    struct MatchConfig {
+        // results are reported from the first engine's perspective
+        std::array<EngineConfig, 2> engines{};
+
+        // every opening is played twice, with each engine as black once
+        u32 pairs{kDefaultMatchPairs};
+        u32 concurrency{kDefaultMatchConcurrency};
+
+        // one opening per line, in the format of analyse input files, used in order and repeated
+        // if there are fewer than pairs. If empty, random openings are played from startpos instead
+        std::string openingsFile{};
+
+        // uniformly random legal moves played from startpos for each random opening
+        u32 randomPlies{kDefaultRandomPlies};
+        // random opening n is played with seed + n
+        u64 seed{};
+
+        // if set, the match stops as soon as either hypothesis is accepted
+        std::optional<SprtConfig> sprt{};
+    };
+
+    // Plays the two engine configurations against each other in this process, with
+    // pairs of games running concurrently on separate threads. The engines differ only
+    // in their limits and resources, as everything else is shared within a process.
+    // returns false if the openings file could not be read
+    bool run(const MatchConfig& config);
+
+    // [--pairs <count>] [--concurrency <count>] [--openings <file>] [--random-plies <plies>]
+    //     [--seed <seed>] [--nodes <nodes>[,<nodes>]] [--hash <mib>[,<mib>]] [--threads <count>[,<count>]]
+    //     [--sprt <elo0>,<elo1>]
+    // a pair of values gives each engine its own, a single value is used for both.
+    // prints an error and returns nothing if the arguments are invalid
+    [[nodiscard]] std::optional<MatchConfig> parseArgs(std::span<const std::string_view> args);
+} // namespace stoat::match
@@ -0,0 +1,70 @@
+/*
+ * Stoat, a USI shogi engine
+ * Copyright (C) 2025 Ciekce
+ *
+ * Stoat is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Stoat is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Stoat. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "mate.h"
+
+#include "attacks/attacks.h"
+#include "movegen.h"
+
+namespace stoat::mate {
+    Move findMateIn1(const Position& pos) {
+        assert(!pos.isInCheck());
+
+        const auto stm = pos.stm();
+        const auto theirKing = pos.king(stm.flip());
+
+        // squares we would give contact check from, a knight check cannot be blocked either
+        const auto contactSquares = attacks::kingAttacks(theirKing) | attacks::knightAttacks(theirKing, stm.flip());
+
+        movegen::MoveList checks{};
+        movegen::generateLegalChecks(checks, pos, contactSquares);
+
+        const auto adjacent = attacks::kingAttacks(theirKing);
+
+        for (const auto move : checks) {
+            const auto to = move.to();
+
+            // their king can just take an adjacent checker that nothing else defends.
+            // ignores defenders x-raying through the moving piece, which may miss a mate
+            if (adjacent.getSquare(to)) {
+                auto defenders = pos.attackersTo(to, stm);
+
+                if (!move.isDrop()) {
+                    defenders &= ~Bitboard::fromSquare(move.from());
+                }
+
+                if (defenders.empty()) {
+                    continue;
+                }
+            }
+
+            const auto newPos = pos.applyMove(move);
+            assert(newPos.isInCheck());
+
+            // a pawn drop that mates is illegal, and so never generated
+            movegen::MoveList evasions{};
+            movegen::generateLegal(evasions, newPos);
+
+            if (evasions.empty()) {
+                return move;
+            }
+        }
+
+        return kNullMove;
+    }
+} // namespace stoat::mate
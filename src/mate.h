@@ -0,0 +1,31 @@
+/*
+ * Stoat, a USI shogi engine
+ * Copyright (C) 2025 Ciekce
+ *
+ * Stoat is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Stoat is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Stoat. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "types.h"
+
+#include "move.h"
+#include "position.h"
+
+namespace stoat::mate {
+    // Finds a move that mates immediately, trying contact checks (moves and drops to squares
+    // next to their king, and knight checks) only. Distant checks can also mate, but rarely
+    // do, so this may miss mates. Returns a null move if none was found, never usable in check
+    [[nodiscard]] Move findMateIn1(const Position& pos);
+} // namespace stoat::mate
@@ -0,0 +1,336 @@
+/*
+ * Stoat, a USI shogi engine
+ * Copyright (C) 2025 Ciekce
+ *
+ * Stoat is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Stoat is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Stoat. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Times the hot kernels of the engine in isolation, over positions
+// reached by random playouts from the bench positions. Built as a
+// separate target, see CMakeLists.txt and the microbench make target
+
+#include "types.h"
+
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "attacks/attacks.h"
+#include "bench.h"
+#include "eval/eval.h"
+#include "eval/nnue.h"
+#include "movegen.h"
+#include "position.h"
+#include "protocol/handler.h"
+#include "see.h"
+#include "util/rng.h"
+#include "util/timer.h"
+
+#if defined(__x86_64__)
+    #include <x86intrin.h>
+#endif
+
+using namespace stoat;
+
+namespace stoat::protocol {
+    // only needed to link the search, which nothing here runs
+    const IProtocolHandler& currHandler() {
+        static EngineState s_state{};
+        static const auto s_handler = createHandler(kDefaultHandler, s_state);
+
+        return *s_handler;
+    }
+} // namespace stoat::protocol
+
+namespace {
+    constexpr i32 kPlayoutPlies = 48;
+    constexpr f64 kMinKernelTime = 0.25;
+
+#if defined(__x86_64__)
+    constexpr bool kHasCycleCounter = true;
+
+    // tsc ticks, which only approximate core cycles under frequency scaling
+    [[nodiscard]] inline u64 readCycles() {
+        return __rdtsc();
+    }
+#else
+    constexpr bool kHasCycleCounter = false;
+
+    [[nodiscard]] inline u64 readCycles() {
+        return 0;
+    }
+#endif
+
+    struct CorpusEntry {
+        Position pos;
+
+        movegen::MoveList pseudolegal{};
+        movegen::MoveList legal{};
+        movegen::MoveList captures{};
+    };
+
+    [[nodiscard]] std::vector<CorpusEntry> buildCorpus() {
+        util::rng::Jsf64Rng rng{UINT64_C(0x5709a7)};
+
+        std::vector<CorpusEntry> corpus{};
+
+        for (const auto sfen : bench::kBenchSfens) {
+            auto pos = Position::fromSfen(sfen).take();
+
+            for (i32 ply = 0; ply < kPlayoutPlies; ++ply) {
+                auto& entry = corpus.emplace_back(CorpusEntry{pos});
+
+                movegen::generateAll(entry.pseudolegal, pos);
+                movegen::generateLegal(entry.legal, pos);
+                movegen::generateLegalCaptures(entry.captures, pos);
+
+                if (entry.legal.empty()) {
+                    break;
+                }
+
+                pos = pos.applyMove(entry.legal[rng.nextU32(entry.legal.size())]);
+            }
+        }
+
+        return corpus;
+    }
+
+    // pass() runs the kernel over the whole corpus and returns how many operations it timed
+    void measure(std::string_view filter, std::string_view name, usize& sink, auto pass) {
+        if (!filter.empty() && name.find(filter) == std::string_view::npos) {
+            return;
+        }
+
+        // warm up the caches and branch predictors
+        pass(sink);
+
+        usize ops{};
+
+        const auto start = util::Instant::now();
+        const auto startCycles = readCycles();
+
+        do {
+            ops += pass(sink);
+        } while (start.elapsed() < kMinKernelTime);
+
+        const auto cycles = static_cast<f64>(readCycles() - startCycles);
+        const auto time = start.elapsed();
+
+        std::cout << std::left << std::setw(24) << name << std::right << std::setw(12) << ops << " ops "
+                  << std::setw(10) << time / static_cast<f64>(ops) * 1000000000.0 << " ns/op";
+
+        if constexpr (kHasCycleCounter) {
+            std::cout << std::setw(10) << cycles / static_cast<f64>(ops) << " cycles/op";
+        }
+
+        std::cout << std::endl;
+    }
+} // namespace
+
+i32 main(i32 argc, char* argv[]) {
+    eval::nnue::loadDefaultNetwork();
+
+    // only kernels whose name contains the filter are run
+    const auto filter = argc > 1 ? std::string_view{argv[1]} : std::string_view{};
+
+    const auto corpus = buildCorpus();
+
+    std::cout << corpus.size() << " positions" << std::endl;
+    std::cout << std::fixed << std::setprecision(2);
+
+    // keeps the results from being optimised out
+    usize sink{};
+
+    const auto generator = [&](auto generate) {
+        return [&, generate](usize& dst) {
+            usize ops{};
+
+            for (const auto& entry : corpus) {
+                movegen::MoveList moves{};
+                generate(moves, entry.pos);
+
+                dst += moves.size();
+                ++ops;
+            }
+
+            return ops;
+        };
+    };
+
+    measure(filter, "generateAll", sink, generator([](auto& dst, const auto& pos) {
+                movegen::generateAll(dst, pos);
+            }));
+    measure(filter, "generateCaptures", sink, generator([](auto& dst, const auto& pos) {
+                movegen::generateCaptures(dst, pos);
+            }));
+    measure(filter, "generateNonCaptures", sink, generator([](auto& dst, const auto& pos) {
+                movegen::generateNonCaptures(dst, pos);
+            }));
+    measure(filter, "generateLegal", sink, generator([](auto& dst, const auto& pos) {
+                movegen::generateLegal(dst, pos);
+            }));
+
+    const auto sliders = [&](auto attacks) {
+        return [&, attacks](usize& dst) {
+            usize ops{};
+
+            for (const auto& entry : corpus) {
+                const auto occ = entry.pos.occupancy();
+
+                for (i32 sqIdx = 0; sqIdx < Squares::kCount; ++sqIdx) {
+                    dst += attacks(Square::fromRaw(sqIdx), entry.pos.stm(), occ).popcount();
+                }
+
+                ops += Squares::kCount;
+            }
+
+            return ops;
+        };
+    };
+
+    measure(filter, "lanceAttacks", sink, sliders([](Square sq, Color c, Bitboard occ) {
+                return attacks::lanceAttacks(sq, c, occ);
+            }));
+    measure(filter, "bishopAttacks", sink, sliders([](Square sq, Color, Bitboard occ) {
+                return attacks::bishopAttacks(sq, occ);
+            }));
+    measure(filter, "rookAttacks", sink, sliders([](Square sq, Color, Bitboard occ) {
+                return attacks::rookAttacks(sq, occ);
+            }));
+
+    measure(filter, "applyMove", sink, [&](usize& dst) {
+        usize ops{};
+
+        for (const auto& entry : corpus) {
+            for (const auto move : entry.legal) {
+                dst += entry.pos.applyMove(move).key();
+            }
+
+            ops += entry.legal.size();
+        }
+
+        return ops;
+    });
+
+    measure(filter, "isLegal", sink, [&](usize& dst) {
+        usize ops{};
+
+        for (const auto& entry : corpus) {
+            for (const auto move : entry.pseudolegal) {
+                dst += entry.pos.isLegal(move);
+            }
+
+            ops += entry.pseudolegal.size();
+        }
+
+        return ops;
+    });
+
+    measure(filter, "see", sink, [&](usize& dst) {
+        usize ops{};
+
+        for (const auto& entry : corpus) {
+            for (const auto move : entry.captures) {
+                dst += see::see(entry.pos, move, 0);
+            }
+
+            ops += entry.captures.size();
+        }
+
+        return ops;
+    });
+
+    std::vector<std::string> sfens{};
+    std::vector<PackedPosition> packed{};
+
+    for (const auto& entry : corpus) {
+        sfens.push_back(entry.pos.sfen());
+
+        if (PackedPosition dst{}; entry.pos.pack(dst)) {
+            packed.push_back(dst);
+        }
+    }
+
+    measure(filter, "fromSfen", sink, [&](usize& dst) {
+        for (const auto& sfen : sfens) {
+            dst += Position::fromSfen(sfen).take().key();
+        }
+
+        return sfens.size();
+    });
+
+    measure(filter, "pack", sink, [&](usize& dst) {
+        for (const auto& entry : corpus) {
+            PackedPosition result{};
+            dst += entry.pos.pack(result) + result.data[31];
+        }
+
+        return corpus.size();
+    });
+
+    measure(filter, "unpack", sink, [&](usize& dst) {
+        for (const auto& entry : packed) {
+            dst += Position::unpack(entry)->key();
+        }
+
+        return packed.size();
+    });
+
+    measure(filter, "staticEval (classical)", sink, [&](usize& dst) {
+        for (const auto& entry : corpus) {
+            dst += static_cast<usize>(eval::staticEval(entry.pos));
+        }
+
+        return corpus.size();
+    });
+
+    if (eval::nnue::network()) {
+        // large enough that the accumulator stack is kept off the stack
+        auto nnueState = std::make_unique<eval::nnue::NnueState>();
+
+        measure(filter, "nnue refresh", sink, [&](usize& dst) {
+            for (const auto& entry : corpus) {
+                nnueState->reset(entry.pos);
+                dst += static_cast<usize>(eval::staticEval(entry.pos, *nnueState));
+            }
+
+            return corpus.size();
+        });
+
+        measure(filter, "nnue update", sink, [&](usize& dst) {
+            usize ops{};
+
+            for (const auto& entry : corpus) {
+                nnueState->reset(entry.pos);
+
+                for (const auto move : entry.legal) {
+                    nnueState->push(entry.pos, move);
+                    dst += static_cast<usize>(eval::staticEval(entry.pos.applyMove(move), *nnueState));
+                    nnueState->pop();
+                }
+
+                ops += entry.legal.size();
+            }
+
+            return ops;
+        });
+    }
+
+    std::cout << "checksum " << sink << std::endl;
+
+    return 0;
+}
@@ -23,7 +23,7 @@
 
 namespace stoat::movegen {
     namespace {
-        void serializeNormals(MoveList& dst, i32 offset, Bitboard attacks) {
+        void serializeNormals(auto& dst, i32 offset, Bitboard attacks) {
             while (!attacks.empty()) {
                 const auto to = attacks.popLsb();
                 const auto from = to.offset(-offset);
@@ -32,14 +32,14 @@ namespace stoat::movegen {
             }
         }
 
-        void serializeNormals(MoveList& dst, Square from, Bitboard attacks) {
+        void serializeNormals(auto& dst, Square from, Bitboard attacks) {
             while (!attacks.empty()) {
                 const auto to = attacks.popLsb();
                 dst.push(Move::makeNormal(from, to));
             }
         }
 
-        void serializePromotions(MoveList& dst, i32 offset, Bitboard attacks) {
+        void serializePromotions(auto& dst, i32 offset, Bitboard attacks) {
             while (!attacks.empty()) {
                 const auto to = attacks.popLsb();
                 const auto from = to.offset(-offset);
@@ -48,14 +48,14 @@ namespace stoat::movegen {
             }
         }
 
-        void serializePromotions(MoveList& dst, Square from, Bitboard attacks) {
+        void serializePromotions(auto& dst, Square from, Bitboard attacks) {
             while (!attacks.empty()) {
                 const auto to = attacks.popLsb();
                 dst.push(Move::makePromotion(from, to));
             }
         }
 
-        void serializeDrops(MoveList& dst, PieceType pt, Bitboard targets) {
+        void serializeDrops(auto& dst, PieceType pt, Bitboard targets) {
             while (!targets.empty()) {
                 const auto to = targets.popLsb();
                 dst.push(Move::makeDrop(pt, to));
@@ -64,7 +64,7 @@ namespace stoat::movegen {
 
         template <bool kCanPromote>
         void generatePrecalculatedWithColorAndOcc(
-            MoveList& dst,
+            auto& dst,
             const Position& pos,
             Bitboard pieces,
             auto attackGetter,
@@ -106,7 +106,7 @@ namespace stoat::movegen {
 
         template <bool kCanPromote>
         void generatePrecalculatedWithColor(
-            MoveList& dst,
+            auto& dst,
             const Position& pos,
             Bitboard pieces,
             auto attackGetter,
@@ -125,7 +125,7 @@ namespace stoat::movegen {
 
         template <bool kCanPromote>
         void generatePrecalculatedWithOcc(
-            MoveList& dst,
+            auto& dst,
             const Position& pos,
             Bitboard pieces,
             auto attackGetter,
@@ -144,7 +144,7 @@ namespace stoat::movegen {
 
         template <bool kCanPromote>
         void generatePrecalculated(
-            MoveList& dst,
+            auto& dst,
             const Position& pos,
             Bitboard pieces,
             auto attackGetter,
@@ -161,9 +161,9 @@ namespace stoat::movegen {
             );
         }
 
-        void generatePawns(MoveList& dst, const Position& pos, Bitboard dstMask) {
+        void generatePawns(auto& dst, const Position& pos, Bitboard dstMask, Bitboard pieceMask) {
             const auto stm = pos.stm();
-            const auto pawns = pos.pieceBb(PieceTypes::kPawn, stm);
+            const auto pawns = pos.pieceBb(PieceTypes::kPawn, stm) & pieceMask;
 
             const auto shifted = pawns.shiftNorthRelative(stm) & dstMask;
 
@@ -176,8 +176,8 @@ namespace stoat::movegen {
             serializeNormals(dst, offset, nonPromos);
         }
 
-        void generateLances(MoveList& dst, const Position& pos, Bitboard dstMask) {
-            const auto lances = pos.pieceBb(PieceTypes::kLance, pos.stm());
+        void generateLances(auto& dst, const Position& pos, Bitboard dstMask, Bitboard pieceMask) {
+            const auto lances = pos.pieceBb(PieceTypes::kLance, pos.stm()) & pieceMask;
             generatePrecalculatedWithColorAndOcc<true>(
                 dst,
                 pos,
@@ -188,8 +188,8 @@ namespace stoat::movegen {
             );
         }
 
-        void generateKnights(MoveList& dst, const Position& pos, Bitboard dstMask) {
-            const auto knights = pos.pieceBb(PieceTypes::kKnight, pos.stm());
+        void generateKnights(auto& dst, const Position& pos, Bitboard dstMask, Bitboard pieceMask) {
+            const auto knights = pos.pieceBb(PieceTypes::kKnight, pos.stm()) & pieceMask;
             generatePrecalculatedWithColor<true>(
                 dst,
                 pos,
@@ -200,46 +200,49 @@ namespace stoat::movegen {
             );
         }
 
-        void generateSilvers(MoveList& dst, const Position& pos, Bitboard dstMask) {
-            const auto silvers = pos.pieceBb(PieceTypes::kSilver, pos.stm());
+        void generateSilvers(auto& dst, const Position& pos, Bitboard dstMask, Bitboard pieceMask) {
+            const auto silvers = pos.pieceBb(PieceTypes::kSilver, pos.stm()) & pieceMask;
             generatePrecalculatedWithColor<true>(dst, pos, silvers, attacks::silverAttacks, dstMask);
         }
 
-        void generateGolds(MoveList& dst, const Position& pos, Bitboard dstMask) {
-            const auto golds = pos.pieceBb(PieceTypes::kGold, pos.stm())
-                             | pos.pieceBb(PieceTypes::kPromotedPawn, pos.stm())
-                             | pos.pieceBb(PieceTypes::kPromotedLance, pos.stm())
-                             | pos.pieceBb(PieceTypes::kPromotedKnight, pos.stm())
-                             | pos.pieceBb(PieceTypes::kPromotedSilver, pos.stm());
+        void generateGolds(auto& dst, const Position& pos, Bitboard dstMask, Bitboard pieceMask) {
+            const auto golds = (pos.pieceBb(PieceTypes::kGold, pos.stm())
+                                | pos.pieceBb(PieceTypes::kPromotedPawn, pos.stm())
+                                | pos.pieceBb(PieceTypes::kPromotedLance, pos.stm())
+                                | pos.pieceBb(PieceTypes::kPromotedKnight, pos.stm())
+                                | pos.pieceBb(PieceTypes::kPromotedSilver, pos.stm()))
+                             & pieceMask;
             generatePrecalculatedWithColor<false>(dst, pos, golds, attacks::goldAttacks, dstMask);
         }
 
-        void generateBishops(MoveList& dst, const Position& pos, Bitboard dstMask) {
-            const auto bishops = pos.pieceBb(PieceTypes::kBishop, pos.stm());
+        void generateBishops(auto& dst, const Position& pos, Bitboard dstMask, Bitboard pieceMask) {
+            const auto bishops = pos.pieceBb(PieceTypes::kBishop, pos.stm()) & pieceMask;
             generatePrecalculatedWithOcc<true>(dst, pos, bishops, attacks::bishopAttacks, dstMask);
         }
 
-        void generateRooks(MoveList& dst, const Position& pos, Bitboard dstMask) {
-            const auto rooks = pos.pieceBb(PieceTypes::kRook, pos.stm());
+        void generateRooks(auto& dst, const Position& pos, Bitboard dstMask, Bitboard pieceMask) {
+            const auto rooks = pos.pieceBb(PieceTypes::kRook, pos.stm()) & pieceMask;
             generatePrecalculatedWithOcc<true>(dst, pos, rooks, attacks::rookAttacks, dstMask);
         }
 
-        void generatePromotedBishops(MoveList& dst, const Position& pos, Bitboard dstMask) {
-            const auto horses = pos.pieceBb(PieceTypes::kPromotedBishop, pos.stm());
+        void generatePromotedBishops(auto& dst, const Position& pos, Bitboard dstMask, Bitboard pieceMask) {
+            const auto horses = pos.pieceBb(PieceTypes::kPromotedBishop, pos.stm()) & pieceMask;
             generatePrecalculatedWithOcc<false>(dst, pos, horses, attacks::promotedBishopAttacks, dstMask);
         }
 
-        void generatePromotedRooks(MoveList& dst, const Position& pos, Bitboard dstMask) {
-            const auto dragons = pos.pieceBb(PieceTypes::kPromotedRook, pos.stm());
+        void generatePromotedRooks(auto& dst, const Position& pos, Bitboard dstMask, Bitboard pieceMask) {
+            const auto dragons = pos.pieceBb(PieceTypes::kPromotedRook, pos.stm()) & pieceMask;
             generatePrecalculatedWithOcc<false>(dst, pos, dragons, attacks::promotedRookAttacks, dstMask);
         }
 
-        void generateKings(MoveList& dst, const Position& pos, Bitboard dstMask) {
+        void generateKings(auto& dst, const Position& pos, Bitboard dstMask) {
             const auto kings = pos.pieceBb(PieceTypes::kKing, pos.stm());
             generatePrecalculated<false>(dst, pos, kings, attacks::kingAttacks, dstMask);
         }
 
-        void generateDrops(MoveList& dst, const Position& pos, Bitboard dstMask) {
+        // typeMask(pt) further restricts the drop targets of each piece type
+        template <bool kLegal>
+        void generateDrops(auto& dst, const Position& pos, Bitboard dstMask, auto typeMask) {
             if (dstMask.empty()) {
                 return;
             }
@@ -253,15 +256,26 @@ namespace stoat::movegen {
 
             const auto generate = [&](PieceType pt, Bitboard restriction = Bitboards::kAll) {
                 if (hand.count(pt) > 0) {
-                    const auto targets = dstMask & restriction;
+                    const auto targets = dstMask & restriction & typeMask(pt);
                     serializeDrops(dst, pt, targets);
                 }
             };
 
-            generate(
-                PieceTypes::kPawn,
-                ~Bitboards::relativeRank(stm, 8) & ~pos.pieceBb(PieceTypes::kPawn, stm).fillFile()
-            );
+            auto pawnMask = ~Bitboards::relativeRank(stm, 8) & ~pos.pieceBb(PieceTypes::kPawn, stm).fillFile()
+                          & typeMask(PieceTypes::kPawn);
+
+            if constexpr (kLegal) {
+                // the only pawn drop that can be illegal is one that mates
+                const auto mateSquare = pos.pieceBb(PieceTypes::kKing, stm.flip()).shiftSouthRelative(stm);
+
+                if (hand.count(PieceTypes::kPawn) > 0 && !(mateSquare & dstMask & pawnMask).empty()
+                    && !pos.isLegal(Move::makeDrop(PieceTypes::kPawn, mateSquare.lsb())))
+                {
+                    pawnMask &= ~mateSquare;
+                }
+            }
+
+            generate(PieceTypes::kPawn, pawnMask);
             generate(PieceTypes::kLance, ~Bitboards::relativeRank(stm, 8));
             generate(PieceTypes::kKnight, ~(Bitboards::relativeRank(stm, 8) | Bitboards::relativeRank(stm, 7)));
             generate(PieceTypes::kSilver);
@@ -270,9 +284,37 @@ namespace stoat::movegen {
             generate(PieceTypes::kRook);
         }
 
-        template <bool kGenerateDrops>
-        void generate(MoveList& dst, const Position& pos, Bitboard dstMask) {
-            generateKings(dst, pos, dstMask);
+        template <bool kLegal>
+        void generateDrops(auto& dst, const Position& pos, Bitboard dstMask) {
+            generateDrops<kLegal>(dst, pos, dstMask, [](PieceType) { return Bitboards::kAll; });
+        }
+
+        void generateNonKings(auto& dst, const Position& pos, Bitboard dstMask, Bitboard pieceMask) {
+            generatePawns(dst, pos, dstMask, pieceMask);
+            generateLances(dst, pos, dstMask, pieceMask);
+            generateKnights(dst, pos, dstMask, pieceMask);
+            generateSilvers(dst, pos, dstMask, pieceMask);
+            generateGolds(dst, pos, dstMask, pieceMask);
+            generateBishops(dst, pos, dstMask, pieceMask);
+            generateRooks(dst, pos, dstMask, pieceMask);
+            generatePromotedBishops(dst, pos, dstMask, pieceMask);
+            generatePromotedRooks(dst, pos, dstMask, pieceMask);
+        }
+
+        void generateLegalKingMoves(auto& dst, const Position& pos, Bitboard dstMask) {
+            const auto king = pos.king(pos.stm());
+            const auto targets = attacks::kingAttacks(king) & dstMask & ~pos.threats();
+
+            serializeNormals(dst, king, targets);
+        }
+
+        template <bool kGenerateDrops, bool kLegal>
+        void generate(auto& dst, const Position& pos, Bitboard dstMask) {
+            if constexpr (kLegal) {
+                generateLegalKingMoves(dst, pos, dstMask);
+            } else {
+                generateKings(dst, pos, dstMask);
+            }
 
             if (pos.checkers().multiple()) {
                 return;
@@ -288,42 +330,180 @@ namespace stoat::movegen {
                 dropMask &= checkRay;
             }
 
-            generatePawns(dst, pos, dstMask);
-            generateLances(dst, pos, dstMask);
-            generateKnights(dst, pos, dstMask);
-            generateSilvers(dst, pos, dstMask);
-            generateGolds(dst, pos, dstMask);
-            generateBishops(dst, pos, dstMask);
-            generateRooks(dst, pos, dstMask);
-            generatePromotedBishops(dst, pos, dstMask);
-            generatePromotedRooks(dst, pos, dstMask);
+            if constexpr (kLegal) {
+                const auto king = pos.king(pos.stm());
+                const auto pinned = pos.pinned();
+
+                generateNonKings(dst, pos, dstMask, ~pinned);
+
+                // a pinned piece can never resolve a check, and otherwise can only move along its pin
+                if (pos.checkers().empty()) {
+                    auto pinnedPieces = pinned;
+                    while (!pinnedPieces.empty()) {
+                        const auto sq = pinnedPieces.popLsb();
+                        generateNonKings(dst, pos, dstMask & rayIntersecting(sq, king), Bitboard::fromSquare(sq));
+                    }
+                }
+            } else {
+                generateNonKings(dst, pos, dstMask, Bitboards::kAll);
+            }
 
             if constexpr (kGenerateDrops) {
-                generateDrops(dst, pos, dropMask);
+                generateDrops<kLegal>(dst, pos, dropMask);
             }
         }
+
+        void generateRecapturesTo(auto& dst, const Position& pos, Square captureSq) {
+            assert(!pos.colorBb(pos.stm()).getSquare(captureSq));
+            assert(pos.colorBb(pos.stm().flip()).getSquare(captureSq));
+
+            const auto dstMask = Bitboard::fromSquare(captureSq);
+            generate<false, false>(dst, pos, dstMask);
+        }
+
+        void generateChecks(auto& dst, const Position& pos, Bitboard dstMask) {
+            assert(!pos.isInCheck());
+
+            const auto stm = pos.stm();
+            const auto nstm = stm.flip();
+
+            const auto theirKing = pos.king(nstm);
+
+            const auto occ = pos.occupancy();
+            const auto stmOcc = pos.colorBb(stm);
+            const auto nstmOcc = pos.colorBb(nstm);
+
+            // squares from which a piece of each type gives check, i.e. the
+            // squares a piece of that type would attack from their king's square
+            std::array<Bitboard, PieceTypes::kCount> checkSquares{};
+
+            for (const auto pt : PieceTypes::kAll) {
+                if (pt != PieceTypes::kKing) {
+                    checkSquares[pt.idx()] = attacks::pieceAttacks(pt, theirKing, nstm, occ);
+                }
+            }
+
+            // our pieces that are alone between their king and one of our sliders
+            Bitboard discoverers{};
+
+            const auto stmLances = pos.pieceBb(PieceTypes::kLance, stm);
+            const auto stmBishops =
+                pos.pieceBb(PieceTypes::kBishop, stm) | pos.pieceBb(PieceTypes::kPromotedBishop, stm);
+            const auto stmRooks = pos.pieceBb(PieceTypes::kRook, stm) | pos.pieceBb(PieceTypes::kPromotedRook, stm);
+
+            auto snipers = (attacks::lanceAttacks(theirKing, nstm, nstmOcc) & stmLances)
+                         | (attacks::bishopAttacks(theirKing, nstmOcc) & stmBishops)
+                         | (attacks::rookAttacks(theirKing, nstmOcc) & stmRooks);
+            while (!snipers.empty()) {
+                const auto sniper = snipers.popLsb();
+                const auto blocker = stmOcc & rayBetween(sniper, theirKing);
+
+                if (blocker.one()) {
+                    discoverers |= blocker;
+                }
+            }
+
+            MoveList candidates{};
+            generate<false, true>(candidates, pos, dstMask & ~stmOcc);
+
+            for (const auto move : candidates) {
+                const auto from = move.from();
+                const auto to = move.to();
+
+                const auto pt = pos.pieceOn(from).type();
+                const auto resultPt = move.isPromo() ? pt.promoted() : pt;
+
+                const bool direct = checkSquares[resultPt.idx()].getSquare(to);
+                const bool discovered = discoverers.getSquare(from) && !rayIntersecting(from, theirKing).getSquare(to);
+
+                if (direct || discovered) {
+                    dst.push(move);
+                }
+            }
+
+            generateDrops<true>(dst, pos, dstMask & ~occ, [&](PieceType pt) { return checkSquares[pt.idx()]; });
+        }
     } // namespace
 
     void generateAll(MoveList& dst, const Position& pos) {
         const auto dstMask = ~pos.colorBb(pos.stm());
-        generate<true>(dst, pos, dstMask);
+        generate<true, false>(dst, pos, dstMask);
     }
 
     void generateCaptures(MoveList& dst, const Position& pos) {
         const auto dstMask = pos.colorBb(pos.stm().flip());
-        generate<false>(dst, pos, dstMask);
+        generate<false, false>(dst, pos, dstMask);
     }
 
     void generateNonCaptures(MoveList& dst, const Position& pos) {
         const auto dstMask = ~pos.occupancy();
-        generate<true>(dst, pos, dstMask);
+        generate<true, false>(dst, pos, dstMask);
     }
 
     void generateRecaptures(MoveList& dst, const Position& pos, Square captureSq) {
-        assert(!pos.colorBb(pos.stm()).getSquare(captureSq));
-        assert(pos.colorBb(pos.stm().flip()).getSquare(captureSq));
+        generateRecapturesTo(dst, pos, captureSq);
+    }
+
+    void generateLegal(MoveList& dst, const Position& pos) {
+        const auto dstMask = ~pos.colorBb(pos.stm());
+        generate<true, true>(dst, pos, dstMask);
+    }
+
+    void generateLegalCaptures(MoveList& dst, const Position& pos) {
+        const auto dstMask = pos.colorBb(pos.stm().flip());
+        generate<false, true>(dst, pos, dstMask);
+    }
+
+    void generateLegalNonCaptures(MoveList& dst, const Position& pos) {
+        const auto dstMask = ~pos.occupancy();
+        generate<true, true>(dst, pos, dstMask);
+    }
+
+    void generateLegalChecks(MoveList& dst, const Position& pos) {
+        generateLegalChecks(dst, pos, ~pos.occupancy());
+    }
+
+    void generateLegalChecks(MoveList& dst, const Position& pos, Bitboard dstMask) {
+        generateChecks(dst, pos, dstMask);
+    }
+
+    void generateRecaptures(ScoredMoveList& dst, const Position& pos, Square captureSq) {
+        generateRecapturesTo(dst, pos, captureSq);
+    }
+
+    void generateLegalCaptures(ScoredMoveList& dst, const Position& pos) {
+        const auto dstMask = pos.colorBb(pos.stm().flip());
+        generate<false, true>(dst, pos, dstMask);
+    }
+
+    void generateLegalNonCaptures(ScoredMoveList& dst, const Position& pos) {
+        const auto dstMask = ~pos.occupancy();
+        generate<true, true>(dst, pos, dstMask);
+    }
+
+    void generateLegalChecks(ScoredMoveList& dst, const Position& pos) {
+        generateChecks(dst, pos, ~pos.occupancy());
+    }
+
+    void generateLegalBoardNonCaptures(ScoredMoveList& dst, const Position& pos) {
+        const auto dstMask = ~pos.occupancy();
+        generate<false, true>(dst, pos, dstMask);
+    }
+
+    void generateLegalDrops(ScoredMoveList& dst, const Position& pos) {
+        const auto checkers = pos.checkers();
+
+        if (checkers.multiple()) {
+            return;
+        }
+
+        auto dropMask = ~pos.occupancy();
+
+        // only interpositions can resolve a check
+        if (!checkers.empty()) {
+            dropMask &= rayBetween(pos.king(pos.stm()), checkers.lsb());
+        }
 
-        const auto dstMask = Bitboard::fromSquare(captureSq);
-        generate<false>(dst, pos, dstMask);
+        generateDrops<true>(dst, pos, dropMask);
     }
 } // namespace stoat::movegen
@@ -20,15 +20,77 @@
 
 #include "types.h"
 
+#include <bit>
+
 #include "move.h"
 #include "position.h"
 #include "util/static_vector.h"
 
 namespace stoat::movegen {
-    using MoveList = util::StaticVector<Move, 600>;
+    constexpr usize kMaxMoves = 600;
+    using MoveList = util::StaticVector<Move, kMaxMoves>;
+
+    // A move and its ordering score packed into one word, score in the high half.
+    // Moves convert implicitly with a score of 0, so movegen can fill either list
+    class ScoredMove {
+    public:
+        constexpr ScoredMove() = default;
+
+        constexpr ScoredMove(Move move) : // NOLINT(google-explicit-constructor)
+                m_packed{static_cast<u64>(kSignBit) << 32 | std::bit_cast<u16>(move)} {}
+
+        [[nodiscard]] constexpr Move move() const {
+            return std::bit_cast<Move>(static_cast<u16>(m_packed));
+        }
+
+        [[nodiscard]] constexpr i32 score() const {
+            return static_cast<i32>(static_cast<u32>(m_packed >> 32) ^ kSignBit);
+        }
+
+        constexpr void setScore(i32 score) {
+            m_packed = (static_cast<u64>(static_cast<u32>(score) ^ kSignBit) << 32) | (m_packed & kMoveMask);
+        }
+
+        // orders the same as score(), but compares as a plain unsigned integer
+        [[nodiscard]] constexpr u32 key() const {
+            return static_cast<u32>(m_packed >> 32);
+        }
+
+    private:
+        static constexpr u32 kSignBit = 0x80000000;
+        static constexpr u64 kMoveMask = 0xffff;
+
+        // scores are biased by flipping the sign bit, so that larger words hold larger scores
+        u64 m_packed;
+    };
+
+    static_assert(sizeof(ScoredMove) == sizeof(u64));
+
+    using ScoredMoveList = util::StaticVector<ScoredMove, kMaxMoves>;
 
     void generateAll(MoveList& dst, const Position& pos);
     void generateCaptures(MoveList& dst, const Position& pos);
     void generateNonCaptures(MoveList& dst, const Position& pos);
     void generateRecaptures(MoveList& dst, const Position& pos, Square captureSq);
+
+    // fully legal, using the position's checkers and pins
+    // instead of filtering every move with Position::isLegal()
+    void generateLegal(MoveList& dst, const Position& pos);
+    void generateLegalCaptures(MoveList& dst, const Position& pos);
+    void generateLegalNonCaptures(MoveList& dst, const Position& pos);
+    // non-captures and drops that give check, not usable in check
+    void generateLegalChecks(MoveList& dst, const Position& pos);
+    // moves and drops to dstMask that give check, including captures
+    void generateLegalChecks(MoveList& dst, const Position& pos, Bitboard dstMask);
+
+    // same as above, for the move picker to score in place
+    void generateRecaptures(ScoredMoveList& dst, const Position& pos, Square captureSq);
+    void generateLegalCaptures(ScoredMoveList& dst, const Position& pos);
+    void generateLegalNonCaptures(ScoredMoveList& dst, const Position& pos);
+    void generateLegalChecks(ScoredMoveList& dst, const Position& pos);
+
+    // generateLegalNonCaptures(), split into board moves and drops
+    // so that the picker can leave drops until quiet moves run out
+    void generateLegalBoardNonCaptures(ScoredMoveList& dst, const Position& pos);
+    void generateLegalDrops(ScoredMoveList& dst, const Position& pos);
 } // namespace stoat::movegen
@@ -18,13 +18,33 @@
 
 #include "movepick.h"
 
+#include "see.h"
+
 namespace stoat {
+    namespace {
+        [[nodiscard]] i32 scoreCapture(const Position& pos, Move move) {
+            assert(!move.isDrop());
+
+            const auto moving = pos.pieceOn(move.from()).type();
+            const auto captured = pos.pieceOn(move.to()).type();
+
+            // most valuable victim, least valuable attacker
+            auto score = see::pieceValue(captured) * 16 - see::pieceValue(moving);
+
+            if (move.isPromo()) {
+                score += (see::pieceValue(moving.promoted()) - see::pieceValue(moving)) * 16;
+            }
+
+            return score;
+        }
+    } // namespace
+
     Move MoveGenerator::next() {
         switch (m_stage) {
             case MovegenStage::TtMove: {
                 ++m_stage;
 
-                if (m_ttMove && m_pos.isPseudolegal(m_ttMove)) {
+                if (m_ttMove && m_pos.isPseudolegal(m_ttMove) && m_pos.isLegal(m_ttMove)) {
                     return m_ttMove;
                 }
 
@@ -32,15 +52,30 @@ namespace stoat {
             }
 
             case MovegenStage::GenerateCaptures: {
-                movegen::generateCaptures(m_moves, m_pos);
+                movegen::generateLegalCaptures(m_moves, m_pos);
                 m_end = m_moves.size();
 
+                scoreCaptures();
+
                 ++m_stage;
                 [[fallthrough]];
             }
 
-            case MovegenStage::Captures: {
-                if (const auto move = selectNext([this](Move move) { return move != m_ttMove; })) {
+            case MovegenStage::GoodCaptures: {
+                const auto move = selectBest([this](Move move) {
+                    if (move == m_ttMove) {
+                        return false;
+                    }
+
+                    if (!m_see.see(move, 0)) {
+                        m_moves[m_badCaptureEnd++] = move;
+                        return false;
+                    }
+
+                    return true;
+                });
+
+                if (move) {
                     return move;
                 }
 
@@ -49,15 +84,56 @@ namespace stoat {
             }
 
             case MovegenStage::GenerateNonCaptures: {
-                movegen::generateNonCaptures(m_moves, m_pos);
+                // drops are left to their own stage, as a cutoff usually comes before them
+                movegen::generateLegalBoardNonCaptures(m_moves, m_pos);
+                addRefutationDrops();
                 m_end = m_moves.size();
 
+                scoreNonCaptures();
+
                 ++m_stage;
                 [[fallthrough]];
             }
 
             case MovegenStage::NonCaptures: {
-                if (const auto move = selectNext([this](Move move) { return move != m_ttMove; })) {
+                if (const auto move = selectBest([this](Move move) { return move != m_ttMove; })) {
+                    return move;
+                }
+
+                ++m_stage;
+                [[fallthrough]];
+            }
+
+            case MovegenStage::GenerateDrops: {
+                assert(m_idx == m_moves.size());
+
+                movegen::generateLegalDrops(m_moves, m_pos);
+                m_end = m_moves.size();
+
+                scoreNonCaptures();
+
+                ++m_stage;
+                [[fallthrough]];
+            }
+
+            case MovegenStage::Drops: {
+                if (const auto move = selectBest([this](Move move) {
+                        return move != m_ttMove && !isRefutation(move);
+                    }))
+                {
+                    return move;
+                }
+
+                m_idx = 0;
+                m_end = m_badCaptureEnd;
+
+                ++m_stage;
+                [[fallthrough]];
+            }
+
+            case MovegenStage::BadCaptures: {
+                // already in order, and the tt move was never stored with them
+                if (const auto move = selectNext([](Move) { return true; })) {
                     return move;
                 }
 
@@ -65,15 +141,57 @@ namespace stoat {
                 return kNullMove;
             }
 
+            case MovegenStage::QsearchTtMove: {
+                ++m_stage;
+
+                // only captures are searched in qsearch
+                if (m_ttMove && m_pos.isPseudolegal(m_ttMove) && m_pos.isCapture(m_ttMove)
+                    && m_pos.isLegal(m_ttMove))
+                {
+                    return m_ttMove;
+                }
+
+                [[fallthrough]];
+            }
+
             case MovegenStage::QsearchGenerateCaptures: {
-                movegen::generateCaptures(m_moves, m_pos);
+                movegen::generateLegalCaptures(m_moves, m_pos);
                 m_end = m_moves.size();
 
+                scoreCaptures();
+
                 ++m_stage;
                 [[fallthrough]];
             }
 
             case MovegenStage::QsearchCaptures: {
+                if (const auto move = selectBest([this](Move move) { return move != m_ttMove; })) {
+                    return move;
+                }
+
+                if (!m_generateChecks) {
+                    m_stage = MovegenStage::End;
+                    return kNullMove;
+                }
+
+                ++m_stage;
+                [[fallthrough]];
+            }
+
+            case MovegenStage::QsearchGenerateChecks: {
+                assert(!m_pos.isInCheck());
+
+                m_idx = m_moves.size();
+
+                movegen::generateLegalChecks(m_moves, m_pos);
+                m_end = m_moves.size();
+
+                ++m_stage;
+                [[fallthrough]];
+            }
+
+            case MovegenStage::QsearchChecks: {
+                // the tt move is always a capture in qsearch, so never duplicated here
                 if (const auto move = selectNext([](Move) { return true; })) {
                     return move;
                 }
@@ -82,19 +200,147 @@ namespace stoat {
                 return kNullMove;
             }
 
+            case MovegenStage::QsearchGenerateRecaptures: {
+                movegen::generateRecaptures(m_moves, m_pos, m_captureSq);
+                m_end = m_moves.size();
+
+                scoreCaptures();
+
+                ++m_stage;
+                [[fallthrough]];
+            }
+
+            case MovegenStage::QsearchRecaptures: {
+                // unlike the other generators, generateRecaptures() is only pseudolegal
+                if (const auto move = selectBest([this](Move move) { return m_pos.isLegal(move); })) {
+                    return move;
+                }
+
+                m_stage = MovegenStage::End;
+                return kNullMove;
+            }
+
             default:
                 return kNullMove;
         }
     }
 
-    MoveGenerator MoveGenerator::main(const Position& pos, Move ttMove) {
-        return MoveGenerator{MovegenStage::TtMove, pos, ttMove};
+    void MoveGenerator::addRefutationDrops() {
+        for (const auto move : {m_killers[0], m_killers[1], m_countermove}) {
+            if (!move || !move.isDrop() || move == m_ttMove) {
+                continue;
+            }
+
+            // the countermove may also be a killer
+            if (move == m_countermove && (move == m_killers[0] || move == m_killers[1])) {
+                continue;
+            }
+
+            if (m_pos.isPseudolegal(move) && m_pos.isLegal(move)) {
+                m_moves.push(move);
+            }
+        }
     }
 
-    MoveGenerator MoveGenerator::qsearch(const Position& pos) {
-        return MoveGenerator{MovegenStage::QsearchGenerateCaptures, pos, kNullMove};
+    void MoveGenerator::scoreCaptures() {
+        for (usize idx = m_idx; idx < m_end; ++idx) {
+            m_moves[idx].setScore(scoreCapture(m_pos, m_moves[idx].move()));
+        }
     }
 
-    MoveGenerator::MoveGenerator(MovegenStage initialStage, const Position& pos, Move ttMove) :
-            m_stage{initialStage}, m_pos{pos}, m_ttMove{ttMove} {}
+    void MoveGenerator::scoreNonCaptures() {
+        // above any possible history score
+        constexpr i32 kKillerScore = 1 << 20;
+        constexpr i32 kCountermoveScore = 1 << 19;
+
+        assert(m_history);
+
+        for (usize idx = m_idx; idx < m_end; ++idx) {
+            auto& scored = m_moves[idx];
+            const auto move = scored.move();
+
+            if (move == m_killers[0]) {
+                scored.setScore(kKillerScore + 1);
+            } else if (move == m_killers[1]) {
+                scored.setScore(kKillerScore);
+            } else if (move == m_countermove) {
+                scored.setScore(kCountermoveScore);
+            } else {
+                scored.setScore(
+                    m_history->nonCaptureScore(m_continuations, m_pos.stm(), m_pos.movingPiece(move), move)
+                );
+            }
+        }
+    }
+
+    MoveGenerator MoveGenerator::main(
+        movegen::ScoredMoveList& moves,
+        const Position& pos,
+        Move ttMove,
+        const HistoryTables& history,
+        std::span<ContinuationSubtable* const> continuations,
+        std::span<const Move, 2> killers,
+        Move countermove
+    ) {
+        return MoveGenerator{MovegenStage::TtMove, moves, pos, ttMove, &history, continuations, killers, countermove};
+    }
+
+    MoveGenerator MoveGenerator::qsearch(
+        movegen::ScoredMoveList& moves,
+        const Position& pos,
+        Move ttMove,
+        bool generateChecks
+    ) {
+        constexpr std::array kNoKillers = {kNullMove, kNullMove};
+
+        auto generator =
+            MoveGenerator{MovegenStage::QsearchTtMove, moves, pos, ttMove, nullptr, {}, kNoKillers, kNullMove};
+        generator.m_generateChecks = generateChecks && !pos.isInCheck();
+
+        return generator;
+    }
+
+    MoveGenerator MoveGenerator::qsearchRecaptures(
+        movegen::ScoredMoveList& moves,
+        const Position& pos,
+        Square captureSq
+    ) {
+        constexpr std::array kNoKillers = {kNullMove, kNullMove};
+
+        auto generator = MoveGenerator{
+            MovegenStage::QsearchGenerateRecaptures,
+            moves,
+            pos,
+            kNullMove,
+            nullptr,
+            {},
+            kNoKillers,
+            kNullMove,
+        };
+        generator.m_captureSq = captureSq;
+
+        return generator;
+    }
+
+    MoveGenerator::MoveGenerator(
+        MovegenStage initialStage,
+        movegen::ScoredMoveList& moves,
+        const Position& pos,
+        Move ttMove,
+        const HistoryTables* history,
+        std::span<ContinuationSubtable* const> continuations,
+        std::span<const Move, 2> killers,
+        Move countermove
+    ) :
+            m_stage{initialStage},
+            m_pos{pos},
+            m_see{pos},
+            m_moves{moves},
+            m_ttMove{ttMove},
+            m_history{history},
+            m_continuations{continuations},
+            m_killers{killers[0], killers[1]},
+            m_countermove{countermove} {
+        m_moves.clear();
+    }
 } // namespace stoat
@@ -20,21 +20,35 @@
 
 #include "types.h"
 
+#include <array>
+#include <cassert>
 #include <compare>
+#include <span>
+#include <utility>
 
+#include "history.h"
 #include "move.h"
 #include "movegen.h"
 #include "position.h"
+#include "see.h"
 
 namespace stoat {
     enum class MovegenStage : i32 {
         TtMove = 0,
         GenerateCaptures,
-        Captures,
+        GoodCaptures,
         GenerateNonCaptures,
         NonCaptures,
+        GenerateDrops,
+        Drops,
+        BadCaptures,
+        QsearchTtMove,
         QsearchGenerateCaptures,
         QsearchCaptures,
+        QsearchGenerateChecks,
+        QsearchChecks,
+        QsearchGenerateRecaptures,
+        QsearchRecaptures,
         End,
     };
 
@@ -55,15 +69,97 @@ namespace stoat {
             return m_stage;
         }
 
-        [[nodiscard]] static MoveGenerator main(const Position& pos, Move ttMove);
-        [[nodiscard]] static MoveGenerator qsearch(const Position& pos);
+        // shares attacker sets with the exchanges already evaluated for good captures
+        [[nodiscard]] inline bool see(Move move, i32 threshold) {
+            return m_see.see(move, threshold);
+        }
+
+        // Every generator fills a list owned by the caller, see ThreadData::moveList(),
+        // which must outlive it and not be used by any other generator in the meantime
+
+        [[nodiscard]] static MoveGenerator main(
+            movegen::ScoredMoveList& moves,
+            const Position& pos,
+            Move ttMove,
+            const HistoryTables& history,
+            std::span<ContinuationSubtable* const> continuations,
+            std::span<const Move, 2> killers,
+            Move countermove
+        );
+
+        // quiet checks are only generated when requested, and never in check
+        [[nodiscard]] static MoveGenerator qsearch(
+            movegen::ScoredMoveList& moves,
+            const Position& pos,
+            Move ttMove,
+            bool generateChecks
+        );
+
+        // only captures on captureSq, usually the destination of the last move
+        [[nodiscard]] static MoveGenerator qsearchRecaptures(
+            movegen::ScoredMoveList& moves,
+            const Position& pos,
+            Square captureSq
+        );
 
     private:
-        MoveGenerator(MovegenStage initialStage, const Position& pos, Move ttMove);
+        MoveGenerator(
+            MovegenStage initialStage,
+            movegen::ScoredMoveList& moves,
+            const Position& pos,
+            Move ttMove,
+            const HistoryTables* history,
+            std::span<ContinuationSubtable* const> continuations,
+            std::span<const Move, 2> killers,
+            Move countermove
+        );
+
+        // killer and countermove drops are tried with the board moves rather than waiting for the rest
+        void addRefutationDrops();
+
+        [[nodiscard]] inline bool isRefutation(Move move) const {
+            return move == m_killers[0] || move == m_killers[1] || move == m_countermove;
+        }
+
+        void scoreCaptures();
+        void scoreNonCaptures();
+
+        // partial selection sort - moves the highest scored remaining
+        // move to the front, so that a cutoff on the first move is cheap
+        [[nodiscard]] inline usize findBest() {
+            assert(m_idx < m_end);
+
+            auto bestIdx = m_idx;
+            auto bestKey = m_moves[m_idx].key();
+
+            for (usize idx = m_idx + 1; idx < m_end; ++idx) {
+                if (m_moves[idx].key() > bestKey) {
+                    bestIdx = idx;
+                    bestKey = m_moves[idx].key();
+                }
+            }
+
+            if (bestIdx != m_idx) {
+                std::swap(m_moves[m_idx], m_moves[bestIdx]);
+            }
+
+            return m_idx++;
+        }
+
+        [[nodiscard]] inline Move selectBest(auto predicate) {
+            while (m_idx < m_end) {
+                const auto move = m_moves[findBest()].move();
+                if (predicate(move)) {
+                    return move;
+                }
+            }
+
+            return kNullMove;
+        }
 
         [[nodiscard]] inline Move selectNext(auto predicate) {
             while (m_idx < m_end) {
-                const auto move = m_moves[m_idx++];
+                const auto move = m_moves[m_idx++].move();
                 if (predicate(move)) {
                     return move;
                 }
@@ -75,11 +171,28 @@ namespace stoat {
         MovegenStage m_stage;
 
         const Position& m_pos;
-        movegen::MoveList m_moves{};
+        see::Context m_see;
+
+        // scores are only filled for scored stages
+        movegen::ScoredMoveList& m_moves;
 
         Move m_ttMove;
 
+        // null in qsearch, which never scores non-captures
+        const HistoryTables* m_history;
+        std::span<ContinuationSubtable* const> m_continuations;
+
+        std::array<Move, 2> m_killers;
+        Move m_countermove;
+
+        bool m_generateChecks{};
+        Square m_captureSq{Squares::kNone};
+
         usize m_idx{};
         usize m_end{};
+
+        // captures that fail SEE are moved to the front of the
+        // list while searching good captures, and tried last
+        usize m_badCaptureEnd{};
     };
 } // namespace stoat
@@ -15,63 +15,160 @@
  * You should have received a copy of the GNU General Public License
  * along with Stoat. If not, see <https://www.gnu.org/licenses/>.
  */
-
 #include "perft.h"
 
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <thread>
+#include <vector>
+
 #include "movegen.h"
 #include "util/timer.h"
 
 namespace stoat {
     namespace {
-        usize doPerft(const Position& pos, i32 depth) {
+        // Shared between threads without locking. Each entry stores its key xored
+        // with its data, so a torn write from another thread just reads as a miss
+        class PerftTable {
+        public:
+            explicit PerftTable(usize mib) {
+                if (mib == 0) {
+                    return;
+                }
+
+                const auto entries = std::bit_floor(mib * 1024 * 1024 / sizeof(Entry));
+                m_entries = std::vector<Entry>(entries);
+            }
+
+            [[nodiscard]] inline bool enabled() const {
+                return !m_entries.empty();
+            }
+
+            [[nodiscard]] bool probe(u64 key, i32 depth, usize& nodes) const {
+                const auto& entry = m_entries[index(key)];
+
+                const auto data = entry.data.load(std::memory_order::relaxed);
+                const auto check = entry.check.load(std::memory_order::relaxed);
+
+                if ((check ^ data) != key || static_cast<i32>(data & kDepthMask) != depth) {
+                    return false;
+                }
+
+                nodes = static_cast<usize>(data >> kDepthBits);
+                return true;
+            }
+
+            void store(u64 key, i32 depth, usize nodes) {
+                auto& entry = m_entries[index(key)];
+
+                const auto data = (static_cast<u64>(nodes) << kDepthBits) | static_cast<u64>(depth);
+
+                entry.data.store(data, std::memory_order::relaxed);
+                entry.check.store(key ^ data, std::memory_order::relaxed);
+            }
+
+        private:
+            // node counts are limited to 2^56, far more than any feasible perft
+            static constexpr i32 kDepthBits = 8;
+            static constexpr u64 kDepthMask = (u64{1} << kDepthBits) - 1;
+
+            struct Entry {
+                std::atomic<u64> check{};
+                std::atomic<u64> data{};
+            };
+
+            std::vector<Entry> m_entries{};
+
+            [[nodiscard]] inline usize index(u64 key) const {
+                return static_cast<usize>(key) & (m_entries.size() - 1);
+            }
+        };
+
+        usize doPerft(PerftTable& table, const Position& pos, i32 depth) {
             if (depth <= 0) {
                 return 1;
             }
 
             movegen::MoveList moves{};
-            movegen::generateAll(moves, pos);
+            movegen::generateLegal(moves, pos);
+
+            // bulk counting, the moves at the last ply are never made
+            if (depth == 1) {
+                return moves.size();
+            }
+
+            const auto key = pos.key();
+
+            if (usize nodes{}; table.enabled() && table.probe(key, depth, nodes)) {
+                return nodes;
+            }
 
             usize total{};
 
             for (const auto move : moves) {
-                if (!pos.isLegal(move)) {
-                    continue;
-                }
+                const auto newPos = pos.applyMove(move);
+                total += doPerft(table, newPos, depth - 1);
+            }
 
-                if (depth == 1) {
-                    ++total;
-                } else {
-                    const auto newPos = pos.applyMove(move);
-                    total += doPerft(newPos, depth - 1);
-                }
+            if (table.enabled()) {
+                table.store(key, depth, total);
             }
 
             return total;
         }
     } // namespace
 
-    void splitPerft(const Position& pos, i32 depth) {
+    void splitPerft(const Position& pos, i32 depth, u32 threads, usize hashMib) {
         if (depth < 1) {
             depth = 1;
         }
 
+        threads = std::max<u32>(threads, 1);
+
         const auto start = util::Instant::now();
 
+        PerftTable table{hashMib};
+
         movegen::MoveList moves{};
-        movegen::generateAll(moves, pos);
+        movegen::generateLegal(moves, pos);
 
-        usize total{};
+        std::vector<usize> values(moves.size());
 
-        for (const auto move : moves) {
-            if (!pos.isLegal(move)) {
-                continue;
+        // root moves are handed out one at a time, so a slow subtree does not hold up the rest
+        std::atomic<usize> nextMove{};
+
+        const auto worker = [&] {
+            while (true) {
+                const auto idx = nextMove.fetch_add(1, std::memory_order::relaxed);
+
+                if (idx >= moves.size()) {
+                    break;
+                }
+
+                const auto newPos = pos.applyMove(moves[idx]);
+                values[idx] = doPerft(table, newPos, depth - 1);
             }
+        };
+
+        std::vector<std::thread> helpers{};
+        helpers.reserve(threads - 1);
 
-            const auto newPos = pos.applyMove(move);
-            const auto value = doPerft(newPos, depth - 1);
+        for (u32 i = 1; i < threads; ++i) {
+            helpers.emplace_back(worker);
+        }
+
+        worker();
+
+        for (auto& helper : helpers) {
+            helper.join();
+        }
+
+        usize total{};
 
-            total += value;
-            std::cout << move << '\t' << value << '\n';
+        for (usize idx = 0; idx < moves.size(); ++idx) {
+            total += values[idx];
+            std::cout << moves[idx] << '\t' << values[idx] << '\n';
         }
 
         const auto nps = static_cast<usize>(static_cast<f64>(total) / start.elapsed());
@@ -23,5 +23,7 @@
 #include "position.h"
 
 namespace stoat {
-    void splitPerft(const Position& pos, i32 depth);
+    // root moves are split between threads, and positions are only
+    // hashed from depth 2 up, when hashMib is nonzero
+    void splitPerft(const Position& pos, i32 depth, u32 threads = 1, usize hashMib = 0);
 }
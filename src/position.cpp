@@ -22,11 +22,10 @@
 #include <sstream>
 
 #include "attacks/attacks.h"
+#include "eval/material.h"
 #include "keys.h"
-#include "movegen.h"
 #include "rays.h"
 #include "util/parse.h"
-#include "util/split.h"
 
 namespace stoat {
     namespace {
@@ -38,15 +37,25 @@ namespace stoat {
         constexpr i32 kBishopHandBits = 2;
         constexpr i32 kRookHandBits = 2;
 
+        // every count is followed by an always-clear guard bit, which catches
+        // the borrow out of that count when subtracting two hands in Hand::covers()
         constexpr i32 kPawnHandOffset = 0;
-        constexpr i32 kLanceHandOffset = kPawnHandOffset + kPawnHandBits;
-        constexpr i32 kKnightHandOffset = kLanceHandOffset + kLanceHandBits;
-        constexpr i32 kSilverHandOffset = kKnightHandOffset + kKnightHandBits;
-        constexpr i32 kGoldHandOffset = kSilverHandOffset + kSilverHandBits;
-        constexpr i32 kBishopHandOffset = kGoldHandOffset + kGoldHandBits;
-        constexpr i32 kRookHandOffset = kBishopHandOffset + kBishopHandBits;
-
-        static_assert(kRookHandOffset + kRookHandBits <= 32);
+        constexpr i32 kLanceHandOffset = kPawnHandOffset + kPawnHandBits + 1;
+        constexpr i32 kKnightHandOffset = kLanceHandOffset + kLanceHandBits + 1;
+        constexpr i32 kSilverHandOffset = kKnightHandOffset + kKnightHandBits + 1;
+        constexpr i32 kGoldHandOffset = kSilverHandOffset + kSilverHandBits + 1;
+        constexpr i32 kBishopHandOffset = kGoldHandOffset + kGoldHandBits + 1;
+        constexpr i32 kRookHandOffset = kBishopHandOffset + kBishopHandBits + 1;
+
+        static_assert(kRookHandOffset + kRookHandBits + 1 <= 32);
+
+        constexpr u32 kHandGuardBits = (1U << (kPawnHandOffset + kPawnHandBits))
+                                     | (1U << (kLanceHandOffset + kLanceHandBits))
+                                     | (1U << (kKnightHandOffset + kKnightHandBits))
+                                     | (1U << (kSilverHandOffset + kSilverHandBits))
+                                     | (1U << (kGoldHandOffset + kGoldHandBits))
+                                     | (1U << (kBishopHandOffset + kBishopHandBits))
+                                     | (1U << (kRookHandOffset + kRookHandBits));
 
         constexpr auto kHandOffsets = [] {
             std::array<i32, PieceTypes::kCount> offsets{};
@@ -76,6 +85,100 @@ namespace stoat {
 
             return masks;
         }();
+
+        struct PieceCode {
+            u32 bits{};
+            u32 length{};
+        };
+
+        // indexed like kHandPieces, bits are in the order written
+        constexpr std::array<PieceCode, kHandPieces.size()> kPieceCodes = {{
+            {0b0, 1},
+            {0b001, 3},
+            {0b101, 3},
+            {0b0011, 4},
+            {0b1011, 4},
+            {0b0111, 4},
+            {0b1111, 4},
+        }};
+
+        constexpr std::array<u32, kHandPieces.size()> kPieceTotals = {18, 4, 4, 4, 4, 2, 2};
+
+        constexpr auto kHandPieceIndices = [] {
+            std::array<u8, PieceTypes::kCount> indices{};
+
+            for (usize idx = 0; idx < kHandPieces.size(); ++idx) {
+                indices[kHandPieces[idx].idx()] = idx;
+            }
+
+            return indices;
+        }();
+
+        class PackWriter {
+        public:
+            explicit PackWriter(PackedPosition& dst) :
+                    m_dst{dst} {}
+
+            inline void write(u32 value, u32 bits) {
+                for (u32 bit = 0; bit < bits; ++bit, ++m_pos) {
+                    assert(m_pos < m_dst.data.size() * 8);
+                    m_dst.data[m_pos / 8] |= static_cast<u8>(((value >> bit) & 1) << (m_pos % 8));
+                }
+            }
+
+            inline void write(PieceCode code) {
+                write(code.bits, code.length);
+            }
+
+        private:
+            PackedPosition& m_dst;
+            usize m_pos{};
+        };
+
+        // reads past the end return 0, and are only caught by overflowed() afterwards
+        class PackReader {
+        public:
+            explicit PackReader(const PackedPosition& src) :
+                    m_src{src} {}
+
+            inline u32 read(u32 bits) {
+                u32 value{};
+
+                for (u32 bit = 0; bit < bits; ++bit, ++m_pos) {
+                    if (m_pos < m_src.data.size() * 8) {
+                        value |= static_cast<u32>((m_src.data[m_pos / 8] >> (m_pos % 8)) & 1) << bit;
+                    }
+                }
+
+                return value;
+            }
+
+            // index into kHandPieces
+            [[nodiscard]] inline usize readPiece() {
+                u32 bits{};
+
+                for (u32 length = 1;; ++length) {
+                    bits |= read(1) << (length - 1);
+
+                    for (usize idx = 0; idx < kPieceCodes.size(); ++idx) {
+                        if (kPieceCodes[idx].length == length && kPieceCodes[idx].bits == bits) {
+                            return idx;
+                        }
+                    }
+
+                    // the code is complete, so every 4 bit sequence is matched
+                    assert(length < 4);
+                }
+            }
+
+            [[nodiscard]] inline bool overflowed() const {
+                return m_pos > m_src.data.size() * 8;
+            }
+
+        private:
+            const PackedPosition& m_src;
+            usize m_pos{};
+        };
     } // namespace
 
     u32 Hand::count(PieceType pt) const {
@@ -117,6 +220,12 @@ namespace stoat {
         m_hand = (m_hand & ~mask) | (count << offset);
     }
 
+    bool Hand::covers(const Hand& other) const {
+        // a count smaller than the other hand's borrows from, and sets, its guard bit.
+        // a borrow rippling further can only set guard bits above one that is already set
+        return ((m_hand - other.m_hand) & kHandGuardBits) == 0;
+    }
+
     std::string Hand::sfen(bool uppercase) const {
         std::ostringstream sfen{};
 
@@ -184,23 +293,42 @@ namespace stoat {
 
     void PositionKeys::clear() {
         all = 0;
+        board = 0;
+        pawns = 0;
     }
 
     void PositionKeys::flipPiece(Piece piece, Square sq) {
         assert(piece);
         assert(sq);
-        all ^= keys::pieceSquare(piece, sq);
+
+        const auto key = keys::pieceSquare(piece, sq);
+
+        all ^= key;
+        board ^= key;
+
+        if (piece.type() == PieceTypes::kPawn) {
+            pawns ^= key;
+        }
     }
 
     void PositionKeys::movePiece(Piece piece, Square from, Square to) {
         assert(piece);
         assert(from);
         assert(to);
-        all ^= keys::pieceSquare(piece, from) ^ keys::pieceSquare(piece, to);
+
+        const auto key = keys::pieceSquare(piece, from) ^ keys::pieceSquare(piece, to);
+
+        all ^= key;
+        board ^= key;
+
+        if (piece.type() == PieceTypes::kPawn) {
+            pawns ^= key;
+        }
     }
 
     void PositionKeys::flipStm() {
         all ^= keys::stm();
+        board ^= keys::stm();
     }
 
     void PositionKeys::flipHandCount(Color c, PieceType pt, u32 count) {
@@ -250,7 +378,7 @@ namespace stoat {
         newPos.m_stm = newPos.m_stm.flip();
         newPos.m_keys.flipStm();
 
-        newPos.updateAttacks();
+        newPos.updateAttacks(move);
 
         if (newPos.isInCheck()) {
             ++newPos.m_consecutiveChecks[newPos.stm().idx()];
@@ -258,6 +386,8 @@ namespace stoat {
             newPos.m_consecutiveChecks[newPos.stm().idx()] = 0;
         }
 
+        assert(newPos.key() == keyAfter(move));
+
         return newPos;
     }
 
@@ -274,6 +404,44 @@ namespace stoat {
         return newPos;
     }
 
+    u64 Position::keyAfter(Move move) const {
+        const auto stm = this->stm();
+
+        auto keys = m_keys;
+
+        if (move.isDrop()) {
+            const auto pt = move.dropPiece();
+            const auto count = hand(stm).count(pt);
+
+            keys.flipPiece(pt.withColor(stm), move.to());
+            keys.switchHandCount(stm, pt, count, count - 1);
+        } else {
+            const auto to = move.to();
+            const auto from = move.from();
+
+            const auto piece = pieceOn(from);
+
+            if (const auto captured = pieceOn(to)) {
+                const auto handPt = captured.type().unpromoted();
+                const auto count = hand(stm).count(handPt);
+
+                keys.switchHandCount(stm, handPt, count, count + 1);
+                keys.flipPiece(captured, to);
+            }
+
+            if (move.isPromo()) {
+                keys.flipPiece(piece, from);
+                keys.flipPiece(piece.promoted(), to);
+            } else {
+                keys.movePiece(piece, from, to);
+            }
+        }
+
+        keys.flipStm();
+
+        return keys.all;
+    }
+
     SennichiteStatus Position::testSennichite(bool cuteChessWorkaround, std::span<const u64> keyHistory, i32 limit)
         const {
         const auto end = std::max(0, static_cast<i32>(keyHistory.size()) - limit - 1);
@@ -288,9 +456,13 @@ namespace stoat {
                     // properly - work around that to avoid illegal moves
                     if (cuteChessWorkaround) {
                         return isInCheck() ? SennichiteStatus::kWin : SennichiteStatus::kDraw;
-                    } else {
-                        return m_consecutiveChecks[stm().idx()] >= 2 ? SennichiteStatus::kWin : SennichiteStatus::kDraw;
                     }
+
+                    // a perpetual only if every opponent move in the cycle gave check,
+                    // the cycle can be longer than 4 plies with a long enough limit
+                    const auto cycleChecks = (static_cast<i32>(keyHistory.size()) - i) / 2;
+                    return m_consecutiveChecks[stm().idx()] >= cycleChecks ? SennichiteStatus::kWin
+                                                                           : SennichiteStatus::kDraw;
                 }
             }
         }
@@ -421,17 +593,7 @@ namespace stoat {
             if (move.dropPiece() == PieceTypes::kPawn) {
                 const auto dropBb = Bitboard::fromSquare(move.to());
                 if (!(dropBb.shiftNorthRelative(stm) & pieceBb(PieceTypes::kKing, nstm)).empty()) {
-                    // this pawn drop gives check - ensure it's not mate
-                    // slow and cursed, but rare
-                    const auto newPos = applyMove(move);
-
-                    assert(newPos.checkers().one());
-                    assert(newPos.checkers().getSquare(move.to()));
-
-                    movegen::MoveList newMoves{};
-                    movegen::generateAll(newMoves, newPos);
-
-                    return std::ranges::any_of(newMoves, [&](Move newMove) { return newPos.isLegal(newMove); });
+                    return !isPawnDropMate(move.to());
                 }
             }
 
@@ -440,15 +602,13 @@ namespace stoat {
         }
 
         if (pieceOn(move.from()).type() == PieceTypes::kKing) {
-            // remove the king to account for moving away from the checker
-            const auto kinglessOcc = occupancy() ^ pieceBb(PieceTypes::kKing, stm);
-            return !isAttacked(move.to(), nstm, kinglessOcc);
+            return !threats().getSquare(move.to());
         } else if (m_checkers.multiple()) {
             // multiple checks can only be evaded with a king move
             return false;
         }
 
-        if (m_pinned.getSquare(move.from())) {
+        if (pinned().getSquare(move.from())) {
             const auto pinRay = rayIntersecting(move.from(), stmKing);
             if (!pinRay.getSquare(move.to())) {
                 return false;
@@ -470,6 +630,41 @@ namespace stoat {
         return true;
     }
 
+    bool Position::isPawnDropMate(Square sq) const {
+        const auto stm = this->stm();
+        const auto nstm = this->stm().flip();
+
+        const auto nstmKing = king(nstm);
+        assert(attacks::pawnAttacks(sq, stm).getSquare(nstmKing));
+
+        // the pawn is adjacent to the king, so the check cannot be blocked
+        const auto occWithPawn = occupancy() | Bitboard::fromSquare(sq);
+
+        // capture the pawn with anything other than the king, as long as
+        // that does not expose the king to one of our sliders. Nothing else
+        // can be attacking the king yet, because it's not the opponent's move
+        auto capturers = attackersTo(sq, nstm) & ~Bitboard::fromSquare(nstmKing);
+        while (!capturers.empty()) {
+            const auto capturer = capturers.popLsb();
+            if (!isAttacked(nstmKing, stm, occWithPawn ^ Bitboard::fromSquare(capturer))) {
+                return false;
+            }
+        }
+
+        // or move the king out of check, which includes capturing the pawn
+        // itself. the pawn only attacks the king's square, so it can be ignored
+        const auto kinglessOcc = occWithPawn ^ Bitboard::fromSquare(nstmKing);
+
+        auto escapes = attacks::kingAttacks(nstmKing) & ~colorBb(nstm);
+        while (!escapes.empty()) {
+            if (!isAttacked(escapes.popLsb(), stm, kinglessOcc)) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
     bool Position::isCapture(Move move) const {
         return pieceOn(move.to()) != Pieces::kNone;
     }
@@ -535,6 +730,82 @@ namespace stoat {
         return false;
     }
 
+    bool Position::canDeclareWin(EnteringKingRule rule) const {
+        static constexpr i32 kMinPieces = 10;
+        static constexpr i32 kBigPiecePoints = 5;
+
+        if (rule == EnteringKingRule::kNone || isInCheck()) {
+            return false;
+        }
+
+        const auto stm = this->stm();
+        const auto promoArea = Bitboards::promoArea(stm);
+
+        if (!promoArea.getSquare(king(stm))) {
+            return false;
+        }
+
+        const auto pieces = colorBb(stm) & promoArea & ~pieceTypeBb(PieceTypes::kKing);
+        const auto pieceCount = pieces.popcount();
+
+        if (pieceCount < kMinPieces) {
+            return false;
+        }
+
+        // promoted pieces share their unpromoted type's bitboard
+        const auto bigPieces =
+            pieces & (m_pieces[foldedIdx(PieceTypes::kBishop)] | m_pieces[foldedIdx(PieceTypes::kRook)]);
+
+        const auto& hand = this->hand(stm);
+
+        const auto bigInHand = static_cast<i32>(hand.count(PieceTypes::kBishop) + hand.count(PieceTypes::kRook));
+        const auto smallInHand = static_cast<i32>(
+            hand.count(PieceTypes::kPawn) + hand.count(PieceTypes::kLance) + hand.count(PieceTypes::kKnight)
+            + hand.count(PieceTypes::kSilver) + hand.count(PieceTypes::kGold)
+        );
+
+        const auto points = pieceCount + (kBigPiecePoints - 1) * bigPieces.popcount() + kBigPiecePoints * bigInHand
+                          + smallInHand;
+
+        switch (rule) {
+            case EnteringKingRule::k24Point:
+                return points >= 31;
+            case EnteringKingRule::k27Point:
+                return points >= (stm == Colors::kBlack ? 28 : 27);
+            default:
+                return false;
+        }
+    }
+
+    bool Position::givesCheck(Move move) const {
+        assert(!move.isNull());
+
+        const auto stm = this->stm();
+        const auto nstmKing = king(stm.flip());
+
+        if (move.isDrop()) {
+            return attacks::pieceAttacks(move.dropPiece(), move.to(), stm, occupancy()).getSquare(nstmKing);
+        }
+
+        auto pt = pieceOn(move.from()).type();
+
+        if (move.isPromo()) {
+            pt = pt.promoted();
+        }
+
+        // a slider can move along the line to the king, so its own square must be vacated
+        auto occ = occupancy();
+        occ.clearSquare(move.from());
+        occ.setSquare(move.to());
+
+        if (attacks::pieceAttacks(pt, move.to(), stm, occ).getSquare(nstmKing)) {
+            return true;
+        }
+
+        return discoveryCandidates().getSquare(move.from())
+            && !rayIntersecting(move.from(), nstmKing).getSquare(move.to());
+    }
+
     Bitboard Position::attackersTo(Square sq, Color attacker) const {
         assert(sq);
         assert(attacker);
@@ -578,6 +849,10 @@ namespace stoat {
     }
 
     Bitboard Position::allAttackersTo(Square sq, Bitboard occ) const {
+        return stepAttackersTo(sq) | sliderAttackersTo(sq, occ);
+    }
+
+    Bitboard Position::stepAttackersTo(Square sq) const {
         assert(sq);
 
         Bitboard attackers{};
@@ -585,19 +860,11 @@ namespace stoat {
         const auto black = colorBb(Colors::kBlack);
         const auto white = colorBb(Colors::kWhite);
 
-        const auto horses = pieceTypeBb(PieceTypes::kPromotedBishop);
-        const auto dragons = pieceTypeBb(PieceTypes::kPromotedRook);
-
         const auto pawns = pieceTypeBb(PieceTypes::kPawn);
 
         attackers |= pawns & black & attacks::pawnAttacks(sq, Colors::kWhite);
         attackers |= pawns & white & attacks::pawnAttacks(sq, Colors::kBlack);
 
-        const auto lances = pieceTypeBb(PieceTypes::kLance);
-
-        attackers |= lances & black & attacks::lanceAttacks(sq, Colors::kWhite, occ);
-        attackers |= lances & white & attacks::lanceAttacks(sq, Colors::kBlack, occ);
-
         const auto knights = pieceTypeBb(PieceTypes::kKnight);
 
         attackers |= knights & black & attacks::knightAttacks(sq, Colors::kWhite);
@@ -615,15 +882,30 @@ namespace stoat {
         attackers |= golds & black & attacks::goldAttacks(sq, Colors::kWhite);
         attackers |= golds & white & attacks::goldAttacks(sq, Colors::kBlack);
 
-        const auto bishops = horses | pieceTypeBb(PieceTypes::kBishop);
+        // horses and dragons also step one square like a king
+        const auto kings = pieceTypeBb(PieceTypes::kPromotedBishop) | pieceTypeBb(PieceTypes::kPromotedRook)
+                         | pieceTypeBb(PieceTypes::kKing);
+        attackers |= kings & attacks::kingAttacks(sq);
+
+        return attackers;
+    }
+
+    Bitboard Position::sliderAttackersTo(Square sq, Bitboard occ) const {
+        assert(sq);
+
+        Bitboard attackers{};
+
+        const auto lances = pieceTypeBb(PieceTypes::kLance);
+
+        attackers |= lances & colorBb(Colors::kBlack) & attacks::lanceAttacks(sq, Colors::kWhite, occ);
+        attackers |= lances & colorBb(Colors::kWhite) & attacks::lanceAttacks(sq, Colors::kBlack, occ);
+
+        const auto bishops = pieceTypeBb(PieceTypes::kBishop) | pieceTypeBb(PieceTypes::kPromotedBishop);
         attackers |= bishops & attacks::bishopAttacks(sq, occ);
 
-        const auto rooks = dragons | pieceTypeBb(PieceTypes::kRook);
+        const auto rooks = pieceTypeBb(PieceTypes::kRook) | pieceTypeBb(PieceTypes::kPromotedRook);
         attackers |= rooks & attacks::rookAttacks(sq, occ);
 
-        const auto kings = horses | dragons | pieceTypeBb(PieceTypes::kKing);
-        attackers |= kings & attacks::kingAttacks(sq);
-
         return attackers;
     }
 
@@ -668,6 +950,73 @@ namespace stoat {
         return sfen.str();
     }
 
+    bool Position::pack(PackedPosition& dst) const {
+        dst = {};
+
+        PackWriter writer{dst};
+
+        writer.write(stm() == Colors::kWhite, 1);
+
+        const auto blackKing = king(Colors::kBlack);
+        const auto whiteKing = king(Colors::kWhite);
+
+        writer.write(blackKing.raw(), 7);
+        writer.write(whiteKing.raw(), 7);
+
+        std::array<u32, kHandPieces.size()> counts{};
+
+        for (u8 sqIdx = 0; sqIdx < Squares::kCount; ++sqIdx) {
+            const auto sq = Square::fromRaw(sqIdx);
+
+            if (sq == blackKing || sq == whiteKing) {
+                continue;
+            }
+
+            const auto piece = pieceOn(sq);
+
+            if (!piece) {
+                writer.write(0, 1);
+                continue;
+            }
+
+            const auto type = piece.type().unpromoted();
+            const auto idx = kHandPieceIndices[type.idx()];
+
+            // also catches extra kings
+            if (type == PieceTypes::kKing || ++counts[idx] > kPieceTotals[idx]) {
+                return false;
+            }
+
+            writer.write(1, 1);
+            writer.write(kPieceCodes[idx]);
+
+            if (type.canPromote()) {
+                writer.write(piece.isPromoted(), 1);
+            }
+
+            writer.write(piece.color() == Colors::kWhite, 1);
+        }
+
+        for (const auto c : {Colors::kBlack, Colors::kWhite}) {
+            for (usize idx = 0; idx < kHandPieces.size(); ++idx) {
+                const auto count = hand(c).count(kHandPieces[idx]);
+
+                counts[idx] += count;
+
+                if (counts[idx] > kPieceTotals[idx]) {
+                    return false;
+                }
+
+                for (u32 i = 0; i < count; ++i) {
+                    writer.write(kPieceCodes[idx]);
+                    writer.write(c == Colors::kWhite, 1);
+                }
+            }
+        }
+
+        return counts == kPieceTotals;
+    }
+
     void Position::regenKey() {
         m_keys.clear();
 
@@ -693,6 +1042,42 @@ namespace stoat {
         }
     }
 
+    void Position::regenEvalTerms() {
+        m_material = 0;
+
+        for (const auto c : {Colors::kBlack, Colors::kWhite}) {
+            Score material{};
+
+            for (const auto pt : PieceTypes::kAll) {
+                if (pt != PieceTypes::kKing) {
+                    material += static_cast<Score>(pieceBb(pt, c).popcount()) * eval::pieceValue(pt);
+                }
+            }
+
+            const auto& hand = this->hand(c);
+            for (const auto pt : kHandPieces) {
+                material += static_cast<Score>(hand.count(pt)) * eval::pieceValue(pt);
+            }
+
+            m_material += c == Colors::kBlack ? material : -material;
+
+            const auto kingRing = attacks::kingAttacks(king(c));
+            m_kingRingPieces[c.idx()] = (colorBb(c) & kingRing).popcount();
+        }
+    }
+
+    void Position::updateKingRing(Color c, Square from, Square to) {
+        const auto kingRing = attacks::kingAttacks(king(c));
+
+        if (from && kingRing.getSquare(from)) {
+            --m_kingRingPieces[c.idx()];
+        }
+
+        if (to && kingRing.getSquare(to)) {
+            ++m_kingRingPieces[c.idx()];
+        }
+    }
+
     void Position::addPiece(Square sq, Piece piece) {
         assert(sq);
         assert(piece);
@@ -700,7 +1085,11 @@ namespace stoat {
         assert(!pieceOn(sq));
 
         m_colors[piece.color().idx()] |= sq.bit();
-        m_pieces[piece.type().idx()] |= sq.bit();
+        m_pieces[foldedIdx(piece.type())] |= sq.bit();
+
+        if (piece.isPromoted()) {
+            m_promoted |= sq.bit();
+        }
 
         m_mailbox[sq.idx()] = piece;
 
@@ -720,7 +1109,11 @@ namespace stoat {
 
         if (captured) {
             m_colors[captured.color().idx()] ^= to.bit();
-            m_pieces[captured.type().idx()] ^= to.bit();
+            m_pieces[foldedIdx(captured.type())] ^= to.bit();
+
+            if (captured.isPromoted()) {
+                m_promoted ^= to.bit();
+            }
 
             const auto handPt = captured.type().unpromoted();
 
@@ -728,15 +1121,32 @@ namespace stoat {
             m_keys.switchHandCount(piece.color(), handPt, newCount - 1, newCount);
 
             m_keys.flipPiece(captured, to);
+
+            // the captured piece changes sides and loses its promotion
+            const auto materialSwing = eval::pieceValue(captured.type()) + eval::pieceValue(handPt);
+            m_material += piece.color() == Colors::kBlack ? materialSwing : -materialSwing;
+
+            updateKingRing(captured.color(), to, Squares::kNone);
         }
 
         m_colors[piece.color().idx()] ^= from.bit() ^ to.bit();
-        m_pieces[piece.type().idx()] ^= from.bit() ^ to.bit();
+        m_pieces[foldedIdx(piece.type())] ^= from.bit() ^ to.bit();
+
+        if (piece.isPromoted()) {
+            m_promoted ^= from.bit() ^ to.bit();
+        }
 
         m_mailbox[from.idx()] = Pieces::kNone;
         m_mailbox[to.idx()] = piece;
 
         m_keys.movePiece(piece, from, to);
+
+        if (piece.type() == PieceTypes::kKing) {
+            const auto kingRing = attacks::kingAttacks(to);
+            m_kingRingPieces[piece.color().idx()] = (colorBb(piece.color()) & kingRing).popcount();
+        } else {
+            updateKingRing(piece.color(), from, to);
+        }
     }
 
     void Position::promotePiece(Square from, Square to, Piece piece) {
@@ -753,7 +1163,11 @@ namespace stoat {
 
         if (captured) {
             m_colors[captured.color().idx()] ^= to.bit();
-            m_pieces[captured.type().idx()] ^= to.bit();
+            m_pieces[foldedIdx(captured.type())] ^= to.bit();
+
+            if (captured.isPromoted()) {
+                m_promoted ^= to.bit();
+            }
 
             const auto handPt = captured.type().unpromoted();
 
@@ -761,20 +1175,30 @@ namespace stoat {
             m_keys.switchHandCount(piece.color(), handPt, newCount - 1, newCount);
 
             m_keys.flipPiece(captured, to);
+
+            // the captured piece changes sides and loses its promotion
+            const auto materialSwing = eval::pieceValue(captured.type()) + eval::pieceValue(handPt);
+            m_material += piece.color() == Colors::kBlack ? materialSwing : -materialSwing;
+
+            updateKingRing(captured.color(), to, Squares::kNone);
         }
 
         const auto promoted = piece.promoted();
 
         m_colors[piece.color().idx()] ^= from.bit() ^ to.bit();
-
-        m_pieces[piece.type().idx()] ^= from.bit();
-        m_pieces[promoted.type().idx()] ^= to.bit();
+        m_pieces[foldedIdx(piece.type())] ^= from.bit() ^ to.bit();
+        m_promoted ^= to.bit();
 
         m_mailbox[from.idx()] = Pieces::kNone;
         m_mailbox[to.idx()] = promoted;
 
         m_keys.flipPiece(piece, from);
         m_keys.flipPiece(promoted, to);
+
+        const auto promoGain = eval::pieceValue(promoted.type()) - eval::pieceValue(piece.type());
+        m_material += piece.color() == Colors::kBlack ? promoGain : -promoGain;
+
+        updateKingRing(piece.color(), from, to);
     }
 
     void Position::dropPiece(Square sq, Piece piece) {
@@ -787,14 +1211,51 @@ namespace stoat {
 
         const auto newCount = hand.decrement(piece.type());
         m_keys.switchHandCount(piece.color(), piece.type(), newCount + 1, newCount);
+
+        // material is unchanged, the piece just moves from the hand to the board
+        updateKingRing(piece.color(), Squares::kNone, sq);
     }
 
     void Position::updateAttacks() {
+        m_checkers = attackersTo(king(stm()), stm().flip());
+
+        m_pinned = {};
+        m_threats = {};
+        m_discoveryCandidates = {};
+    }
+
+    void Position::updateAttacks(Move move) {
         const auto stm = this->stm();
         const auto nstm = this->stm().flip();
 
-        m_checkers = attackersTo(king(stm), nstm);
-        m_pinned = Bitboards::kEmpty;
+        const auto stmKing = king(stm);
+        const auto occ = occupancy();
+
+        const auto to = move.to();
+
+        m_checkers = Bitboards::kEmpty;
+
+        if (attacks::pieceAttacks(pieceOn(to).type(), to, nstm, occ).getSquare(stmKing)) {
+            m_checkers.setSquare(to);
+        }
+
+        // a capture leaves the destination occupied, so only the vacated square can uncover an attack
+        if (!move.isDrop()) {
+            if (const auto line = rayIntersecting(move.from(), stmKing); !line.empty()) {
+                m_checkers |= sliderAttackersTo(stmKing, occ) & colorBb(nstm) & line;
+            }
+        }
+
+        m_pinned = {};
+        m_threats = {};
+        m_discoveryCandidates = {};
+
+        assert(m_checkers == attackersTo(stmKing, nstm));
+    }
+
+    Bitboard Position::calcPinned() const {
+        const auto stm = this->stm();
+        const auto nstm = this->stm().flip();
 
         const auto stmKing = king(stm);
 
@@ -805,6 +1266,8 @@ namespace stoat {
         const auto nstmBishops = pieceBb(PieceTypes::kBishop, nstm) | pieceBb(PieceTypes::kPromotedBishop, nstm);
         const auto nstmRooks = pieceBb(PieceTypes::kRook, nstm) | pieceBb(PieceTypes::kPromotedRook, nstm);
 
+        Bitboard pinned{};
+
         auto potentialAttackers = (attacks::lanceAttacks(stmKing, stm, nstmOcc) & nstmLances)
                                 | (attacks::bishopAttacks(stmKing, nstmOcc) & nstmBishops)
                                 | (attacks::rookAttacks(stmKing, nstmOcc) & nstmRooks);
@@ -813,9 +1276,60 @@ namespace stoat {
             const auto maybePinned = stmOcc & rayBetween(potentialAttacker, stmKing);
 
             if (maybePinned.one()) {
-                m_pinned |= maybePinned;
+                pinned |= maybePinned;
+            }
+        }
+
+        return pinned;
+    }
+
+    Bitboard Position::calcThreats() const {
+        const auto nstm = stm().flip();
+
+        const auto kinglessOcc = occupancy() ^ pieceBb(PieceTypes::kKing, stm());
+
+        // pawns never attack past the first square, so all of them can be shifted at once
+        auto threats = pieceBb(PieceTypes::kPawn, nstm).shiftNorthRelative(nstm);
+
+        auto pieces = colorBb(nstm) & ~pieceTypeBb(PieceTypes::kPawn);
+        while (!pieces.empty()) {
+            const auto sq = pieces.popLsb();
+            threats |= attacks::pieceAttacks(pieceOn(sq).type(), sq, nstm, kinglessOcc);
+        }
+
+        return threats;
+    }
+
+    Bitboard Position::calcDiscoveryCandidates() const {
+        const auto stm = this->stm();
+        const auto nstm = this->stm().flip();
+
+        const auto nstmKing = king(nstm);
+
+        const auto stmOcc = colorBb(stm);
+        const auto nstmOcc = colorBb(nstm);
+
+        const auto stmLances = pieceBb(PieceTypes::kLance, stm);
+        const auto stmBishops = pieceBb(PieceTypes::kBishop, stm) | pieceBb(PieceTypes::kPromotedBishop, stm);
+        const auto stmRooks = pieceBb(PieceTypes::kRook, stm) | pieceBb(PieceTypes::kPromotedRook, stm);
+
+        // the mirror of finding pins in calcPinned()
+        auto potentialAttackers = (attacks::lanceAttacks(nstmKing, nstm, nstmOcc) & stmLances)
+                                | (attacks::bishopAttacks(nstmKing, nstmOcc) & stmBishops)
+                                | (attacks::rookAttacks(nstmKing, nstmOcc) & stmRooks);
+
+        Bitboard candidates{};
+
+        while (!potentialAttackers.empty()) {
+            const auto potentialAttacker = potentialAttackers.popLsb();
+            const auto blockers = stmOcc & rayBetween(potentialAttacker, nstmKing);
+
+            if (blockers.one()) {
+                candidates |= blockers;
             }
         }
+
+        return candidates;
     }
 
     void Position::regen() {
@@ -833,6 +1347,7 @@ namespace stoat {
         }
 
         regenKey();
+        regenEvalTerms();
         updateAttacks();
     }
 
@@ -842,14 +1357,14 @@ namespace stoat {
         pos.m_colors[Colors::kBlack.idx()] = Bitboard{U128(0, 0x7fd05ff)};
         pos.m_colors[Colors::kWhite.idx()] = Bitboard{U128(0x1ff41, 0x7fc0000000000000)};
 
-        pos.m_pieces[PieceTypes::kPawn.idx()] = Bitboard{U128(0, 0x7fc0000007fc0000)};
-        pos.m_pieces[PieceTypes::kLance.idx()] = Bitboard{U128(0x10100, 0x101)};
-        pos.m_pieces[PieceTypes::kKnight.idx()] = Bitboard{U128(0x8200, 0x82)};
-        pos.m_pieces[PieceTypes::kSilver.idx()] = Bitboard{U128(0x4400, 0x44)};
-        pos.m_pieces[PieceTypes::kGold.idx()] = Bitboard{U128(0x2800, 0x28)};
-        pos.m_pieces[PieceTypes::kKing.idx()] = Bitboard{U128(0x1000, 0x10)};
-        pos.m_pieces[PieceTypes::kBishop.idx()] = Bitboard{U128(0x40, 0x400)};
-        pos.m_pieces[PieceTypes::kRook.idx()] = Bitboard{U128(0x1, 0x10000)};
+        pos.m_pieces[foldedIdx(PieceTypes::kPawn)] = Bitboard{U128(0, 0x7fc0000007fc0000)};
+        pos.m_pieces[foldedIdx(PieceTypes::kLance)] = Bitboard{U128(0x10100, 0x101)};
+        pos.m_pieces[foldedIdx(PieceTypes::kKnight)] = Bitboard{U128(0x8200, 0x82)};
+        pos.m_pieces[foldedIdx(PieceTypes::kSilver)] = Bitboard{U128(0x4400, 0x44)};
+        pos.m_pieces[foldedIdx(PieceTypes::kGold)] = Bitboard{U128(0x2800, 0x28)};
+        pos.m_pieces[foldedIdx(PieceTypes::kKing)] = Bitboard{U128(0x1000, 0x10)};
+        pos.m_pieces[foldedIdx(PieceTypes::kBishop)] = Bitboard{U128(0x40, 0x400)};
+        pos.m_pieces[foldedIdx(PieceTypes::kRook)] = Bitboard{U128(0x1, 0x10000)};
 
         pos.regen();
 
@@ -863,51 +1378,66 @@ namespace stoat {
 
         Position pos{};
 
-        std::vector<std::string_view> ranks{};
-        ranks.reserve(9);
+        // parsed in place rather than split into ranks, to avoid allocating
+        const auto board = sfen[0];
 
-        util::split(ranks, sfen[0], '/');
+        i32 rankIdx = 0;
+        i32 fileIdx = 0;
 
-        if (ranks.size() != 9) {
-            return util::err<SfenError>("wrong number of ranks in SFEN");
-        }
+        for (usize curr = 0; curr < board.size(); ++curr) {
+            const auto c = board[curr];
 
-        for (i32 rankIdx = 0; rankIdx < ranks.size(); ++rankIdx) {
-            const auto rank = ranks[rankIdx];
+            if (c == '/') {
+                if (fileIdx != 9) {
+                    return util::err<SfenError>("wrong number of files in rank");
+                }
 
-            i32 fileIdx = 0;
+                if (++rankIdx == 9) {
+                    return util::err<SfenError>("wrong number of ranks in SFEN");
+                }
 
-            for (i32 curr = 0; curr < rank.size(); ++curr) {
-                const auto c = rank[curr];
-                if (const auto emptySquares = util::tryParseDigit<i32>(c)) {
-                    fileIdx += *emptySquares;
-                } else if (c == '+') {
-                    if (curr == rank.size() - 1) {
-                        return util::err<SfenError>("+ found at end of rank with no matching piece");
-                    }
+                fileIdx = 0;
+                continue;
+            }
 
-                    const auto pieceStr = rank.substr(curr, 2);
+            if (const auto emptySquares = util::tryParseDigit<i32>(c)) {
+                fileIdx += *emptySquares;
+            } else if (fileIdx >= 9) {
+                return util::err<SfenError>("wrong number of files in rank");
+            } else if (c == '+') {
+                if (curr == board.size() - 1) {
+                    return util::err<SfenError>("+ found at end of rank with no matching piece");
+                }
 
-                    if (const auto piece = Piece::fromStr(pieceStr)) {
-                        pos.addPiece(Square::fromFileRank(fileIdx, 8 - rankIdx), piece);
-                        ++fileIdx;
-                        ++curr;
-                    } else {
-                        return util::err<SfenError>("invalid promoted piece " + std::string{pieceStr});
-                    }
-                } else if (const auto piece = Piece::fromStr(rank.substr(curr, 1))) {
+                const auto pieceStr = board.substr(curr, 2);
+
+                if (const auto piece = Piece::fromStr(pieceStr)) {
                     pos.addPiece(Square::fromFileRank(fileIdx, 8 - rankIdx), piece);
                     ++fileIdx;
+                    ++curr;
                 } else {
-                    return util::err<SfenError>("invalid piece char " + std::string{c});
+                    return util::err<SfenError>("invalid promoted piece " + std::string{pieceStr});
                 }
+            } else if (const auto piece = Piece::fromStr(board.substr(curr, 1))) {
+                pos.addPiece(Square::fromFileRank(fileIdx, 8 - rankIdx), piece);
+                ++fileIdx;
+            } else {
+                return util::err<SfenError>("invalid piece char " + std::string{c});
             }
 
-            if (fileIdx != 9) {
+            if (fileIdx > 9) {
                 return util::err<SfenError>("wrong number of files in rank");
             }
         }
 
+        if (rankIdx != 8) {
+            return util::err<SfenError>("wrong number of ranks in SFEN");
+        }
+
+        if (fileIdx != 9) {
+            return util::err<SfenError>("wrong number of files in rank");
+        }
+
         if (const auto blackKingCount = pos.pieceBb(Pieces::kBlackKing).popcount(); blackKingCount != 1) {
             return util::err<SfenError>("black must have exactly 1 king");
         }
@@ -969,6 +1499,7 @@ namespace stoat {
         }
 
         pos.regenKey();
+        pos.regenEvalTerms();
         pos.updateAttacks();
 
         if (pos.isInCheck()) {
@@ -979,12 +1510,195 @@ namespace stoat {
     }
 
     util::Result<Position, SfenError> Position::fromSfen(std::string_view sfen) {
-        std::vector<std::string_view> parts{};
-        parts.reserve(4);
+        std::array<std::string_view, 4> parts{};
+        usize count = 0;
+
+        while (true) {
+            const auto start = sfen.find_first_not_of(' ');
+
+            if (start == std::string_view::npos) {
+                break;
+            }
+
+            if (count == parts.size()) {
+                return util::err<SfenError>("wrong number of SFEN parts");
+            }
+
+            sfen = sfen.substr(start);
+
+            const auto end = std::min(sfen.find(' '), sfen.size());
 
-        util::split(parts, sfen);
+            parts[count++] = sfen.substr(0, end);
+            sfen = sfen.substr(end);
+        }
+
+        return fromSfenParts(std::span{parts}.first(count));
+    }
+
+    util::Result<Position, std::string> Position::fromPositionCommand(
+        std::span<std::string_view> args,
+        const std::function<void(const Position&, Move)>& onMove,
+        usize maxMoves
+    ) {
+        if (args.empty()) {
+            return util::err<std::string>("Empty position");
+        }
+
+        Position pos{};
+
+        if (args[0] == "startpos") {
+            pos = startpos();
+            args = args.subspan(1);
+        } else {
+            if (args[0] == "sfen") {
+                args = args.subspan(1);
+            }
+
+            const auto count = std::distance(args.begin(), std::ranges::find(args, "moves"));
 
-        return fromSfenParts(parts);
+            auto parsed = fromSfenParts(args.subspan(0, count));
+            if (!parsed) {
+                return util::err<std::string>(parsed.takeErr().message());
+            }
+
+            pos = parsed.take();
+            args = args.subspan(count);
+        }
+
+        if (args.empty()) {
+            return util::ok(pos);
+        }
+
+        if (args[0] != "moves") {
+            return util::err<std::string>("Unexpected token '" + std::string{args[0]} + "'");
+        }
+
+        args = args.subspan(1);
+
+        for (usize idx = 0; idx < args.size() && idx < maxMoves; ++idx) {
+            auto parsedMove = Move::fromStr(args[idx]);
+
+            if (!parsedMove) {
+                return util::err<std::string>("Invalid move '" + std::string{args[idx]} + "'");
+            }
+
+            const auto move = parsedMove.take();
+
+            if (!pos.isPseudolegal(move) || !pos.isLegal(move)) {
+                return util::err<std::string>("Illegal move '" + std::string{args[idx]} + "'");
+            }
+
+            onMove(pos, move);
+            pos = pos.applyMove(move);
+        }
+
+        return util::ok(pos);
+    }
+
+    util::Result<Position, std::string> Position::fromPositionCommand(
+        std::span<std::string_view> args,
+        std::vector<u64>& keyHistory
+    ) {
+        keyHistory.clear();
+        return fromPositionCommand(args, [&](const Position& pos, Move) { keyHistory.push_back(pos.key()); });
+    }
+
+    std::optional<Position> Position::unpack(const PackedPosition& packed) {
+        PackReader reader{packed};
+
+        Position pos{};
+
+        pos.m_stm = reader.read(1) ? Colors::kWhite : Colors::kBlack;
+
+        const auto blackKing = reader.read(7);
+        const auto whiteKing = reader.read(7);
+
+        if (blackKing >= Squares::kCount || whiteKing >= Squares::kCount || blackKing == whiteKing) {
+            return {};
+        }
+
+        pos.addPiece(Square::fromRaw(blackKing), Pieces::kBlackKing);
+        pos.addPiece(Square::fromRaw(whiteKing), Pieces::kWhiteKing);
+
+        auto remaining = kPieceTotals;
+
+        for (u8 sqIdx = 0; sqIdx < Squares::kCount; ++sqIdx) {
+            if (sqIdx == blackKing || sqIdx == whiteKing || !reader.read(1)) {
+                continue;
+            }
+
+            const auto idx = reader.readPiece();
+
+            if (remaining[idx] == 0) {
+                return {};
+            }
+
+            --remaining[idx];
+
+            auto type = kHandPieces[idx];
+
+            if (type.canPromote() && reader.read(1)) {
+                type = type.promoted();
+            }
+
+            const auto color = reader.read(1) ? Colors::kWhite : Colors::kBlack;
+
+            pos.addPiece(Square::fromRaw(sqIdx), type.withColor(color));
+        }
+
+        while (std::ranges::any_of(remaining, [](u32 count) { return count > 0; })) {
+            const auto idx = reader.readPiece();
+
+            if (remaining[idx] == 0) {
+                return {};
+            }
+
+            --remaining[idx];
+
+            const auto color = reader.read(1) ? Colors::kWhite : Colors::kBlack;
+            pos.m_hands[color.idx()].increment(kHandPieces[idx]);
+        }
+
+        if (reader.overflowed()) {
+            return {};
+        }
+
+        // packed positions come from files, so anything that cannot occur in a game is rejected
+        for (const auto c : {Colors::kBlack, Colors::kWhite}) {
+            auto pawns = pos.pieceBb(PieceTypes::kPawn, c);
+
+            // nifu
+            while (!pawns.empty()) {
+                if (!(pawns & Bitboard::fromSquare(pawns.popLsb()).fillFile()).empty()) {
+                    return {};
+                }
+            }
+
+            // pieces with no legal moves left
+            const auto lastRank = Bitboards::relativeRank(c, 8);
+            const auto lastTwoRanks = lastRank | Bitboards::relativeRank(c, 7);
+
+            if (!((pos.pieceBb(PieceTypes::kPawn, c) | pos.pieceBb(PieceTypes::kLance, c)) & lastRank).empty()
+                || !(pos.pieceBb(PieceTypes::kKnight, c) & lastTwoRanks).empty())
+            {
+                return {};
+            }
+        }
+
+        // the side that just moved cannot have left its king in check
+        if (pos.isAttacked(pos.king(pos.stm().flip()), pos.stm())) {
+            return {};
+        }
+
+        pos.regenKey();
+        pos.regenEvalTerms();
+        pos.updateAttacks();
+
+        if (pos.isInCheck()) {
+            pos.m_consecutiveChecks[pos.stm().idx()] = 1;
+        }
+
+        return pos;
     }
 
     std::ostream& operator<<(std::ostream& stream, const Position& pos) {
@@ -21,10 +21,14 @@
 #include "types.h"
 
 #include <array>
+#include <functional>
 #include <iostream>
+#include <limits>
+#include <optional>
 #include <span>
 #include <string>
 #include <string_view>
+#include <vector>
 
 #include "bitboard.h"
 #include "move.h"
@@ -44,6 +48,9 @@ namespace stoat {
 
         void set(PieceType pt, u32 count);
 
+        // true if this hand holds at least as many of every piece type as the other
+        [[nodiscard]] bool covers(const Hand& other) const;
+
         [[nodiscard]] std::string sfen(bool uppercase) const;
 
         [[nodiscard]] bool operator==(const Hand&) const = default;
@@ -69,6 +76,15 @@ namespace stoat {
 
     struct PositionKeys {
         u64 all{};
+        // pieces on the board and side to move, excluding hands
+        u64 board{};
+        // unpromoted pawns on the board only
+        u64 pawns{};
+
+        // both hands only
+        [[nodiscard]] inline u64 hands() const {
+            return all ^ board;
+        }
 
         void clear();
 
@@ -83,6 +99,23 @@ namespace stoat {
         [[nodiscard]] bool operator==(const PositionKeys&) const = default;
     };
 
+    // Huffman coded position, see Position::pack()
+    struct PackedPosition {
+        std::array<u8, 32> data{};
+
+        [[nodiscard]] bool operator==(const PackedPosition&) const = default;
+    };
+
+    // declaration rules for entering king (nyugyoku) wins, after the CSA rules: the king and at
+    // least 10 other pieces in the promotion area, no check, and enough points counting 5 for each
+    // rook or bishop (promoted or not) and 1 for everything else, on the board in the promotion
+    // area or in hand. 24 point needs 31, 27 point needs 28 for black and 27 for white
+    enum class EnteringKingRule {
+        kNone = 0,
+        k24Point,
+        k27Point,
+    };
+
     enum class SennichiteStatus {
         kNone = 0,
         kDraw,
@@ -110,18 +143,27 @@ namespace stoat {
 
         [[nodiscard]] inline Bitboard pieceTypeBb(PieceType pt) const {
             assert(pt);
-            return m_pieces[pt.idx()];
+
+            const auto bb = m_pieces[foldedIdx(pt)];
+
+            if (pt.isPromoted()) {
+                return bb & m_promoted;
+            } else if (pt.canPromote()) {
+                return bb & ~m_promoted;
+            }
+
+            return bb;
         }
 
         [[nodiscard]] inline Bitboard pieceBb(Piece piece) const {
             assert(piece);
-            return m_colors[piece.color().idx()] & m_pieces[piece.type().idx()];
+            return m_colors[piece.color().idx()] & pieceTypeBb(piece.type());
         }
 
         [[nodiscard]] inline Bitboard pieceBb(PieceType pt, Color c) const {
             assert(pt);
             assert(c);
-            return m_colors[c.idx()] & m_pieces[pt.idx()];
+            return m_colors[c.idx()] & pieceTypeBb(pt);
         }
 
         [[nodiscard]] inline Piece pieceOn(Square square) const {
@@ -129,6 +171,10 @@ namespace stoat {
             return m_mailbox[square.idx()];
         }
 
+        [[nodiscard]] inline Piece movingPiece(Move move) const {
+            return move.isDrop() ? move.dropPiece().withColor(stm()) : pieceOn(move.from());
+        }
+
         [[nodiscard]] inline const Hand& hand(Color color) const {
             assert(color);
             return m_hands[color.idx()];
@@ -138,6 +184,21 @@ namespace stoat {
             return m_keys.all;
         }
 
+        [[nodiscard]] inline u64 boardKey() const {
+            return m_keys.board;
+        }
+
+        [[nodiscard]] inline u64 pawnKey() const {
+            return m_keys.pawns;
+        }
+
+        [[nodiscard]] inline u64 handKey() const {
+            return m_keys.hands();
+        }
+
+        // key of the position after a (pseudolegal) move, without making it
+        [[nodiscard]] u64 keyAfter(Move move) const;
+
         [[nodiscard]] inline bool isInCheck() const {
             return !m_checkers.empty();
         }
@@ -146,8 +207,35 @@ namespace stoat {
             return m_checkers;
         }
 
+        // the side to move's pieces pinned to its king, computed on first use like threats()
         [[nodiscard]] inline Bitboard pinned() const {
-            return m_pinned;
+            if (!m_pinned.valid()) {
+                m_pinned.squares = calcPinned().raw();
+            }
+
+            return Bitboard{m_pinned.squares};
+        }
+
+        // Squares attacked by the side not to move, with the side to move's king removed so that
+        // squares behind it on a checking ray count as attacked. A king move is legal exactly when
+        // its destination is not in this set. Computed on first use and shared by every caller
+        [[nodiscard]] inline Bitboard threats() const {
+            if (!m_threats.valid()) {
+                m_threats.squares = calcThreats().raw();
+            }
+
+            return Bitboard{m_threats.squares};
+        }
+
+        // The side to move's pieces that are the only piece between one of its own sliders
+        // and the other king, so that moving one off that line gives discovered check.
+        // Computed on first use like threats()
+        [[nodiscard]] inline Bitboard discoveryCandidates() const {
+            if (!m_discoveryCandidates.valid()) {
+                m_discoveryCandidates.squares = calcDiscoveryCandidates().raw();
+            }
+
+            return Bitboard{m_discoveryCandidates.squares};
         }
 
         [[nodiscard]] inline Color stm() const {
@@ -163,17 +251,34 @@ namespace stoat {
             return pieceBb(PieceTypes::kKing, c).lsb();
         }
 
+        // material on the board and in hand, from black's perspective
+        [[nodiscard]] inline Score material() const {
+            return m_material;
+        }
+
+        // number of a side's own pieces adjacent to its king
+        [[nodiscard]] inline u32 kingRingPieces(Color c) const {
+            assert(c);
+            return m_kingRingPieces[c.idx()];
+        }
+
         [[nodiscard]] SennichiteStatus testSennichite(
             bool cuteChessWorkaround,
             std::span<const u64> keyHistory,
             i32 limit = 16
         ) const;
 
+        // whether the side to move wins by declaring entering king under rule
+        [[nodiscard]] bool canDeclareWin(EnteringKingRule rule) const;
+
         [[nodiscard]] bool isPseudolegal(Move move) const;
         [[nodiscard]] bool isLegal(Move move) const;
 
         [[nodiscard]] bool isCapture(Move move) const;
 
+        // whether a pseudolegal move checks the other king, without making it
+        [[nodiscard]] bool givesCheck(Move move) const;
+
         [[nodiscard]] bool isAttacked(Square sq, Color attacker, Bitboard occ) const;
 
         [[nodiscard]] bool isAttacked(Square sq, Color attacker) const {
@@ -184,10 +289,28 @@ namespace stoat {
 
         [[nodiscard]] Bitboard allAttackersTo(Square sq, Bitboard occ) const;
 
+        // allAttackersTo(), split into the pieces whose attacks do not depend
+        // on occupancy and the sliders, whose attacks do
+        [[nodiscard]] Bitboard stepAttackersTo(Square sq) const;
+        [[nodiscard]] Bitboard sliderAttackersTo(Square sq, Bitboard occ) const;
+
         [[nodiscard]] std::string sfen() const;
 
+        // Packs the position into 256 bits, least significant bit of each byte first: the side to
+        // move, both king squares in 7 bits each, then for every other square in index order a 0 if
+        // empty, or a 1 and the piece, and then every piece in hand. Pieces are coded by unpromoted
+        // type (pawn 0, lance 100, knight 101, silver 1100, gold 1101, bishop 1110, rook 1111, in the
+        // order read), followed by a promotion bit on the board for types that can promote, and the
+        // colour. Every non-king piece must be present exactly once, so that the fixed cost of each
+        // piece fits the budget and the decoder knows when the hands end. The move count is not kept.
+        // returns false otherwise
+        [[nodiscard]] bool pack(PackedPosition& dst) const;
+
         void regenKey();
 
+        // whether dropping a pawn on sq, which must give check, is checkmate
+        [[nodiscard]] bool isPawnDropMate(Square sq) const;
+
         [[nodiscard]] bool operator==(const Position&) const = default;
 
         Position& operator=(const Position&) = default;
@@ -198,11 +321,84 @@ namespace stoat {
         [[nodiscard]] static util::Result<Position, SfenError> fromSfenParts(std::span<std::string_view> sfen);
         [[nodiscard]] static util::Result<Position, SfenError> fromSfen(std::string_view sfen);
 
+        // Parses the arguments of a usi position command, "startpos" or "[sfen] <sfen>" optionally
+        // followed by "moves <moves...>". Each move is checked for legality and passed to onMove
+        // with the position it is played in, moves past the first maxMoves are ignored.
+        // returns an error message on failure
+        [[nodiscard]] static util::Result<Position, std::string> fromPositionCommand(
+            std::span<std::string_view> args,
+            const std::function<void(const Position&, Move)>& onMove,
+            usize maxMoves = std::numeric_limits<usize>::max()
+        );
+        // as above, keyHistory gets the key of every position a move is played in
+        [[nodiscard]] static util::Result<Position, std::string> fromPositionCommand(
+            std::span<std::string_view> args,
+            std::vector<u64>& keyHistory
+        );
+
+        // empty if the packed position is malformed or illegal (nifu, a piece that can never
+        // move again, or the side not to move in check). the move count is always 1
+        [[nodiscard]] static std::optional<Position> unpack(const PackedPosition& packed);
+
         friend std::ostream& operator<<(std::ostream& stream, const Position& pos);
 
     private:
+        // Positions are copied for every move made, so promoted pieces share the
+        // bitboard of their unpromoted type and are told apart by m_promoted.
+        // Members are ordered to avoid padding
+        static constexpr usize kFoldedPieceTypes = 8;
+
+        // derived from the rest of the position, so never part of equality. A
+        // bit outside the board marks it as not computed yet, to keep it 16 bytes
+        struct LazyBitboard {
+            static constexpr u128 kInvalid = u128{1} << 127;
+
+            u128 squares{kInvalid};
+
+            [[nodiscard]] constexpr bool valid() const {
+                return squares != kInvalid;
+            }
+
+            [[nodiscard]] constexpr bool operator==(const LazyBitboard&) const {
+                return true;
+            }
+        };
+
+        static constexpr auto kFoldedIndices = [] {
+            std::array<u8, PieceTypes::kCount> indices{};
+            u8 next = 0;
+
+            for (const auto pt : PieceTypes::kAll) {
+                if (!pt.isPromoted()) {
+                    indices[pt.idx()] = next++;
+                }
+            }
+
+            for (const auto pt : PieceTypes::kAll) {
+                if (pt.isPromoted()) {
+                    indices[pt.idx()] = indices[pt.unpromoted().idx()];
+                }
+            }
+
+            assert(next == kFoldedPieceTypes);
+
+            return indices;
+        }();
+
+        [[nodiscard]] static constexpr usize foldedIdx(PieceType pt) {
+            assert(pt);
+            return kFoldedIndices[pt.idx()];
+        }
+
         std::array<Bitboard, Colors::kCount> m_colors{};
-        std::array<Bitboard, PieceTypes::kCount> m_pieces{};
+        std::array<Bitboard, kFoldedPieceTypes> m_pieces{};
+        Bitboard m_promoted{};
+
+        Bitboard m_checkers{};
+
+        mutable LazyBitboard m_pinned{};
+        mutable LazyBitboard m_threats{};
+        mutable LazyBitboard m_discoveryCandidates{};
 
         std::array<Piece, Squares::kCount> m_mailbox{};
 
@@ -212,8 +408,9 @@ namespace stoat {
 
         PositionKeys m_keys{};
 
-        Bitboard m_checkers{};
-        Bitboard m_pinned{};
+        // incrementally updated eval terms, see eval::staticEval
+        Score m_material{};
+        std::array<u8, Colors::kCount> m_kingRingPieces{};
 
         Color m_stm{Colors::kBlack};
 
@@ -224,7 +421,21 @@ namespace stoat {
         void promotePiece(Square from, Square to, Piece piece);
         void dropPiece(Square sq, Piece piece);
 
+        // recomputes the checkers from scratch
         void updateAttacks();
+        // only looks at what a move just made can have changed: a check from the moved or
+        // dropped piece, or one uncovered along the line from the square it left to the king
+        void updateAttacks(Move move);
+
+        [[nodiscard]] Bitboard calcPinned() const;
+        [[nodiscard]] Bitboard calcThreats() const;
+        [[nodiscard]] Bitboard calcDiscoveryCandidates() const;
+
+        void regenEvalTerms();
+
+        // adjusts the king ring count of piece's colour for a non-king
+        // piece leaving from and/or arriving on to (either may be none)
+        void updateKingRing(Color c, Square from, Square to);
 
         void regen();
     };
@@ -54,13 +54,21 @@ namespace stoat::protocol {
     struct SearchInfo {
         i32 depth;
         std::optional<i32> seldepth{};
+        std::optional<u32> multipv{};
         std::optional<f64> timeSec{};
         usize nodes;
         DisplayScore score;
+        ScoreBound bound{ScoreBound::kExact};
         const PvList& pv;
         std::optional<u32> hashfull{};
     };
 
+    enum class MateStatus {
+        kMate = 0,
+        kNoMate,
+        kTimeout,
+    };
+
     enum class CommandResult {
         kContinue = 0,
         kQuit,
@@ -83,7 +91,14 @@ namespace stoat::protocol {
         // engine -> gui
         virtual void printSearchInfo(std::ostream& stream, const SearchInfo& info) const = 0;
         virtual void printInfoString(std::ostream& stream, std::string_view str) const = 0;
-        virtual void printBestMove(std::ostream& stream, Move move) const = 0;
+        // ponderMove may be null
+        virtual void printBestMove(std::ostream& stream, Move move, Move ponderMove) const = 0;
+        // declares an entering king win in place of a best move. returns
+        // false without printing anything if the protocol cannot declare
+        virtual bool printWinDeclaration(std::ostream& stream) const = 0;
+        [[nodiscard]] virtual bool supportsWinDeclaration() const = 0;
+        // line is only used for MateStatus::kMate
+        virtual void printCheckmate(std::ostream& stream, MateStatus status, std::span<const Move> line) const = 0;
     };
 
     constexpr std::string_view kDefaultHandler = "usi";
@@ -0,0 +1,162 @@
+/*
+ * Stoat, a USI shogi engine
+ * Copyright (C) 2025 Ciekce
+ *
+ * Stoat is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Stoat is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Stoat. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "output.h"
+
+#include <array>
+#include <atomic>
+#include <iostream>
+#include <thread>
+
+#include "../arch.h"
+
+namespace stoat::protocol::output {
+    namespace {
+        // single producer, single consumer
+        class OutputQueue {
+        public:
+            OutputQueue() :
+                    m_writer{[this] { runWriter(); }} {}
+
+            ~OutputQueue() {
+                m_quit.store(true);
+                wake();
+
+                m_writer.join();
+            }
+
+            bool tryPush(std::string& output) {
+                const auto tail = m_tail.load(std::memory_order::relaxed);
+
+                if (tail - m_head.load(std::memory_order::acquire) == kCapacity) {
+                    return false;
+                }
+
+                m_slots[tail % kCapacity] = std::move(output);
+                m_tail.store(tail + 1, std::memory_order::release);
+
+                wake();
+
+                return true;
+            }
+
+            void push(std::string& output) {
+                while (!tryPush(output)) {
+                    waitForWrite();
+                }
+            }
+
+            void flush() {
+                while (!waitForWrite()) {}
+            }
+
+            inline void setSuppressed(bool suppressed) {
+                m_suppressed.store(suppressed);
+            }
+
+        private:
+            static constexpr usize kCapacity = 256;
+
+            std::array<std::string, kCapacity> m_slots{};
+
+            // next slot to write, only advanced by the writer
+            alignas(kCacheLineSize) std::atomic<u64> m_head{};
+            // next slot to fill, only advanced by the producer
+            alignas(kCacheLineSize) std::atomic<u64> m_tail{};
+
+            // bumped for every push and on destruction, for the writer to wait on
+            alignas(kCacheLineSize) std::atomic<u32> m_wakeups{};
+            std::atomic_bool m_quit{};
+
+            std::atomic_bool m_suppressed{};
+
+            std::thread m_writer;
+
+            inline void wake() {
+                m_wakeups.fetch_add(1, std::memory_order::release);
+                m_wakeups.notify_one();
+            }
+
+            // returns true if the queue was already empty, otherwise after at least one write
+            bool waitForWrite() {
+                const auto head = m_head.load(std::memory_order::acquire);
+
+                if (head == m_tail.load(std::memory_order::acquire)) {
+                    return true;
+                }
+
+                m_head.wait(head);
+
+                return false;
+            }
+
+            void runWriter() {
+                while (true) {
+                    const auto wakeups = m_wakeups.load(std::memory_order::acquire);
+
+                    auto head = m_head.load(std::memory_order::relaxed);
+                    const auto tail = m_tail.load(std::memory_order::acquire);
+
+                    if (head == tail) {
+                        // only once everything has been written
+                        if (m_quit.load()) {
+                            return;
+                        }
+
+                        m_wakeups.wait(wakeups);
+                        continue;
+                    }
+
+                    for (; head != tail; ++head) {
+                        auto& slot = m_slots[head % kCapacity];
+
+                        if (!m_suppressed.load(std::memory_order::relaxed)) {
+                            std::cout << slot << std::flush;
+                        }
+
+                        slot.clear();
+
+                        m_head.store(head + 1, std::memory_order::release);
+                        m_head.notify_all();
+                    }
+                }
+            }
+        };
+
+        OutputQueue& queue() {
+            static OutputQueue s_queue{};
+            return s_queue;
+        }
+    } // namespace
+
+    bool tryPost(std::string output) {
+        return queue().tryPush(output);
+    }
+
+    void post(std::string output) {
+        queue().push(output);
+    }
+
+    void flush() {
+        queue().flush();
+    }
+
+    void setSuppressed(bool suppressed) {
+        queue().setSuppressed(suppressed);
+    }
+} // namespace stoat::protocol::output
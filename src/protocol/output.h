@@ -0,0 +1,41 @@
+/*
+ * Stoat, a USI shogi engine
+ * Copyright (C) 2025 Ciekce
+ *
+ * Stoat is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Stoat is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Stoat. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "../types.h"
+
+#include <string>
+
+// Output from the search, written to stdout by a writer thread so that a
+// slow gui never stalls the searching thread. Lines are queued without
+// locking, with only one thread posting at a time (the main search thread,
+// or the protocol thread while no search is running)
+namespace stoat::protocol::output {
+    // drops the output if the queue is full, for lines that a later line supersedes
+    bool tryPost(std::string output);
+    // waits for space if the queue is full
+    void post(std::string output);
+
+    // waits until everything posted so far has been written,
+    // direct writes to stdout must be preceded by this
+    void flush();
+
+    // output is still queued and drained, but not written, while suppressed
+    void setSuppressed(bool suppressed);
+} // namespace stoat::protocol::output
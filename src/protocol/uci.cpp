@@ -271,4 +271,12 @@ namespace stoat::protocol {
     std::string_view UciHandler::wincToken() const {
         return "binc";
     }
+
+    bool UciHandler::supportsGoMate() const {
+        return false;
+    }
+
+    bool UciHandler::supportsWinDeclaration() const {
+        return false;
+    }
 } // namespace stoat::protocol
@@ -23,13 +23,35 @@
 #include <iostream>
 #include <sstream>
 
+#include "../attacks/sliders/backend.h"
+#include "../dfpn.h"
+#include "../eval/nnue.h"
 #include "../limit.h"
 #include "../perft.h"
 #include "../ttable.h"
+#include "../tunable.h"
 #include "../util/parse.h"
 #include "common.h"
 
 namespace stoat::protocol {
+    namespace {
+        [[nodiscard]] std::string joinArgs(std::span<std::string_view> args) {
+            std::ostringstream str{};
+
+            bool first = true;
+            for (const auto arg : args) {
+                if (!first) {
+                    str << ' ';
+                } else {
+                    first = false;
+                }
+                str << arg;
+            }
+
+            return str.str();
+        }
+    } // namespace
+
     UciLikeHandler::UciLikeHandler(EngineState& state) :
             m_state{state} {
 #define REGISTER_HANDLER(Command) \
@@ -39,10 +61,13 @@ namespace stoat::protocol {
         REGISTER_HANDLER(position);
         REGISTER_HANDLER(go);
         REGISTER_HANDLER(stop);
+        REGISTER_HANDLER(ponderhit);
         REGISTER_HANDLER(setoption);
 
         REGISTER_HANDLER(d);
         REGISTER_HANDLER(splitperft);
+        REGISTER_HANDLER(savehash);
+        REGISTER_HANDLER(loadhash);
 
 #undef REGISTER_HANDLER
     }
@@ -51,20 +76,87 @@ namespace stoat::protocol {
         std::cout << "id name " << kName << ' ' << kVersion << '\n';
         std::cout << "id author " << kAuthor << '\n';
 
-        // dummy options for OB
         std::cout << "option name ";
         printOptionName(std::cout, "Hash");
         std::cout << " type spin default " << tt::kDefaultTtSizeMib << " min " << tt::kTtSizeRange.min() << " max "
                   << tt::kTtSizeRange.max() << '\n';
 
+        std::cout << "option name ";
+        printOptionName(std::cout, "SharedTT");
+        std::cout << " type string default <empty>\n";
+
+        std::cout << "option name ";
+        printOptionName(std::cout, "MateHash");
+        std::cout << " type spin default " << mate::kDefaultMateTableSizeMib << " min "
+                  << mate::kMateTableSizeRange.min() << " max " << mate::kMateTableSizeRange.max() << '\n';
+
         std::cout << "option name ";
         printOptionName(std::cout, "Threads");
-        std::cout << " type spin default 1 min 1 max 1\n";
+        std::cout << " type spin default " << kDefaultThreadCount << " min " << kThreadCountRange.min() << " max "
+                  << kThreadCountRange.max() << '\n';
+
+        std::cout << "option name ";
+        printOptionName(std::cout, "MultiPV");
+        std::cout << " type spin default " << kDefaultMultiPv << " min " << kMultiPvRange.min() << " max "
+                  << kMultiPvRange.max() << '\n';
+
+        std::cout << "option name ";
+        printOptionName(std::cout, "Ponder");
+        std::cout << " type check default false\n";
+
+        std::cout << "option name ";
+        printOptionName(std::cout, "MoveOverhead");
+        std::cout << " type spin default " << limit::kDefaultMoveOverheadMs << " min "
+                  << limit::kMoveOverheadRange.min() << " max " << limit::kMoveOverheadRange.max() << '\n';
+
+        std::cout << "option name ";
+        printOptionName(std::cout, "NumaBinding");
+        std::cout << " type check default false\n";
+
+        std::cout << "option name ";
+        printOptionName(std::cout, "EvalFile");
+        std::cout << " type string default " << (eval::nnue::hasEmbeddedNetwork() ? "<internal>" : "<empty>") << '\n';
+
+        std::cout << "option name ";
+        printOptionName(std::cout, "BookFile");
+        std::cout << " type string default <empty>\n";
+
+        std::cout << "option name ";
+        printOptionName(std::cout, "ClusterNodes");
+        std::cout << " type string default <empty>\n";
 
         std::cout << "option name ";
         printOptionName(std::cout, "CuteChessWorkaround");
         std::cout << " type check default false\n";
 
+        std::cout << "option name ";
+        printOptionName(std::cout, "FullGameSennichite");
+        std::cout << " type check default false\n";
+
+        std::cout << "option name ";
+        printOptionName(std::cout, "Telemetry");
+        std::cout << " type check default false\n";
+
+        // wins cannot be declared in uci, so they are never aimed for
+        if (supportsWinDeclaration()) {
+            std::cout << "option name ";
+            printOptionName(std::cout, "EnteringKingRule");
+            std::cout << " type combo default 27point var none var 24point var 27point\n";
+        }
+
+        std::cout << "option name ";
+        printOptionName(std::cout, "SliderAttacks");
+        std::cout << " type combo default auto var auto var blackmagic var bmi2 var bmi2compact\n";
+
+#ifdef ST_TUNE
+        for (const auto& param : tunable::params()) {
+            std::cout << "option name ";
+            printOptionName(std::cout, param.name);
+            std::cout << " type spin default " << param.defaultValue << " min " << param.min << " max " << param.max
+                      << '\n';
+        }
+#endif
+
         finishInitialInfo();
     }
 
@@ -92,6 +184,10 @@ namespace stoat::protocol {
             stream << " seldepth " << *info.seldepth;
         }
 
+        if (info.multipv) {
+            stream << " multipv " << *info.multipv;
+        }
+
         if (info.timeSec) {
             const auto ms = static_cast<usize>(*info.timeSec * 1000.0);
             stream << " time " << ms;
@@ -115,6 +211,12 @@ namespace stoat::protocol {
             stream << "cp " << score;
         }
 
+        if (info.bound == ScoreBound::kLowerBound) {
+            stream << " lowerbound";
+        } else if (info.bound == ScoreBound::kUpperBound) {
+            stream << " upperbound";
+        }
+
         if (info.hashfull) {
             stream << " hashfull " << *info.hashfull;
         }
@@ -133,9 +235,45 @@ namespace stoat::protocol {
         stream << "info string " << str << std::endl;
     }
 
-    void UciLikeHandler::printBestMove(std::ostream& stream, Move move) const {
+    void UciLikeHandler::printBestMove(std::ostream& stream, Move move, Move ponderMove) const {
         stream << "bestmove ";
         printMove(stream, move);
+
+        if (ponderMove) {
+            stream << " ponder ";
+            printMove(stream, ponderMove);
+        }
+
+        stream << std::endl;
+    }
+
+    bool UciLikeHandler::printWinDeclaration(std::ostream& stream) const {
+        if (!supportsWinDeclaration()) {
+            return false;
+        }
+
+        stream << "bestmove win" << std::endl;
+        return true;
+    }
+
+    void UciLikeHandler::printCheckmate(std::ostream& stream, MateStatus status, std::span<const Move> line) const {
+        stream << "checkmate";
+
+        switch (status) {
+            case MateStatus::kMate:
+                for (const auto move : line) {
+                    stream << ' ';
+                    printMove(stream, move);
+                }
+                break;
+            case MateStatus::kNoMate:
+                stream << " nomate";
+                break;
+            case MateStatus::kTimeout:
+                stream << " timeout";
+                break;
+        }
+
         stream << std::endl;
     }
 
@@ -203,6 +341,8 @@ namespace stoat::protocol {
             return;
         }
 
+        m_state.keyHistory.reserve(args.size() - next - 1);
+
         for (usize i = next + 1; i < args.size(); ++i) {
             if (auto parsedMove = parseMove(args[i])) {
                 m_state.keyHistory.push_back(m_state.pos.key());
@@ -220,21 +360,32 @@ namespace stoat::protocol {
             return;
         }
 
-        auto limiter = std::make_unique<limit::CompoundLimiter>();
+        if (!args.empty() && args[0] == "mate" && supportsGoMate()) {
+            handleGoMate(args.subspan<1>(), startTime);
+            return;
+        }
 
         bool infinite = false;
+        bool ponder = false;
 
         auto maxDepth = kMaxDepth;
 
+        std::optional<usize> maxNodes{};
+        std::optional<f64> maxTime{};
+
         std::optional<f64> btime{};
         std::optional<f64> wtime{};
 
         std::optional<f64> binc{};
         std::optional<f64> winc{};
 
+        std::optional<f64> byoyomi{};
+
         for (i32 i = 0; i < args.size(); ++i) {
             if (args[i] == "infinite") {
                 infinite = true;
+            } else if (args[i] == "ponder") {
+                ponder = true;
             } else if (args[i] == "depth") {
                 if (++i == args.size()) {
                     std::cerr << "Missing depth" << std::endl;
@@ -251,14 +402,14 @@ namespace stoat::protocol {
                     return;
                 }
 
-                usize maxNodes{};
+                usize nodes{};
 
-                if (!util::tryParse(maxNodes, args[i])) {
+                if (!util::tryParse(nodes, args[i])) {
                     std::cerr << "Invalid node limit '" << args[i] << "'" << std::endl;
                     return;
                 }
 
-                limiter->addLimiter<limit::NodeLimiter>(maxNodes);
+                maxNodes = nodes;
             } else if (args[i] == "movetime") {
                 if (++i == args.size()) {
                     std::cerr << "Missing move time limit" << std::endl;
@@ -273,9 +424,7 @@ namespace stoat::protocol {
                 }
 
                 maxTimeMs = std::max<i64>(maxTimeMs, 1);
-
-                const auto maxTimeSec = static_cast<f64>(maxTimeMs) / 1000.0;
-                limiter->addLimiter<limit::MoveTimeLimiter>(startTime, maxTimeSec);
+                maxTime = static_cast<f64>(maxTimeMs) / 1000.0;
             } else if (args[i] == btimeToken()) {
                 if (++i == args.size()) {
                     std::cerr << "Missing " << btimeToken() << " limit" << std::endl;
@@ -336,25 +485,94 @@ namespace stoat::protocol {
 
                 wincMs = std::max<i64>(wincMs, 0);
                 winc = static_cast<f64>(wincMs) / 1000.0;
+            } else if (args[i] == "byoyomi") {
+                if (++i == args.size()) {
+                    std::cerr << "Missing byoyomi limit" << std::endl;
+                    return;
+                }
+
+                i64 byoyomiMs{};
+
+                if (!util::tryParse(byoyomiMs, args[i])) {
+                    std::cerr << "Invalid byoyomi limit '" << args[i] << "'" << std::endl;
+                    return;
+                }
+
+                byoyomiMs = std::max<i64>(byoyomiMs, 0);
+                byoyomi = static_cast<f64>(byoyomiMs) / 1000.0;
             }
         }
 
         const auto time = m_state.pos.stm() == Colors::kBlack ? btime : wtime;
         const auto inc = m_state.pos.stm() == Colors::kBlack ? binc : winc;
 
-        if (time) {
-            const limit::TimeLimits limits{
-                .remaining = *time,
-                .increment = inc ? *inc : 0,
-            };
+        // byoyomi on its own means the main time has run out
+        const bool timeManaged = time || (byoyomi && *byoyomi > 0);
 
-            limiter->addLimiter<limit::TimeManager>(startTime, limits);
-        } else if (inc) {
+        if (!timeManaged && inc) {
             printInfoString(std::cout, "Warning: increment given but no time, ignoring");
         }
 
+        const limit::TimeLimits limits{
+            .remaining = time ? *time : 0,
+            .increment = inc ? *inc : 0,
+            .byoyomi = byoyomi ? *byoyomi : 0,
+            .moveOverhead = static_cast<f64>(m_moveOverheadMs) / 1000.0,
+        };
+
+        // time limits count from the ponderhit when pondering
+        const auto createLimiter = [=](util::Instant limiterStart) -> std::unique_ptr<limit::ISearchLimiter> {
+            auto limiter = std::make_unique<limit::CompoundLimiter>();
+
+            if (maxNodes) {
+                limiter->addLimiter<limit::NodeLimiter>(*maxNodes);
+            }
+
+            if (maxTime) {
+                limiter->addLimiter<limit::MoveTimeLimiter>(limiterStart, *maxTime);
+            }
+
+            if (timeManaged) {
+                limiter->addLimiter<limit::TimeManager>(limiterStart, limits);
+            }
+
+            return limiter;
+        };
+
+        if (ponder) {
+            m_ponderLimiter = createLimiter;
+        }
+
+        // the search is not limited at all until the ponderhit
+        auto limiter = ponder ? std::make_unique<limit::CompoundLimiter>() : createLimiter(startTime);
+
         m_state.searcher
-            ->startSearch(m_state.pos, m_state.keyHistory, startTime, infinite, maxDepth, std::move(limiter));
+            ->startSearch(m_state.pos, m_state.keyHistory, startTime, infinite, ponder, maxDepth, std::move(limiter));
+    }
+
+    void UciLikeHandler::handleGoMate(std::span<std::string_view> args, util::Instant startTime) {
+        if (args.empty()) {
+            std::cerr << "Missing mate time limit" << std::endl;
+            return;
+        }
+
+        auto limiter = std::make_unique<limit::CompoundLimiter>();
+
+        if (args[0] != "infinite") {
+            i64 maxTimeMs{};
+
+            if (!util::tryParse(maxTimeMs, args[0])) {
+                std::cerr << "Invalid mate time limit '" << args[0] << "'" << std::endl;
+                return;
+            }
+
+            maxTimeMs = std::max<i64>(maxTimeMs, 1);
+
+            const auto maxTimeSec = static_cast<f64>(maxTimeMs) / 1000.0;
+            limiter->addLimiter<limit::MoveTimeLimiter>(startTime, maxTimeSec);
+        }
+
+        m_state.searcher->startMateSearch(m_state.pos, m_state.keyHistory, startTime, std::move(limiter));
     }
 
     void UciLikeHandler::handle_stop(std::span<std::string_view> args, [[maybe_unused]] util::Instant startTime) {
@@ -365,6 +583,15 @@ namespace stoat::protocol {
         }
     }
 
+    void UciLikeHandler::handle_ponderhit([[maybe_unused]] std::span<std::string_view> args, util::Instant startTime) {
+        if (!m_state.searcher->isPondering()) {
+            std::cerr << "Not pondering" << std::endl;
+            return;
+        }
+
+        m_state.searcher->ponderhit(m_ponderLimiter(startTime));
+    }
+
     void UciLikeHandler::handle_setoption(std::span<std::string_view> args, [[maybe_unused]] util::Instant startTime) {
         if (m_state.searcher->isSearching()) {
             std::cerr << "Still searching" << std::endl;
@@ -435,15 +662,149 @@ namespace stoat::protocol {
             } else {
                 std::cerr << "Invalid hash size '" << value << "'" << std::endl;
             }
+        } else if (name == "sharedtt") {
+            if (value == "<empty>") {
+                m_state.searcher->unshareTt();
+            } else if (const auto err = m_state.searcher->shareTt(std::string{value})) {
+                std::cerr << "Failed to share TT: " << *err << std::endl;
+            } else {
+                printInfoString(
+                    std::cout,
+                    "Sharing TT " + std::string{value} + " of " + std::to_string(m_state.searcher->ttSizeMib()) + " MiB"
+                );
+            }
+        } else if (name == "matehash") {
+            if (const auto newMateHash = util::tryParse<usize>(value)) {
+                m_state.searcher->setMateTableSize(mate::kMateTableSizeRange.clamp(*newMateHash));
+            } else {
+                std::cerr << "Invalid mate hash size '" << value << "'" << std::endl;
+            }
         } else if (name == "threads") {
-            //
+            if (const auto newThreads = util::tryParse<u32>(value)) {
+                const auto count = kThreadCountRange.clamp(*newThreads);
+                m_state.searcher->setThreads(count);
+            } else {
+                std::cerr << "Invalid thread count '" << value << "'" << std::endl;
+            }
+        } else if (name == "multipv") {
+            if (const auto newMultiPv = util::tryParse<u32>(value)) {
+                m_state.searcher->setMultiPv(kMultiPvRange.clamp(*newMultiPv));
+            } else {
+                std::cerr << "Invalid multipv '" << value << "'" << std::endl;
+            }
+        } else if (name == "ponder") {
+            // only tells us that the gui may send go ponder, which always works
+            if (!util::tryParseBool(value)) {
+                std::cerr << "Invalid check value '" << value << "'" << std::endl;
+            }
+        } else if (name == "moveoverhead") {
+            if (const auto newMoveOverhead = util::tryParse<u32>(value)) {
+                m_moveOverheadMs = limit::kMoveOverheadRange.clamp(*newMoveOverhead);
+            } else {
+                std::cerr << "Invalid move overhead '" << value << "'" << std::endl;
+            }
+        } else if (name == "numabinding") {
+            if (const auto newNumaBinding = util::tryParseBool(value)) {
+                m_state.searcher->setNumaBinding(*newNumaBinding);
+            } else {
+                std::cerr << "Invalid check value '" << value << "'" << std::endl;
+            }
+        } else if (name == "evalfile") {
+            if (value == "<internal>") {
+                eval::nnue::loadDefaultNetwork();
+            } else if (value == "<empty>") {
+                eval::nnue::unloadNetwork();
+            } else if (const auto err = eval::nnue::loadNetwork(std::string{value})) {
+                std::cerr << "Failed to load network: " << *err << std::endl;
+            } else {
+                printInfoString(std::cout, "Loaded network " + std::string{value});
+            }
+        } else if (name == "bookfile") {
+            if (value == "<empty>") {
+                m_state.searcher->unloadBook();
+            } else if (const auto err = m_state.searcher->loadBook(std::string{value})) {
+                std::cerr << "Failed to load book: " << *err << std::endl;
+            } else {
+                printInfoString(
+                    std::cout,
+                    "Loaded book " + std::string{value} + " with " + std::to_string(m_state.searcher->bookSize())
+                        + " moves"
+                );
+            }
+        } else if (name == "clusternodes") {
+            if (value == "<empty>") {
+                m_state.searcher->clearClusterNodes();
+            } else if (const auto err = m_state.searcher->setClusterNodes(value)) {
+                std::cerr << "Failed to connect to cluster: " << *err << std::endl;
+            } else {
+                printInfoString(
+                    std::cout,
+                    "Connected to " + std::to_string(m_state.searcher->clusterNodeCount()) + " cluster nodes"
+                );
+            }
         } else if (name == "cutechessworkaround") {
             if (const auto newCcWorkaround = util::tryParseBool(value)) {
                 m_state.searcher->setCuteChessWorkaround(*newCcWorkaround);
             } else {
                 std::cerr << "Invalid check value '" << value << "'" << std::endl;
             }
+        } else if (name == "fullgamesennichite") {
+            if (const auto newFullGameSennichite = util::tryParseBool(value)) {
+                m_state.searcher->setFullGameSennichite(*newFullGameSennichite);
+            } else {
+                std::cerr << "Invalid check value '" << value << "'" << std::endl;
+            }
+        } else if (name == "telemetry") {
+            if (const auto newTelemetry = util::tryParseBool(value)) {
+                m_state.searcher->setTelemetry(*newTelemetry);
+            } else {
+                std::cerr << "Invalid check value '" << value << "'" << std::endl;
+            }
+        } else if (name == "enteringkingrule" && supportsWinDeclaration()) {
+            if (value == "none") {
+                m_state.searcher->setEnteringKingRule(EnteringKingRule::kNone);
+            } else if (value == "24point") {
+                m_state.searcher->setEnteringKingRule(EnteringKingRule::k24Point);
+            } else if (value == "27point") {
+                m_state.searcher->setEnteringKingRule(EnteringKingRule::k27Point);
+            } else {
+                std::cerr << "Invalid entering king rule '" << value << "'" << std::endl;
+            }
+        } else if (name == "sliderattacks") {
+            if (value == "auto") {
+                attacks::sliders::setBackend(attacks::sliders::detectBackend());
+            } else if (const auto backend = attacks::sliders::parseBackend(value)) {
+                if (!attacks::sliders::setBackend(*backend)) {
+                    std::cerr << "Slider backend '" << value << "' not supported on this machine" << std::endl;
+                    return;
+                }
+            } else {
+                std::cerr << "Invalid slider backend '" << value << "'" << std::endl;
+                return;
+            }
+
+            printInfoString(
+                std::cout,
+                "Using " + std::string{attacks::sliders::backendName(attacks::sliders::backend())} + " slider attacks"
+            );
         } else {
+#ifdef ST_TUNE
+            if (auto* param = tunable::findParam(name)) {
+                if (!util::tryParse(param->value, value)) {
+                    std::cerr << "Invalid spin value '" << value << "'" << std::endl;
+                    return;
+                }
+
+                param->value = std::clamp(param->value, param->min, param->max);
+
+                if (param->callback) {
+                    param->callback();
+                }
+
+                return;
+            }
+#endif
+
             std::cerr << "Unknown option '" << args[1] << "'" << std::endl;
         }
     }
@@ -489,8 +850,62 @@ namespace stoat::protocol {
             return;
         }
 
-        if (const auto depth = util::tryParse<i32>(args[0])) {
-            splitPerft(m_state.pos, *depth);
+        // splitperft <depth> [threads] [hash mib]
+        const auto depth = util::tryParse<i32>(args[0]);
+
+        if (!depth) {
+            std::cerr << "Invalid depth '" << args[0] << "'" << std::endl;
+            return;
+        }
+
+        u32 threads = 1;
+        usize hashMib = 0;
+
+        if (args.size() > 1 && !util::tryParse(threads, args[1])) {
+            std::cerr << "Invalid thread count '" << args[1] << "'" << std::endl;
+            return;
+        }
+
+        if (args.size() > 2 && !util::tryParse(hashMib, args[2])) {
+            std::cerr << "Invalid hash size '" << args[2] << "'" << std::endl;
+            return;
+        }
+
+        splitPerft(m_state.pos, *depth, kThreadCountRange.clamp(threads), hashMib);
+    }
+
+    void UciLikeHandler::handle_savehash(std::span<std::string_view> args, [[maybe_unused]] util::Instant startTime) {
+        if (m_state.searcher->isSearching()) {
+            std::cerr << "Still searching" << std::endl;
+            return;
+        }
+
+        if (args.empty()) {
+            std::cerr << "Missing path" << std::endl;
+            return;
+        }
+
+        if (const auto error = m_state.searcher->saveTt(joinArgs(args))) {
+            std::cerr << *error << std::endl;
+        }
+    }
+
+    void UciLikeHandler::handle_loadhash(std::span<std::string_view> args, [[maybe_unused]] util::Instant startTime) {
+        if (m_state.searcher->isSearching()) {
+            std::cerr << "Still searching" << std::endl;
+            return;
+        }
+
+        if (args.empty()) {
+            std::cerr << "Missing path" << std::endl;
+            return;
+        }
+
+        if (const auto error = m_state.searcher->loadTt(joinArgs(args))) {
+            std::cerr << *error << std::endl;
+            return;
         }
+
+        printInfoString(std::cout, "Loaded " + std::to_string(m_state.searcher->ttSizeMib()) + " MiB TT");
     }
 } // namespace stoat::protocol
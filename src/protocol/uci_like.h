@@ -25,6 +25,7 @@
 #include <string>
 #include <utility>
 
+#include "../limit.h"
 #include "../util/result.h"
 #include "../util/string_map.h"
 #include "../util/timer.h"
@@ -48,7 +49,9 @@ namespace stoat::protocol {
 
         void printSearchInfo(std::ostream& stream, const SearchInfo& info) const final;
         void printInfoString(std::ostream& stream, std::string_view str) const final;
-        void printBestMove(std::ostream& stream, Move move) const final;
+        void printBestMove(std::ostream& stream, Move move, Move ponderMove) const final;
+        bool printWinDeclaration(std::ostream& stream) const final;
+        void printCheckmate(std::ostream& stream, MateStatus status, std::span<const Move> line) const final;
 
     protected:
         using CommandHandlerType = std::function<void(std::span<std::string_view>, util::Instant)>;
@@ -80,19 +83,31 @@ namespace stoat::protocol {
         [[nodiscard]] virtual std::string_view bincToken() const = 0;
         [[nodiscard]] virtual std::string_view wincToken() const = 0;
 
+        // go mate means a tsume search in usi, but a depth-limited mate search in uci
+        [[nodiscard]] virtual bool supportsGoMate() const = 0;
+
     private:
         util::UnorderedStringMap<CommandHandlerType> m_cmdHandlers{};
 
         EngineState& m_state;
 
+        u32 m_moveOverheadMs{limit::kDefaultMoveOverheadMs};
+
+        // creates the limiter of the current go ponder once the opponent plays the expected move
+        std::function<std::unique_ptr<limit::ISearchLimiter>(util::Instant)> m_ponderLimiter{};
+
         void handle_isready(std::span<std::string_view> args, util::Instant startTime);
         void handle_position(std::span<std::string_view> args, util::Instant startTime);
         void handle_go(std::span<std::string_view> args, util::Instant startTime);
+        void handleGoMate(std::span<std::string_view> args, util::Instant startTime);
         void handle_stop(std::span<std::string_view> args, util::Instant startTime);
+        void handle_ponderhit(std::span<std::string_view> args, util::Instant startTime);
         void handle_setoption(std::span<std::string_view> args, util::Instant startTime);
 
         // nonstandard
         void handle_d(std::span<std::string_view> args, util::Instant startTime);
         void handle_splitperft(std::span<std::string_view> args, util::Instant startTime);
+        void handle_savehash(std::span<std::string_view> args, util::Instant startTime);
+        void handle_loadhash(std::span<std::string_view> args, util::Instant startTime);
     };
 } // namespace stoat::protocol
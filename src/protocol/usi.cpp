@@ -30,6 +30,7 @@ namespace stoat::protocol {
     void UsiHandler::printOptionName(std::ostream& stream, std::string_view name) const {
         static constexpr std::array kFixedSemanticsOptions = {
             "Hash",
+            "Ponder",
         };
 
         if (std::ranges::find(kFixedSemanticsOptions, name) != kFixedSemanticsOptions.end()) {
@@ -107,4 +108,12 @@ namespace stoat::protocol {
     std::string_view UsiHandler::wincToken() const {
         return "winc";
     }
+
+    bool UsiHandler::supportsGoMate() const {
+        return true;
+    }
+
+    bool UsiHandler::supportsWinDeclaration() const {
+        return true;
+    }
 } // namespace stoat::protocol
@@ -49,5 +49,8 @@ namespace stoat::protocol {
 
         [[nodiscard]] std::string_view bincToken() const final;
         [[nodiscard]] std::string_view wincToken() const final;
+
+        [[nodiscard]] bool supportsGoMate() const final;
+        [[nodiscard]] bool supportsWinDeclaration() const final;
     };
 } // namespace stoat::protocol
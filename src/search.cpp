@@ -19,44 +19,70 @@
 #include "search.h"
 
 #include <algorithm>
-#include <cmath>
+#include <array>
+#include <iomanip>
+#include <sstream>
+#include <utility>
 
 #include "eval/eval.h"
+#include "eval/material.h"
+#include "mate.h"
 #include "movepick.h"
 #include "protocol/handler.h"
+#include "protocol/output.h"
 #include "see.h"
+#include "tunable.h"
 #include "util/multi_array.h"
+#include "util/numa.h"
+#include "util/static_vector.h"
 
 namespace stoat {
+    using namespace tunable;
+
     namespace {
-        // [depth][move index]
-        const auto s_lmrTable = [] {
-            constexpr f64 kBase = 0.2;
-            constexpr f64 kDivisor = 3.5;
+        // the limiter is only polled by the main thread every this many nodes
+        constexpr usize kLimiterCheckInterval = 256;
 
-            util::MultiArray<i32, 256, 64> reductions{};
+        // qsearch plies after which only recaptures are searched
+        constexpr i32 kQsearchRecaptureOnlyPly = 6;
 
-            for (i32 depth = 1; depth < 256; ++depth) {
-                for (i32 moveNumber = 1; moveNumber < 64; ++moveNumber) {
-                    const auto lnDepth = std::log(static_cast<f64>(depth));
-                    const auto lnMoveNumber = std::log(static_cast<f64>(moveNumber));
+        [[nodiscard]] Score evaluate(ThreadData& thread, const Position& pos) {
+            // the classical eval is cheaper than a cache probe
+            if (!thread.nnueState.enabled()) {
+                return eval::staticEval(pos);
+            }
 
-                    reductions[depth][moveNumber] = static_cast<i32>(kBase + lnDepth * lnMoveNumber / kDivisor);
-                }
+            if (const auto cached = thread.evalCache.probe(pos.key())) {
+                return *cached;
             }
 
-            return reductions;
-        }();
+            const auto score = eval::staticEval(pos, thread.nnueState);
+            thread.evalCache.put(pos.key(), score);
 
-        void generateLegal(movegen::MoveList& dst, const Position& pos) {
-            movegen::MoveList generated{};
-            movegen::generateAll(generated, pos);
+            return score;
+        }
 
-            for (const auto move : generated) {
-                if (pos.isLegal(move)) {
-                    dst.push(move);
-                }
+        // what pruning decisions are based on, kept clear of win scores
+        [[nodiscard]] Score correctedEval(ThreadData& thread, const Position& pos) {
+            const auto eval = evaluate(thread, pos) + thread.history.correction(pos);
+            return std::clamp(eval, -kScoreWin + 1, kScoreWin - 1);
+        }
+
+        constexpr i32 kMinAspDepth = 4;
+
+        // lazy smp depth skipping for helper threads, from earlier versions of Stockfish
+        constexpr std::array kSkipSize = {1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 4, 4, 4, 4, 4, 4, 4, 4};
+        constexpr std::array kSkipPhase = {0, 1, 0, 1, 2, 3, 0, 1, 2, 3, 4, 5, 0, 1, 2, 3, 4, 5, 6, 7};
+
+        static_assert(kSkipSize.size() == kSkipPhase.size());
+
+        [[nodiscard]] constexpr bool skipDepth(u32 threadId, i32 depth) {
+            if (threadId == 0) {
+                return false;
             }
+
+            const auto idx = (threadId - 1) % kSkipSize.size();
+            return ((depth + kSkipPhase[idx]) / kSkipSize[idx]) % 2 != 0;
         }
 
         [[nodiscard]] constexpr Score drawScore(usize nodes) {
@@ -66,7 +92,10 @@ namespace stoat {
 
     Searcher::Searcher(usize ttSizeMb) :
             m_ttable{ttSizeMb} {
-        setThreads(1);
+        setThreads(kDefaultThreadCount);
+
+        // overlaps the default allocation with the rest of the handshake
+        m_ttable.beginFinalize(ttClearThreads());
     }
 
     Searcher::~Searcher() {
@@ -75,14 +104,24 @@ namespace stoat {
     }
 
     void Searcher::newGame() {
+        const bool keepTt = std::exchange(m_keepTt, false);
+
         // Finalisation (init) clears the TT, so don't clear it twice
-        if (!m_ttable.finalize()) {
-            m_ttable.clear();
+        if (!m_ttable.finalize(ttClearThreads()) && !keepTt) {
+            m_ttable.clear(ttClearThreads());
+        }
+
+        for (auto& thread : m_threads) {
+            thread->history.clear();
+        }
+
+        if (m_cluster) {
+            m_cluster->newGame();
         }
     }
 
     void Searcher::ensureReady() {
-        m_ttable.finalize();
+        m_ttable.finalize(ttClearThreads());
     }
 
     void Searcher::setThreads(u32 threadCount) {
@@ -99,24 +138,71 @@ namespace stoat {
 
         m_threads.clear();
         m_threads.shrink_to_fit();
-        m_threads.reserve(threadCount);
+        m_threads.resize(threadCount);
+
+        m_workers.clear();
+        m_workers.shrink_to_fit();
+        m_workers.reserve(threadCount);
 
+        m_initBarrier.reset(threadCount + 1);
         m_resetBarrier.reset(threadCount + 1);
         m_idleBarrier.reset(threadCount + 1);
 
         m_searchEndBarrier.reset(threadCount);
 
         for (u32 threadId = 0; threadId < threadCount; ++threadId) {
-            auto& thread = m_threads.emplace_back();
+            m_workers.emplace_back([this, threadId] {
+                if (m_numaBinding) {
+                    util::numa::bindThreadToNode(util::numa::nodeForThread(threadId));
+                }
+
+                // allocated by the thread itself, so that it is first touched on the
+                // thread's own numa node. setThreads() waits for all of them below
+                auto& thread = m_threads[threadId];
+
+                thread = std::make_unique<ThreadData>();
+                thread->id = threadId;
+
+                m_initBarrier.arriveAndWait();
 
-            thread.id = threadId;
-            thread.thread = std::thread{[this, &thread] { runThread(thread); }};
+                runThread(*thread);
+            });
         }
+
+        m_initBarrier.arriveAndWait();
     }
 
     void Searcher::setTtSize(usize mib) {
         assert(!isSearching());
+
         m_ttable.resize(mib);
+        // isready, newgame or go wait for it to finish
+        m_ttable.beginFinalize(ttClearThreads());
+    }
+
+    void Searcher::setReportStream(std::ostream& stream) {
+        m_ttable.setReportStream(stream);
+    }
+
+    void Searcher::setNumaBinding(bool enabled) {
+        assert(!isSearching());
+
+        if (m_numaBinding == enabled) {
+            return;
+        }
+
+        m_numaBinding = enabled;
+        m_ttable.setNumaInterleave(enabled);
+
+        // restart the threads to (un)bind them and reallocate their data
+        setThreads(static_cast<u32>(m_threads.size()));
+
+        m_ttable.beginFinalize(ttClearThreads());
+    }
+
+    void Searcher::setMultiPv(u32 multiPv) {
+        assert(!isSearching());
+        m_multiPv = multiPv;
     }
 
     void Searcher::setCuteChessWorkaround(bool enabled) {
@@ -124,11 +210,120 @@ namespace stoat {
         m_cuteChessWorkaround = enabled;
     }
 
+    void Searcher::setFullGameSennichite(bool enabled) {
+        assert(!isSearching());
+        m_fullGameSennichite = enabled;
+    }
+
+    void Searcher::setTelemetry(bool enabled) {
+        assert(!isSearching());
+        m_telemetry = enabled;
+    }
+
+    void Searcher::setEnteringKingRule(EnteringKingRule rule) {
+        assert(!isSearching());
+        m_enteringKingRule = rule;
+    }
+
+    void Searcher::setMateTableSize(usize mib) {
+        assert(!isSearching());
+
+        m_mateTableMib = mib;
+
+        if (m_mateTable) {
+            m_mateTable->resize(mib);
+        }
+    }
+
+    std::optional<std::string> Searcher::saveTt(const std::string& path) {
+        assert(!isSearching());
+
+        m_ttable.finalize(ttClearThreads());
+        return m_ttable.save(path);
+    }
+
+    std::optional<std::string> Searcher::loadTt(const std::string& path) {
+        assert(!isSearching());
+
+        auto error = m_ttable.load(path);
+        m_keepTt = !error;
+
+        return error;
+    }
+
+    std::optional<std::string> Searcher::shareTt(const std::string& name) {
+        assert(!isSearching());
+        return m_ttable.share(name);
+    }
+
+    void Searcher::unshareTt() {
+        assert(!isSearching());
+
+        m_ttable.unshare();
+        m_ttable.beginFinalize(ttClearThreads());
+    }
+
+    std::optional<std::string> Searcher::setClusterNodes(std::string_view nodes) {
+        assert(!isSearching());
+
+        clearClusterNodes();
+
+        auto client = std::make_unique<cluster::Client>([this](std::span<const cluster::SharedEntry> entries) {
+            importEntries(entries);
+        });
+
+        if (auto err = client->connect(nodes)) {
+            return err;
+        }
+
+        m_cluster = std::move(client);
+        m_exportQueue = &m_cluster->queue();
+
+        return {};
+    }
+
+    void Searcher::clearClusterNodes() {
+        assert(!isSearching());
+
+        m_exportQueue = nullptr;
+        m_cluster = nullptr;
+    }
+
+    void Searcher::setEntryExport(cluster::EntryQueue* queue) {
+        assert(!isSearching());
+        m_exportQueue = queue;
+    }
+
+    void Searcher::importEntries(std::span<const cluster::SharedEntry> entries) {
+        // the search mutex is only held while setting up or finishing a search,
+        // and finalReport() waits for cluster results, which arrive on the same thread
+        const std::unique_lock lock{m_searchMutex, std::try_to_lock};
+
+        if (!lock.owns_lock() || !m_searching) {
+            return;
+        }
+
+        for (const auto& entry : entries) {
+            m_ttable.put(entry.key, entry.score, entry.move, entry.depth, 0, entry.flag);
+        }
+    }
+
+    std::optional<std::string> Searcher::loadBook(const std::string& path) {
+        assert(!isSearching());
+        return m_book.load(path);
+    }
+
+    void Searcher::unloadBook() {
+        assert(!isSearching());
+        m_book.unload();
+    }
+
     void Searcher::startSearch(
         const Position& pos,
         std::span<const u64> keyHistory,
         util::Instant startTime,
         bool infinite,
+        bool ponder,
         i32 maxDepth,
         std::unique_ptr<limit::ISearchLimiter> limiter
     ) {
@@ -137,13 +332,34 @@ namespace stoat {
             return;
         }
 
+        // answered without waking the search threads at all
+        if (m_book.loaded() && !infinite && !ponder) {
+            if (const auto bookMove = m_book.probe(pos)) {
+                const auto& handler = protocol::currHandler();
+
+                handler.printInfoString(std::cout, "book move");
+                handler.printBestMove(std::cout, bookMove, kNullMove);
+
+                return;
+            }
+        }
+
+        // nothing to search, the game ends on the spot
+        if (!infinite && !ponder && pos.canDeclareWin(effectiveEnteringKingRule())) {
+            const auto& handler = protocol::currHandler();
+
+            if (handler.printWinDeclaration(std::cout)) {
+                return;
+            }
+        }
+
         m_resetBarrier.arriveAndWait();
 
         const std::unique_lock lock{m_searchMutex};
 
         const auto initStart = util::Instant::now();
 
-        if (m_ttable.finalize()) {
+        if (m_ttable.finalize(ttClearThreads())) {
             const auto initTime = initStart.elapsed();
             const auto ms = static_cast<u32>(initTime * 1000.0);
             protocol::currHandler().printInfoString(
@@ -152,8 +368,13 @@ namespace stoat {
             );
         }
 
+        m_ttable.age();
+
         m_infinite = infinite;
         m_limiter = std::move(limiter);
+        m_silent = false;
+
+        m_searchEnteringKingRule = effectiveEnteringKingRule();
 
         const auto status = initRootMoves(pos);
 
@@ -175,26 +396,101 @@ namespace stoat {
         assert(!m_rootMoves.empty());
 
         for (auto& thread : m_threads) {
-            thread.reset(pos, keyHistory);
-            thread.maxDepth = maxDepth;
+            thread->reset(pos, keyHistory, m_rootMoves);
+            thread->maxDepth = maxDepth;
+        }
+
+        m_startTime = startTime;
+        m_lastReportTime = -kMinReportInterval;
+
+        m_lastIterationEnd = 0.0;
+        m_lastIterationEndNodes = 0;
+        m_lastIterationNodes = 0;
+
+        m_pondering.store(ponder);
+
+        m_stop.store(false);
+        m_runningThreads.store(m_threads.size());
+
+        m_mateSearch = false;
+        m_searching = true;
+
+        if (m_cluster) {
+            m_cluster->startSearch(pos, keyHistory, maxDepth);
+        }
+
+        m_idleBarrier.arriveAndWait();
+    }
+
+    void Searcher::startMateSearch(
+        const Position& pos,
+        std::span<const u64> keyHistory,
+        util::Instant startTime,
+        std::unique_ptr<limit::ISearchLimiter> limiter
+    ) {
+        if (!limiter) {
+            std::cerr << "Missing limiter" << std::endl;
+            return;
+        }
+
+        m_resetBarrier.arriveAndWait();
+
+        const std::unique_lock lock{m_searchMutex};
+
+        if (!m_mateTable) {
+            m_mateTable = std::make_unique<mate::DfpnTable>(m_mateTableMib);
+        } else {
+            m_mateTable->clear();
+        }
+
+        m_mateTable->setShared(m_threads.size() > 1);
+
+        m_infinite = false;
+        m_pondering.store(false);
+        m_limiter = std::move(limiter);
+        m_silent = false;
+
+        for (auto& thread : m_threads) {
+            thread->reset(pos, keyHistory, {});
         }
 
         m_startTime = startTime;
 
+        m_mateResult.store(mate::SolveResult::kUnknown);
+
         m_stop.store(false);
         m_runningThreads.store(m_threads.size());
 
+        m_mateSearch = true;
         m_searching = true;
 
         m_idleBarrier.arriveAndWait();
     }
 
     void Searcher::stop() {
-        m_stop.store(true, std::memory_order::relaxed);
-        if (m_runningThreads.load() > 0) {
-            std::unique_lock lock{m_stopMutex};
-            m_stopSignal.wait(lock, [this] { return m_runningThreads.load() == 0; });
+        {
+            // under the lock so that a main thread in waitForStop() cannot miss it
+            const std::unique_lock lock{m_stopMutex};
+
+            m_stop.store(true, std::memory_order::relaxed);
+            m_pondering.store(false);
+        }
+
+        m_stopSignal.notify_all();
+
+        waitForThreads();
+    }
+
+    void Searcher::ponderhit(std::unique_ptr<limit::ISearchLimiter> limiter) {
+        {
+            const std::unique_lock lock{m_stopMutex};
+
+            // the main thread leaves the limiter alone until it sees that pondering has ended
+            m_limiter = std::move(limiter);
+            m_pondering.store(false);
         }
+
+        m_stopSignal.notify_all();
     }
 
     void Searcher::runBenchSearch(BenchInfo& info, const Position& pos, i32 depth) {
@@ -203,25 +499,98 @@ namespace stoat {
             return;
         }
 
-        m_limiter = std::make_unique<limit::CompoundLimiter>();
-        m_infinite = false;
+        runBlockingSearch(pos, {}, depth, std::make_unique<limit::CompoundLimiter>(), false);
 
-        auto& thread = m_threads[0];
+        // the main thread holds the search mutex until it has finished reporting
+        const std::unique_lock lock{m_searchMutex};
 
-        thread.reset(pos, {});
-        thread.maxDepth = depth;
+        info.time = m_startTime.elapsed();
+        info.nodes = 0;
 
-        m_runningThreads.store(1);
-        m_stop.store(false);
+        for (const auto& thread : m_threads) {
+            info.nodes += thread->loadNodes();
+        }
 
-        m_startTime = util::Instant::now();
+        // the final report may still be queued
+        protocol::output::flush();
+    }
 
-        runSearch(thread);
+    void Searcher::runAnalysisSearch(
+        AnalysisResult& result,
+        const Position& pos,
+        std::span<const u64> keyHistory,
+        i32 maxDepth,
+        std::unique_ptr<limit::ISearchLimiter> limiter
+    ) {
+        result = {};
 
-        info.time = m_startTime.elapsed();
-        info.nodes = thread.loadNodes();
+        if (initRootMoves(pos) == RootStatus::kNoLegalMoves) {
+            result.score = -kScoreMate;
+            return;
+        }
+
+        runBlockingSearch(pos, keyHistory, maxDepth, std::move(limiter), true);
+
+        const std::unique_lock lock{m_searchMutex};
+
+        const auto& bestThread = selectThread();
+
+        result.depth = bestThread.depthCompleted;
+        result.score = bestThread.lastScore;
+        result.pv = bestThread.lastPv;
+
+        result.time = m_startTime.elapsed();
+
+        for (const auto& thread : m_threads) {
+            result.nodes += thread->loadNodes();
+        }
+    }
+
+    void Searcher::runBlockingSearch(
+        const Position& pos,
+        std::span<const u64> keyHistory,
+        i32 maxDepth,
+        std::unique_ptr<limit::ISearchLimiter> limiter,
+        bool silent
+    ) {
+        assert(!m_rootMoves.empty());
+
+        m_resetBarrier.arriveAndWait();
+
+        {
+            const std::unique_lock lock{m_searchMutex};
+
+            m_ttable.age();
+
+            m_limiter = std::move(limiter);
+            m_infinite = false;
+            m_pondering.store(false);
+            m_silent = silent;
+
+            m_searchEnteringKingRule = effectiveEnteringKingRule();
+
+            for (auto& thread : m_threads) {
+                thread->reset(pos, keyHistory, m_rootMoves);
+                thread->maxDepth = maxDepth;
+            }
+
+            m_startTime = util::Instant::now();
+            m_lastReportTime = -kMinReportInterval;
+
+            m_lastIterationEnd = 0.0;
+            m_lastIterationEndNodes = 0;
+            m_lastIterationNodes = 0;
+
+            m_stop.store(false);
+            m_runningThreads.store(m_threads.size());
+
+            m_mateSearch = false;
+            m_searching = true;
+        }
+
+        m_idleBarrier.arriveAndWait();
 
-        m_limiter = nullptr;
+        waitForThreads();
     }
 
     bool Searcher::isSearching() const {
@@ -229,9 +598,14 @@ namespace stoat {
         return m_searching;
     }
 
+    EnteringKingRule Searcher::effectiveEnteringKingRule() const {
+        // a win that cannot be declared is worth nothing, and searching for one would trade real material for it
+        return protocol::currHandler().supportsWinDeclaration() ? m_enteringKingRule : EnteringKingRule::kNone;
+    }
+
     Searcher::RootStatus Searcher::initRootMoves(const Position& pos) {
         m_rootMoves.clear();
-        generateLegal(m_rootMoves, pos);
+        movegen::generateLegal(m_rootMoves, pos);
         return m_rootMoves.empty() ? Searcher::RootStatus::kNoLegalMoves : Searcher::RootStatus::kGenerated;
     }
 
@@ -244,7 +618,11 @@ namespace stoat {
                 return;
             }
 
-            runSearch(thread);
+            if (m_mateSearch) {
+                runMateSearch(thread);
+            } else {
+                runSearch(thread);
+            }
         }
     }
 
@@ -254,11 +632,34 @@ namespace stoat {
         m_resetBarrier.arriveAndWait();
         m_idleBarrier.arriveAndWait();
 
-        for (auto& thread : m_threads) {
-            thread.thread.join();
+        for (auto& worker : m_workers) {
+            worker.join();
+        }
+    }
+
+    void Searcher::finishThread() {
+        if (m_runningThreads.fetch_sub(1) == 1) {
+            m_runningThreads.notify_all();
+        }
+    }
+
+    void Searcher::waitForThreads() const {
+        while (true) {
+            const auto running = m_runningThreads.load();
+
+            if (running == 0) {
+                return;
+            }
+
+            util::spinWait(m_runningThreads, running);
         }
     }
 
+    void Searcher::waitForStop() {
+        std::unique_lock lock{m_stopMutex};
+        m_stopSignal.wait(lock, [this] { return hasStopped() || !m_infinite && !isPondering(); });
+    }
+
     void Searcher::runSearch(ThreadData& thread) {
         assert(!m_rootMoves.empty());
 
@@ -266,57 +667,233 @@ namespace stoat {
 
         thread.lastScore = kScoreNone;
         thread.lastPv.reset();
+        thread.lastLines.clear();
+
+        const auto multiPv = std::min<usize>(m_multiPv, thread.rootMoves.size());
 
         for (i32 depth = 1;; ++depth) {
+            if (skipDepth(thread.id, depth) && depth < thread.maxDepth) {
+                continue;
+            }
+
             thread.rootDepth = depth;
             thread.resetSeldepth();
 
-            const auto score = search<true, true>(thread, thread.rootPos, rootPv, depth, 0, -kScoreInf, kScoreInf);
-
-            if (hasStopped()) {
-                break;
+            for (auto& rootMove : thread.rootMoves) {
+                rootMove.previousScore = rootMove.score;
             }
 
-            thread.depthCompleted = depth;
+            for (thread.pvIdx = 0; thread.pvIdx < multiPv; ++thread.pvIdx) {
+                const auto lineScore = thread.rootMoves[thread.pvIdx].previousScore;
 
-            thread.lastScore = score;
-            thread.lastPv = rootPv;
+                Score delta = initialAspWindow();
 
-            if (depth >= thread.maxDepth) {
-                break;
-            }
+                auto alpha = -kScoreInf;
+                auto beta = kScoreInf;
 
-            if (thread.isMainThread()) {
-                if (m_limiter->stopSoft(thread.loadNodes())) {
-                    break;
+                if (depth >= kMinAspDepth && std::abs(lineScore) < kScoreMaxMate) {
+                    alpha = std::max(lineScore - delta, -kScoreInf);
+                    beta = std::min(lineScore + delta, kScoreInf);
                 }
 
-                report(thread, m_startTime.elapsed());
-            }
-        }
+                while (true) {
+                    const auto score = search<true, true>(thread, thread.rootPos, rootPv, depth, 0, alpha, beta);
 
-        const auto waitForThreads = [&] {
-            --m_runningThreads;
-            m_stopSignal.notify_all();
+                    if (hasStopped()) {
+                        break;
+                    }
 
-            m_searchEndBarrier.arriveAndWait();
-        };
+                    thread.sortRootMoves(thread.pvIdx);
 
-        if (thread.isMainThread()) {
-            const std::unique_lock lock{m_searchMutex};
+                    // bounds are only reported for a single pv
+                    const bool reportBound = thread.isMainThread() && multiPv == 1;
 
-            m_stop.store(true);
-            waitForThreads();
+                    if (score <= alpha) {
+                        // the root pv is not updated on a fail low
+                        if (reportBound) {
+                            report(depth, score, thread.lastPv, ScoreBound::kUpperBound, m_startTime.elapsed());
+                        }
 
-            finalReport(m_startTime.elapsed());
+                        beta = (alpha + beta) / 2;
+                        alpha = std::max(score - delta, -kScoreInf);
+                    } else if (score >= beta) {
+                        if (reportBound) {
+                            report(depth, score, rootPv, ScoreBound::kLowerBound, m_startTime.elapsed());
+                        }
 
-            m_limiter = nullptr;
-            m_searching = false;
+                        beta = std::min(score + delta, kScoreInf);
+                    } else {
+                        break;
+                    }
+
+                    delta += delta / 2;
+                }
+
+                if (hasStopped()) {
+                    break;
+                }
+            }
+
+            if (hasStopped()) {
+                break;
+            }
+
+            // order the lines themselves by score
+            thread.sortRootMoves(0, multiPv);
+
+            thread.depthCompleted = depth;
+
+            thread.lastScore = thread.rootMoves[0].score;
+            thread.lastPv = thread.rootMoves[0].pv;
+
+            if (multiPv > 1) {
+                thread.lastLines.assign(thread.rootMoves.begin(), thread.rootMoves.begin() + multiPv);
+            }
+
+            thread.publishNodes();
+
+            if (thread.isMainThread()) {
+                telemetryReport(depth, m_startTime.elapsed());
+            }
+
+            if (depth >= thread.maxDepth) {
+                break;
+            }
+
+            if (thread.isMainThread()) {
+                if (!isPondering()) {
+                    const auto& bestMove = thread.rootMoves[0];
+
+                    m_limiter->update({
+                        .depth = depth,
+                        .bestMove = bestMove.move,
+                        .score = bestMove.score,
+                        .bestMoveNodeFraction = static_cast<f64>(bestMove.nodes) / static_cast<f64>(thread.nodes),
+                    });
+
+                    if (m_limiter->stopSoft(thread.nodes)) {
+                        break;
+                    }
+                }
+
+                report(thread, m_startTime.elapsed());
+            }
+        }
+
+        thread.publishNodes();
+        flushExports(thread);
+
+        if (thread.isMainThread() && !hasStopped()) {
+            waitForStop();
+        }
+
+        const auto waitForThreads = [&] {
+            finishThread();
+            m_searchEndBarrier.arriveAndWait();
+        };
+
+        if (thread.isMainThread()) {
+            const std::unique_lock lock{m_searchMutex};
+
+            m_stop.store(true);
+            waitForThreads();
+
+            finalReport(m_startTime.elapsed());
+
+            m_limiter = nullptr;
+            m_searching = false;
+        } else {
+            waitForThreads();
+        }
+    }
+
+    void Searcher::runMateSearch(ThreadData& thread) {
+        mate::DfpnSolver solver{*m_mateTable, thread.id, [&](usize nodes) {
+            thread.nodes = nodes;
+            thread.publishNodes();
+
+            if (thread.isMainThread() && m_limiter->stopHard(nodes)) {
+                m_stop.store(true, std::memory_order::relaxed);
+            }
+
+            return hasStopped();
+        }};
+
+        const auto result = solver.solve(thread.rootPos, thread.keyHistory.keys());
+
+        thread.nodes = solver.nodes();
+        thread.publishNodes();
+
+        // the first thread to solve the root stops the others
+        if (result != mate::SolveResult::kUnknown) {
+            auto expected = mate::SolveResult::kUnknown;
+            m_mateResult.compare_exchange_strong(expected, result);
+
+            m_stop.store(true);
+        }
+
+        const auto waitForThreads = [&] {
+            finishThread();
+            m_searchEndBarrier.arriveAndWait();
+        };
+
+        if (thread.isMainThread()) {
+            const std::unique_lock lock{m_searchMutex};
+
+            m_stop.store(true);
+            waitForThreads();
+
+            mateReport(thread.rootPos, thread.keyHistory.keys(), m_mateResult.load(), m_startTime.elapsed());
+
+            m_limiter = nullptr;
+            m_searching = false;
         } else {
             waitForThreads();
         }
     }
 
+    void Searcher::exportEntry(ThreadData& thread, u64 key, Score score, Move move, i32 depth, tt::Flag flag) {
+        thread.sharedEntries.push_back({
+            .key = key,
+            .score = score,
+            .move = move,
+            .depth = depth,
+            .flag = flag,
+        });
+
+        if (thread.sharedEntries.size() >= cluster::kBatchSize) {
+            flushExports(thread);
+        }
+    }
+
+    void Searcher::flushExports(ThreadData& thread) {
+        if (m_exportQueue && !thread.sharedEntries.empty()) {
+            m_exportQueue->push(thread.sharedEntries);
+        }
+
+        thread.sharedEntries.clear();
+    }
+
+    SennichiteStatus Searcher::testSennichite(const ThreadData& thread, const Position& pos) const {
+        // the common case, nothing to scan
+        if (!thread.keyHistory.mayContain(pos.key())) {
+            return SennichiteStatus::kNone;
+        }
+
+        const auto keys = thread.keyHistory.keys();
+
+        if (m_fullGameSennichite) {
+            return pos.testSennichite(m_cuteChessWorkaround, keys, static_cast<i32>(keys.size()));
+        }
+
+        return pos.testSennichite(m_cuteChessWorkaround, keys, kSennichiteLimit);
+    }
+
+    bool Searcher::isHandDominated(const ThreadData& thread, const Position& pos) const {
+        const auto limit = m_fullGameSennichite ? static_cast<i32>(thread.keyHistory.size()) : kSennichiteLimit;
+        return thread.keyHistory.isHandDominated(pos, limit);
+    }
+
     template <bool kPvNode, bool kRootNode>
     Score Searcher::search(
         ThreadData& thread,
@@ -334,8 +911,10 @@ namespace stoat {
 
         assert(kPvNode || alpha == beta - 1);
 
-        if (!kRootNode && thread.isMainThread() && thread.rootDepth > 1) {
-            if (m_limiter->stopHard(thread.loadNodes())) {
+        if (!kRootNode && thread.isMainThread() && thread.rootDepth > 1
+            && thread.nodes % kLimiterCheckInterval == 0 && !isPondering())
+        {
+            if (m_limiter->stopHard(thread.nodes)) {
                 m_stop.store(true, std::memory_order::relaxed);
                 return 0;
             }
@@ -346,96 +925,262 @@ namespace stoat {
         }
 
         thread.incNodes();
+        thread.counters.inc(stats::Counter::kNodes);
 
         if constexpr (kPvNode) {
             thread.updateSeldepth(ply + 1);
         }
 
         if (ply >= kMaxDepth) {
-            return pos.isInCheck() ? 0 : eval::staticEval(pos);
+            return pos.isInCheck() ? 0 : evaluate(thread, pos);
+        }
+
+        // entering king, the side to move wins by declaring. better than any mate
+        if (!kRootNode && pos.canDeclareWin(m_searchEnteringKingRule)) {
+            return kScoreMate - ply;
         }
 
         auto& curr = thread.stack[ply];
+        // only written by pv nodes
+        auto& childPv = thread.pvs[ply];
         const auto* parent = kRootNode ? nullptr : &thread.stack[ply - 1];
 
+        thread.stack[ply + 1].killers.fill(kNullMove);
+
+        const auto excluded = curr.excluded;
+        auto& moves = thread.moveList(ply, !excluded.isNull());
+
         tt::ProbedEntry ttEntry{};
         const bool ttHit = m_ttable.probe(ttEntry, pos.key(), ply);
 
-        if (!kPvNode && ttEntry.depth >= depth
+        thread.counters.inc(stats::Counter::kTtProbes);
+        if (ttHit) {
+            thread.counters.inc(stats::Counter::kTtHits);
+        }
+
+        if (!kPvNode && !excluded && ttEntry.depth >= depth
             && (ttEntry.flag == tt::Flag::kExact                                   //
                 || ttEntry.flag == tt::Flag::kUpperBound && ttEntry.score <= alpha //
                 || ttEntry.flag == tt::Flag::kLowerBound && ttEntry.score >= beta))
         {
+            thread.counters.inc(stats::Counter::kTtCutoffs);
             return ttEntry.score;
         }
 
+        // the check generation is too expensive to repeat at every interior node, and pv
+        // and deep nodes find short mates through the normal search anyway
+        if (!kPvNode && !excluded && depth <= mate1MaxDepth() && !pos.isInCheck()) {
+            if (const auto mateMove = mate::findMateIn1(pos)) {
+                const auto score = kScoreMate - ply - 1;
+                m_ttable.put(pos.key(), score, mateMove, depth, ply, tt::Flag::kExact);
+                return score;
+            }
+        }
+
         if (depth >= 3 && !ttEntry.move) {
             --depth;
         }
 
-        const auto staticEval = eval::staticEval(pos);
+        const auto staticEval = correctedEval(thread, pos);
 
-        if (!kPvNode && !pos.isInCheck()) {
-            if (depth <= 4 && staticEval - 120 * depth >= beta) {
+        if (!kPvNode && !excluded && !pos.isInCheck()) {
+            if (depth <= rfpMaxDepth() && staticEval - rfpMargin() * depth >= beta) {
                 return staticEval;
             }
 
-            if (depth >= 4 && staticEval >= beta && !parent->move.isNull()) {
-                static constexpr i32 kR = 3;
+            if (depth >= nmpMinDepth() && staticEval >= beta && !parent->move.isNull()) {
+                thread.counters.inc(stats::Counter::kNullMoveSearches);
 
                 const auto [newPos, guard] = thread.applyNullMove(ply, pos);
-                const auto score = -search(thread, newPos, curr.pv, depth - kR, ply + 1, -beta, -beta + 1);
+                const auto score = -search(thread, newPos, childPv, depth - nmpReduction(), ply + 1, -beta, -beta + 1);
 
                 if (score >= beta) {
+                    thread.counters.inc(stats::Counter::kNullMoveCutoffs);
                     return score > kScoreWin ? beta : score;
                 }
             }
         }
 
+        // probcut - a capture that beats beta by a margin in a reduced search almost certainly beats beta
+        // in a full one. skipped if the tt already says that the capture search would come up short
+        const auto probcutBeta = beta + probcutMargin();
+
+        if (!kPvNode && !excluded && !pos.isInCheck() && depth >= probcutMinDepth() && std::abs(beta) < kScoreWin
+            && !(ttEntry.depth >= depth - probcutReduction() + 1 && ttEntry.score < probcutBeta))
+        {
+            const auto probcutDepth = depth - probcutReduction();
+
+            thread.counters.inc(stats::Counter::kProbcutSearches);
+
+            auto generator = MoveGenerator::qsearch(
+                moves,
+                pos,
+                pos.isCapture(ttEntry.move) ? ttEntry.move : kNullMove,
+                false
+            );
+
+            while (const auto move = generator.next()) {
+                assert(pos.isPseudolegal(move));
+                assert(pos.isLegal(move));
+
+                // captures that cannot win enough material to make up the gap are not worth a search
+                if (!generator.see(move, probcutBeta - staticEval)) {
+                    continue;
+                }
+
+                m_ttable.prefetch(pos.keyAfter(move));
+
+                const auto [newPos, guard] = thread.applyMove(ply, pos, move);
+
+                if (testSennichite(thread, newPos) != SennichiteStatus::kNone) {
+                    continue;
+                }
+
+                // verified with a qsearch first, which is much cheaper and usually fails already
+                auto score = -qsearch(thread, newPos, ply + 1, -probcutBeta, -probcutBeta + 1);
+
+                if (score >= probcutBeta) {
+                    score = -search(thread, newPos, childPv, probcutDepth, ply + 1, -probcutBeta, -probcutBeta + 1);
+                }
+
+                if (hasStopped()) {
+                    return 0;
+                }
+
+                if (score >= probcutBeta) {
+                    thread.counters.inc(stats::Counter::kProbcutCutoffs);
+
+                    m_ttable.put(pos.key(), score, move, probcutDepth + 1, ply, tt::Flag::kLowerBound);
+                    return score;
+                }
+            }
+        }
+
         auto bestMove = kNullMove;
         auto bestScore = -kScoreInf;
 
         auto ttFlag = tt::Flag::kUpperBound;
 
-        auto generator = MoveGenerator::main(pos, ttEntry.move);
+        const std::array continuations = {
+            ply >= 1 ? thread.stack[ply - 1].contHist : nullptr,
+            ply >= 2 ? thread.stack[ply - 2].contHist : nullptr,
+        };
+
+        const auto countermove = !kRootNode && !parent->move.isNull()
+                                   ? thread.history.countermove(parent->moving, parent->move.to())
+                                   : kNullMove;
+
+        auto generator =
+            MoveGenerator::main(moves, pos, ttEntry.move, thread.history, continuations, curr.killers, countermove);
+
+        util::StaticVector<Move, 64> nonCapturesTried{};
 
         u32 legalMoves{};
 
-        while (const auto move = generator.next()) {
-            assert(pos.isPseudolegal(move));
+        // the root searches its moves in the order of the last iteration instead,
+        // skipping the moves that are already the best move of earlier pv lines
+        usize rootMoveIdx = kRootNode ? thread.pvIdx : 0;
 
+        const auto nextMove = [&] {
             if constexpr (kRootNode) {
-                if (!isLegalRootMove(move)) {
-                    continue;
-                }
-                assert(pos.isLegal(move));
-            } else if (!pos.isLegal(move)) {
+                return rootMoveIdx < thread.rootMoves.size() ? thread.rootMoves[rootMoveIdx++].move : kNullMove;
+            } else {
+                return generator.next();
+            }
+        };
+
+        while (const auto move = nextMove()) {
+            assert(pos.isPseudolegal(move));
+            assert(pos.isLegal(move));
+
+            if (move == excluded) {
                 continue;
             }
 
-            const auto baseLmr = s_lmrTable[depth][std::min<u32>(legalMoves, 63)];
+            const auto baseLmr = g_lmrTable[depth][std::min<u32>(legalMoves, 63)];
+
+            const bool nonCapture = !pos.isCapture(move);
+            const bool givesCheck = pos.givesCheck(move);
+
+            const auto history =
+                nonCapture ? thread.history.nonCaptureScore(continuations, pos.stm(), pos.movingPiece(move), move) : 0;
 
             if (!kRootNode && bestScore > -kScoreWin) {
-                const auto seeThreshold = pos.isCapture(move) ? -100 * depth * depth : -20 * depth * depth;
-                if (!see::see(pos, move, seeThreshold)) {
+                // late move pruning - with drops there are often over a hundred
+                // quiet moves, and past the first few the rest rarely matter
+                if (nonCapture && !givesCheck && !pos.isInCheck() && depth <= lmpMaxDepth()
+                    && legalMoves >= lmpBase() + depth * depth)
+                {
+                    continue;
+                }
+
+                // history pruning - checks and evasions are left alone, as with lmp
+                if (nonCapture && !givesCheck && !pos.isInCheck() && depth <= historyPruningMaxDepth()
+                    && history < -historyPruningMargin() * depth)
+                {
                     continue;
                 }
 
-                if (!pos.isCapture(move) && !pos.isInCheck() && alpha < 2000 && depth <= 4
-                    && staticEval + 150 + 100 * depth <= alpha)
+                const auto seeThreshold = pos.isCapture(move) ? -seeCaptureMargin() * depth * depth
+                                                        : -seeNonCaptureMargin() * depth * depth;
+                if (!generator.see(move, seeThreshold)) {
+                    continue;
+                }
+
+                if (!pos.isCapture(move) && !pos.isInCheck() && alpha < 2000 && depth <= fpMaxDepth()
+                    && staticEval + fpBase() + fpScale() * depth <= alpha)
                 {
                     continue;
                 }
             }
 
+            i32 extension{};
+
+            // singular extensions - if no other move comes close to the tt move's score in a reduced
+            // search without it, the tt move is forced and worth searching deeper. if other moves
+            // beat beta even without it, this node very likely fails high whatever the tt move does
+            if (!kRootNode && !excluded && move == ttEntry.move && depth >= seMinDepth() && ply < thread.rootDepth * 2
+                && ttEntry.depth >= depth - 3 && ttEntry.flag != tt::Flag::kUpperBound
+                && std::abs(ttEntry.score) < kScoreWin)
+            {
+                const auto singularBeta = ttEntry.score - depth * seBetaScale();
+                const auto singularDepth = (depth - 1) / 2;
+
+                thread.counters.inc(stats::Counter::kSingularSearches);
+
+                curr.excluded = move;
+                const auto score = search(thread, pos, childPv, singularDepth, ply, singularBeta - 1, singularBeta);
+                curr.excluded = kNullMove;
+
+                if (hasStopped()) {
+                    return 0;
+                }
+
+                if (score < singularBeta) {
+                    thread.counters.inc(stats::Counter::kSingularExtensions);
+                    extension = 1;
+                } else if (singularBeta >= beta) {
+                    // multicut
+                    return singularBeta;
+                } else if (ttEntry.score >= beta) {
+                    // the tt move is expected to fail high, but so would others
+                    extension = -1;
+                }
+            }
+
             if constexpr (kPvNode) {
-                curr.pv.length = 0;
+                childPv.length = 0;
             }
 
             ++legalMoves;
 
+            const auto nodesBefore = thread.nodes;
+
+            // start loading the child's tt entry while the move is made
+            m_ttable.prefetch(pos.keyAfter(move));
+
             const auto [newPos, guard] = thread.applyMove(ply, pos, move);
-            const auto sennichite = newPos.testSennichite(m_cuteChessWorkaround, thread.keyHistory);
+            const auto sennichite = testSennichite(thread, newPos);
 
             Score score;
 
@@ -444,28 +1189,42 @@ namespace stoat {
                 --legalMoves;
                 continue;
             } else if (sennichite == SennichiteStatus::kDraw) {
-                score = drawScore(thread.loadNodes());
+                score = drawScore(thread.nodes);
+            } else if (isHandDominated(thread, newPos)) {
+                // the same board with one side strictly better off in hand, searching
+                // further would only repeat the cycle. the eval sees the hand difference
+                score = -evaluate(thread, newPos);
             } else {
-                const auto newDepth = depth - 1;
+                const auto newDepth = depth - 1 + extension;
+
+                const bool reducible =
+                    kRootNode ? !pos.isCapture(move) : generator.stage() >= MovegenStage::NonCaptures;
 
-                if (depth >= 2 && legalMoves >= 5 + 2 * kRootNode && generator.stage() >= MovegenStage::NonCaptures) {
+                if (depth >= 2 && legalMoves >= 5 + 2 * kRootNode && reducible) {
                     auto r = baseLmr;
 
                     r -= kPvNode;
                     r += !pos.isInCheck();
+                    r -= givesCheck;
+
+                    // quiets with good history are reduced less, and with bad history more
+                    r -= history / lmrHistoryDivisor();
 
                     const auto reduced = std::min(std::max(newDepth - r, 1), newDepth - 1);
-                    score = -search(thread, newPos, curr.pv, reduced, ply + 1, -alpha - 1, -alpha);
+                    score = -search(thread, newPos, childPv, reduced, ply + 1, -alpha - 1, -alpha);
+
+                    thread.counters.inc(stats::Counter::kReducedSearches);
 
                     if (score > alpha && reduced < newDepth) {
-                        score = -search(thread, newPos, curr.pv, newDepth, ply + 1, -alpha - 1, -alpha);
+                        thread.counters.inc(stats::Counter::kLmrResearches);
+                        score = -search(thread, newPos, childPv, newDepth, ply + 1, -alpha - 1, -alpha);
                     }
                 } else if (!kPvNode || legalMoves > 1) {
-                    score = -search(thread, newPos, curr.pv, newDepth, ply + 1, -alpha - 1, -alpha);
+                    score = -search(thread, newPos, childPv, newDepth, ply + 1, -alpha - 1, -alpha);
                 }
 
                 if (kPvNode && (legalMoves == 1 || score > alpha)) {
-                    score = -search<true>(thread, newPos, curr.pv, newDepth, ply + 1, -beta, -alpha);
+                    score = -search<true>(thread, newPos, childPv, newDepth, ply + 1, -beta, -alpha);
                 }
             }
 
@@ -473,6 +1232,20 @@ namespace stoat {
                 return 0;
             }
 
+            if constexpr (kRootNode) {
+                auto& rootMove = thread.rootMoves[rootMoveIdx - 1];
+                assert(rootMove.move == move);
+
+                rootMove.nodes += thread.nodes - nodesBefore;
+
+                if (legalMoves == 1 || score > alpha) {
+                    rootMove.score = score;
+                    rootMove.pv.update(move, childPv);
+                } else {
+                    rootMove.score = -kScoreInf;
+                }
+            }
+
             if (score > bestScore) {
                 bestScore = score;
             }
@@ -482,8 +1255,8 @@ namespace stoat {
                 bestMove = move;
 
                 if constexpr (kPvNode) {
-                    assert(curr.pv.length + 1 <= kMaxDepth);
-                    pv.update(move, curr.pv);
+                    assert(childPv.length + 1 <= kMaxDepth);
+                    pv.update(move, childPv);
                 }
 
                 ttFlag = tt::Flag::kExact;
@@ -491,80 +1264,236 @@ namespace stoat {
 
             if (score >= beta) {
                 ttFlag = tt::Flag::kLowerBound;
+
+                thread.counters.inc(stats::Counter::kFailHighs);
+                if (legalMoves == 1) {
+                    thread.counters.inc(stats::Counter::kFirstMoveFailHighs);
+                }
+
+                if (!pos.isCapture(move)) {
+                    const auto bonus = historyBonus(depth);
+
+                    thread.history.updateNonCaptureScore(continuations, pos.stm(), pos.movingPiece(move), move, bonus);
+
+                    for (const auto prevNonCapture : nonCapturesTried) {
+                        thread.history.updateNonCaptureScore(
+                            continuations,
+                            pos.stm(),
+                            pos.movingPiece(prevNonCapture),
+                            prevNonCapture,
+                            -bonus
+                        );
+                    }
+
+                    if (curr.killers[0] != move) {
+                        curr.killers[1] = curr.killers[0];
+                        curr.killers[0] = move;
+                    }
+
+                    if (!kRootNode && !parent->move.isNull()) {
+                        thread.history.setCountermove(parent->moving, parent->move.to(), move);
+                    }
+                }
+
                 break;
             }
+
+            if (!pos.isCapture(move) && nonCapturesTried.size() < nonCapturesTried.capacity()) {
+                nonCapturesTried.push(move);
+            }
+        }
+
+        // the excluded move was the only one
+        if (legalMoves == 0 && excluded) {
+            return alpha;
         }
 
+        // can happen at the root if every move left for this pv line is an illegal perpetual
         if (legalMoves == 0) {
-            assert(!kRootNode);
             return -kScoreMate + ply;
         }
 
+        // the result of a search without one of the moves is not a result for the position
+        if (excluded) {
+            return bestScore;
+        }
+
+        // only scores that say something about the eval, i.e. not bounds on the wrong side of it
+        if (!pos.isInCheck() && (!bestMove || !pos.isCapture(bestMove)) && std::abs(bestScore) < kScoreWin
+            && !(ttFlag == tt::Flag::kLowerBound && bestScore <= staticEval)
+            && !(ttFlag == tt::Flag::kUpperBound && bestScore >= staticEval))
+        {
+            thread.history.updateCorrection(pos, depth, bestScore, staticEval);
+        }
+
         m_ttable.put(pos.key(), bestScore, bestMove, depth, ply, ttFlag);
 
+        if (m_exportQueue && depth >= cluster::kShareDepth && std::abs(bestScore) < kScoreWin) {
+            exportEntry(thread, pos.key(), bestScore, bestMove, depth, ttFlag);
+        }
+
         return bestScore;
     }
 
     template <bool kPvNode>
-    Score Searcher::qsearch(ThreadData& thread, const Position& pos, i32 ply, Score alpha, Score beta) {
+    Score Searcher::qsearch(ThreadData& thread, const Position& pos, i32 ply, Score alpha, Score beta, i32 qsPly) {
         assert(ply >= 0 && ply <= kMaxDepth);
 
-        if (thread.isMainThread() && thread.rootDepth > 1) {
-            if (m_limiter->stopHard(thread.loadNodes())) {
+        if (thread.isMainThread() && thread.rootDepth > 1 && thread.nodes % kLimiterCheckInterval == 0
+            && !isPondering())
+        {
+            if (m_limiter->stopHard(thread.nodes)) {
                 m_stop.store(true, std::memory_order::relaxed);
                 return 0;
             }
         }
 
         thread.incNodes();
+        thread.counters.inc(stats::Counter::kNodes);
+        thread.counters.inc(stats::Counter::kQsearchNodes);
 
         if constexpr (kPvNode) {
             thread.updateSeldepth(ply + 1);
         }
 
         if (ply >= kMaxDepth) {
-            return pos.isInCheck() ? 0 : eval::staticEval(pos);
+            return pos.isInCheck() ? 0 : evaluate(thread, pos);
         }
 
-        const auto staticEval = eval::staticEval(pos);
+        if (pos.canDeclareWin(m_searchEnteringKingRule)) {
+            return kScoreMate - ply;
+        }
+
+        tt::ProbedEntry ttEntry{};
 
-        if (staticEval >= beta) {
-            return staticEval;
+        thread.counters.inc(stats::Counter::kTtProbes);
+        if (m_ttable.probe(ttEntry, pos.key(), ply)) {
+            thread.counters.inc(stats::Counter::kTtHits);
+        }
+
+        // any entry was searched at least as deep as qsearch
+        if (!kPvNode
+            && (ttEntry.flag == tt::Flag::kExact                                   //
+                || ttEntry.flag == tt::Flag::kUpperBound && ttEntry.score <= alpha //
+                || ttEntry.flag == tt::Flag::kLowerBound && ttEntry.score >= beta))
+        {
+            thread.counters.inc(stats::Counter::kTtCutoffs);
+            return ttEntry.score;
         }
 
-        if (staticEval > alpha) {
-            alpha = staticEval;
+        auto bestScore = -kScoreInf;
+        auto staticEval = kScoreNone;
+
+        // no standing pat in check, every evasion is searched instead
+        if (!pos.isInCheck()) {
+            // lazy eval - a network eval is expensive, and far enough outside
+            // the window material alone decides whether to stand pat
+            if (thread.nnueState.enabled()) {
+                const auto material = pos.stm() == Colors::kBlack ? pos.material() : -pos.material();
+
+                if (material - lazyEvalMargin() >= beta) {
+                    return material - lazyEvalMargin();
+                }
+
+                if (material + lazyEvalMargin() <= alpha) {
+                    return material + lazyEvalMargin();
+                }
+            }
+
+            staticEval = correctedEval(thread, pos);
+
+            if (staticEval >= beta) {
+                return staticEval;
+            }
+
+            if (staticEval > alpha) {
+                alpha = staticEval;
+            }
+
+            bestScore = staticEval;
         }
 
-        auto bestScore = staticEval;
+        auto bestMove = kNullMove;
+
+        auto ttFlag = tt::Flag::kUpperBound;
+
+        const std::array continuations = {
+            ply >= 1 ? thread.stack[ply - 1].contHist : nullptr,
+            ply >= 2 ? thread.stack[ply - 2].contHist : nullptr,
+        };
+
+        constexpr std::array kNoKillers = {kNullMove, kNullMove};
+
+        auto& moves = thread.moveList(ply, false);
+
+        auto generator = [&] {
+            if (pos.isInCheck()) {
+                return MoveGenerator::main(
+                    moves,
+                    pos,
+                    ttEntry.move,
+                    thread.history,
+                    continuations,
+                    kNoKillers,
+                    kNullMove
+                );
+            }
+
+            // bound long exchanges by only resolving the last capture this deep
+            if (qsPly >= kQsearchRecaptureOnlyPly) {
+                assert(ply >= 1);
+                return MoveGenerator::qsearchRecaptures(moves, pos, thread.stack[ply - 1].move.to());
+            }
 
-        auto generator = MoveGenerator::qsearch(pos);
+            return MoveGenerator::qsearch(moves, pos, ttEntry.move, qsPly == 0);
+        }();
+
+        u32 legalMoves{};
 
         while (const auto move = generator.next()) {
             assert(pos.isPseudolegal(move));
+            assert(pos.isLegal(move));
 
-            if (!pos.isLegal(move)) {
-                continue;
-            }
+            ++legalMoves;
 
             if (bestScore > -kScoreWin) {
-                if (!see::see(pos, move, -100)) {
+                // delta pruning - even winning the captured piece and a promotion for free would not get near alpha
+                if (!pos.isInCheck() && pos.isCapture(move)) {
+                    const auto captured = pos.pieceOn(move.to()).type();
+                    auto gain = eval::pieceValue(captured) + eval::pieceValue(captured.unpromoted());
+
+                    if (move.isPromo()) {
+                        const auto moving = pos.pieceOn(move.from()).type();
+                        gain += eval::pieceValue(moving.promoted()) - eval::pieceValue(moving);
+                    }
+
+                    if (staticEval + gain + deltaMargin() <= alpha) {
+                        continue;
+                    }
+                }
+
+                if (!generator.see(move, qsearchSeeThreshold())) {
                     continue;
                 }
             }
 
             const auto [newPos, guard] = thread.applyMove(ply, pos, move);
-            const auto sennichite = newPos.testSennichite(m_cuteChessWorkaround, thread.keyHistory);
+            const auto sennichite = testSennichite(thread, newPos);
 
             Score score;
 
             if (sennichite == SennichiteStatus::kWin) {
                 // illegal perpetual
+                --legalMoves;
                 continue;
             } else if (sennichite == SennichiteStatus::kDraw) {
-                score = drawScore(thread.loadNodes());
+                score = drawScore(thread.nodes);
             } else {
-                score = -qsearch<kPvNode>(thread, newPos, ply + 1, -beta, -alpha);
+                score = -qsearch<kPvNode>(thread, newPos, ply + 1, -beta, -alpha, qsPly + 1);
+            }
+
+            if (hasStopped()) {
+                return 0;
             }
 
             if (score > bestScore) {
@@ -573,61 +1502,344 @@ namespace stoat {
 
             if (score > alpha) {
                 alpha = score;
+                bestMove = move;
+                ttFlag = tt::Flag::kExact;
             }
 
             if (score >= beta) {
+                ttFlag = tt::Flag::kLowerBound;
                 break;
             }
         }
 
+        // every move was searched, see above
+        if (pos.isInCheck() && legalMoves == 0) {
+            return -kScoreMate + ply;
+        }
+
+        m_ttable.put(pos.key(), bestScore, bestMove, 0, ply, ttFlag);
+
         return bestScore;
     }
 
+    bool Searcher::rateLimitReport(i32 depth, f64 time) {
+        if (m_silent) {
+            return true;
+        }
+
+        if (depth < kUnlimitedReportDepth && time - m_lastReportTime < kMinReportInterval) {
+            return true;
+        }
+
+        m_lastReportTime = time;
+        return false;
+    }
+
     void Searcher::report(const ThreadData& bestThread, f64 time) {
+        if (rateLimitReport(bestThread.depthCompleted, time)) {
+            return;
+        }
+
+        std::ostringstream stream{};
+        writeLines(stream, bestThread, time);
+
+        protocol::output::tryPost(stream.str());
+    }
+
+    void Searcher::report(i32 depth, Score score, const PvList& pv, ScoreBound bound, f64 time) {
+        if (rateLimitReport(depth, time)) {
+            return;
+        }
+
+        std::ostringstream stream{};
+        writeInfo(stream, depth, score, pv, bound, time);
+
+        protocol::output::tryPost(stream.str());
+    }
+
+    void Searcher::telemetryReport(i32 depth, f64 time) {
+        if (m_silent || !m_telemetry) {
+            return;
+        }
+
+        usize totalNodes = 0;
+
+        std::ostringstream threadNps{};
+        threadNps << "nps";
+
+        for (const auto& thread : m_threads) {
+            const auto nodes = thread->loadNodes();
+            totalNodes += nodes;
+
+            threadNps << (thread->isMainThread() ? " " : ",")
+                      << static_cast<usize>(static_cast<f64>(nodes) / std::max(time, 0.001));
+        }
+
+        const auto iterationNodes = totalNodes - m_lastIterationEndNodes;
+        const auto iterationMs = static_cast<usize>((time - m_lastIterationEnd) * 1000.0);
+
+        std::ostringstream str{};
+        str << "telemetry depth " << depth << " time " << static_cast<usize>(time * 1000.0) << " iteration "
+            << iterationMs << " nodes " << totalNodes << " iterationnodes " << iterationNodes;
+
+        // effective branching factor, the nodes of this iteration over those of the last
+        if (m_lastIterationNodes > 0) {
+            str << " ebf " << std::fixed << std::setprecision(2)
+                << static_cast<f64>(iterationNodes) / static_cast<f64>(m_lastIterationNodes);
+        }
+
+        str << " hashfull " << m_ttable.fullPermille() << ' ' << threadNps.str();
+
+        m_lastIterationEnd = time;
+        m_lastIterationEndNodes = totalNodes;
+        m_lastIterationNodes = iterationNodes;
+
+        std::ostringstream stream{};
+        protocol::currHandler().printInfoString(stream, str.str());
+
+        protocol::output::tryPost(stream.str());
+    }
+
+    void Searcher::writeThreadTelemetry(std::ostream& stream, f64 time) const {
+        for (const auto& thread : m_threads) {
+            const auto nodes = thread->loadNodes();
+            const auto nps = static_cast<usize>(static_cast<f64>(nodes) / std::max(time, 0.001));
+
+            protocol::currHandler().printInfoString(
+                stream,
+                "telemetry thread " + std::to_string(thread->id) + " depth " + std::to_string(thread->depthCompleted)
+                    + " seldepth " + std::to_string(thread->loadSeldepth()) + " nodes " + std::to_string(nodes)
+                    + " nps " + std::to_string(nps)
+            );
+        }
+    }
+
+    void Searcher::writeLines(std::ostream& stream, const ThreadData& bestThread, f64 time) const {
+        if (bestThread.lastLines.empty()) {
+            writeInfo(
+                stream,
+                bestThread.depthCompleted,
+                bestThread.lastScore,
+                bestThread.lastPv,
+                ScoreBound::kExact,
+                time
+            );
+            return;
+        }
+
+        for (u32 idx = 0; idx < bestThread.lastLines.size(); ++idx) {
+            const auto& line = bestThread.lastLines[idx];
+            writeInfo(stream, bestThread.depthCompleted, line.score, line.pv, ScoreBound::kExact, time, idx + 1);
+        }
+    }
+
+    void Searcher::writeInfo(
+        std::ostream& stream,
+        i32 depth,
+        Score score,
+        const PvList& pv,
+        ScoreBound bound,
+        f64 time,
+        std::optional<u32> multiPvIdx
+    ) const {
         usize totalNodes = 0;
         i32 maxSeldepth = 0;
 
         for (const auto& thread : m_threads) {
-            totalNodes += thread.loadNodes();
-            maxSeldepth = std::max(maxSeldepth, thread.loadSeldepth());
+            totalNodes += thread->loadNodes();
+            maxSeldepth = std::max(maxSeldepth, thread->loadSeldepth());
         }
 
-        protocol::DisplayScore score{};
+        protocol::DisplayScore displayScore{};
 
-        if (std::abs(bestThread.lastScore) >= kScoreMaxMate) {
-            if (bestThread.lastScore > 0) {
-                score = protocol::MateDisplayScore{kScoreMate - bestThread.lastScore};
+        if (std::abs(score) >= kScoreMaxMate) {
+            if (score > 0) {
+                displayScore = protocol::MateDisplayScore{kScoreMate - score};
             } else {
-                score = protocol::MateDisplayScore{-(kScoreMate + bestThread.lastScore)};
+                displayScore = protocol::MateDisplayScore{-(kScoreMate + score)};
             }
         } else {
-            auto cp = bestThread.lastScore;
+            auto cp = score;
 
             // clamp draw scores to 0
             if (std::abs(cp) <= 2) {
                 cp = 0;
             }
 
-            score = protocol::CpDisplayScore{cp};
+            displayScore = protocol::CpDisplayScore{cp};
         }
 
         const protocol::SearchInfo info = {
-            .depth = bestThread.depthCompleted,
+            .depth = depth,
             .seldepth = maxSeldepth,
+            .multipv = multiPvIdx,
             .timeSec = time,
             .nodes = totalNodes,
-            .score = score,
-            .pv = bestThread.lastPv,
+            .score = displayScore,
+            .bound = bound,
+            .pv = pv,
             .hashfull = m_ttable.fullPermille(),
         };
 
-        protocol::currHandler().printSearchInfo(std::cout, info);
+        protocol::currHandler().printSearchInfo(stream, info);
+    }
+
+    const ThreadData& Searcher::selectThread() const {
+        if (m_threads.size() == 1) {
+            return *m_threads[0];
+        }
+
+        auto minScore = kScoreInf;
+
+        for (const auto& thread : m_threads) {
+            if (thread->depthCompleted > 0) {
+                minScore = std::min(minScore, thread->lastScore);
+            }
+        }
+
+        const auto weight = [&](const ThreadData& thread) {
+            return static_cast<i64>(thread.lastScore - minScore + 14) * static_cast<i64>(thread.depthCompleted);
+        };
+
+        // total votes for a thread's best move, from every thread that agrees with it
+        const auto votes = [&](const ThreadData& thread) {
+            i64 total{};
+
+            for (const auto& other : m_threads) {
+                if (other->depthCompleted > 0 && other->lastPv.moves[0] == thread.lastPv.moves[0]) {
+                    total += weight(*other);
+                }
+            }
+
+            return total;
+        };
+
+        const auto* bestThread = m_threads[0].get();
+        auto bestVotes = votes(*bestThread);
+
+        for (const auto& threadPtr : m_threads) {
+            const auto& thread = *threadPtr;
+
+            if (thread.depthCompleted == 0 || thread.lastPv.length == 0) {
+                continue;
+            }
+
+            const auto threadVotes = votes(thread);
+
+            if (bestThread->lastScore > kScoreWin) {
+                // prefer the shortest mate found
+                if (thread.lastScore > bestThread->lastScore) {
+                    bestThread = &thread;
+                    bestVotes = threadVotes;
+                }
+            } else if (thread.lastScore > kScoreWin || threadVotes > bestVotes) {
+                bestThread = &thread;
+                bestVotes = threadVotes;
+            }
+        }
+
+        return *bestThread;
     }
 
     void Searcher::finalReport(f64 time) {
-        const auto& bestThread = m_threads[0];
+        if (m_silent) {
+            return;
+        }
+
+        const auto& bestThread = selectThread();
+
+        std::ostringstream stream{};
+        writeLines(stream, bestThread, time);
+
+        if (m_telemetry) {
+            writeThreadTelemetry(stream, time);
+        }
+
+        if constexpr (stats::kEnabled) {
+            stats::SearchCounters counters{};
+
+            for (const auto& thread : m_threads) {
+                counters += thread->counters;
+            }
+
+            stats::print(stream, counters);
+        }
+
+        const auto* pv = &bestThread.lastPv;
+
+        // a worker that got deeper than every local thread wins
+        std::optional<cluster::RemoteResult> remote{};
+
+        if (m_cluster) {
+            remote = m_cluster->finishSearch();
+
+            // the worker's line is only as trustworthy as its connection, so its move must at least be legal here
+            const auto isRootMove = [&](Move move) {
+                return std::ranges::any_of(bestThread.rootMoves, [&](const auto& root) { return root.move == move; });
+            };
+
+            if (remote && remote->depth > bestThread.depthCompleted && remote->pv.length > 0
+                && isRootMove(remote->pv.moves[0]))
+            {
+                writeInfo(stream, remote->depth, remote->score, remote->pv, ScoreBound::kExact, time);
+                pv = &remote->pv;
+            }
+        }
+
+        // stopped before depth 1 completed, which a quit straight after a go can do. any legal move beats none
+        if (pv->length == 0) {
+            assert(!bestThread.rootMoves.empty());
+            protocol::currHandler().printBestMove(stream, bestThread.rootMoves[0].move, kNullMove);
+        } else {
+            protocol::currHandler().printBestMove(stream, pv->moves[0], pv->length > 1 ? pv->moves[1] : kNullMove);
+        }
+
+        protocol::output::post(stream.str());
+    }
+
+    void Searcher::mateReport(
+        const Position& root,
+        std::span<const u64> keyHistory,
+        mate::SolveResult result,
+        f64 time
+    ) {
+        const auto& handler = protocol::currHandler();
+
+        usize nodes = 0;
+
+        for (const auto& thread : m_threads) {
+            nodes += thread->loadNodes();
+        }
+
+        std::ostringstream stream{};
+
+        const auto ms = static_cast<usize>(time * 1000.0);
+        handler.printInfoString(
+            stream,
+            "mate search: " + std::to_string(nodes) + " nodes, " + std::to_string(ms) + " ms"
+        );
+
+        switch (result) {
+            case mate::SolveResult::kProven: {
+                mate::MateLine line{};
+
+                if (mate::extractMateLine(line, *m_mateTable, root, keyHistory)) {
+                    handler.printCheckmate(stream, protocol::MateStatus::kMate, line);
+                } else {
+                    handler.printInfoString(stream, "mate line lost from the mate table");
+                    handler.printCheckmate(stream, protocol::MateStatus::kTimeout, {});
+                }
+
+                break;
+            }
+            case mate::SolveResult::kDisproven:
+                handler.printCheckmate(stream, protocol::MateStatus::kNoMate, {});
+                break;
+            case mate::SolveResult::kUnknown:
+                handler.printCheckmate(stream, protocol::MateStatus::kTimeout, {});
+                break;
+        }
 
-        report(bestThread, time);
-        protocol::currHandler().printBestMove(std::cout, bestThread.lastPv.moves[0]);
+        protocol::output::post(stream.str());
     }
 } // namespace stoat
@@ -21,13 +21,22 @@
 #include "types.h"
 
 #include <atomic>
+#include <condition_variable>
+#include <iostream>
 #include <memory>
 #include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
 #include <thread>
 #include <utility>
 #include <vector>
 
 #include "arch.h"
+#include "book.h"
+#include "cluster.h"
+#include "dfpn.h"
 #include "limit.h"
 #include "movegen.h"
 #include "position.h"
@@ -35,14 +44,31 @@
 #include "thread.h"
 #include "ttable.h"
 #include "util/barrier.h"
+#include "util/range.h"
 #include "util/timer.h"
 
 namespace stoat {
+    constexpr u32 kDefaultThreadCount = 1;
+    constexpr util::Range<u32> kThreadCountRange{1, 2048};
+
+    constexpr u32 kDefaultMultiPv = 1;
+    constexpr util::Range<u32> kMultiPvRange{1, 256};
+
     struct BenchInfo {
         usize nodes{};
         f64 time{};
     };
 
+    struct AnalysisResult {
+        // 0 if not even depth 1 completed, the other fields are then meaningless
+        i32 depth{};
+        Score score{};
+        PvList pv{};
+
+        usize nodes{};
+        f64 time{};
+    };
+
     class Searcher {
     public:
         Searcher(usize ttSizeMib);
@@ -53,32 +79,107 @@ namespace stoat {
 
         void setThreads(u32 threadCount);
         void setTtSize(usize mib);
+        void setNumaBinding(bool enabled);
+        // see tt::TTable::setReportStream()
+        void setReportStream(std::ostream& stream);
+        void setMultiPv(u32 multiPv);
         void setCuteChessWorkaround(bool enabled);
+        void setFullGameSennichite(bool enabled);
+        void setTelemetry(bool enabled);
+        void setEnteringKingRule(EnteringKingRule rule);
+        void setMateTableSize(usize mib);
+
+        // return an error message on failure. a loaded table is kept by the next newGame()
+        [[nodiscard]] std::optional<std::string> saveTt(const std::string& path);
+        [[nodiscard]] std::optional<std::string> loadTt(const std::string& path);
+        [[nodiscard]] std::optional<std::string> loadBook(const std::string& path);
+        [[nodiscard]] std::optional<std::string> shareTt(const std::string& name);
+        // see cluster::Client::connect()
+        [[nodiscard]] std::optional<std::string> setClusterNodes(std::string_view nodes);
+
+        void unloadBook();
+        void unshareTt();
+        void clearClusterNodes();
+
+        // entries stored by deep enough searches are pushed to the queue, if not null
+        void setEntryExport(cluster::EntryQueue* queue);
+        // stores entries from other cluster nodes. may be called from any thread,
+        // but entries that arrive while no search is running are dropped
+        void importEntries(std::span<const cluster::SharedEntry> entries);
+
+        [[nodiscard]] inline usize clusterNodeCount() const {
+            return m_cluster ? m_cluster->nodeCount() : 0;
+        }
+
+        [[nodiscard]] inline usize bookSize() const {
+            return m_book.size();
+        }
+
+        [[nodiscard]] inline usize ttSizeMib() const {
+            return m_ttable.sizeMib();
+        }
 
         void startSearch(
             const Position& pos,
             std::span<const u64> keyHistory,
             util::Instant startTime,
             bool infinite,
+            bool ponder,
             i32 maxDepth,
             std::unique_ptr<limit::ISearchLimiter> limiter
         );
+        // df-pn search for a forced mate by the side to move, reported as a checkmate line
+        void startMateSearch(
+            const Position& pos,
+            std::span<const u64> keyHistory,
+            util::Instant startTime,
+            std::unique_ptr<limit::ISearchLimiter> limiter
+        );
+
         void stop();
 
+        // ends pondering, the limiter replaces the one the search was started with
+        // and so should measure time from the ponderhit
+        void ponderhit(std::unique_ptr<limit::ISearchLimiter> limiter);
+
+        [[nodiscard]] inline bool isPondering() const {
+            return m_pondering.load();
+        }
+
         void runBenchSearch(BenchInfo& info, const Position& pos, i32 depth);
+        // blocks like runBenchSearch(), but prints nothing at all. safe to
+        // run on several searchers at once, unlike every other search
+        void runAnalysisSearch(
+            AnalysisResult& result,
+            const Position& pos,
+            std::span<const u64> keyHistory,
+            i32 maxDepth,
+            std::unique_ptr<limit::ISearchLimiter> limiter
+        );
 
         [[nodiscard]] bool isSearching() const;
 
     private:
-        std::vector<ThreadData> m_threads{};
+        std::vector<std::unique_ptr<ThreadData>> m_threads{};
+        std::vector<std::thread> m_workers{};
 
+        bool m_numaBinding{};
+        u32 m_multiPv{kDefaultMultiPv};
         bool m_cuteChessWorkaround{};
+        bool m_fullGameSennichite{};
+        bool m_telemetry{};
+        EnteringKingRule m_enteringKingRule{EnteringKingRule::k27Point};
+        // the rule searches actually use, none if the protocol has no way to declare a win
+        EnteringKingRule m_searchEnteringKingRule{EnteringKingRule::k27Point};
 
         mutable std::mutex m_searchMutex{};
         bool m_searching{};
 
         util::Instant m_startTime{util::Instant::now()};
 
+        // passed once every thread has allocated its data after setThreads()
+        util::Barrier m_initBarrier{2};
+
         util::Barrier m_resetBarrier{2};
         util::Barrier m_idleBarrier{2};
 
@@ -95,9 +196,32 @@ namespace stoat {
         bool m_infinite{};
         std::unique_ptr<limit::ISearchLimiter> m_limiter{};
 
+        // no reports at all, not even the best move
+        bool m_silent{};
+
+        // the limiter is not consulted while pondering
+        std::atomic_bool m_pondering{};
+
         movegen::MoveList m_rootMoves{};
 
         tt::TTable m_ttable;
+        // set by loadTt(), so that the usinewgame that usually follows does not clear the table
+        bool m_keepTt{};
+
+        // probed at the start of normal searches only, not when pondering or analysing
+        book::Book m_book{};
+
+        // null unless connected to worker nodes
+        std::unique_ptr<cluster::Client> m_cluster{};
+        // the cluster client's queue on the main node
+        cluster::EntryQueue* m_exportQueue{};
+
+        // only allocated once a mate search is started
+        std::unique_ptr<mate::DfpnTable> m_mateTable{};
+        usize m_mateTableMib{mate::kDefaultMateTableSizeMib};
+
+        bool m_mateSearch{};
+        std::atomic<mate::SolveResult> m_mateResult{};
 
         enum class RootStatus {
             kNoLegalMoves = 0,
@@ -106,6 +230,22 @@ namespace stoat {
 
         RootStatus initRootMoves(const Position& pos);
 
+        [[nodiscard]] EnteringKingRule effectiveEnteringKingRule() const;
+
+        // starts a search and waits for every thread to finish it
+        void runBlockingSearch(
+            const Position& pos,
+            std::span<const u64> keyHistory,
+            i32 maxDepth,
+            std::unique_ptr<limit::ISearchLimiter> limiter,
+            bool silent
+        );
+
+        // the tt is cleared with as many threads as we search with
+        [[nodiscard]] inline u32 ttClearThreads() const {
+            return static_cast<u32>(m_threads.size());
+        }
+
         void runThread(ThreadData& thread);
 
         [[nodiscard]] inline bool hasStopped() const {
@@ -114,11 +254,25 @@ namespace stoat {
 
         void stopThreads();
 
+        // go infinite and go ponder only end with a stop or ponderhit
+        void waitForStop();
+
+        // called by every search thread once done with the search
+        void finishThread();
+        // waits for every search thread to finish
+        void waitForThreads() const;
+
         void runSearch(ThreadData& thread);
+        void runMateSearch(ThreadData& thread);
 
-        [[nodiscard]] inline bool isLegalRootMove(Move move) const {
-            return std::ranges::find(m_rootMoves, move) != m_rootMoves.end();
-        }
+        // plies searched back for repetitions, unless checking the full game
+        static constexpr i32 kSennichiteLimit = 16;
+
+        void exportEntry(ThreadData& thread, u64 key, Score score, Move move, i32 depth, tt::Flag flag);
+        void flushExports(ThreadData& thread);
+
+        [[nodiscard]] SennichiteStatus testSennichite(const ThreadData& thread, const Position& pos) const;
+        [[nodiscard]] bool isHandDominated(const ThreadData& thread, const Position& pos) const;
 
         template <bool kPvNode = false, bool kRootNode = false>
         Score search(ThreadData& thread, const Position& pos, PvList& pv, i32 depth, i32 ply, Score alpha, Score beta);
@@ -134,10 +288,47 @@ namespace stoat {
             Score beta
         ) = delete;
 
+        // qsPly counts the plies since qsearch was entered, quiet checks are only tried in the first
         template <bool kPvNode = false>
-        Score qsearch(ThreadData& thread, const Position& pos, i32 ply, Score alpha, Score beta);
+        Score qsearch(ThreadData& thread, const Position& pos, i32 ply, Score alpha, Score beta, i32 qsPly = 0);
+
+        [[nodiscard]] const ThreadData& selectThread() const;
+
+        // intermediate reports at shallow depths are limited to one per kMinReportInterval
+        static constexpr i32 kUnlimitedReportDepth = 10;
+        static constexpr f64 kMinReportInterval = 0.005;
+
+        // only touched by the main search thread
+        f64 m_lastReportTime{};
 
+        // the main thread's last completed iteration, for telemetry
+        f64 m_lastIterationEnd{};
+        usize m_lastIterationEndNodes{};
+        usize m_lastIterationNodes{};
+
+        // returns true if the report should be skipped
+        [[nodiscard]] bool rateLimitReport(i32 depth, f64 time);
+
+        // intermediate reports, dropped rather than waited for if the output queue is full
         void report(const ThreadData& bestThread, f64 time);
+        void report(i32 depth, Score score, const PvList& pv, ScoreBound bound, f64 time);
+
+        // per iteration timing, branching factor, hashfull and per thread nps, if enabled
+        void telemetryReport(i32 depth, f64 time);
+        void writeThreadTelemetry(std::ostream& stream, f64 time) const;
+
+        void writeLines(std::ostream& stream, const ThreadData& bestThread, f64 time) const;
+        void writeInfo(
+            std::ostream& stream,
+            i32 depth,
+            Score score,
+            const PvList& pv,
+            ScoreBound bound,
+            f64 time,
+            std::optional<u32> multiPvIdx = {}
+        ) const;
+
         void finalReport(f64 time);
+        void mateReport(const Position& root, std::span<const u64> keyHistory, mate::SolveResult result, f64 time);
     };
 } // namespace stoat
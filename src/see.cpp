@@ -82,7 +82,8 @@ namespace stoat::see {
         }
     } // namespace
 
-    bool see(const Position& pos, Move move, i32 threshold) {
+    bool Context::see(Move move, i32 threshold) {
+        const auto& pos = m_pos;
         const auto stm = pos.stm();
 
         auto score = gain(pos, move) - threshold;
@@ -99,13 +100,14 @@ namespace stoat::see {
             return true;
         }
 
+        if (!m_slidersReady) {
+            initSliders();
+        }
+
         const auto sq = move.to();
         auto occ = pos.occupancy() ^ move.from().bit() ^ sq.bit();
 
-        const auto bishops = pos.pieceTypeBb(PieceTypes::kBishop) | pos.pieceTypeBb(PieceTypes::kPromotedBishop);
-        const auto rooks = pos.pieceTypeBb(PieceTypes::kRook) | pos.pieceTypeBb(PieceTypes::kPromotedRook);
-
-        auto attackers = pos.allAttackersTo(sq, occ);
+        auto attackers = attackersTo(sq, occ);
 
         auto curr = stm.flip();
 
@@ -119,11 +121,11 @@ namespace stoat::see {
             next = popLeastValuable(pos, occ, attackers, curr);
 
             if (canMoveDiagonally(next)) {
-                attackers |= attacks::bishopAttacks(sq, occ) & bishops;
+                attackers |= attacks::bishopAttacks(sq, occ) & m_bishops;
             }
 
             if (canMoveOrthogonally(next)) {
-                attackers |= attacks::rookAttacks(sq, occ) & rooks;
+                attackers |= attacks::rookAttacks(sq, occ) & m_rooks;
             }
 
             attackers &= occ;
@@ -141,4 +143,22 @@ namespace stoat::see {
 
         return curr != stm;
     }
+
+    void Context::initSliders() {
+        m_bishops = m_pos.pieceTypeBb(PieceTypes::kBishop) | m_pos.pieceTypeBb(PieceTypes::kPromotedBishop);
+        m_rooks = m_pos.pieceTypeBb(PieceTypes::kRook) | m_pos.pieceTypeBb(PieceTypes::kPromotedRook);
+
+        m_slidersReady = true;
+    }
+
+    Bitboard Context::attackersTo(Square sq, Bitboard occ) {
+        // captures to the same square are usually evaluated more than once per node,
+        // by the move picker and again for pruning, so only the sliders are redone
+        if (!m_cachedSquares.getSquare(sq)) {
+            m_stepAttackers[sq.idx()] = m_pos.stepAttackersTo(sq).raw();
+            m_cachedSquares |= Bitboard::fromSquare(sq);
+        }
+
+        return Bitboard{m_stepAttackers[sq.idx()]} | m_pos.sliderAttackersTo(sq, occ);
+    }
 } // namespace stoat::see
@@ -20,6 +20,9 @@
 
 #include "types.h"
 
+#include <array>
+
+#include "bitboard.h"
 #include "core.h"
 #include "position.h"
 
@@ -63,5 +66,37 @@ namespace stoat::see {
         return kValues[pt.idx()];
     }
 
-    [[nodiscard]] bool see(const Position& pos, Move move, i32 threshold);
+    // Caches what every exchange evaluated in one position would otherwise recompute: the
+    // slider bitboards, and the non-slider attackers of each square that has been a target.
+    // Cheap to construct, everything is filled on demand. Must not outlive pos
+    class Context {
+    public:
+        explicit Context(const Position& pos) :
+                m_pos{pos} {}
+
+        [[nodiscard]] bool see(Move move, i32 threshold);
+
+    private:
+        const Position& m_pos;
+
+        bool m_slidersReady{};
+
+        // only valid once m_slidersReady is set
+        Bitboard m_bishops;
+        Bitboard m_rooks;
+
+        // squares with valid entries in m_stepAttackers
+        Bitboard m_cachedSquares{};
+        // raw bitboards, as Bitboard would zero the array for every
+        // context, see Position::stepAttackersTo(). deliberately left uninitialised
+        std::array<u128, Squares::kCount> m_stepAttackers;
+
+        void initSliders();
+
+        [[nodiscard]] Bitboard attackersTo(Square sq, Bitboard occ);
+    };
+
+    [[nodiscard]] inline bool see(const Position& pos, Move move, i32 threshold) {
+        return Context{pos}.see(move, threshold);
+    }
 } // namespace stoat::see
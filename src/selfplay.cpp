@@ -0,0 +1,150 @@
+/*
+ * Stoat, a USI shogi engine
+ * Copyright (C) 2025 Ciekce
+ *
+ * Stoat is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Stoat is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Stoat. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "selfplay.h"
+
+#include <cmath>
+#include <iostream>
+
+#include "limit.h"
+#include "movegen.h"
+
+namespace stoat::selfplay {
+    namespace {
+        [[nodiscard]] bool tryRandomOpening(
+            Position& pos,
+            std::vector<u64>& keyHistory,
+            util::rng::Jsf64Rng& rng,
+            u32 plies
+        ) {
+            pos = Position::startpos();
+            keyHistory.clear();
+
+            movegen::MoveList moves{};
+
+            for (u32 ply = 0; ply < plies; ++ply) {
+                moves.clear();
+                movegen::generateLegal(moves, pos);
+
+                if (moves.empty()) {
+                    return false;
+                }
+
+                keyHistory.push_back(pos.key());
+                pos = pos.applyMove(moves[rng.nextU32(moves.size())]);
+            }
+
+            // the opponent must have a move too
+            moves.clear();
+            movegen::generateLegal(moves, pos);
+
+            return !moves.empty();
+        }
+    } // namespace
+
+    std::vector<std::unique_ptr<Searcher>> createSearchers(u32 count, usize hashMib, u32 threads) {
+        std::vector<std::unique_ptr<Searcher>> searchers{};
+        searchers.reserve(count);
+
+        for (u32 idx = 0; idx < count; ++idx) {
+            auto& searcher = searchers.emplace_back(std::make_unique<Searcher>(hashMib));
+
+            searcher->setReportStream(std::cerr);
+            searcher->setThreads(threads);
+            searcher->ensureReady();
+        }
+
+        return searchers;
+    }
+
+    void playRandomOpening(Position& pos, std::vector<u64>& keyHistory, util::rng::Jsf64Rng& rng, u32 plies) {
+        while (!tryRandomOpening(pos, keyHistory, rng, plies)) {
+            // mated during the opening, try another one
+        }
+    }
+
+    u32 occurrences(const Position& pos, std::span<const u64> keyHistory) {
+        u32 count = 1;
+
+        for (i32 idx = static_cast<i32>(keyHistory.size()) - 4; idx >= 0; idx -= 2) {
+            if (keyHistory[idx] == pos.key()) {
+                ++count;
+            }
+        }
+
+        return count;
+    }
+
+    std::optional<Color> playGame(
+        const std::array<Player, 2>& players,
+        Position pos,
+        std::vector<u64> keyHistory,
+        const std::function<void(const Position&, Move, const AnalysisResult&)>& onMove
+    ) {
+        players[0].searcher->newGame();
+
+        if (players[1].searcher != players[0].searcher) {
+            players[1].searcher->newGame();
+        }
+
+        AnalysisResult result{};
+
+        for (u32 ply = 0; ply < kMaxGamePlies; ++ply) {
+            if (pos.canDeclareWin(EnteringKingRule::k27Point)) {
+                return pos.stm();
+            }
+
+            const auto& player = players[pos.stm() == Colors::kBlack ? 0 : 1];
+
+            auto limiter = std::make_unique<limit::CompoundLimiter>();
+            limiter->addLimiter<limit::NodeLimiter>(player.nodes);
+
+            player.searcher->runAnalysisSearch(result, pos, keyHistory, kMaxDepth, std::move(limiter));
+
+            // no legal moves
+            if (result.pv.length == 0) {
+                return pos.stm().flip();
+            }
+
+            if (std::abs(result.score) >= kScoreMaxMate) {
+                return result.score > 0 ? pos.stm() : pos.stm().flip();
+            }
+
+            const auto move = result.pv.moves[0];
+
+            if (onMove) {
+                onMove(pos, move, result);
+            }
+
+            keyHistory.push_back(pos.key());
+            pos = pos.applyMove(move);
+
+            if (occurrences(pos, keyHistory) >= kSennichiteOccurrences) {
+                const auto status = pos.testSennichite(false, keyHistory, static_cast<i32>(keyHistory.size()));
+
+                if (status == SennichiteStatus::kWin) {
+                    return pos.stm();
+                }
+
+                return {};
+            }
+        }
+
+        return {};
+    }
+} // namespace stoat::selfplay
@@ -0,0 +1,73 @@
+/*
+ * Stoat, a USI shogi engine
+ * Copyright (C) 2025 Ciekce
+ *
+ * Stoat is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Stoat is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Stoat. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "types.h"
+
+#include <array>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include "core.h"
+#include "move.h"
+#include "position.h"
+#include "search.h"
+#include "util/rng.h"
+
+// Shared by the subcommands that run many searches side by side, mostly for the
+// games that datagen and match play against themselves
+namespace stoat::selfplay {
+    // games are drawn if they reach this many plies
+    constexpr u32 kMaxGamePlies = 512;
+
+    // the 4th occurrence of a position is sennichite
+    constexpr u32 kSennichiteOccurrences = 4;
+
+    // Creates searchers for running searches in parallel, with their tt already allocated. Made
+    // up front rather than by each worker thread, so that the allocation reports are not
+    // interleaved. Reports go to stderr, these subcommands keep stdout for their results
+    [[nodiscard]] std::vector<std::unique_ptr<Searcher>> createSearchers(u32 count, usize hashMib, u32 threads = 1);
+
+    // plays uniformly random legal moves from startpos until a position is
+    // reached after plies moves in which the side to move is not mated
+    void playRandomOpening(Position& pos, std::vector<u64>& keyHistory, util::rng::Jsf64Rng& rng, u32 plies);
+
+    // how many times pos has occurred, counting itself
+    [[nodiscard]] u32 occurrences(const Position& pos, std::span<const u64> keyHistory);
+
+    struct Player {
+        Searcher* searcher;
+        // per move
+        usize nodes;
+    };
+
+    // Plays a game out from pos, players in the order black, white. Each calls newGame() first,
+    // a searcher may play both sides. Games are adjudicated as soon as a search finds a mate, the
+    // players should be able to play it out. onMove is called with every position, the move played
+    // in it and the search result that chose it. Returns the winner, or none for a draw
+    [[nodiscard]] std::optional<Color> playGame(
+        const std::array<Player, 2>& players,
+        Position pos,
+        std::vector<u64> keyHistory,
+        const std::function<void(const Position&, Move, const AnalysisResult&)>& onMove = {}
+    );
+} // namespace stoat::selfplay
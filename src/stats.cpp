@@ -0,0 +1,106 @@
+/*
+ * Stoat, a USI shogi engine
+ * Copyright (C) 2025 Ciekce
+ *
+ * Stoat is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Stoat is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Stoat. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "stats.h"
+
+#include <iomanip>
+#include <sstream>
+
+#include "protocol/handler.h"
+
+namespace stoat::stats {
+    namespace {
+        [[nodiscard]] f64 percentage(u64 count, u64 total) {
+            return total == 0 ? 0.0 : static_cast<f64>(count) * 100.0 / static_cast<f64>(total);
+        }
+    } // namespace
+
+    void print(std::ostream& stream, const SearchCounters& counters) {
+        const auto& handler = protocol::currHandler();
+
+        const auto line = [&](auto... values) {
+            std::ostringstream str{};
+            str << std::fixed << std::setprecision(1);
+            (str << ... << values);
+
+            handler.printInfoString(stream, str.str());
+        };
+
+        const auto nodes = counters.get(Counter::kNodes);
+        const auto qsearchNodes = counters.get(Counter::kQsearchNodes);
+
+        const auto ttProbes = counters.get(Counter::kTtProbes);
+        const auto ttHits = counters.get(Counter::kTtHits);
+        const auto ttCutoffs = counters.get(Counter::kTtCutoffs);
+
+        const auto nullMoveSearches = counters.get(Counter::kNullMoveSearches);
+        const auto nullMoveCutoffs = counters.get(Counter::kNullMoveCutoffs);
+
+        const auto probcutSearches = counters.get(Counter::kProbcutSearches);
+        const auto probcutCutoffs = counters.get(Counter::kProbcutCutoffs);
+
+        const auto singularSearches = counters.get(Counter::kSingularSearches);
+        const auto singularExtensions = counters.get(Counter::kSingularExtensions);
+
+        const auto failHighs = counters.get(Counter::kFailHighs);
+        const auto firstMoveFailHighs = counters.get(Counter::kFirstMoveFailHighs);
+
+        const auto reducedSearches = counters.get(Counter::kReducedSearches);
+        const auto lmrResearches = counters.get(Counter::kLmrResearches);
+
+        line("stats nodes ", nodes, " qsearch ", percentage(qsearchNodes, nodes), "%");
+        line(
+            "stats tt probes ",
+            ttProbes,
+            " hits ",
+            percentage(ttHits, ttProbes),
+            "% cutoffs ",
+            percentage(ttCutoffs, ttHits),
+            "% of hits"
+        );
+        line("stats fail highs ", failHighs, " first move ", percentage(firstMoveFailHighs, failHighs), "%");
+        line(
+            "stats null move searches ",
+            nullMoveSearches,
+            " cutoffs ",
+            percentage(nullMoveCutoffs, nullMoveSearches),
+            "%"
+        );
+        line(
+            "stats probcut searches ",
+            probcutSearches,
+            " cutoffs ",
+            percentage(probcutCutoffs, probcutSearches),
+            "%"
+        );
+        line(
+            "stats singular searches ",
+            singularSearches,
+            " extended ",
+            percentage(singularExtensions, singularSearches),
+            "%"
+        );
+        line(
+            "stats reduced searches ",
+            reducedSearches,
+            " re-searched ",
+            percentage(lmrResearches, reducedSearches),
+            "%"
+        );
+    }
+} // namespace stoat::stats
@@ -0,0 +1,90 @@
+/*
+ * Stoat, a USI shogi engine
+ * Copyright (C) 2025 Ciekce
+ *
+ * Stoat is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Stoat is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Stoat. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "types.h"
+
+#include <array>
+#include <iostream>
+
+// Counters of search events, to explain why node counts change. They
+// are only compiled in with the ST_SEARCH_STATS define (the cmake option
+// of the same name, or SEARCH_STATS=on with make), otherwise every
+// increment is removed and nothing is printed
+namespace stoat::stats {
+#ifdef ST_SEARCH_STATS
+    constexpr bool kEnabled = true;
+#else
+    constexpr bool kEnabled = false;
+#endif
+
+    enum class Counter : u32 {
+        kNodes = 0,
+        kQsearchNodes,
+        kTtProbes,
+        kTtHits,
+        kTtCutoffs,
+        kNullMoveSearches,
+        kNullMoveCutoffs,
+        kProbcutSearches,
+        kProbcutCutoffs,
+        kSingularSearches,
+        kSingularExtensions,
+        kFailHighs,
+        kFirstMoveFailHighs,
+        kReducedSearches,
+        kLmrResearches,
+        kCount,
+    };
+
+    class SearchCounters {
+    public:
+        inline void inc(Counter counter) {
+            if constexpr (kEnabled) {
+                ++m_values[static_cast<usize>(counter)];
+            }
+        }
+
+        [[nodiscard]] inline u64 get(Counter counter) const {
+            if constexpr (kEnabled) {
+                return m_values[static_cast<usize>(counter)];
+            } else {
+                return 0;
+            }
+        }
+
+        inline void clear() {
+            m_values.fill(0);
+        }
+
+        inline SearchCounters& operator+=(const SearchCounters& other) {
+            for (usize idx = 0; idx < m_values.size(); ++idx) {
+                m_values[idx] += other.m_values[idx];
+            }
+
+            return *this;
+        }
+
+    private:
+        std::array<u64, kEnabled ? static_cast<usize>(Counter::kCount) : 0> m_values{};
+    };
+
+    // as info strings, through the current protocol handler
+    void print(std::ostream& stream, const SearchCounters& counters);
+} // namespace stoat::stats
@@ -18,41 +18,84 @@
 
 #include "thread.h"
 
-namespace stoat {
-    ThreadData::ThreadData() {
-        keyHistory.reserve(1024);
-        stack.resize(kMaxDepth + 1);
-    }
+#include <algorithm>
+#include <tuple>
 
-    void ThreadData::reset(const Position& newRootPos, std::span<const u64> newKeyHistory) {
+namespace stoat {
+    void ThreadData::reset(
+        const Position& newRootPos,
+        std::span<const u64> newKeyHistory,
+        std::span<const Move> newRootMoves
+    ) {
         rootPos = newRootPos;
 
-        keyHistory.clear();
-        keyHistory.reserve(newKeyHistory.size());
+        keyHistory.assign(newKeyHistory);
+
+        rootMoves.clear();
+        rootMoves.reserve(newRootMoves.size());
+
+        for (const auto move : newRootMoves) {
+            rootMoves.push_back({.move = move});
+        }
 
-        std::ranges::copy(newKeyHistory, std::back_inserter(keyHistory));
+        nnueState.reset(rootPos);
+        evalCache.setNetwork(eval::nnue::networkId());
+
+        nodes = 0;
+        counters.clear();
+
+        stack[0].killers.fill(kNullMove);
 
         stats.seldepth.store(0);
         stats.nodes.store(0);
     }
 
+    void ThreadData::sortRootMoves(usize first, usize last) {
+        assert(first <= last && last <= rootMoves.size());
+
+        const auto begin = rootMoves.begin() + static_cast<std::ptrdiff_t>(first);
+        const auto end = rootMoves.begin() + static_cast<std::ptrdiff_t>(last);
+
+        std::stable_sort(begin, end, [](const RootMove& a, const RootMove& b) {
+            if (a.score != b.score) {
+                return a.score > b.score;
+            }
+
+            return a.previousScore > b.previousScore;
+        });
+    }
+
     std::pair<Position, ThreadPosGuard> ThreadData::applyMove(i32 ply, const Position& pos, Move move) {
-        stack[ply].move = move;
-        keyHistory.push_back(pos.key());
+        auto& frame = stack[ply];
+
+        frame.move = move;
+        frame.moving = pos.movingPiece(move);
+        frame.contHist = &history.continuation(frame.moving, move.to());
+
+        keyHistory.push(pos);
+        nnueState.push(pos, move);
+
         return std::pair<Position, ThreadPosGuard>{
             std::piecewise_construct,
             std::forward_as_tuple(pos.applyMove(move)),
-            std::forward_as_tuple(keyHistory)
+            std::forward_as_tuple(keyHistory, nnueState)
         };
     }
 
     std::pair<Position, ThreadPosGuard> ThreadData::applyNullMove(i32 ply, const Position& pos) {
-        stack[ply].move = kNullMove;
-        keyHistory.push_back(pos.key());
+        auto& frame = stack[ply];
+
+        frame.move = kNullMove;
+        frame.moving = Pieces::kNone;
+        frame.contHist = nullptr;
+
+        keyHistory.push(pos);
+        nnueState.pushNull();
+
         return std::pair<Position, ThreadPosGuard>{
             std::piecewise_construct,
             std::forward_as_tuple(pos.applyNullMove()),
-            std::forward_as_tuple(keyHistory)
+            std::forward_as_tuple(keyHistory, nnueState)
         };
     }
 } // namespace stoat
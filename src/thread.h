@@ -20,13 +20,21 @@
 
 #include "types.h"
 
+#include <array>
 #include <atomic>
-#include <thread>
 #include <vector>
 
+#include "cluster.h"
 #include "core.h"
+#include "eval/cache.h"
+#include "eval/nnue.h"
+#include "history.h"
+#include "keyhistory.h"
+#include "movegen.h"
 #include "position.h"
 #include "pv.h"
+#include "stats.h"
+#include "util/multi_array.h"
 
 namespace stoat {
     struct SearchStats {
@@ -49,45 +57,102 @@ namespace stoat {
 
     class ThreadPosGuard {
     public:
-        explicit ThreadPosGuard(std::vector<u64>& keyHistory) :
-                m_keyHistory{keyHistory} {}
+        ThreadPosGuard(KeyHistory& keyHistory, eval::nnue::NnueState& nnueState) :
+                m_keyHistory{keyHistory}, m_nnueState{nnueState} {}
 
         ThreadPosGuard(const ThreadPosGuard&) = delete;
         ThreadPosGuard(ThreadPosGuard&&) = delete;
 
         inline ~ThreadPosGuard() {
-            m_keyHistory.pop_back();
+            m_keyHistory.pop();
+            m_nnueState.pop();
         }
 
     private:
-        std::vector<u64>& m_keyHistory;
+        KeyHistory& m_keyHistory;
+        eval::nnue::NnueState& m_nnueState;
     };
 
     struct StackFrame {
-        PvList pv{};
         Move move{};
+        Piece moving{Pieces::kNone};
+
+        // subtable for the move made at this ply, null after a null move
+        ContinuationSubtable* contHist{};
+
+        std::array<Move, 2> killers{};
+
+        // skipped by the search at this ply, set while verifying that it is singular
+        Move excluded{};
+    };
+
+    struct RootMove {
+        Move move{};
+
+        // -kScoreInf unless the move was best, or the first searched, in the last search
+        Score score{-kScoreInf};
+        Score previousScore{-kScoreInf};
+
+        PvList pv{};
+
+        // spent in this move's subtree over the whole search
+        usize nodes{};
     };
 
     struct alignas(kCacheLineSize) ThreadData {
-        ThreadData();
+        // how often the local node count is made visible to other threads
+        static constexpr usize kNodePublishInterval = 1024;
 
         u32 id{};
-        std::thread thread{};
 
         i32 maxDepth{};
 
         Position rootPos{};
-        std::vector<u64> keyHistory{};
+        KeyHistory keyHistory{};
 
         SearchStats stats{};
 
+        // only ever touched by this thread, see publishNodes()
+        usize nodes{};
+
+        // empty unless built with search stats
+        stats::SearchCounters counters{};
+
         i32 rootDepth{};
         i32 depthCompleted{};
 
         Score lastScore{};
         PvList lastPv{};
 
-        std::vector<StackFrame> stack{};
+        // only filled with multiple pv lines, best first
+        std::vector<RootMove> lastLines{};
+
+        std::array<StackFrame, kMaxDepth + 1> stack{};
+        // kept apart from the stack, so that frames stay small
+        std::array<PvList, kMaxDepth + 1> pvs{};
+
+        // [ply][in a singular verification search]. The move generators of a thread fill these
+        // instead of lists of their own on the native stack, a search only ever touches the lists
+        // of the plies it has reached. Verification searches run at the ply of a node whose
+        // generator is still in use, so they get their own
+        util::MultiArray<movegen::ScoredMoveList, kMaxDepth + 1, 2> moveLists{};
+
+        // best first after every completed root search
+        std::vector<RootMove> rootMoves{};
+        // index of the pv line currently being searched
+        usize pvIdx{};
+
+        HistoryTables history{};
+
+        eval::nnue::NnueState nnueState{};
+        eval::EvalCache evalCache{};
+
+        // entries waiting to be sent to other cluster nodes, see Searcher::exportEntry()
+        std::vector<cluster::SharedEntry> sharedEntries{};
+
+        [[nodiscard]] inline movegen::ScoredMoveList& moveList(i32 ply, bool excluded) {
+            return moveLists[ply][excluded];
+        }
 
         [[nodiscard]] inline u32 isMainThread() const {
             return id == 0;
@@ -107,15 +172,32 @@ namespace stoat {
             stats.seldepth.store(0);
         }
 
+        // may lag behind by up to kNodePublishInterval nodes while searching
         [[nodiscard]] inline usize loadNodes() const {
             return stats.nodes.load(std::memory_order::relaxed);
         }
 
+        inline void publishNodes() {
+            stats.nodes.store(nodes, std::memory_order::relaxed);
+        }
+
         inline void incNodes() {
-            stats.nodes.fetch_add(1, std::memory_order::relaxed);
+            ++nodes;
+
+            if (nodes % kNodePublishInterval == 0) {
+                publishNodes();
+            }
         }
 
-        void reset(const Position& newRootPos, std::span<const u64> newKeyHistory);
+        void reset(const Position& newRootPos, std::span<const u64> newKeyHistory, std::span<const Move> newRootMoves);
+
+        // sorts [first, last), stable, so moves that were not searched
+        // with a full window keep their relative order
+        void sortRootMoves(usize first, usize last);
+
+        inline void sortRootMoves(usize first) {
+            sortRootMoves(first, rootMoves.size());
+        }
 
         [[nodiscard]] std::pair<Position, ThreadPosGuard> applyMove(i32 ply, const Position& pos, Move move);
         [[nodiscard]] std::pair<Position, ThreadPosGuard> applyNullMove(i32 ply, const Position& pos);
@@ -18,11 +18,20 @@
 
 #include "ttable.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
 #include <cstring>
+#include <fstream>
+#include <limits>
+#include <thread>
+#include <vector>
 
 #include "arch.h"
 #include "core.h"
-#include "util/align.h"
+#include "protocol/handler.h"
+#include "util/large_pages.h"
+#include "util/numa.h"
 
 namespace stoat::tt {
     namespace {
@@ -46,9 +55,13 @@ namespace stoat::tt {
             }
         }
 
-        [[nodiscard]] constexpr u16 packEntryKey(u64 key) {
-            return static_cast<u16>(key);
-        }
+        constexpr std::array<char, 8> kFileMagic = {'S', 'T', 'O', 'A', 'T', 'T', 'T', '\0'};
+        // bump whenever the entry layout or key packing changes
+        constexpr u32 kFileVersion = 2;
+
+        constexpr std::array<char, 8> kSharedMagic = {'S', 'T', 'O', 'A', 'T', 'S', 'T', '\0'};
+        // likewise
+        constexpr u32 kSharedVersion = 3;
     } // namespace
 
     TTable::TTable(usize mib) {
@@ -56,57 +69,334 @@ namespace stoat::tt {
     }
 
     TTable::~TTable() {
-        if (m_entries) {
-            util::alignedFree(m_entries);
-        }
+        waitForInit();
+        deallocate();
     }
 
     void TTable::resize(usize mib) {
+        waitForInit();
+
         const auto bytes = mib * 1024 * 1024;
-        const auto entries = bytes / sizeof(Entry);
+        const auto clusters = bytes / sizeof(Cluster);
 
-        if (m_entryCount != entries) {
-            if (m_entries) {
-                util::alignedFree(m_entries);
-            }
+        m_privateClusterCount = clusters;
+
+        // applied once unshared
+        if (shared()) {
+            return;
+        }
+
+        if (m_clusterCount != clusters) {
+            deallocate();
+            m_clusterCount = clusters;
+        }
+
+        m_pendingInit = true;
+    }
+
+    void TTable::setNumaInterleave(bool enabled) {
+        waitForInit();
+
+        if (m_numaInterleave == enabled) {
+            return;
+        }
 
-            m_entries = nullptr;
-            m_entryCount = entries;
+        m_numaInterleave = enabled;
+
+        // likewise, the segment's pages may already have been touched by other processes
+        if (shared()) {
+            return;
         }
 
+        // the memory policy only applies to pages that have not been touched yet
+        deallocate();
+
         m_pendingInit = true;
     }
 
-    bool TTable::finalize() {
+    void TTable::beginFinalize(u32 threadCount) {
+        waitForInit();
+
+        if (!m_pendingInit) {
+            return;
+        }
+
+        m_pendingInit = false;
+        m_initThread = std::thread{[this, threadCount] { m_asyncAllocated = init(threadCount); }};
+    }
+
+    bool TTable::finalize(u32 threadCount) {
+        if (waitForInit()) {
+            return true;
+        }
+
         if (!m_pendingInit) {
             return false;
         }
 
         m_pendingInit = false;
-        m_entries = util::alignedAlloc<Entry>(kCacheLineSize, m_entryCount);
 
-        if (!m_entries) {
-            std::cerr << "Failed to reallocate TT - out of memory?" << std::endl;
-            std::terminate();
+        if (init(threadCount)) {
+            reportAllocation();
+        }
+
+        return true;
+    }
+
+    bool TTable::init(u32 threadCount) {
+        const bool allocate = !m_clusters;
+
+        if (allocate) {
+            const auto bytes = m_clusterCount * sizeof(Cluster);
+
+            m_clusters = static_cast<Cluster*>(util::allocLargePages(bytes, m_largePages));
+
+            if (!m_clusters) {
+                std::cerr << "Failed to reallocate TT - out of memory?" << std::endl;
+                std::terminate();
+            }
+
+            // spread the table over all nodes before clear() first-touches it,
+            // so that no single node's memory bandwidth becomes a bottleneck
+            if (m_numaInterleave) {
+                util::numa::interleave(m_clusters, bytes);
+            }
+        }
+
+        clear(threadCount);
+
+        return allocate;
+    }
+
+    bool TTable::waitForInit() {
+        if (!m_initThread.joinable()) {
+            return false;
         }
 
-        clear();
+        m_initThread.join();
+
+        // reported here rather than by the initialising thread, so
+        // that it cannot end up in the middle of another line of output
+        if (m_asyncAllocated) {
+            reportAllocation();
+        }
 
         return true;
     }
 
+    void TTable::reportAllocation() const {
+        protocol::currHandler().printInfoString(
+            *m_reportStream,
+            m_largePages ? "TT allocated with large pages" : "Large pages unavailable, TT allocated with normal pages"
+        );
+    }
+
+    std::optional<std::string> TTable::save(const std::string& path) const {
+        assert(!m_pendingInit);
+
+        // the table may be mapped from the file being overwritten, and truncating
+        // the file behind a mapping faults on the next access to it. write a new
+        // file next to it instead and rename it over the old one, which leaves the
+        // old file alive until the mapping is gone
+        const auto tmpPath = path + ".tmp";
+
+        std::ofstream stream{tmpPath, std::ios::binary | std::ios::trunc};
+
+        if (!stream) {
+            return "Failed to open '" + tmpPath + "' for writing";
+        }
+
+        const FileHeader header = {
+            .magic = kFileMagic,
+            .version = kFileVersion,
+            .entrySize = sizeof(Entry),
+            .entriesPerCluster = kEntriesPerCluster,
+            .age = m_age,
+            .clusterCount = m_clusterCount,
+        };
+
+        stream.write(reinterpret_cast<const char*>(&header), sizeof(FileHeader));
+        stream.write(
+            reinterpret_cast<const char*>(m_clusters),
+            static_cast<std::streamsize>(m_clusterCount * sizeof(Cluster))
+        );
+
+        stream.close();
+
+        if (!stream) {
+            std::remove(tmpPath.c_str());
+            return "Failed to write to '" + tmpPath + "'";
+        }
+
+        if (std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+            std::remove(tmpPath.c_str());
+            return "Failed to replace '" + path + "'";
+        }
+
+        return {};
+    }
+
+    std::optional<std::string> TTable::load(const std::string& path) {
+        waitForInit();
+
+        if (shared()) {
+            return "Cannot load a TT file into a shared TT";
+        }
+
+        auto mapping = util::MappedFile::open(path);
+
+        if (!mapping) {
+            return "Failed to open '" + path + "'";
+        }
+
+        if (mapping->size() < sizeof(FileHeader)) {
+            return "'" + path + "' is not a TT file";
+        }
+
+        FileHeader header{};
+        std::memcpy(&header, mapping->data(), sizeof(FileHeader));
+
+        if (header.magic != kFileMagic) {
+            return "'" + path + "' is not a TT file";
+        }
+
+        if (header.version != kFileVersion || header.entrySize != sizeof(Entry)
+            || header.entriesPerCluster != kEntriesPerCluster || header.age >= kAgeCycle)
+        {
+            return "'" + path + "' was saved with an incompatible TT layout";
+        }
+
+        if (header.clusterCount == 0 || mapping->size() != sizeof(FileHeader) + header.clusterCount * sizeof(Cluster))
+        {
+            return "'" + path + "' has the wrong size for its header";
+        }
+
+        deallocate();
+
+        m_mapping = std::move(*mapping);
+
+        m_clusters = reinterpret_cast<Cluster*>(m_mapping.data() + sizeof(FileHeader));
+        m_clusterCount = header.clusterCount;
+
+        m_age = header.age;
+        m_pendingInit = false;
+
+        return {};
+    }
+
+    std::optional<std::string> TTable::share(const std::string& name) {
+        waitForInit();
+
+        auto segment =
+            util::SharedMemory::openOrCreate(name, sizeof(SharedHeader) + m_privateClusterCount * sizeof(Cluster));
+
+        if (!segment) {
+            return "Failed to open shared TT '" + name + "'";
+        }
+
+        if (segment->size() < sizeof(SharedHeader)) {
+            return "'" + name + "' is not a shared TT";
+        }
+
+        auto& header = *reinterpret_cast<SharedHeader*>(segment->data());
+        const std::atomic_ref state{header.state};
+
+        if (segment->created()) {
+            header.magic = kSharedMagic;
+            header.version = kSharedVersion;
+            header.entrySize = sizeof(Entry);
+            header.entriesPerCluster = kEntriesPerCluster;
+            header.clusterCount = m_privateClusterCount;
+
+            state.store(kSharedReady, std::memory_order::release);
+        } else {
+            // the segment is zero-filled until its creator gets here
+            for (u32 attempt = 0; attempt < 1000 && state.load(std::memory_order::acquire) != kSharedReady; ++attempt) {
+                std::this_thread::sleep_for(std::chrono::milliseconds{1});
+            }
+
+            if (state.load(std::memory_order::acquire) != kSharedReady) {
+                return "Shared TT '" + name + "' was never initialised";
+            }
+        }
+
+        if (header.magic != kSharedMagic) {
+            return "'" + name + "' is not a shared TT";
+        }
+
+        if (header.version != kSharedVersion || header.entrySize != sizeof(Entry)
+            || header.entriesPerCluster != kEntriesPerCluster)
+        {
+            return "Shared TT '" + name + "' has an incompatible TT layout";
+        }
+
+        if (header.clusterCount == 0 || segment->size() < sizeof(SharedHeader) + header.clusterCount * sizeof(Cluster))
+        {
+            return "Shared TT '" + name + "' has the wrong size for its header";
+        }
+
+        deallocate();
+
+        m_shared = std::move(*segment);
+
+        m_clusters = reinterpret_cast<Cluster*>(m_shared.data() + sizeof(SharedHeader));
+        m_clusterCount = header.clusterCount;
+
+        sharedUsers().fetch_add(1, std::memory_order::relaxed);
+
+        m_sharedGeneration = sharedGeneration().load(std::memory_order::relaxed);
+        m_age = m_sharedGeneration & kAgeMask;
+        m_pendingInit = false;
+
+        return {};
+    }
+
+    void TTable::unshare() {
+        waitForInit();
+
+        if (!shared()) {
+            return;
+        }
+
+        deallocate();
+
+        m_clusterCount = m_privateClusterCount;
+        m_pendingInit = true;
+    }
+
+    void TTable::deallocate() {
+        if (!m_shared.empty()) {
+            if (sharedUsers().fetch_sub(1, std::memory_order::acq_rel) == 1) {
+                m_shared.unlink();
+            }
+
+            m_shared = util::SharedMemory{};
+        } else if (!m_mapping.empty()) {
+            m_mapping = util::MappedFile{};
+        } else if (m_clusters) {
+            util::freeLargePages(m_clusters);
+        }
+
+        m_clusters = nullptr;
+    }
+
     bool TTable::probe(ProbedEntry& dst, u64 key, i32 ply) const {
         assert(!m_pendingInit);
 
-        const auto entry = m_entries[index(key)];
+        const auto entryKey = packEntryKey(key);
+        const auto& cluster = m_clusters[index(key)];
 
-        if (entry.key == packEntryKey(key)) {
-            dst.score = scoreFromTt(static_cast<Score>(entry.score), ply);
-            dst.move = entry.move;
-            dst.depth = static_cast<i32>(entry.depth);
-            dst.flag = entry.flag;
+        for (const auto& slot : cluster.entries) {
+            const auto entry = loadEntry(slot);
 
-            return true;
+            if (entry.key() == entryKey && entry.flag() != Flag::kNone) {
+                dst.score = scoreFromTt(static_cast<Score>(entry.score), ply);
+                dst.move = entry.move;
+                dst.depth = entry.depth();
+                dst.flag = entry.flag();
+
+                return true;
+            }
         }
 
         return false;
@@ -118,36 +408,141 @@ namespace stoat::tt {
         assert(depth >= 0);
         assert(depth <= kMaxDepth);
 
-        auto& entry = m_entries[index(key)];
+        const auto entryKey = packEntryKey(key);
+        auto& cluster = m_clusters[index(key)];
+
+        const auto age = currentAge();
+
+        const auto relativeAge = [age](const Entry& entry) {
+            return (kAgeCycle + age - entry.age()) & kAgeMask;
+        };
+
+        // prefer an entry for this position or an empty slot, otherwise
+        // evict the entry with the lowest depth, penalising older entries
+        auto* entryPtr = &cluster.entries[0];
+        auto newEntry = loadEntry(*entryPtr);
+
+        auto minValue = std::numeric_limits<i32>::max();
+
+        for (auto& slot : cluster.entries) {
+            const auto candidate = loadEntry(slot);
+
+            if (candidate.key() == entryKey || candidate.flag() == Flag::kNone) {
+                entryPtr = &slot;
+                newEntry = candidate;
+                break;
+            }
+
+            const auto value = candidate.depth() - static_cast<i32>(relativeAge(candidate)) * 2;
+
+            if (value < minValue) {
+                entryPtr = &slot;
+                newEntry = candidate;
+                minValue = value;
+            }
+        }
+
+        // don't overwrite a deeper entry for the same position from this search with a non-exact bound
+        if (newEntry.key() == entryKey && newEntry.flag() != Flag::kNone && flag != Flag::kExact
+            && newEntry.age() == age && depth + 4 <= newEntry.depth())
+        {
+            return;
+        }
 
-        auto newEntry = entry;
+        // keep the old move if we don't have a new one
+        if (move || newEntry.key() != entryKey) {
+            newEntry.move = move;
+        }
 
-        newEntry.key = packEntryKey(key);
         newEntry.score = static_cast<i16>(scoreToTt(score, ply));
-        newEntry.move = move;
-        newEntry.depth = static_cast<u8>(depth);
-        newEntry.flag = flag;
+        newEntry.setKeyDepthAgeFlag(entryKey, depth, age, flag);
 
-        entry = newEntry;
+        storeEntry(*entryPtr, newEntry);
     }
 
-    void TTable::clear() {
+    void TTable::age() {
+        // Sessions move the shared generation on, so that entries stored by any of them
+        // in recent searches are preferred over older ones. It is only moved on if no other
+        // session has done so since this one last did, otherwise several sessions searching
+        // at once would age the table several times per search, and the 4 bit age of entries
+        // from their current searches would soon wrap around and make them look new again
+        if (shared()) {
+            auto generation = m_sharedGeneration;
+
+            // on failure, generation is the newer value that another session moved it on to
+            if (sharedGeneration().compare_exchange_strong(generation, generation + 1, std::memory_order::relaxed)) {
+                ++generation;
+            }
+
+            m_sharedGeneration = generation;
+            m_age = generation & kAgeMask;
+
+            return;
+        }
+
+        m_age = (m_age + 1) & kAgeMask;
+    }
+
+    void TTable::clear(u32 threadCount) {
         assert(!m_pendingInit);
-        std::memset(m_entries, 0, m_entryCount * sizeof(Entry));
+        assert(threadCount > 0);
+
+        // other sessions are still using the entries, just treat them as old
+        if (shared()) {
+            age();
+            return;
+        }
+
+        // 1 MiB, not worth starting a thread for less
+        constexpr usize kMinClustersPerThread = 16384;
+
+        threadCount = std::min<usize>(threadCount, std::max<usize>(1, m_clusterCount / kMinClustersPerThread));
+
+        if (threadCount == 1) {
+            std::memset(m_clusters, 0, m_clusterCount * sizeof(Cluster));
+        } else {
+            const auto chunkSize = (m_clusterCount + threadCount - 1) / threadCount;
+
+            std::vector<std::thread> threads{};
+            threads.reserve(threadCount);
+
+            for (u32 threadId = 0; threadId < threadCount; ++threadId) {
+                threads.emplace_back([this, threadId, chunkSize] {
+                    const auto start = chunkSize * threadId;
+
+                    if (start >= m_clusterCount) {
+                        return;
+                    }
+
+                    const auto count = std::min(chunkSize, m_clusterCount - start);
+                    std::memset(&m_clusters[start], 0, count * sizeof(Cluster));
+                });
+            }
+
+            for (auto& thread : threads) {
+                thread.join();
+            }
+        }
+
+        m_age = 0;
     }
 
     u32 TTable::fullPermille() const {
         assert(!m_pendingInit);
 
+        const auto age = currentAge();
+
         u32 filledEntries{};
 
         for (usize i = 0; i < 1000; ++i) {
-            const auto entry = m_entries[i];
-            if (entry.flag != Flag::kNone) {
-                ++filledEntries;
+            for (const auto& slot : m_clusters[i].entries) {
+                const auto entry = loadEntry(slot);
+                if (entry.flag() != Flag::kNone && entry.age() == age) {
+                    ++filledEntries;
+                }
             }
         }
 
-        return filledEntries;
+        return filledEntries / kEntriesPerCluster;
     }
 } // namespace stoat::tt
@@ -20,9 +20,20 @@
 
 #include "types.h"
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <thread>
+
 #include "core.h"
 #include "move.h"
+#include "util/mapped_file.h"
 #include "util/range.h"
+#include "util/shared_memory.h"
 
 namespace stoat::tt {
     constexpr usize kDefaultTtSizeMib = 64;
@@ -48,35 +59,223 @@ namespace stoat::tt {
         ~TTable();
 
         void resize(usize mib);
-        bool finalize();
+        void setNumaInterleave(bool enabled);
+
+        // where allocations are reported, subcommands with results on stdout move them elsewhere
+        inline void setReportStream(std::ostream& stream) {
+            m_reportStream = &stream;
+        }
+
+        // Starts allocating and clearing the table on a background thread, if it is
+        // pending initialisation. Nothing else may touch the table until finalize()
+        void beginFinalize(u32 threadCount);
+        // threadCount threads are used to clear the table. Returns
+        // whether the caller had to initialise it or wait for it
+        bool finalize(u32 threadCount);
 
         bool probe(ProbedEntry& dst, u64 key, i32 ply) const;
         void put(u64 key, Score score, Move move, i32 depth, i32 ply, Flag flag);
 
-        void clear();
+        inline void prefetch(u64 key) const {
+            __builtin_prefetch(&m_clusters[index(key)]);
+        }
+
+        void age();
+
+        void clear(u32 threadCount);
 
         [[nodiscard]] u32 fullPermille() const;
 
+        // Both return an error message on failure. Loading maps the file
+        // copy-on-write and resizes the table to the size it was saved with
+        [[nodiscard]] std::optional<std::string> save(const std::string& path) const;
+        [[nodiscard]] std::optional<std::string> load(const std::string& path);
+
+        // Maps the named segment that other searchers and processes can share, creating
+        // it with the last size passed to resize() if it does not exist yet and taking
+        // the size it was created with otherwise. Returns an error message on failure
+        [[nodiscard]] std::optional<std::string> share(const std::string& name);
+        // goes back to a private table of the last size passed to resize()
+        void unshare();
+
+        [[nodiscard]] inline bool shared() const {
+            return !m_shared.empty();
+        }
+
+        [[nodiscard]] inline usize sizeMib() const {
+            return m_clusterCount * sizeof(Cluster) / (1024 * 1024);
+        }
+
     private:
+        // Score and move take up half of an entry. The rest holds, from the low bits up, as
+        // many key bits as fit, then the depth, age and flag. Depths are stored saturated,
+        // anything deeper than the depth field can hold is only ever treated as shallower
+        static constexpr u32 kFlagBits = 2;
+        static constexpr u32 kAgeBits = 4;
+        static constexpr u32 kDepthBits = 7;
+        static constexpr u32 kKeyBits = 32 - kDepthBits - kAgeBits - kFlagBits;
+
+        static constexpr u32 kAgeCycle = 1 << kAgeBits;
+        static constexpr u32 kAgeMask = kAgeCycle - 1;
+
+        static constexpr u32 kMaxStoredDepth = (1 << kDepthBits) - 1;
+        static constexpr u32 kKeyMask = (1 << kKeyBits) - 1;
+
+        static constexpr u32 kDepthShift = kKeyBits;
+        static constexpr u32 kAgeShift = kDepthShift + kDepthBits;
+        static constexpr u32 kFlagShift = kAgeShift + kAgeBits;
+
         struct alignas(8) Entry {
-            u16 key;
             i16 score;
             Move move;
-            u8 depth;
-            Flag flag;
+            u32 packed;
+
+            [[nodiscard]] inline u32 key() const {
+                return packed & kKeyMask;
+            }
+
+            [[nodiscard]] inline i32 depth() const {
+                return static_cast<i32>((packed >> kDepthShift) & kMaxStoredDepth);
+            }
+
+            [[nodiscard]] inline u32 age() const {
+                return (packed >> kAgeShift) & kAgeMask;
+            }
+
+            [[nodiscard]] inline Flag flag() const {
+                return static_cast<Flag>(packed >> kFlagShift);
+            }
+
+            inline void setKeyDepthAgeFlag(u32 key, i32 depth, u32 age, Flag flag) {
+                assert(key <= kKeyMask);
+                assert(depth >= 0);
+                assert(age < kAgeCycle);
+
+                const auto storedDepth = std::min(static_cast<u32>(depth), kMaxStoredDepth);
+                packed = key | (storedDepth << kDepthShift) | (age << kAgeShift)
+                       | (static_cast<u32>(flag) << kFlagShift);
+            }
         };
 
         static_assert(sizeof(Entry) == 8);
 
+        // Entries are only ever read and written whole, as a single lock-free 8-byte
+        // word, so other search threads can never leave a probe with a torn entry that
+        // combines the key of one position with the score or move of another
+        static_assert(std::atomic_ref<Entry>::is_always_lock_free);
+
+        [[nodiscard]] static inline Entry loadEntry(const Entry& entry) {
+            // atomic_ref<const T> is C++26, loading never writes to the entry
+            return std::atomic_ref{const_cast<Entry&>(entry)}.load(std::memory_order::relaxed);
+        }
+
+        static inline void storeEntry(Entry& dst, const Entry& entry) {
+            std::atomic_ref{dst}.store(entry, std::memory_order::relaxed);
+        }
+
+        static constexpr usize kEntriesPerCluster = 8;
+
+        struct alignas(64) Cluster {
+            std::array<Entry, kEntriesPerCluster> entries;
+        };
+
+        static_assert(sizeof(Cluster) == 64);
+
+        // padded to a cluster, so that clusters in a mapped file stay aligned
+        struct alignas(sizeof(Cluster)) FileHeader {
+            std::array<char, 8> magic;
+            u32 version;
+            u32 entrySize;
+            u32 entriesPerCluster;
+            u32 age;
+            u64 clusterCount;
+        };
+
+        static_assert(sizeof(FileHeader) == sizeof(Cluster));
+
+        static constexpr u32 kSharedReady = 1;
+
+        // the start of a shared segment, padded like FileHeader
+        struct alignas(sizeof(Cluster)) SharedHeader {
+            std::array<char, 8> magic;
+            u32 version;
+            u32 entrySize;
+            u32 entriesPerCluster;
+            // kSharedReady once the creator has filled in the rest of the header
+            u32 state;
+            u64 clusterCount;
+            // shared by every session, searches age the table to the next one
+            u32 generation;
+            // sessions that have the segment mapped, the last one to unmap it removes it.
+            // a session that crashes leaves this too high, so the segment is never removed
+            u32 users;
+        };
+
+        static_assert(sizeof(SharedHeader) == sizeof(Cluster));
+
         bool m_pendingInit{};
+        bool m_numaInterleave{};
+
+        // running beginFinalize()'s initialisation, if joinable
+        std::thread m_initThread{};
+        // only read once the initialising thread has been joined
+        bool m_asyncAllocated{};
+
+        // whether the last allocation got large pages
+        bool m_largePages{};
+
+        std::ostream* m_reportStream{&std::cout};
 
         // is this an owning raw pointer? :fearful:
         // yes :pensive:
-        Entry* m_entries{};
-        usize m_entryCount{};
+        Cluster* m_clusters{};
+        usize m_clusterCount{};
+
+        // the size of a private table, a shared one keeps its segment's
+        usize m_privateClusterCount{};
+
+        u32 m_age{};
+        // the shared generation as of this session's last search, not masked to kAgeBits
+        u32 m_sharedGeneration{};
+
+        // non-empty if the table lives in a loaded file
+        util::MappedFile m_mapping{};
+        // non-empty if the table lives in a shared segment
+        util::SharedMemory m_shared{};
+
+        void deallocate();
+
+        // returns whether the table had to be allocated
+        bool init(u32 threadCount);
+        // returns whether there was an initialisation to wait for
+        bool waitForInit();
+
+        void reportAllocation() const;
+
+        [[nodiscard]] inline std::atomic_ref<u32> sharedGeneration() const {
+            assert(shared());
+            return std::atomic_ref{reinterpret_cast<SharedHeader*>(m_shared.data())->generation};
+        }
+
+        [[nodiscard]] inline std::atomic_ref<u32> sharedUsers() const {
+            assert(shared());
+            return std::atomic_ref{reinterpret_cast<SharedHeader*>(m_shared.data())->users};
+        }
+
+        // other sessions may have moved a shared table's generation on since this one last aged it,
+        // so it is read again rather than cached. otherwise their entries would look the oldest
+        [[nodiscard]] inline u32 currentAge() const {
+            return shared() ? sharedGeneration().load(std::memory_order::relaxed) & kAgeMask : m_age;
+        }
+
+        // index() consumes the high bits of the key, so the low bits
+        // stored here are independent of the cluster an entry is in
+        [[nodiscard]] static constexpr u32 packEntryKey(u64 key) {
+            return static_cast<u32>(key) & kKeyMask;
+        }
 
         [[nodiscard]] constexpr usize index(u64 key) const {
-            return static_cast<usize>((static_cast<u128>(key) * static_cast<u128>(m_entryCount)) >> 64);
+            return static_cast<usize>((static_cast<u128>(key) * static_cast<u128>(m_clusterCount)) >> 64);
         }
     };
 } // namespace stoat::tt
@@ -0,0 +1,102 @@
+/*
+ * Stoat, a USI shogi engine
+ * Copyright (C) 2025 Ciekce
+ *
+ * Stoat is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Stoat is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Stoat. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "tunable.h"
+
+#include <cmath>
+
+#ifdef ST_TUNE
+    #include <algorithm>
+    #include <cctype>
+#endif
+
+namespace stoat::tunable {
+    namespace {
+        [[nodiscard]] util::MultiArray<i32, 256, 64> computeLmrTable() {
+            const auto base = static_cast<f64>(lmrBase()) / 100.0;
+            const auto divisor = static_cast<f64>(lmrDivisor()) / 100.0;
+
+            util::MultiArray<i32, 256, 64> reductions{};
+
+            for (i32 depth = 1; depth < 256; ++depth) {
+                for (i32 moveNumber = 1; moveNumber < 64; ++moveNumber) {
+                    const auto lnDepth = std::log(static_cast<f64>(depth));
+                    const auto lnMoveNumber = std::log(static_cast<f64>(moveNumber));
+
+                    reductions[depth][moveNumber] = static_cast<i32>(base + lnDepth * lnMoveNumber / divisor);
+                }
+            }
+
+            return reductions;
+        }
+    } // namespace
+
+    // defined after every parameter, so that they are initialised first
+    util::MultiArray<i32, 256, 64> g_lmrTable = computeLmrTable();
+
+    void updateLmrTable() {
+        g_lmrTable = computeLmrTable();
+    }
+
+#ifdef ST_TUNE
+    namespace {
+        // references must survive more parameters being added
+        std::deque<TunableParam>& mutableParams() {
+            static std::deque<TunableParam> s_params{};
+            return s_params;
+        }
+    } // namespace
+
+    TunableParam& addParam(std::string_view name, i32 value, i32 min, i32 max, i32 step, void (*callback)()) {
+        assert(min <= value && value <= max);
+        assert(step > 0);
+
+        return mutableParams().emplace_back(TunableParam{
+            .name = name,
+            .defaultValue = value,
+            .value = value,
+            .min = min,
+            .max = max,
+            .step = step,
+            .callback = callback,
+        });
+    }
+
+    TunableParam* findParam(std::string_view name) {
+        const auto matches = [&](const TunableParam& param) {
+            return std::ranges::equal(param.name, name, [](char a, char b) {
+                return std::tolower(static_cast<u8>(a)) == std::tolower(static_cast<u8>(b));
+            });
+        };
+
+        const auto it = std::ranges::find_if(mutableParams(), matches);
+        return it == mutableParams().end() ? nullptr : &*it;
+    }
+
+    const std::deque<TunableParam>& params() {
+        return mutableParams();
+    }
+
+    void printSpsaInputs(std::ostream& stream) {
+        for (const auto& param : params()) {
+            stream << param.name << ", int, " << param.defaultValue << ", " << param.min << ", " << param.max << ", "
+                   << param.step << ", 0.002\n";
+        }
+    }
+#endif
+} // namespace stoat::tunable
@@ -0,0 +1,130 @@
+/*
+ * Stoat, a USI shogi engine
+ * Copyright (C) 2025 Ciekce
+ *
+ * Stoat is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Stoat is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Stoat. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "types.h"
+
+#include <cassert>
+#include <iostream>
+#include <string_view>
+
+#ifdef ST_TUNE
+    #include <deque>
+#endif
+
+#include "util/multi_array.h"
+
+// Search parameters. Tuning builds (the ST_TUNE define, the cmake option of the same name, or
+// TUNE=on with make) expose every one as a USI spin option and read it at runtime, other builds
+// fold each one to a constant, so that release builds pay nothing for them
+namespace stoat::tunable {
+#ifdef ST_TUNE
+    constexpr bool kTuning = true;
+#else
+    constexpr bool kTuning = false;
+#endif
+
+    // [depth][move index], computed from lmrBase and lmrDivisor
+    extern util::MultiArray<i32, 256, 64> g_lmrTable;
+
+    void updateLmrTable();
+
+#ifdef ST_TUNE
+    struct TunableParam {
+        std::string_view name;
+        i32 defaultValue;
+        i32 value;
+        i32 min;
+        i32 max;
+        i32 step;
+        // called after the value changes, if not null
+        void (*callback)();
+    };
+
+    TunableParam& addParam(std::string_view name, i32 value, i32 min, i32 max, i32 step, void (*callback)());
+
+    // in the order they were declared
+    [[nodiscard]] const std::deque<TunableParam>& params();
+
+    // null if there is no parameter of that name, compared case-insensitively
+    [[nodiscard]] TunableParam* findParam(std::string_view name);
+
+    // one line per parameter, name, int, default, min, max, step, learning rate
+    void printSpsaInputs(std::ostream& stream);
+
+    #define ST_TUNABLE_PARAM_CALLBACK(Name, Default, Min, Max, Step, Callback)                              \
+        inline TunableParam& param_##Name = addParam(#Name, Default, Min, Max, Step, Callback);             \
+        [[nodiscard]] inline i32 Name() {                                                                    \
+            return param_##Name.value;                                                                       \
+        }
+#else
+    #define ST_TUNABLE_PARAM_CALLBACK(Name, Default, Min, Max, Step, Callback) \
+        static_assert((Min) <= (Default) && (Default) <= (Max) && (Step) > 0); \
+        [[nodiscard]] constexpr i32 Name() {                                   \
+            return Default;                                                    \
+        }
+#endif
+
+#define ST_TUNABLE_PARAM(Name, Default, Min, Max, Step) \
+    ST_TUNABLE_PARAM_CALLBACK(Name, Default, Min, Max, Step, nullptr)
+
+    // in hundredths
+    ST_TUNABLE_PARAM_CALLBACK(lmrBase, 20, -50, 150, 10, updateLmrTable)
+    ST_TUNABLE_PARAM_CALLBACK(lmrDivisor, 350, 150, 600, 20, updateLmrTable)
+
+    ST_TUNABLE_PARAM(initialAspWindow, 50, 10, 150, 5)
+
+    ST_TUNABLE_PARAM(mate1MaxDepth, 4, 1, 12, 1)
+
+    ST_TUNABLE_PARAM(rfpMaxDepth, 4, 2, 10, 1)
+    ST_TUNABLE_PARAM(rfpMargin, 120, 40, 250, 10)
+
+    ST_TUNABLE_PARAM(nmpMinDepth, 4, 2, 8, 1)
+    ST_TUNABLE_PARAM(nmpReduction, 3, 2, 6, 1)
+
+    ST_TUNABLE_PARAM(probcutMinDepth, 5, 3, 10, 1)
+    ST_TUNABLE_PARAM(probcutMargin, 200, 80, 400, 15)
+    ST_TUNABLE_PARAM(probcutReduction, 4, 2, 6, 1)
+
+    ST_TUNABLE_PARAM(lmpMaxDepth, 8, 3, 12, 1)
+    ST_TUNABLE_PARAM(lmpBase, 3, 1, 10, 1)
+
+    ST_TUNABLE_PARAM(historyPruningMaxDepth, 4, 1, 8, 1)
+    ST_TUNABLE_PARAM(historyPruningMargin, 2048, 512, 6144, 256)
+
+    ST_TUNABLE_PARAM(seeCaptureMargin, 100, 30, 200, 10)
+    ST_TUNABLE_PARAM(seeNonCaptureMargin, 20, 5, 80, 5)
+
+    ST_TUNABLE_PARAM(fpMaxDepth, 4, 2, 10, 1)
+    ST_TUNABLE_PARAM(fpBase, 150, 50, 300, 15)
+    ST_TUNABLE_PARAM(fpScale, 100, 40, 200, 10)
+
+    ST_TUNABLE_PARAM(lmrHistoryDivisor, 8192, 2048, 16384, 512)
+
+    ST_TUNABLE_PARAM(seMinDepth, 8, 5, 12, 1)
+    ST_TUNABLE_PARAM(seBetaScale, 2, 1, 6, 1)
+
+    ST_TUNABLE_PARAM(qsearchSeeThreshold, -100, -300, 50, 15)
+
+    ST_TUNABLE_PARAM(deltaMargin, 200, 50, 500, 25)
+    ST_TUNABLE_PARAM(lazyEvalMargin, 2000, 800, 4000, 100)
+
+#undef ST_TUNABLE_PARAM
+#undef ST_TUNABLE_PARAM_CALLBACK
+} // namespace stoat::tunable
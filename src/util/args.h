@@ -0,0 +1,83 @@
+/*
+ * Stoat, a USI shogi engine
+ * Copyright (C) 2025 Ciekce
+ *
+ * Stoat is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Stoat is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Stoat. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "../types.h"
+
+#include <iostream>
+#include <span>
+#include <string_view>
+
+#include "parse.h"
+
+// Subcommand arguments: "--name value" options, mixed with positional arguments.
+// Every helper prints its own error, and handlers return false to stop parsing
+namespace stoat::util {
+    inline bool unexpectedArg(std::string_view arg) {
+        std::cerr << "Unexpected argument '" << arg << "'" << std::endl;
+        return false;
+    }
+
+    inline bool unknownOption(std::string_view command, std::string_view name) {
+        std::cerr << "Unknown " << command << " option '" << name << "'" << std::endl;
+        return false;
+    }
+
+    inline bool invalidArg(std::string_view what, std::string_view value) {
+        std::cerr << "Invalid " << what << " '" << value << "'" << std::endl;
+        return false;
+    }
+
+    template <typename T>
+    inline bool parseArg(T& dst, std::string_view value, std::string_view what) {
+        return tryParse(dst, value) || invalidArg(what, value);
+    }
+
+    // onOption(name, value) is called with the name including its leading dashes
+    template <typename OnOption, typename OnPositional>
+    [[nodiscard]] bool parseArgs(std::span<const std::string_view> args, OnOption onOption, OnPositional onPositional) {
+        for (usize idx = 0; idx < args.size(); ++idx) {
+            const auto arg = args[idx];
+
+            if (!arg.starts_with("--")) {
+                if (!onPositional(arg)) {
+                    return false;
+                }
+
+                continue;
+            }
+
+            if (idx + 1 >= args.size()) {
+                std::cerr << "Missing value for '" << arg << "'" << std::endl;
+                return false;
+            }
+
+            if (!onOption(arg, args[++idx])) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    template <typename OnOption>
+    [[nodiscard]] bool parseArgs(std::span<const std::string_view> args, OnOption onOption) {
+        return parseArgs(args, onOption, unexpectedArg);
+    }
+} // namespace stoat::util
@@ -22,10 +22,42 @@
 
 #include <atomic>
 #include <cassert>
-#include <condition_variable>
-#include <mutex>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__)
+    #include <immintrin.h>
+#endif
 
 namespace stoat::util {
+    // hint to the cpu that this is a spin loop
+    inline void spinPause() {
+#if defined(__x86_64__) || defined(__i386__)
+        _mm_pause();
+#elif defined(__aarch64__)
+        asm volatile("yield");
+#endif
+    }
+
+    // Waits until the atomic no longer holds the value. Spins for tens of microseconds
+    // before sleeping on a futex (std::atomic::wait), so that a thread woken soon
+    // after it starts waiting does not also pay for the sleep and wakeup
+    template <typename T>
+    inline void spinWait(const std::atomic<T>& atomic, T value) {
+        // spinning on a single core only delays the thread being waited for
+        static const u32 s_spinIterations = std::thread::hardware_concurrency() > 1 ? 1024 : 0;
+
+        for (u32 i = 0; i < s_spinIterations; ++i) {
+            if (atomic.load(std::memory_order::acquire) != value) {
+                return;
+            }
+
+            spinPause();
+        }
+
+        atomic.wait(value, std::memory_order::acquire);
+    }
+
+    // see spinWait(), search threads are woken through these at the start of every search
     class Barrier {
     public:
         explicit Barrier(i64 expected) {
@@ -41,31 +73,23 @@ namespace stoat::util {
         }
 
         void arriveAndWait() {
-            std::unique_lock lock{m_waitMutex};
-
-            const auto current = --m_current;
+            // cannot advance before this thread has arrived
+            const auto phase = m_phase.load(std::memory_order::acquire);
 
-            if (current > 0) {
-                const auto phase = m_phase.load(std::memory_order::relaxed);
-                m_waitSignal.wait(lock, [this, phase] {
-                    return (phase - m_phase.load(std::memory_order::acquire)) < 0;
-                });
+            if (m_current.fetch_sub(1, std::memory_order::acq_rel) > 1) {
+                spinWait(m_phase, phase);
             } else {
-                const auto total = m_total.load(std::memory_order::acquire);
-                m_current.store(total, std::memory_order::release);
+                // reset before the phase is published, as waiting threads may arrive again straight away
+                m_current.store(m_total.load(std::memory_order::relaxed), std::memory_order::relaxed);
 
-                ++m_phase;
-
-                m_waitSignal.notify_all();
+                m_phase.fetch_add(1, std::memory_order::release);
+                m_phase.notify_all();
             }
         }
 
     private:
         std::atomic<i64> m_total{};
         std::atomic<i64> m_current{};
-        std::atomic<i64> m_phase{};
-
-        std::mutex m_waitMutex{};
-        std::condition_variable m_waitSignal{};
+        std::atomic<u32> m_phase{};
     };
 } // namespace stoat::util
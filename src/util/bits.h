@@ -24,7 +24,7 @@
 
 #include "../arch.h"
 
-#if ST_HAS_FAST_PEXT
+#if ST_HAS_BMI2
     #include <immintrin.h>
 #endif
 
@@ -83,13 +83,23 @@ namespace stoat::util {
         }
     }
 
+    [[nodiscard]] constexpr i32 clz(u128 v) {
+        const auto [high, low] = fromU128(v);
+
+        if (high == 0) {
+            return 64 + std::countl_zero(low);
+        } else {
+            return std::countl_zero(high);
+        }
+    }
+
     [[nodiscard]] constexpr i32 popcount(u128 v) {
         const auto [high, low] = fromU128(v);
         return std::popcount(high) + std::popcount(low);
     }
 
     [[nodiscard]] constexpr u128 pext(u128 v, u128 mask, i32 shift) {
-#if ST_HAS_FAST_PEXT
+#if ST_HAS_BMI2
         if (std::is_constant_evaluated()) {
             return fallback::pext(v, mask);
         }
@@ -113,7 +123,7 @@ namespace stoat::util {
     }
 
     [[nodiscard]] constexpr u128 pdep(u128 v, u128 mask, i32 shift) {
-#if ST_HAS_FAST_PEXT
+#if ST_HAS_BMI2
         if (std::is_constant_evaluated()) {
             return fallback::pdep(v, mask);
         }
@@ -0,0 +1,149 @@
+/*
+ * Stoat, a USI shogi engine
+ * Copyright (C) 2025 Ciekce
+ *
+ * Stoat is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Stoat is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Stoat. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "large_pages.h"
+
+#ifdef _WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #include <Windows.h>
+#else // posix
+    #include <cstdlib>
+
+    #ifdef __linux__
+        #include <fstream>
+        #include <string>
+
+        #include <sys/mman.h>
+    #endif
+#endif
+
+namespace stoat::util {
+    namespace {
+        constexpr usize kPageSize = 4096;
+
+        [[nodiscard]] constexpr usize roundUp(usize size, usize alignment) {
+            return (size + alignment - 1) / alignment * alignment;
+        }
+
+#ifdef _WIN32
+        // requires the "Lock pages in memory" privilege, which
+        // has to be granted to the user by an administrator
+        [[nodiscard]] void* tryAllocWindowsLargePages(usize size) {
+            const auto largePageSize = GetLargePageMinimum();
+            if (largePageSize == 0) {
+                return nullptr;
+            }
+
+            HANDLE token{};
+            if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token)) {
+                return nullptr;
+            }
+
+            void* ptr{};
+
+            LUID luid{};
+            if (LookupPrivilegeValue(nullptr, SE_LOCK_MEMORY_NAME, &luid)) {
+                TOKEN_PRIVILEGES privileges{};
+                privileges.PrivilegeCount = 1;
+                privileges.Privileges[0].Luid = luid;
+                privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+
+                TOKEN_PRIVILEGES prevPrivileges{};
+                DWORD prevPrivilegesSize{};
+
+                // AdjustTokenPrivileges succeeds even if the privilege was not granted
+                if (AdjustTokenPrivileges(
+                        token,
+                        FALSE,
+                        &privileges,
+                        sizeof(TOKEN_PRIVILEGES),
+                        &prevPrivileges,
+                        &prevPrivilegesSize
+                    )
+                    && GetLastError() == ERROR_SUCCESS)
+                {
+                    ptr = VirtualAlloc(
+                        nullptr,
+                        roundUp(size, largePageSize),
+                        MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES,
+                        PAGE_READWRITE
+                    );
+
+                    AdjustTokenPrivileges(token, FALSE, &prevPrivileges, 0, nullptr, nullptr);
+                }
+            }
+
+            CloseHandle(token);
+
+            return ptr;
+        }
+#elif defined(__linux__)
+        constexpr usize kHugePageSize = 2 * 1024 * 1024;
+
+        [[nodiscard]] bool transparentHugePagesEnabled() {
+            std::ifstream stream{"/sys/kernel/mm/transparent_hugepage/enabled"};
+
+            std::string mode{};
+            if (!stream || !std::getline(stream, mode)) {
+                return false;
+            }
+
+            return mode.find("[never]") == std::string::npos;
+        }
+#endif
+    } // namespace
+
+    void* allocLargePages(usize size, bool& largePages) {
+        largePages = false;
+
+#ifdef _WIN32
+        if (auto* ptr = tryAllocWindowsLargePages(size)) {
+            largePages = true;
+            return ptr;
+        }
+
+        return VirtualAlloc(nullptr, roundUp(size, kPageSize), MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#elif defined(__linux__)
+        // not worth wasting up to 2 MiB on tiny allocations
+        const auto alignment = size >= kHugePageSize ? kHugePageSize : kPageSize;
+        const auto allocSize = roundUp(size, alignment);
+
+        auto* ptr = std::aligned_alloc(alignment, allocSize);
+
+        if (ptr && alignment == kHugePageSize) {
+            largePages = madvise(ptr, allocSize, MADV_HUGEPAGE) == 0 && transparentHugePagesEnabled();
+        }
+
+        return ptr;
+#else
+        return std::aligned_alloc(kPageSize, roundUp(size, kPageSize));
+#endif
+    }
+
+    void freeLargePages(void* ptr) {
+        if (!ptr) {
+            return;
+        }
+
+#ifdef _WIN32
+        VirtualFree(ptr, 0, MEM_RELEASE);
+#else
+        std::free(ptr);
+#endif
+    }
+} // namespace stoat::util
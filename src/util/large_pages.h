@@ -0,0 +1,29 @@
+/*
+ * Stoat, a USI shogi engine
+ * Copyright (C) 2025 Ciekce
+ *
+ * Stoat is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Stoat is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Stoat. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "../types.h"
+
+namespace stoat::util {
+    // Allocates at least size bytes, preferring large pages if the os gives
+    // them to us. The returned memory is always at least 4 KiB aligned, and
+    // must be freed with freeLargePages()
+    [[nodiscard]] void* allocLargePages(usize size, bool& largePages);
+    void freeLargePages(void* ptr);
+} // namespace stoat::util
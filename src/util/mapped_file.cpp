@@ -0,0 +1,152 @@
+/*
+ * Stoat, a USI shogi engine
+ * Copyright (C) 2025 Ciekce
+ *
+ * Stoat is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Stoat is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Stoat. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "mapped_file.h"
+
+#include <utility>
+
+#ifdef _WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #include <Windows.h>
+#else // posix
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+namespace stoat::util {
+    MappedFile::~MappedFile() {
+        unmap();
+    }
+
+#ifdef _WIN32
+    std::optional<MappedFile> MappedFile::open(const std::string& path) {
+        const auto file = CreateFileA(
+            path.c_str(),
+            GENERIC_READ,
+            FILE_SHARE_READ,
+            nullptr,
+            OPEN_EXISTING,
+            FILE_ATTRIBUTE_NORMAL,
+            nullptr
+        );
+
+        if (file == INVALID_HANDLE_VALUE) {
+            return {};
+        }
+
+        LARGE_INTEGER size{};
+
+        if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+            CloseHandle(file);
+            return {};
+        }
+
+        // the mapping keeps the file open
+        const auto mapping = CreateFileMappingA(file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+        CloseHandle(file);
+
+        if (!mapping) {
+            return {};
+        }
+
+        auto* data = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+
+        if (!data) {
+            CloseHandle(mapping);
+            return {};
+        }
+
+        MappedFile result{};
+
+        result.m_data = static_cast<std::byte*>(data);
+        result.m_size = static_cast<usize>(size.QuadPart);
+        result.m_mapping = mapping;
+
+        return result;
+    }
+
+    void MappedFile::unmap() {
+        if (m_data) {
+            UnmapViewOfFile(m_data);
+            CloseHandle(m_mapping);
+        }
+
+        m_data = nullptr;
+        m_size = 0;
+        m_mapping = nullptr;
+    }
+#else
+    std::optional<MappedFile> MappedFile::open(const std::string& path) {
+        const auto fd = ::open(path.c_str(), O_RDONLY);
+
+        if (fd < 0) {
+            return {};
+        }
+
+        struct stat stats{};
+
+        if (fstat(fd, &stats) != 0 || stats.st_size <= 0) {
+            close(fd);
+            return {};
+        }
+
+        const auto size = static_cast<usize>(stats.st_size);
+
+        // the mapping keeps the file open
+        auto* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        close(fd);
+
+        if (data == MAP_FAILED) {
+            return {};
+        }
+
+        MappedFile result{};
+
+        result.m_data = static_cast<std::byte*>(data);
+        result.m_size = size;
+
+        return result;
+    }
+
+    void MappedFile::unmap() {
+        if (m_data) {
+            munmap(m_data, m_size);
+        }
+
+        m_data = nullptr;
+        m_size = 0;
+    }
+#endif
+
+    MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+        if (this != &other) {
+            unmap();
+
+            m_data = std::exchange(other.m_data, nullptr);
+            m_size = std::exchange(other.m_size, 0);
+
+#ifdef _WIN32
+            m_mapping = std::exchange(other.m_mapping, nullptr);
+#endif
+        }
+
+        return *this;
+    }
+} // namespace stoat::util
@@ -0,0 +1,70 @@
+/*
+ * Stoat, a USI shogi engine
+ * Copyright (C) 2025 Ciekce
+ *
+ * Stoat is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Stoat is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Stoat. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "../types.h"
+
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <utility>
+
+namespace stoat::util {
+    // A private mapping of a whole file. Pages are only read from disk
+    // when first touched, and writes go to copy-on-write pages that are
+    // never written back to the file
+    class MappedFile {
+    public:
+        MappedFile() = default;
+        ~MappedFile();
+
+        MappedFile(const MappedFile&) = delete;
+
+        inline MappedFile(MappedFile&& other) noexcept {
+            *this = std::move(other);
+        }
+
+        [[nodiscard]] inline std::byte* data() const {
+            return m_data;
+        }
+
+        [[nodiscard]] inline usize size() const {
+            return m_size;
+        }
+
+        [[nodiscard]] inline bool empty() const {
+            return m_data == nullptr;
+        }
+
+        [[nodiscard]] static std::optional<MappedFile> open(const std::string& path);
+
+        MappedFile& operator=(const MappedFile&) = delete;
+        MappedFile& operator=(MappedFile&& other) noexcept;
+
+    private:
+        void unmap();
+
+        std::byte* m_data{};
+        usize m_size{};
+
+#ifdef _WIN32
+        void* m_mapping{};
+#endif
+    };
+} // namespace stoat::util
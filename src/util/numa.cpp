@@ -0,0 +1,166 @@
+/*
+ * Stoat, a USI shogi engine
+ * Copyright (C) 2025 Ciekce
+ *
+ * Stoat is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Stoat is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Stoat. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "numa.h"
+
+#ifdef __linux__
+    #include <algorithm>
+    #include <fstream>
+    #include <string>
+    #include <vector>
+
+    #include <linux/mempolicy.h>
+    #include <pthread.h>
+    #include <sched.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
+
+    #include "parse.h"
+    #include "split.h"
+#endif
+
+namespace stoat::util::numa {
+#ifdef __linux__
+    namespace {
+        // parses the kernel's cpu/node list format, e.g. "0-3,8-11"
+        [[nodiscard]] std::vector<u32> readList(const std::string& path) {
+            std::ifstream stream{path};
+
+            std::string line{};
+            if (!stream || !std::getline(stream, line)) {
+                return {};
+            }
+
+            std::vector<std::string_view> ranges{};
+            split(ranges, line, ',');
+
+            std::vector<u32> result{};
+
+            for (const auto range : ranges) {
+                const auto dash = range.find('-');
+
+                u32 first{};
+                u32 last{};
+
+                if (dash == std::string_view::npos) {
+                    if (!tryParse(first, range)) {
+                        return {};
+                    }
+
+                    last = first;
+                } else if (!tryParse(first, range.substr(0, dash)) || !tryParse(last, range.substr(dash + 1))) {
+                    return {};
+                }
+
+                for (u32 value = first; value <= last; ++value) {
+                    result.push_back(value);
+                }
+            }
+
+            return result;
+        }
+
+        struct Topology {
+            // cpus of each node that has any
+            std::vector<std::vector<u32>> nodeCpus{};
+            // nodes with memory attached
+            std::vector<u32> memoryNodes{};
+        };
+
+        const Topology& topology() {
+            static const auto s_topology = [] {
+                Topology topology{};
+
+                for (const auto node : readList("/sys/devices/system/node/has_cpu")) {
+                    auto cpus = readList("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+                    if (!cpus.empty()) {
+                        topology.nodeCpus.push_back(std::move(cpus));
+                    }
+                }
+
+                topology.memoryNodes = readList("/sys/devices/system/node/has_memory");
+
+                return topology;
+            }();
+
+            return s_topology;
+        }
+    } // namespace
+
+    u32 nodeCount() {
+        return std::max<u32>(1, topology().nodeCpus.size());
+    }
+
+    bool bindThreadToNode(u32 node) {
+        const auto& nodeCpus = topology().nodeCpus;
+
+        if (nodeCpus.size() < 2 || node >= nodeCpus.size()) {
+            return false;
+        }
+
+        cpu_set_t set;
+        CPU_ZERO(&set);
+
+        for (const auto cpu : nodeCpus[node]) {
+            if (cpu < CPU_SETSIZE) {
+                CPU_SET(cpu, &set);
+            }
+        }
+
+        return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+    }
+
+    bool interleave(void* ptr, usize size) {
+        const auto& memoryNodes = topology().memoryNodes;
+
+        if (memoryNodes.size() < 2) {
+            return false;
+        }
+
+        constexpr usize kBitsPerWord = sizeof(unsigned long) * 8;
+
+        std::vector<unsigned long> mask{};
+
+        for (const auto node : memoryNodes) {
+            const auto word = node / kBitsPerWord;
+
+            if (word >= mask.size()) {
+                mask.resize(word + 1);
+            }
+
+            mask[word] |= 1UL << (node % kBitsPerWord);
+        }
+
+        // the kernel ignores the final bit of maxnode
+        const auto maxNode = mask.size() * kBitsPerWord + 1;
+        return syscall(SYS_mbind, ptr, size, MPOL_INTERLEAVE, mask.data(), maxNode, 0) == 0;
+    }
+#else
+    u32 nodeCount() {
+        return 1;
+    }
+
+    bool bindThreadToNode([[maybe_unused]] u32 node) {
+        return false;
+    }
+
+    bool interleave([[maybe_unused]] void* ptr, [[maybe_unused]] usize size) {
+        return false;
+    }
+#endif
+} // namespace stoat::util::numa
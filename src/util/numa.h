@@ -0,0 +1,40 @@
+/*
+ * Stoat, a USI shogi engine
+ * Copyright (C) 2025 Ciekce
+ *
+ * Stoat is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Stoat is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Stoat. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "../types.h"
+
+// Minimal numa support without a libnuma dependency. Only implemented
+// on Linux, everywhere else the machine is treated as a single node
+namespace stoat::util::numa {
+    // number of numa nodes with at least one cpu, always at least 1
+    [[nodiscard]] u32 nodeCount();
+
+    // node that the search thread with the given id should run on
+    [[nodiscard]] inline u32 nodeForThread(u32 threadId) {
+        return threadId % nodeCount();
+    }
+
+    // restricts the calling thread to the cpus of the given node
+    bool bindThreadToNode(u32 node);
+
+    // interleaves the pages of a not-yet-touched allocation over all nodes
+    // ptr must be page-aligned
+    bool interleave(void* ptr, usize size);
+} // namespace stoat::util::numa
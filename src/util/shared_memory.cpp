@@ -0,0 +1,247 @@
+/*
+ * Stoat, a USI shogi engine
+ * Copyright (C) 2025 Ciekce
+ *
+ * Stoat is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Stoat is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Stoat. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "shared_memory.h"
+
+#include <utility>
+
+#ifdef _WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #include <Windows.h>
+#else // posix
+    #include <cerrno>
+    #include <chrono>
+    #include <thread>
+
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+namespace stoat::util {
+    SharedMemory::~SharedMemory() {
+        unmap();
+    }
+
+#ifdef _WIN32
+    std::optional<SharedMemory> SharedMemory::openOrCreate(const std::string& name, usize size) {
+        const auto fullName = "Local\\stoat-" + name;
+
+        const auto mapping = CreateFileMappingA(
+            INVALID_HANDLE_VALUE,
+            nullptr,
+            PAGE_READWRITE,
+            static_cast<DWORD>(static_cast<u64>(size) >> 32),
+            static_cast<DWORD>(size),
+            fullName.c_str()
+        );
+
+        if (!mapping) {
+            return {};
+        }
+
+        const bool created = GetLastError() != ERROR_ALREADY_EXISTS;
+
+        auto* data = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+
+        if (!data) {
+            CloseHandle(mapping);
+            return {};
+        }
+
+        // rounded up to whole pages, which only matters for segments created elsewhere
+        MEMORY_BASIC_INFORMATION info{};
+
+        if (VirtualQuery(data, &info, sizeof(info)) == 0) {
+            UnmapViewOfFile(data);
+            CloseHandle(mapping);
+            return {};
+        }
+
+        SharedMemory result{};
+
+        result.m_data = static_cast<std::byte*>(data);
+        result.m_size = created ? size : static_cast<usize>(info.RegionSize);
+        result.m_created = created;
+        result.m_mapping = mapping;
+
+        return result;
+    }
+
+    void SharedMemory::unmap() {
+        if (m_data) {
+            UnmapViewOfFile(m_data);
+            CloseHandle(m_mapping);
+        }
+
+        m_data = nullptr;
+        m_size = 0;
+        m_created = false;
+        m_mapping = nullptr;
+    }
+
+    void SharedMemory::unlink() {
+        // named mappings go away with their last handle
+    }
+#else
+    namespace {
+        // whether the name refers to the segment with these stats
+        bool namesSegment(const std::string& name, const struct stat& stats) {
+            const auto fd = shm_open(name.c_str(), O_RDONLY, 0);
+
+            if (fd < 0) {
+                return false;
+            }
+
+            struct stat current{};
+            const bool same =
+                fstat(fd, &current) == 0 && current.st_dev == stats.st_dev && current.st_ino == stats.st_ino;
+
+            close(fd);
+
+            return same;
+        }
+    } // namespace
+
+    std::optional<SharedMemory> SharedMemory::openOrCreate(const std::string& name, usize size) {
+        const auto fullName = "/stoat-" + name;
+
+        // retried once, after removing a segment that was never sized
+        for (u32 attempt = 0; attempt < 2; ++attempt) {
+            bool created = true;
+            auto fd = shm_open(fullName.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+
+            if (fd >= 0) {
+                if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+                    close(fd);
+                    shm_unlink(fullName.c_str());
+                    return {};
+                }
+            } else if (errno == EEXIST) {
+                created = false;
+                fd = shm_open(fullName.c_str(), O_RDWR, 0);
+            }
+
+            if (fd < 0) {
+                return {};
+            }
+
+            struct stat stats{};
+
+            if (fstat(fd, &stats) != 0) {
+                close(fd);
+                return {};
+            }
+
+            // the creator may not have sized the segment yet
+            for (u32 wait = 0; !created && stats.st_size <= 0 && wait < 1000; ++wait) {
+                std::this_thread::sleep_for(std::chrono::milliseconds{1});
+
+                if (fstat(fd, &stats) != 0) {
+                    close(fd);
+                    return {};
+                }
+            }
+
+            if (!created && stats.st_size <= 0) {
+                // its creator died before sizing it, so nothing can be using it
+                if (namesSegment(fullName, stats)) {
+                    shm_unlink(fullName.c_str());
+                }
+
+                close(fd);
+                continue;
+            }
+
+            if (!created) {
+                size = static_cast<usize>(stats.st_size);
+            }
+
+            // the mapping keeps the segment open
+            auto* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            close(fd);
+
+            if (data == MAP_FAILED) {
+                return {};
+            }
+
+            SharedMemory result{};
+
+            result.m_data = static_cast<std::byte*>(data);
+            result.m_size = size;
+            result.m_created = created;
+            result.m_name = fullName;
+            result.m_device = static_cast<u64>(stats.st_dev);
+            result.m_inode = static_cast<u64>(stats.st_ino);
+
+            return result;
+        }
+
+        return {};
+    }
+
+    void SharedMemory::unlink() {
+        if (!m_data) {
+            return;
+        }
+
+        struct stat stats{};
+
+        stats.st_dev = static_cast<dev_t>(m_device);
+        stats.st_ino = static_cast<ino_t>(m_inode);
+
+        if (namesSegment(m_name, stats)) {
+            shm_unlink(m_name.c_str());
+        }
+    }
+
+    void SharedMemory::unmap() {
+        if (m_data) {
+            munmap(m_data, m_size);
+        }
+
+        m_data = nullptr;
+        m_size = 0;
+        m_created = false;
+        m_name.clear();
+        m_device = 0;
+        m_inode = 0;
+    }
+#endif
+
+    SharedMemory& SharedMemory::operator=(SharedMemory&& other) noexcept {
+        if (this != &other) {
+            unmap();
+
+            m_data = std::exchange(other.m_data, nullptr);
+            m_size = std::exchange(other.m_size, 0);
+            m_created = std::exchange(other.m_created, false);
+
+#ifdef _WIN32
+            m_mapping = std::exchange(other.m_mapping, nullptr);
+#else
+            m_name = std::exchange(other.m_name, {});
+            m_device = std::exchange(other.m_device, 0);
+            m_inode = std::exchange(other.m_inode, 0);
+#endif
+        }
+
+        return *this;
+    }
+} // namespace stoat::util
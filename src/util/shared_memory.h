@@ -0,0 +1,87 @@
+/*
+ * Stoat, a USI shogi engine
+ * Copyright (C) 2025 Ciekce
+ *
+ * Stoat is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Stoat is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Stoat. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "../types.h"
+
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <utility>
+
+namespace stoat::util {
+    // A named read-write mapping that other processes can map too, writes are
+    // visible to all of them. The segment outlives the process that created it,
+    // until unlink() is called
+    class SharedMemory {
+    public:
+        SharedMemory() = default;
+        ~SharedMemory();
+
+        SharedMemory(const SharedMemory&) = delete;
+
+        inline SharedMemory(SharedMemory&& other) noexcept {
+            *this = std::move(other);
+        }
+
+        [[nodiscard]] inline std::byte* data() const {
+            return m_data;
+        }
+
+        [[nodiscard]] inline usize size() const {
+            return m_size;
+        }
+
+        [[nodiscard]] inline bool empty() const {
+            return m_data == nullptr;
+        }
+
+        // whether this mapping created the segment, in which case it is zero-filled
+        [[nodiscard]] inline bool created() const {
+            return m_created;
+        }
+
+        // Maps the segment with this name, creating it with the given size if it does
+        // not exist yet. An existing segment is mapped whole, whatever its size
+        [[nodiscard]] static std::optional<SharedMemory> openOrCreate(const std::string& name, usize size);
+
+        // Removes the name, so that the next openOrCreate() creates a new segment. Existing
+        // mappings stay valid. Does nothing if the name now refers to a newer segment
+        void unlink();
+
+        SharedMemory& operator=(const SharedMemory&) = delete;
+        SharedMemory& operator=(SharedMemory&& other) noexcept;
+
+    private:
+        void unmap();
+
+        std::byte* m_data{};
+        usize m_size{};
+        bool m_created{};
+
+#ifdef _WIN32
+        void* m_mapping{};
+#else
+        std::string m_name{};
+        // identify the segment that was mapped, the name may have been reused since
+        u64 m_device{};
+        u64 m_inode{};
+#endif
+    };
+} // namespace stoat::util
@@ -61,6 +61,10 @@ namespace stoat::util {
             return m_size == 0;
         }
 
+        [[nodiscard]] static constexpr usize capacity() {
+            return Capacity;
+        }
+
         [[nodiscard]] inline const T& operator[](usize i) const {
             assert(i < m_size);
             return m_data[i];